@@ -0,0 +1,117 @@
+/**
+ * Affinity.h
+ *
+ * This is the Affinity.h file that pins threads to CPUs and NUMA nodes.
+ * The CPUs of a node are read from sysfs, so no NUMA library is needed.
+ * Memory placement relies on the kernel's first-touch policy: pages are
+ * placed on the node of the CPU that first writes them, so a thread
+ * that allocates and initializes data while pinned to a node keeps that
+ * data local to the node. Allocations served from pages that were
+ * touched before stay where they are.
+ *
+ * Every function returns false instead of failing when the machine has
+ * no such CPU or node, so callers can treat pinning as a hint.
+ **/
+#ifndef AFFINITY_H_
+#define AFFINITY_H_
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+using namespace std;
+
+/**
+ * This returns the number of CPUs online.
+ * No other methods are called.
+ * @return number of online CPUs, at least 1
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+inline int cpuCount()
+{
+   long count = sysconf(_SC_NPROCESSORS_ONLN);
+   return (count < 1) ? 1 : (int) count;
+}
+
+/**
+ * Reads the set of CPUs belonging to a NUMA node.
+ * No other methods are called.
+ * @param node NUMA node number
+ * @param cpus receives the node's CPUs
+ * @return true if the node exists and has CPUs
+ * @custom.preconditions  cpus != NULL
+ * @custom.postconditions  cpus holds the node's CPUs on success
+ **/
+inline bool nodeCpus(int node, cpu_set_t* cpus)
+{
+   char path[64];
+   snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+   FILE* file = fopen(path, "r");
+   if (file == NULL) {
+      return false;
+   }
+   char list[1024];
+   bool read = fgets(list, sizeof(list), file) != NULL;
+   fclose(file);
+   if (!read) {
+      return false;
+   }
+
+   /** cpulist is a comma separated list of CPUs and ranges, e.g. 0-3,8 */
+   CPU_ZERO(cpus);
+   char* next = list;
+   while (*next >= '0' && *next <= '9') {
+      int first = (int) strtol(next, &next, 10);
+      int last = first;
+      if (*next == '-') {
+         last = (int) strtol(next + 1, &next, 10);
+      }
+      for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+         CPU_SET(cpu, cpus);
+      }
+      if (*next == ',') {
+         ++next;
+      }
+   }
+   return CPU_COUNT(cpus) > 0;
+}
+
+/**
+ * Restricts a thread to a single CPU.
+ * No other methods are called.
+ * @param thread thread to pin
+ * @param cpu CPU number
+ * @return true if the thread was pinned
+ * @custom.preconditions  thread is running
+ * @custom.postconditions  thread only runs on cpu on success
+ **/
+inline bool pinToCpu(pthread_t thread, int cpu)
+{
+   if (cpu < 0 || cpu >= CPU_SETSIZE) {
+      return false;
+   }
+   cpu_set_t cpus;
+   CPU_ZERO(&cpus);
+   CPU_SET(cpu, &cpus);
+   return pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0;
+}
+
+/**
+ * Restricts a thread to the CPUs of a NUMA node.
+ * Calls nodeCpus method.
+ * @param thread thread to pin
+ * @param node NUMA node number
+ * @return true if the thread was pinned
+ * @custom.preconditions  thread is running
+ * @custom.postconditions  thread only runs on the node's CPUs on success
+ **/
+inline bool pinToNode(pthread_t thread, int node)
+{
+   cpu_set_t cpus;
+   if (!nodeCpus(node, &cpus)) {
+      return false;
+   }
+   return pthread_setaffinity_np(thread, sizeof(cpus), &cpus) == 0;
+}
+#endif
@@ -0,0 +1,255 @@
+/**
+ * ArrivalProcess.cpp
+ *
+ * This is the ArrivalProcess.cpp file that implements the methods of the
+ * ArrivalProcess class. Arrivals are generated as offsets from the start
+ * and paced against absolute deadlines on CLOCK_MONOTONIC.
+ **/
+#include "ArrivalProcess.h"
+#include <algorithm>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/prctl.h>
+#include "Clock.h"
+#include "WaitStrategy.h"
+
+/**
+ * Creates the process and, for a trace, reads the trace file.
+ * No other methods are called.
+ * @param options arrival process and its parameters
+ * @return none
+ * @custom.preconditions  rate_ > 0 unless replaying a trace
+ * @custom.postconditions  good() tells whether the trace could be read
+ **/
+ArrivalProcess::ArrivalProcess(const ArrivalOptions& options) :
+   options_(options), rng_(options.seed_), offset_ns_(0), generated_(0), in_burst_(false),
+   state_end_ns_(0), quiet_rate_(0), burst_rate_(0), good_(true), start_ns_(0), last_ns_(0), arrivals_(0)
+{
+   if (options_.kind_ == kTraceArrivals) {
+      good_ = loadTrace();
+   } else if (options_.kind_ == kBurstyArrivals) {
+      /** rates that average to rate_ over the fraction of time in bursts */
+      double f = options_.burst_fraction_;
+      quiet_rate_ = options_.rate_ / (f * options_.burst_ratio_ + (1.0 - f));
+      burst_rate_ = quiet_rate_ * options_.burst_ratio_;
+      /** the first state switch starts with a quiet period */
+      in_burst_ = true;
+   }
+}
+
+/**
+ * This returns false if a trace was requested but could not be read.
+ * No other methods are called.
+ * @return true if the process can generate arrivals
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+bool ArrivalProcess::good() const
+{
+   return good_;
+}
+
+/**
+ * Reads the trace file.
+ * No other methods are called.
+ * @return false if the file could not be read or holds no arrivals
+ * @custom.preconditions  options_.trace_path_ != NULL
+ * @custom.postconditions  trace_ holds the arrival times in order
+ **/
+bool ArrivalProcess::loadTrace()
+{
+   FILE* file = (options_.trace_path_ != NULL) ? fopen(options_.trace_path_, "r") : NULL;
+   if (file == NULL) {
+      return false;
+   }
+   char line[128];
+   while (fgets(line, sizeof(line), file) != NULL) {
+      if (line[0] == '#') {
+         continue;
+      }
+      char* end = NULL;
+      double time_us = strtod(line, &end);
+      if (end != line && time_us >= 0) {
+         trace_.push_back((uint64_t) (time_us * 1000.0));
+      }
+   }
+   fclose(file);
+   /** arrivals are released in time order whatever order they were recorded in */
+   sort(trace_.begin(), trace_.end());
+   return !trace_.empty();
+}
+
+/**
+ * This returns the gap until the next bursty arrival, switching
+ * between bursts and quiet periods as their ends are passed.
+ * No other methods are called.
+ * @return gap in nanoseconds after offset_ns_
+ * @custom.preconditions  bursty arrivals
+ * @custom.postconditions  burst state follows offset_ns_ + gap
+ **/
+uint64_t ArrivalProcess::burstyGap()
+{
+   double f = options_.burst_fraction_;
+   double burst_s = options_.burst_length_s_;
+   double quiet_s = burst_s * (1.0 - f) / f;
+   uint64_t now_ns = offset_ns_;
+   while (true) {
+      if (now_ns >= state_end_ns_) {
+         /** both periods are exponential, so the process is memoryless */
+         in_burst_ = !in_burst_;
+         exponential_distribution<double> length(1.0 / (in_burst_ ? burst_s : quiet_s));
+         state_end_ns_ = now_ns + (uint64_t) (length(rng_) * 1e9);
+      }
+      exponential_distribution<double> gap_s(in_burst_ ? burst_rate_ : quiet_rate_);
+      uint64_t arrival_ns = now_ns + (uint64_t) (gap_s(rng_) * 1e9);
+      if (arrival_ns < state_end_ns_) {
+         return arrival_ns - offset_ns_;
+      }
+      now_ns = state_end_ns_;
+   }
+}
+
+/**
+ * Computes the time of the next arrival without waiting for it.
+ * No other methods are called.
+ * @param offset_ns receives the arrival time since the start in nanoseconds
+ * @return false once a trace has no more arrivals
+ * @custom.preconditions  none
+ * @custom.postconditions  process advanced by one arrival
+ **/
+bool ArrivalProcess::next(uint64_t* offset_ns)
+{
+   switch (options_.kind_) {
+   case kTraceArrivals:
+      if (generated_ >= (long) trace_.size()) {
+         return false;
+      }
+      offset_ns_ = trace_[generated_];
+      break;
+   case kConstantArrivals:
+      /** computed from the index so rounding never accumulates */
+      offset_ns_ = (uint64_t) ((generated_ + 1) * 1e9 / options_.rate_);
+      break;
+   case kUniformArrivals: {
+      uniform_real_distribution<double> gap_s(0.0, 2.0 / options_.rate_);
+      offset_ns_ += (uint64_t) (gap_s(rng_) * 1e9);
+      break;
+   }
+   case kBurstyArrivals:
+      offset_ns_ += burstyGap();
+      break;
+   default: {
+      exponential_distribution<double> gap_s(options_.rate_);
+      offset_ns_ += (uint64_t) (gap_s(rng_) * 1e9);
+      break;
+   }
+   }
+   ++generated_;
+   *offset_ns = offset_ns_;
+   return true;
+}
+
+/**
+ * Starts the clock that waitNext paces against and lowers the calling
+ * thread's timer slack.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  called by the thread that calls waitNext
+ * @custom.postconditions  time 0 of the arrivals is now
+ **/
+void ArrivalProcess::start()
+{
+   /** the default 50 μs of slack would delay every wake-up by that much */
+   prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);
+   start_ns_ = monotonicNs();
+   last_ns_ = start_ns_;
+}
+
+/**
+ * Waits until the next arrival is due.
+ * Calls next method.
+ * @return false once a trace has no more arrivals
+ * @custom.preconditions  start has been called
+ * @custom.postconditions  the next arrival is due, lateness recorded
+ **/
+bool ArrivalProcess::waitNext()
+{
+   uint64_t offset_ns = 0;
+   if (!next(&offset_ns)) {
+      return false;
+   }
+   uint64_t deadline_ns = start_ns_ + offset_ns;
+
+   /** Sleep to an absolute deadline so oversleeping never accumulates */
+   if (deadline_ns > options_.spin_ns_ && monotonicNs() < deadline_ns - options_.spin_ns_) {
+      uint64_t wake_ns = deadline_ns - options_.spin_ns_;
+      struct timespec wake;
+      wake.tv_sec = wake_ns / 1000000000ULL;
+      wake.tv_nsec = wake_ns % 1000000000ULL;
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL) == EINTR) {
+      }
+   }
+   uint64_t now_ns = monotonicNs();
+   while (now_ns < deadline_ns) {
+      cpuRelax();
+      now_ns = monotonicNs();
+   }
+
+   lateness_.record(now_ns - deadline_ns);
+   last_ns_ = now_ns;
+   ++arrivals_;
+   return true;
+}
+
+/**
+ * This returns the mean arrival rate the process was asked for.
+ * No other methods are called.
+ * @return arrivals per second, for a trace its count over its length
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+double ArrivalProcess::get_requested_rate() const
+{
+   if (options_.kind_ == kTraceArrivals) {
+      return (trace_.empty() || trace_.back() == 0) ? 0.0 : trace_.size() / (trace_.back() / 1e9);
+   }
+   return options_.rate_;
+}
+
+/**
+ * This returns the rate at which waitNext actually released arrivals.
+ * No other methods are called.
+ * @return arrivals per second from start until the last arrival, 0 if none
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+double ArrivalProcess::get_achieved_rate() const
+{
+   return (last_ns_ <= start_ns_) ? 0.0 : arrivals_ / ((last_ns_ - start_ns_) / 1e9);
+}
+
+/**
+ * This returns the number of arrivals released by waitNext.
+ * No other methods are called.
+ * @return number of arrivals
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long ArrivalProcess::get_arrivals() const
+{
+   return arrivals_;
+}
+
+/**
+ * This returns how late waitNext released each arrival.
+ * No other methods are called.
+ * @return histogram of lateness in nanoseconds
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+const Histogram& ArrivalProcess::get_lateness() const
+{
+   return lateness_;
+}
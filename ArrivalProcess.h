@@ -0,0 +1,204 @@
+/**
+ * ArrivalProcess.h
+ *
+ * This is the ArrivalProcess.h file that defines the ArrivalProcess class,
+ * which decides when customers arrive and paces the caller to those
+ * instants. Arrival times come from a seeded generator, so a run offers
+ * the same load every time:
+ *
+ * Poisson arrivals have exponential gaps, uniform arrivals have gaps
+ * spread evenly over [0, 2 / rate), constant arrivals are exactly 1 / rate
+ * apart and bursty arrivals follow a two-state Markov-modulated Poisson
+ * process that alternates between bursts and quiet periods. A trace
+ * replays arrival times read from a file, one time in μ seconds since the
+ * start per line, lines starting with # ignored.
+ *
+ * Each arrival is due at an absolute deadline from the start, so pacing
+ * errors never accumulate. The caller sleeps with clock_nanosleep until
+ * shortly before the deadline and spins for the rest, with the thread's
+ * timer slack set to the minimum. The lateness of every arrival and the
+ * achieved rate are reported next to the requested rate.
+ **/
+#ifndef ARRIVAL_PROCESS_H_
+#define ARRIVAL_PROCESS_H_
+#include <stdint.h>
+#include <random>
+#include <vector>
+#include "Histogram.h"
+using namespace std;
+
+/** default time spun before a deadline instead of sleeping, in nanoseconds */
+#define kArrivalSpinNs 20000
+
+/** arrival processes an ArrivalProcess can generate */
+enum ArrivalKind {
+   /** exponential gaps */
+   kPoissonArrivals,
+   /** gaps uniform in [0, 2 / rate) */
+   kUniformArrivals,
+   /** two-state Markov-modulated Poisson process */
+   kBurstyArrivals,
+   /** gaps of exactly 1 / rate */
+   kConstantArrivals,
+   /** arrival times read from a trace file */
+   kTraceArrivals
+};
+
+/** settings of an ArrivalProcess */
+struct ArrivalOptions {
+   /** arrival process */
+   ArrivalKind kind_{kPoissonArrivals};
+   /** mean number of arrivals per second, unused by traces */
+   double rate_{1000.0};
+   /** seed of the generator */
+   unsigned long seed_{1};
+   /** bursty, arrival rate in a burst over the rate between bursts */
+   double burst_ratio_{10.0};
+   /** bursty, fraction of the time spent in bursts */
+   double burst_fraction_{0.1};
+   /** bursty, mean length of a burst in seconds */
+   double burst_length_s_{0.01};
+   /** trace, file of arrival times in μ seconds */
+   const char* trace_path_{NULL};
+   /** time spun before each deadline instead of sleeping, 0 to only sleep */
+   uint64_t spin_ns_{kArrivalSpinNs};
+};
+
+class ArrivalProcess
+{
+public:
+
+   /**
+    * Creates the process and, for a trace, reads the trace file.
+    * No other methods are called.
+    * @param options arrival process and its parameters
+    * @return none
+    * @custom.preconditions  rate_ > 0 unless replaying a trace
+    * @custom.postconditions  good() tells whether the trace could be read
+    **/
+   explicit ArrivalProcess(const ArrivalOptions& options);
+
+   /**
+    * This returns false if a trace was requested but could not be read.
+    * No other methods are called.
+    * @return true if the process can generate arrivals
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   bool good() const;
+
+   /**
+    * Computes the time of the next arrival without waiting for it.
+    * No other methods are called.
+    * @param offset_ns receives the arrival time since the start in nanoseconds
+    * @return false once a trace has no more arrivals
+    * @custom.preconditions  none
+    * @custom.postconditions  process advanced by one arrival
+    **/
+   bool next(uint64_t* offset_ns);
+
+   /**
+    * Starts the clock that waitNext paces against and lowers the calling
+    * thread's timer slack.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  called by the thread that calls waitNext
+    * @custom.postconditions  time 0 of the arrivals is now
+    **/
+   void start();
+
+   /**
+    * Waits until the next arrival is due.
+    * Calls next method.
+    * @return false once a trace has no more arrivals
+    * @custom.preconditions  start has been called
+    * @custom.postconditions  the next arrival is due, lateness recorded
+    **/
+   bool waitNext();
+
+   /**
+    * This returns the mean arrival rate the process was asked for.
+    * No other methods are called.
+    * @return arrivals per second, for a trace its count over its length
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_requested_rate() const;
+
+   /**
+    * This returns the rate at which waitNext actually released arrivals.
+    * No other methods are called.
+    * @return arrivals per second from start until the last arrival, 0 if none
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_achieved_rate() const;
+
+   /**
+    * This returns the number of arrivals released by waitNext.
+    * No other methods are called.
+    * @return number of arrivals
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   long get_arrivals() const;
+
+   /**
+    * This returns how late waitNext released each arrival.
+    * No other methods are called.
+    * @return histogram of lateness in nanoseconds
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   const Histogram& get_lateness() const;
+
+private:
+
+   /** settings of the process */
+   ArrivalOptions options_;
+   /** generator of all random gaps */
+   mt19937_64 rng_;
+   /** time of the last generated arrival since the start */
+   uint64_t offset_ns_;
+   /** number of generated arrivals */
+   long generated_;
+   /** bursty, true while in a burst */
+   bool in_burst_;
+   /** bursty, time since the start at which the current state ends */
+   uint64_t state_end_ns_;
+   /** bursty, arrival rates between and during bursts */
+   double quiet_rate_;
+   double burst_rate_;
+   /** trace, arrival times since the start in nanoseconds */
+   vector<uint64_t> trace_;
+   /** false if the trace could not be read */
+   bool good_;
+   /** time the arrivals started */
+   uint64_t start_ns_;
+   /** time the last arrival was released */
+   uint64_t last_ns_;
+   /** number of arrivals released */
+   long arrivals_;
+   /** lateness of each released arrival */
+   Histogram lateness_;
+
+   /**
+    * Reads the trace file.
+    * No other methods are called.
+    * @return false if the file could not be read or holds no arrivals
+    * @custom.preconditions  options_.trace_path_ != NULL
+    * @custom.postconditions  trace_ holds the arrival times in order
+    **/
+   bool loadTrace();
+
+   /**
+    * This returns the gap until the next bursty arrival, switching
+    * between bursts and quiet periods as their ends are passed.
+    * No other methods are called.
+    * @return gap in nanoseconds after offset_ns_
+    * @custom.preconditions  bursty arrivals
+    * @custom.postconditions  burst state follows offset_ns_ + gap
+    **/
+   uint64_t burstyGap();
+};
+#endif
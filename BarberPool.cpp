@@ -0,0 +1,341 @@
+/**
+ * BarberPool.cpp
+ *
+ * This is the BarberPool.cpp file that implements the methods of the
+ * BarberPool class. The shop decides which slot a new barber gets and
+ * when a retired barber is out of its way; the pool only keeps one
+ * thread per slot and decides how many barbers work.
+ **/
+#include "BarberPool.h"
+#include <unistd.h>
+
+/**
+ * Starts a thread for every working barber of the shop and the
+ * control thread, adding barbers up to min_barbers_ first.
+ * Calls grow method.
+ * @param shop shop whose barbers the pool runs
+ * @param service_time duration of every hair-cut in μ seconds
+ * @param options limits and thresholds of the pool
+ * @return none
+ * @custom.preconditions  fresh shop, no barber thread started yet
+ * @custom.postconditions  barbers and control thread running
+ **/
+BarberPool::BarberPool(Shop* shop, int service_time, const BarberPoolOptions& options) :
+   BarberPool(shop, ServiceTime::fixed(service_time), options)
+{
+}
+
+/**
+ * Starts a thread for every working barber of the shop and the
+ * control thread, adding barbers up to min_barbers_ first. Slot i
+ * draws its hair-cuts from service seeded with seed_ + i at the speed
+ * Shop::get_barber_speed reports for it.
+ * Calls grow method.
+ * @param shop shop whose barbers the pool runs
+ * @param service distribution of the hair-cut durations at speed 1
+ * @param options limits and thresholds of the pool
+ * @return none
+ * @custom.preconditions  fresh shop, barber speeds set, no barber
+ *                        thread started yet
+ * @custom.postconditions  barbers and control thread running
+ **/
+BarberPool::BarberPool(Shop* shop, const ServiceOptions& service, const BarberPoolOptions& options) :
+   shop_(shop), options_(options), peak_(0), grown_(0), retired_(0),
+   quiet_looks_(0), last_drops_(0), stopping_(false)
+{
+   int capacity = shop_->get_barber_capacity();
+   if (options_.max_barbers_ <= 0 || options_.max_barbers_ > capacity) {
+      options_.max_barbers_ = capacity;
+   }
+   if (options_.min_barbers_ < 1) {
+      options_.min_barbers_ = 1;
+   }
+   if (options_.min_barbers_ > options_.max_barbers_) {
+      options_.min_barbers_ = options_.max_barbers_;
+   }
+   pthread_mutex_init(&mutex_, NULL);
+   pthread_cond_init(&cond_wake_, NULL);
+
+   workers_ = new Worker[capacity];
+   pthread_mutex_lock(&mutex_);
+   for (int i = 0; i < capacity; i++) {
+      workers_[i].pool_ = this;
+      workers_[i].id_ = i;
+      workers_[i].started_ = false;
+      workers_[i].alive_ = false;
+      workers_[i].wake_ = false;
+      ServiceOptions slot_service = service;
+      slot_service.seed_ = service.seed_ + i;
+      slot_service.speed_ = shop_->get_barber_speed(i);
+      workers_[i].service_ = new ServiceTime(slot_service);
+   }
+   /** a fresh shop's working barbers are the first slots */
+   for (int i = 0; i < shop_->get_active_barbers(); i++) {
+      workers_[i].started_ = true;
+      workers_[i].alive_ = true;
+      pthread_create(&workers_[i].thread_, NULL, barber, &workers_[i]);
+      working_.push_back(i);
+   }
+   while ((int) working_.size() < options_.min_barbers_ && grow()) {
+   }
+   peak_ = (int) working_.size();
+   last_drops_ = shop_->get_cust_drops();
+   pthread_mutex_unlock(&mutex_);
+   pthread_create(&control_thread_, NULL, control, this);
+}
+
+/**
+ * Destructor for BarberPool class. Stops the pool if stop has not
+ * been called yet.
+ * Calls stop method.
+ * @return none
+ * @custom.preconditions  no customer is in the shop
+ * @custom.postconditions  every thread joined
+ **/
+BarberPool::~BarberPool()
+{
+   stop();
+   for (int i = 0; i < shop_->get_barber_capacity(); i++) {
+      delete workers_[i].service_;
+   }
+   delete[] workers_;
+   pthread_cond_destroy(&cond_wake_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * Stops resizing, retires every barber and joins all threads.
+ * Calls Shop::retireBarber method.
+ * @return none
+ * @custom.preconditions  no customer is in the shop
+ * @custom.postconditions  every thread joined
+ **/
+void BarberPool::stop()
+{
+   pthread_mutex_lock(&mutex_);
+   if (stopping_) {
+      pthread_mutex_unlock(&mutex_);
+      return;
+   }
+   stopping_ = true;
+   pthread_mutex_unlock(&mutex_);
+   pthread_join(control_thread_, NULL);
+
+   pthread_mutex_lock(&mutex_);
+   for (size_t i = 0; i < working_.size(); i++) {
+      shop_->retireBarber(working_[i]);
+   }
+   working_.clear();
+   pthread_cond_broadcast(&cond_wake_);
+   pthread_mutex_unlock(&mutex_);
+
+   for (int i = 0; i < shop_->get_barber_capacity(); i++) {
+      if (workers_[i].started_) {
+         pthread_join(workers_[i].thread_, NULL);
+      }
+   }
+}
+
+/**
+ * Entry point of the barber threads. Serves customers until the
+ * barber is retired, then parks or exits.
+ * Calls Shop::helloCustomer and Shop::byeCustomer methods.
+ * @param arg the Worker the thread runs as
+ * @return none
+ * @custom.preconditions  arg points to a worker of a live pool
+ * @custom.postconditions  thread exits once retired and not reused
+ **/
+void* BarberPool::barber(void* arg)
+{
+   Worker* worker = (Worker*) arg;
+   BarberPool* pool = worker->pool_;
+   Shop* shop = pool->shop_;
+
+   while (true) {
+      while (shop->helloCustomer(worker->id_)) {
+         usleep(worker->service_->next());
+         shop->byeCustomer(worker->id_);
+      }
+
+      /** Retired: wait until the slot is opened again, or leave */
+      pthread_mutex_lock(&pool->mutex_);
+      while (pool->options_.park_idle_ && !worker->wake_ && !pool->stopping_) {
+         pthread_cond_wait(&pool->cond_wake_, &pool->mutex_);
+      }
+      if (!worker->wake_) {
+         worker->alive_ = false;
+         pthread_mutex_unlock(&pool->mutex_);
+         return nullptr;
+      }
+      worker->wake_ = false;
+      pthread_mutex_unlock(&pool->mutex_);
+   }
+}
+
+/**
+ * Entry point of the control thread, looks at the shop every interval.
+ * Calls look method.
+ * @param arg the pool
+ * @return none
+ * @custom.preconditions  arg points to a live pool
+ * @custom.postconditions  thread exits once the pool stops
+ **/
+void* BarberPool::control(void* arg)
+{
+   BarberPool* pool = (BarberPool*) arg;
+   while (true) {
+      usleep(pool->options_.interval_us_);
+      pthread_mutex_lock(&pool->mutex_);
+      if (pool->stopping_) {
+         pthread_mutex_unlock(&pool->mutex_);
+         return nullptr;
+      }
+      pool->look();
+      pthread_mutex_unlock(&pool->mutex_);
+   }
+}
+
+/**
+ * Looks at the shop once and adds or retires barbers.
+ * Calls grow and shrink methods.
+ * @return none
+ * @custom.preconditions  mutex_ held
+ * @custom.postconditions  pool resized if the thresholds were crossed
+ **/
+void BarberPool::look()
+{
+   int waiting = shop_->get_waiting();
+   int drops = shop_->get_cust_drops();
+   bool dropped = drops > last_drops_;
+   last_drops_ = drops;
+   int working = (int) working_.size();
+
+   /** Busy: add barbers at once */
+   if (waiting >= options_.grow_waiting_ || dropped) {
+      quiet_looks_ = 0;
+      for (int i = 0; i < options_.grow_step_ && working < options_.max_barbers_ && grow(); i++) {
+         ++working;
+      }
+      return;
+   }
+
+   /** Quiet: retire a barber only after the lull has lasted */
+   if (waiting == 0 && shop_->get_free_barbers() > 0) {
+      if (++quiet_looks_ >= options_.shrink_after_ && working > options_.min_barbers_) {
+         shrink();
+         quiet_looks_ = 0;
+      }
+      return;
+   }
+   quiet_looks_ = 0;
+}
+
+/**
+ * Adds a barber and wakes or starts its thread.
+ * Calls Shop::addBarber method.
+ * @return false if the shop has no closed slot
+ * @custom.preconditions  mutex_ held
+ * @custom.postconditions  one more working barber on success
+ **/
+bool BarberPool::grow()
+{
+   int id = shop_->addBarber();
+   if (id < 0) {
+      return false;
+   }
+   Worker& worker = workers_[id];
+   if (worker.alive_) {
+      /** the slot's thread is parked, or about to park */
+      worker.wake_ = true;
+      pthread_cond_broadcast(&cond_wake_);
+   } else {
+      /** an exited thread only returns, so joining it under mutex_ is safe */
+      if (worker.started_) {
+         pthread_join(worker.thread_, NULL);
+      }
+      worker.started_ = true;
+      worker.alive_ = true;
+      pthread_create(&worker.thread_, NULL, barber, &worker);
+   }
+   working_.push_back(id);
+   if ((int) working_.size() > peak_) {
+      peak_ = (int) working_.size();
+   }
+   ++grown_;
+   return true;
+}
+
+/**
+ * Retires the barber that joined last.
+ * Calls Shop::retireBarber method.
+ * @return none
+ * @custom.preconditions  mutex_ held, at least one working barber
+ * @custom.postconditions  one working barber less
+ **/
+void BarberPool::shrink()
+{
+   int id = working_.back();
+   working_.pop_back();
+   shop_->retireBarber(id);
+   ++retired_;
+}
+
+/**
+ * This returns the number of barbers the pool keeps working.
+ * No other methods are called.
+ * @return number of working barbers
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int BarberPool::get_barbers()
+{
+   pthread_mutex_lock(&mutex_);
+   int working = (int) working_.size();
+   pthread_mutex_unlock(&mutex_);
+   return working;
+}
+
+/**
+ * This returns the largest number of barbers that worked at once.
+ * No other methods are called.
+ * @return peak number of working barbers
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int BarberPool::get_peak_barbers()
+{
+   pthread_mutex_lock(&mutex_);
+   int peak = peak_;
+   pthread_mutex_unlock(&mutex_);
+   return peak;
+}
+
+/**
+ * This returns how many barbers the pool added to the shop.
+ * No other methods are called.
+ * @return number of barbers added
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long BarberPool::get_grown()
+{
+   pthread_mutex_lock(&mutex_);
+   long grown = grown_;
+   pthread_mutex_unlock(&mutex_);
+   return grown;
+}
+
+/**
+ * This returns how many barbers the pool retired before stop.
+ * No other methods are called.
+ * @return number of barbers retired
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long BarberPool::get_retired()
+{
+   pthread_mutex_lock(&mutex_);
+   long retired = retired_;
+   pthread_mutex_unlock(&mutex_);
+   return retired;
+}
@@ -0,0 +1,230 @@
+/**
+ * BarberPool.h
+ *
+ * This is the BarberPool.h file that defines the BarberPool class, which
+ * runs the barber threads of a Shop and resizes the set of working
+ * barbers while the shop is open. A control thread looks at the shop
+ * every interval: when customers are waiting or have been turned away
+ * since the last look it adds a barber, and when nobody has waited and a
+ * barber has been free for shrink_after_ looks in a row it retires the
+ * barber that joined last. The gap between the two conditions is the
+ * hysteresis that keeps the pool from flapping.
+ *
+ * A retired barber's thread finishes its customer, if any, and then
+ * either parks until the pool needs the barber again or exits, so a
+ * lull either costs parked threads or a thread start per burst.
+ *
+ * Barber slots beyond the shop's starting barbers come from
+ * ShopOptions::barber_capacity_. Every slot draws its hair-cut durations
+ * from a ServiceTime of its own, at the speed the shop has for it.
+ **/
+#ifndef BARBER_POOL_H_
+#define BARBER_POOL_H_
+#include <pthread.h>
+#include <vector>
+#include "Shop.h"
+#include "ServiceTime.h"
+using namespace std;
+
+/** settings of a BarberPool */
+struct BarberPoolOptions {
+   /** fewest working barbers */
+   int min_barbers_{1};
+   /** most working barbers, 0 for the shop's barber capacity */
+   int max_barbers_{0};
+   /** time between two looks at the shop, in μ seconds */
+   int interval_us_{1000};
+   /** waiting customers at which a barber is added */
+   int grow_waiting_{1};
+   /** barbers added per look while the shop is busy */
+   int grow_step_{1};
+   /** quiet looks in a row before a barber is retired */
+   int shrink_after_{20};
+   /** true to park the threads of retired barbers for reuse, false to
+    *  end them */
+   bool park_idle_{true};
+};
+
+class BarberPool
+{
+public:
+
+   /**
+    * Starts a thread for every working barber of the shop and the
+    * control thread, adding barbers up to min_barbers_ first.
+    * Calls grow method.
+    * @param shop shop whose barbers the pool runs
+    * @param service_time duration of every hair-cut in μ seconds
+    * @param options limits and thresholds of the pool
+    * @return none
+    * @custom.preconditions  fresh shop, no barber thread started yet
+    * @custom.postconditions  barbers and control thread running
+    **/
+   BarberPool(Shop* shop, int service_time, const BarberPoolOptions& options);
+
+   /**
+    * Starts a thread for every working barber of the shop and the
+    * control thread, adding barbers up to min_barbers_ first. Slot i
+    * draws its hair-cuts from service seeded with seed_ + i at the speed
+    * Shop::get_barber_speed reports for it.
+    * Calls grow method.
+    * @param shop shop whose barbers the pool runs
+    * @param service distribution of the hair-cut durations at speed 1
+    * @param options limits and thresholds of the pool
+    * @return none
+    * @custom.preconditions  fresh shop, barber speeds set, no barber
+    *                        thread started yet
+    * @custom.postconditions  barbers and control thread running
+    **/
+   BarberPool(Shop* shop, const ServiceOptions& service, const BarberPoolOptions& options);
+
+   /**
+    * Destructor for BarberPool class. Stops the pool if stop has not
+    * been called yet.
+    * Calls stop method.
+    * @return none
+    * @custom.preconditions  no customer is in the shop
+    * @custom.postconditions  every thread joined
+    **/
+   ~BarberPool();
+
+   /**
+    * Stops resizing, retires every barber and joins all threads.
+    * Calls Shop::retireBarber method.
+    * @return none
+    * @custom.preconditions  no customer is in the shop
+    * @custom.postconditions  every thread joined
+    **/
+   void stop();
+
+   /**
+    * This returns the number of barbers the pool keeps working.
+    * No other methods are called.
+    * @return number of working barbers
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_barbers();
+
+   /**
+    * This returns the largest number of barbers that worked at once.
+    * No other methods are called.
+    * @return peak number of working barbers
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_peak_barbers();
+
+   /**
+    * This returns how many barbers the pool added to the shop.
+    * No other methods are called.
+    * @return number of barbers added
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   long get_grown();
+
+   /**
+    * This returns how many barbers the pool retired before stop.
+    * No other methods are called.
+    * @return number of barbers retired
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   long get_retired();
+
+private:
+
+   /** thread of one barber slot */
+   struct Worker {
+      /** pool the worker belongs to */
+      BarberPool* pool_;
+      /** barber id of the slot */
+      int id_;
+      /** thread handle, valid once started_ */
+      pthread_t thread_;
+      /** true once a thread was created for the slot */
+      bool started_;
+      /** true while the thread runs, parked or not */
+      bool alive_;
+      /** true when a parked thread is to work again */
+      bool wake_;
+      /** hair-cut durations of the slot, only its thread draws them */
+      ServiceTime* service_;
+   };
+
+   /** shop whose barbers the pool runs */
+   Shop* shop_;
+   /** limits and thresholds */
+   BarberPoolOptions options_;
+   /** one worker per barber slot */
+   Worker* workers_;
+   /** working barbers in the order they joined */
+   vector<int> working_;
+   /** largest size working_ had */
+   int peak_;
+   /** barbers added and retired while running */
+   long grown_;
+   long retired_;
+   /** looks in a row without waiting customers and with a free barber */
+   int quiet_looks_;
+   /** drops seen at the previous look */
+   int last_drops_;
+   /** true once stop was called */
+   bool stopping_;
+   /** control thread handle */
+   pthread_t control_thread_;
+   /** mutex guarding every field above */
+   pthread_mutex_t mutex_;
+   /** signaled when a parked worker is woken or the pool stops */
+   pthread_cond_t cond_wake_;
+
+   /**
+    * Entry point of the barber threads. Serves customers until the
+    * barber is retired, then parks or exits.
+    * Calls Shop::helloCustomer and Shop::byeCustomer methods.
+    * @param arg the Worker the thread runs as
+    * @return none
+    * @custom.preconditions  arg points to a worker of a live pool
+    * @custom.postconditions  thread exits once retired and not reused
+    **/
+   static void* barber(void* arg);
+
+   /**
+    * Entry point of the control thread, looks at the shop every interval.
+    * Calls look method.
+    * @param arg the pool
+    * @return none
+    * @custom.preconditions  arg points to a live pool
+    * @custom.postconditions  thread exits once the pool stops
+    **/
+   static void* control(void* arg);
+
+   /**
+    * Looks at the shop once and adds or retires barbers.
+    * Calls grow and shrink methods.
+    * @return none
+    * @custom.preconditions  mutex_ held
+    * @custom.postconditions  pool resized if the thresholds were crossed
+    **/
+   void look();
+
+   /**
+    * Adds a barber and wakes or starts its thread.
+    * Calls Shop::addBarber method.
+    * @return false if the shop has no closed slot
+    * @custom.preconditions  mutex_ held
+    * @custom.postconditions  one more working barber on success
+    **/
+   bool grow();
+
+   /**
+    * Retires the barber that joined last.
+    * Calls Shop::retireBarber method.
+    * @return none
+    * @custom.preconditions  mutex_ held, at least one working barber
+    * @custom.postconditions  one working barber less
+    **/
+   void shrink();
+};
+#endif
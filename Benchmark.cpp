@@ -0,0 +1,1433 @@
+/**
+ * Benchmark.cpp
+ *
+ * This is the Benchmark.cpp file that measures the Shop class over a grid
+ * of configurations. Every combination of the requested numbers of
+ * barbers, waiting chairs, arrival rates and service times is run with a
+ * fresh shop: barber threads loop on helloCustomer/ byeCustomer until the
+ * shop is drained, while customers arrive as a seeded ArrivalProcess, Poisson by default, and
+ * are run on a CustomerExecutor that records their wait and end-to-end
+ * latency. The arrival rate actually achieved and how late arrivals were
+ * released are reported next to the requested rate, so a point whose
+ * offered load fell short of the request can be told apart.
+ *
+ * With --warmup every point first runs that many discarded runs of the
+ * same customers. The shop and its barber threads are kept: the shop is
+ * drained and reset between runs, and the barbers wait for the next one
+ * instead of being respawned.
+ *
+ * With --shards every point runs a Franchise of that many shops, each
+ * with the point's barbers and chairs.
+ *
+ * With --elastic the point's barbers are only the minimum: a BarberPool
+ * adds barbers up to the given maximum while customers wait and retires
+ * them again in lulls, and the peak number of barbers is reported.
+ *
+ * With --room ticket every waiting customer parks on a ticket of its own
+ * and barbers wake them in arrival order, which bounds the tail of the
+ * wait that the locked room's shared condition variable leaves open.
+ * With --batch a free barber of the ticket waiting room claims up to that
+ * many waiting customers at once and serves them back to back.
+ *
+ * With --classes customers are spread evenly over that many priority
+ * classes by a seeded generator, and --dispatch picks how the ticket
+ * waiting room orders them. With --patience a customer of class c gives
+ * up after waiting (c + 1) times that long, so class 0 is the most
+ * latency-sensitive; reneges are reported apart from drops, next to the
+ * queue wait p99 of every class.
+ *
+ * With --service-dist every barber draws its hair-cuts from a seeded
+ * ServiceTime, the point's service time being the mean, and --speeds
+ * gives barber i the i-th speed factor of the list, cycled. With
+ * --barber-dispatch the shop hands a customer to the fastest free barber,
+ * or also queues it for the barber with the shortest expected wait, and
+ * every barber's share of the customers is reported next to the mean
+ * end-to-end latency.
+ *
+ * With --stages every point runs a PipelineShop instead, the point's
+ * chairs being the queue of the first stage and --stage-queue the queue
+ * between two stages, and every stage's utilization, blocked time and
+ * capacity are reported together with the bottleneck stage.
+ *
+ * Built with -DSHOP_PROFILE_LOCKS=1, every threaded point also prints the
+ * lock profile of the shop's handshake: per step the acquisitions, how
+ * many were contended, mean wait and hold time, condition variable
+ * sleeps and the wake-ups that found nothing to do, and the step that
+ * lost the most time to contention.
+ *
+ * With --event-trace every event of the shops is stored into a mapped
+ * trace file, for shopTrace to take apart afterwards. Customer ids start
+ * over at every run, so the start of every run, warm-up runs included,
+ * is marked in the trace and shopTrace reports one run at a time.
+ *
+ * With --stats-page the live counters of the shop of each threaded point
+ * are published every --stats-interval milliseconds to a memory-mapped
+ * page, for shopStats to watch from another process while the point
+ * runs. Each point replaces the page with its own.
+ *
+ * Each point can also be run on the ShopSimulator, which models the same
+ * rules on a virtual clock, so the threaded shop and the model can be
+ * cross-checked. Simulated rows report virtual time, CPU time is real.
+ *
+ * For each point it reports throughput in served customers per second,
+ * drop rate, p50/ p99/ p999 wait and end-to-end latency, the CPU time
+ * used by the process, context switches per customer, and the shop's own
+ * payment latency and barber utilization from Shop::get_stats, as a table
+ * on stdout and optionally as CSV and
+ * JSON files that can be diffed between builds.
+ *
+ * Usage: shopBenchmark [--barbers 1,4] [--chairs 0,8] [--rates 2000]
+ *        [--service 100] [--customers 10000] [--room locked|lockfree|ticket]
+ *        [--handoff condvar|direct] [--pin none|cpu|node] [--node 0]
+ *        [--shards 4] [--routing rr|hash] [--elastic 16] [--shrink-after 20]
+ *        [--batch 4] [--classes 2] [--dispatch fifo|strict|weighted|edf]
+ *        [--patience 500]
+ *        [--arrivals poisson|uniform|bursty|constant|trace] [--trace file]
+ *        [--spin 20] [--engine threads|sim|both] [--event-trace file]
+ *        [--stats-page file] [--stats-interval 100] [--warmup 0]
+ *        [--seed 1] [--csv file] [--json file]
+ **/
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "Shop.h"
+#include "CustomerExecutor.h"
+#include "Franchise.h"
+#include "Histogram.h"
+#include "Clock.h"
+#include "ShopSimulator.h"
+#include "WaitStrategy.h"
+#include "Affinity.h"
+#include "ArrivalProcess.h"
+#include "BarberPool.h"
+#include "ServiceTime.h"
+#include "PipelineShop.h"
+#include "LockProfile.h"
+#include "EventLog.h"
+#include "StatsPage.h"
+using namespace std;
+
+/** ways a grid point can be run */
+enum BenchmarkEngine {
+   /** real Shop with barber threads and a CustomerExecutor */
+   kThreadEngine,
+   /** ShopSimulator on a virtual clock */
+   kSimEngine
+};
+
+/** ways barber threads can be pinned */
+enum BarberPinning {
+   /** barbers run wherever the scheduler puts them */
+   kPinNone,
+   /** barber i runs only on CPU i modulo the number of CPUs */
+   kPinCpu,
+   /** barbers run only on the CPUs of the shop's NUMA node */
+   kPinNode
+};
+
+/** one point of the benchmark grid */
+struct BenchmarkPoint {
+   int num_barbers;
+   int num_chairs;
+   /** mean arrival rate in customers per second */
+   double arrival_rate;
+   /** barber service time in μ seconds */
+   int service_time;
+};
+
+/** everything measured for one point */
+struct BenchmarkResult {
+   BenchmarkPoint point;
+   BenchmarkEngine engine;
+   long customers;
+   long served;
+   long drops;
+   /** customers that gave up waiting */
+   long reneges;
+   double elapsed_s;
+   double cpu_s;
+   /** voluntary + involuntary context switches per arriving customer */
+   double switches_per_customer;
+   /** arrival rate asked of the arrival process, arrivals per second */
+   double requested_rate;
+   /** arrival rate the customers were actually released at */
+   double achieved_rate;
+   /** how late each customer was released, in nanoseconds */
+   Histogram lateness;
+   /** most barbers working at once */
+   int peak_barbers;
+   Histogram wait;
+   Histogram total;
+   ShopStats stats;
+   /** pipeline shop, statistics of every stage */
+   PipelineStats pipeline;
+   /** lock profile of the shop's handshake, with SHOP_PROFILE_LOCKS */
+   LockProfile locks;
+};
+
+/** settings shared by every point */
+struct BenchmarkSettings {
+   long num_customers;
+   unsigned long seed;
+   WaitingRoomKind waiting_room;
+   HandoffKind handoff;
+   BarberPinning pinning;
+   /** NUMA node of the shop's memory, -1 for no placement */
+   int numa_node;
+   /** number of franchise shops, 0 for a single Shop */
+   int num_shards;
+   /** how franchise customers pick their home shop */
+   FranchiseRouting routing;
+   /** arrival process of every point, its rate set by the point */
+   ArrivalOptions arrivals;
+   /** most barbers of an elastic shop, 0 for a fixed number of barbers */
+   int elastic_barbers;
+   /** elastic shop, quiet looks before a barber is retired */
+   int shrink_after;
+   /** most customers a free barber claims at once, 1 for one at a time */
+   int batch_size;
+   /** number of priority classes customers are spread over */
+   int num_classes;
+   /** how the ticket waiting room orders the classes */
+   DispatchPolicy dispatch;
+   /** patience of class 0 customers in μ seconds, 0 for unlimited */
+   double patience_us;
+   /** distribution of the hair-cuts, its mean set by the point */
+   ServiceOptions service;
+   /** speed factors of the barbers, cycled, empty for all at speed 1 */
+   vector<double> speeds;
+   /** how customers pick among the barbers */
+   BarberDispatch barber_dispatch;
+   /** stages of a pipeline shop, empty for a Shop */
+   vector<PipelineStageOptions> stages;
+   /** pipeline shop, customers that may wait between two stages */
+   int stage_queue;
+   /** file the shop's live counters are published to, NULL for none */
+   const char* stats_page;
+   /** time between two readings of the stats page in milliseconds */
+   int stats_interval_ms;
+   /** discarded runs of every point before the measured one */
+   int warmup_runs;
+   vector<BenchmarkEngine> engines;
+};
+
+/**
+ * This class represents the gate barber threads of a point wait at between
+ * two runs, once the shop is drained.
+ */
+class BarberGate
+{
+public:
+   pthread_mutex_t mutex;
+   pthread_cond_t cond;
+   /** number of runs opened after the first */
+   int generation;
+   /** true once the point is done and the barbers can leave */
+   bool stop;
+};
+
+/**
+ * This class represents the parameters passed to a benchmark barber thread.
+ */
+class BarberParam
+{
+public:
+   /** shop of the barber, NULL in a franchise */
+   Shop* shop;
+   /** franchise of the barber, NULL in a single shop */
+   Franchise* franchise;
+   int id;
+   /** hair-cut durations of the barber */
+   ServiceTime* service;
+   /** gate of the point's runs */
+   BarberGate* gate;
+};
+
+/** method called by barber threads */
+void *barber(void *);
+/** lets the barbers of a point into its next run, or out */
+static void openGate(BarberGate* gate, bool stop);
+/** parses a comma separated list of numbers */
+static vector<double> parseList(const char* text);
+/** parses a comma separated list of pipeline stages */
+static bool parseStages(const char* text, vector<PipelineStageOptions>* stages);
+/** name of an arrival process */
+static const char* arrivalName(ArrivalKind kind);
+/** name of a dispatch policy */
+static const char* dispatchName(DispatchPolicy policy);
+/** name of a service time distribution */
+static const char* serviceName(ServiceKind kind);
+/** name of a barber dispatch */
+static const char* barberDispatchName(BarberDispatch dispatch);
+/** speed factor of a barber */
+static double barberSpeed(const BenchmarkSettings& settings, int id);
+/** mean utilization of the barbers of a run */
+static double meanUtilization(const ShopStats& stats);
+/** marks the start of a run in the event trace */
+static void markRun(bool warmup);
+/** runs one grid point on the threaded shop */
+static void runPoint(const BenchmarkSettings& settings, BenchmarkResult* result);
+/** runs one grid point on a pipeline shop */
+static void runPipelinePoint(const BenchmarkSettings& settings, BenchmarkResult* result);
+/** runs one grid point on the simulator */
+static void simulatePoint(const BenchmarkSettings& settings, BenchmarkResult* result);
+/** prints one table row */
+static void printResult(const BenchmarkSettings& settings, const BenchmarkResult& result);
+/** writes the results as CSV */
+static void writeCsv(const char* path, const vector<BenchmarkResult*>& results);
+/** writes the results as JSON */
+static void writeJson(const char* path, const BenchmarkSettings& settings, const vector<BenchmarkResult*>& results);
+
+/**
+ * Parses the command line, runs every point of the grid and reports the
+ * results.
+ * Calls parseList, runPoint, simulatePoint, printResult, writeCsv and writeJson.
+ * @return 0 on success, -1 on bad arguments
+ * @custom.preconditions  none
+ * @custom.postconditions  results written to stdout and requested files
+ **/
+int main(int argc, char *argv[])
+{
+   vector<double> barbers = {1, 4};
+   vector<double> chairs = {0, 8};
+   vector<double> rates = {2000};
+   vector<double> service_times = {100};
+   BenchmarkSettings settings;
+   settings.num_customers = 10000;
+   settings.seed = 1;
+   settings.waiting_room = kLockedWaitingRoom;
+   settings.handoff = kCondvarHandoff;
+   settings.pinning = kPinNone;
+   settings.numa_node = -1;
+   settings.num_shards = 0;
+   settings.routing = kRouteRoundRobin;
+   settings.arrivals.kind_ = kPoissonArrivals;
+   settings.elastic_barbers = 0;
+   settings.shrink_after = BarberPoolOptions().shrink_after_;
+   settings.batch_size = 1;
+   settings.num_classes = 1;
+   settings.dispatch = kDispatchFifo;
+   settings.patience_us = 0;
+   settings.barber_dispatch = kBarberFifo;
+   settings.stage_queue = PipelineStageOptions().queue_capacity_;
+   settings.stats_page = NULL;
+   settings.stats_interval_ms = 100;
+   settings.warmup_runs = 0;
+   settings.engines.push_back(kThreadEngine);
+   const char* csv_path = NULL;
+   const char* json_path = NULL;
+   const char* event_trace_path = NULL;
+
+   for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      if (i + 1 >= argc) {
+         cerr << "missing value for " << arg << endl;
+         return -1;
+      }
+      const char* value = argv[++i];
+      if (arg == "--barbers") {
+         barbers = parseList(value);
+      } else if (arg == "--chairs") {
+         chairs = parseList(value);
+      } else if (arg == "--rates") {
+         rates = parseList(value);
+      } else if (arg == "--service") {
+         service_times = parseList(value);
+      } else if (arg == "--customers") {
+         settings.num_customers = atol(value);
+      } else if (arg == "--seed") {
+         settings.seed = strtoul(value, NULL, 10);
+      } else if (arg == "--room") {
+         settings.waiting_room = (string(value) == "lockfree") ? kLockFreeWaitingRoom :
+                                 (string(value) == "ticket") ? kTicketWaitingRoom : kLockedWaitingRoom;
+      } else if (arg == "--handoff") {
+         settings.handoff = (string(value) == "direct") ? kDirectHandoff : kCondvarHandoff;
+      } else if (arg == "--pin") {
+         settings.pinning = (string(value) == "cpu") ? kPinCpu :
+                            (string(value) == "node") ? kPinNode : kPinNone;
+      } else if (arg == "--node") {
+         settings.numa_node = atoi(value);
+      } else if (arg == "--shards") {
+         settings.num_shards = atoi(value);
+      } else if (arg == "--routing") {
+         settings.routing = (string(value) == "hash") ? kRouteHash : kRouteRoundRobin;
+      } else if (arg == "--elastic") {
+         settings.elastic_barbers = atoi(value);
+      } else if (arg == "--shrink-after") {
+         settings.shrink_after = atoi(value);
+      } else if (arg == "--batch") {
+         settings.batch_size = atoi(value);
+      } else if (arg == "--classes") {
+         settings.num_classes = atoi(value);
+      } else if (arg == "--dispatch") {
+         string policy = value;
+         settings.dispatch = (policy == "strict") ? kDispatchStrict :
+                             (policy == "weighted") ? kDispatchWeighted :
+                             (policy == "edf") ? kDispatchEarliestDeadline : kDispatchFifo;
+      } else if (arg == "--patience") {
+         settings.patience_us = atof(value);
+      } else if (arg == "--service-dist") {
+         string kind = value;
+         settings.service.kind_ = (kind == "exp") ? kExponentialService :
+                                  (kind == "lognormal") ? kLognormalService :
+                                  (kind == "trace") ? kTraceService : kFixedService;
+      } else if (arg == "--service-sigma") {
+         settings.service.sigma_ = atof(value);
+      } else if (arg == "--service-trace") {
+         settings.service.kind_ = kTraceService;
+         settings.service.trace_path_ = value;
+      } else if (arg == "--speeds") {
+         settings.speeds = parseList(value);
+      } else if (arg == "--barber-dispatch") {
+         string dispatch = value;
+         settings.barber_dispatch = (dispatch == "fastest") ? kBarberFastest :
+                                    (dispatch == "jsew") ? kBarberShortestWait : kBarberFifo;
+      } else if (arg == "--stages") {
+         if (!parseStages(value, &settings.stages)) {
+            cerr << "bad --stages, expected name:workers:service_us,..." << endl;
+            return -1;
+         }
+      } else if (arg == "--stage-queue") {
+         settings.stage_queue = atoi(value);
+      } else if (arg == "--arrivals") {
+         string kind = value;
+         settings.arrivals.kind_ = (kind == "uniform") ? kUniformArrivals :
+                                   (kind == "bursty") ? kBurstyArrivals :
+                                   (kind == "constant") ? kConstantArrivals :
+                                   (kind == "trace") ? kTraceArrivals : kPoissonArrivals;
+      } else if (arg == "--trace") {
+         settings.arrivals.kind_ = kTraceArrivals;
+         settings.arrivals.trace_path_ = value;
+      } else if (arg == "--spin") {
+         settings.arrivals.spin_ns_ = (uint64_t) (atof(value) * 1000);
+      } else if (arg == "--engine") {
+         settings.engines.clear();
+         if (string(value) != "sim") {
+            settings.engines.push_back(kThreadEngine);
+         }
+         if (string(value) != "threads") {
+            settings.engines.push_back(kSimEngine);
+         }
+      } else if (arg == "--event-trace") {
+         event_trace_path = value;
+      } else if (arg == "--stats-page") {
+         settings.stats_page = value;
+      } else if (arg == "--stats-interval") {
+         settings.stats_interval_ms = atoi(value);
+      } else if (arg == "--warmup") {
+         settings.warmup_runs = atoi(value);
+      } else if (arg == "--csv") {
+         csv_path = value;
+      } else if (arg == "--json") {
+         json_path = value;
+      } else {
+         cerr << "usage: shopBenchmark [--barbers 1,4] [--chairs 0,8] [--rates 2000] [--service 100]" << endl;
+         cerr << "       [--customers 10000] [--room locked|lockfree|ticket] [--handoff condvar|direct]" << endl;
+         cerr << "       [--pin none|cpu|node] [--node 0] [--shards 4] [--routing rr|hash]" << endl;
+         cerr << "       [--elastic 16] [--shrink-after 20] [--batch 4]" << endl;
+         cerr << "       [--classes 2] [--dispatch fifo|strict|weighted|edf] [--patience 500]" << endl;
+         cerr << "       [--service-dist fixed|exp|lognormal|trace] [--service-sigma 0.5] [--service-trace file]" << endl;
+         cerr << "       [--speeds 1,2] [--barber-dispatch fifo|fastest|jsew]" << endl;
+         cerr << "       [--stages wash:1:50,cut:2:200,checkout:1:30] [--stage-queue 2]" << endl;
+         cerr << "       [--arrivals poisson|uniform|bursty|constant|trace] [--trace file] [--spin 20]" << endl;
+         cerr << "       [--engine threads|sim|both] [--event-trace file]" << endl;
+         cerr << "       [--stats-page file] [--stats-interval 100] [--warmup 0]" << endl;
+         cerr << "       [--seed 1] [--csv file] [--json file]" << endl;
+         return -1;
+      }
+   }
+
+   settings.arrivals.seed_ = settings.seed;
+   if (settings.arrivals.kind_ == kTraceArrivals && !ArrivalProcess(settings.arrivals).good()) {
+      cerr << "cannot read arrival trace " << ((settings.arrivals.trace_path_ != NULL) ? settings.arrivals.trace_path_ : "(none)") << endl;
+      return -1;
+   }
+   settings.service.seed_ = settings.seed + 2;
+   if (settings.service.kind_ == kTraceService && !ServiceTime(settings.service).good()) {
+      cerr << "cannot read service trace " << ((settings.service.trace_path_ != NULL) ? settings.service.trace_path_ : "(none)") << endl;
+      return -1;
+   }
+   for (size_t i = 0; i < settings.speeds.size(); i++) {
+      if (settings.speeds[i] <= 0) {
+         cerr << "barber speeds must be positive" << endl;
+         return -1;
+      }
+   }
+
+   printf("# wait strategy: %s\n", ShopWait::name());
+   printf("# arrivals: %s\n", arrivalName(settings.arrivals.kind_));
+   printf("# service: %s\n", serviceName(settings.service.kind_));
+   printf("# lock profiler: %s\n", SHOP_PROFILE_LOCKS ? "on" : "off");
+   if (event_trace_path != NULL) {
+      if (!EventLog::instance().open(kTraceSink, event_trace_path, kLogVerbose)) {
+         cerr << "cannot create event trace " << event_trace_path << endl;
+         return -1;
+      }
+      printf("# event trace: %s\n", event_trace_path);
+   }
+   if (settings.elastic_barbers > 0 && settings.num_shards > 0) {
+      cerr << "--elastic applies to a single shop, ignored with --shards" << endl;
+      settings.elastic_barbers = 0;
+   }
+   if (settings.warmup_runs > 0 && (settings.elastic_barbers > 0 || !settings.stages.empty())) {
+      cerr << "--warmup applies to a fixed number of barbers, ignored with --elastic and --stages" << endl;
+      settings.warmup_runs = 0;
+   }
+   if (settings.warmup_runs < 0) {
+      settings.warmup_runs = 0;
+   }
+   if (settings.warmup_runs > 0) {
+      printf("# warmup: %d runs per point\n", settings.warmup_runs);
+   }
+   if (settings.stats_page != NULL && (settings.num_shards > 0 || !settings.stages.empty())) {
+      cerr << "--stats-page applies to a single shop, ignored with --shards and --stages" << endl;
+      settings.stats_page = NULL;
+   }
+   if (settings.stats_page != NULL) {
+      printf("# stats page: %s every %d ms\n", settings.stats_page, settings.stats_interval_ms);
+   }
+   bool tickets = settings.waiting_room != kLockFreeWaitingRoom && settings.handoff == kCondvarHandoff &&
+                  settings.num_shards == 0;
+   if (settings.batch_size > 1 && !tickets) {
+      cerr << "--batch applies to the ticket waiting room, ignored" << endl;
+      settings.batch_size = 1;
+   }
+   if (settings.num_classes < 1) {
+      settings.num_classes = 1;
+   } else if (settings.num_classes > kMaxPriorityClasses) {
+      settings.num_classes = kMaxPriorityClasses;
+   }
+   if ((settings.dispatch != kDispatchFifo || settings.patience_us > 0) && !tickets) {
+      cerr << "--dispatch and --patience apply to the ticket waiting room, ignored" << endl;
+      settings.dispatch = kDispatchFifo;
+      settings.patience_us = 0;
+   }
+   if (settings.barber_dispatch == kBarberShortestWait && !tickets) {
+      cerr << "--barber-dispatch jsew applies to the ticket waiting room, ignored" << endl;
+      settings.barber_dispatch = kBarberFifo;
+   }
+   if (settings.barber_dispatch == kBarberFastest &&
+       (settings.waiting_room == kLockFreeWaitingRoom || settings.handoff == kDirectHandoff ||
+        settings.num_shards > 0)) {
+      cerr << "--barber-dispatch fastest applies to the locked and ticket waiting rooms, ignored" << endl;
+      settings.barber_dispatch = kBarberFifo;
+   }
+   if ((settings.service.kind_ != kFixedService || !settings.speeds.empty()) &&
+       find(settings.engines.begin(), settings.engines.end(), kSimEngine) != settings.engines.end()) {
+      cerr << "the simulator models fixed service at speed 1 whatever --service-dist and --speeds say" << endl;
+   }
+   if (!settings.stages.empty()) {
+      if (settings.num_shards > 0 || settings.elastic_barbers > 0) {
+         cerr << "--shards and --elastic do not apply to --stages, ignored" << endl;
+         settings.num_shards = 0;
+         settings.elastic_barbers = 0;
+      }
+      if (find(settings.engines.begin(), settings.engines.end(), kSimEngine) != settings.engines.end()) {
+         cerr << "the simulator does not model --stages, threaded runs only" << endl;
+         settings.engines.assign(1, kThreadEngine);
+      }
+      printf("# pipeline:");
+      for (size_t s = 0; s < settings.stages.size(); s++) {
+         printf(" %s x%d %.0fus", settings.stages[s].name_.c_str(), settings.stages[s].workers_,
+                settings.stages[s].service_.mean_us_);
+      }
+      printf(", the points' barbers and service times are not used\n");
+      barbers.assign(1, 1);
+      service_times.assign(1, 1);
+   }
+   /** the shop turns a locked room into a ticket room for them, say so */
+   if (settings.batch_size > 1 || settings.dispatch != kDispatchFifo || settings.patience_us > 0 ||
+       settings.barber_dispatch == kBarberShortestWait) {
+      settings.waiting_room = kTicketWaitingRoom;
+   }
+   printf("%7s %7s %6s %9s %9s %7s %11s %7s %9s %9s %9s %9s %9s %9s %9s %9s %6s %7s %6s\n",
+          "engine", "barbers", "chairs", "rate/s", "ach/s", "svc_us", "served/s", "drop%",
+          "wait_p50", "wait_p99", "wait_p999", "e2e_mean", "e2e_p50", "e2e_p99", "e2e_p999",
+          "pay_p99", "util%", "cpu_s", "csw/c");
+
+   vector<BenchmarkResult*> results;
+   for (size_t b = 0; b < barbers.size(); b++) {
+      for (size_t c = 0; c < chairs.size(); c++) {
+         for (size_t r = 0; r < rates.size(); r++) {
+            for (size_t t = 0; t < service_times.size(); t++) {
+               for (size_t e = 0; e < settings.engines.size(); e++) {
+                  BenchmarkResult* result = new BenchmarkResult();
+                  result->engine = settings.engines[e];
+                  result->point.num_barbers = (int) barbers[b];
+                  result->point.num_chairs = (int) chairs[c];
+                  result->point.arrival_rate = rates[r];
+                  result->point.service_time = (int) service_times[t];
+                  if (result->point.num_barbers < 1 || result->point.num_chairs < 0 ||
+                      result->point.arrival_rate <= 0 || result->point.service_time <= 0) {
+                     cerr << "skipping invalid point" << endl;
+                     delete result;
+                     continue;
+                  }
+                  if (!settings.stages.empty()) {
+                     runPipelinePoint(settings, result);
+                  } else if (result->engine == kSimEngine) {
+                     simulatePoint(settings, result);
+                  } else {
+                     runPoint(settings, result);
+                  }
+                  results.push_back(result);
+                  printResult(settings, *result);
+               }
+            }
+         }
+      }
+   }
+
+   if (event_trace_path != NULL) {
+      EventLog::instance().close();
+      if (EventLog::instance().get_dropped() > 0) {
+         printf("# event trace full, %ld events dropped\n", EventLog::instance().get_dropped());
+      }
+   }
+   if (csv_path != NULL) {
+      writeCsv(csv_path, results);
+   }
+   if (json_path != NULL) {
+      writeJson(json_path, settings, results);
+   }
+   for (size_t i = 0; i < results.size(); i++) {
+      delete results[i];
+   }
+   return 0;
+}
+
+/**
+ * Prints one table row, latencies in μ seconds, and with barbers of
+ * different speeds every barber's share of the customers.
+ * Calls barberSpeed method.
+ * @param settings settings shared by every point
+ * @param result measured point
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  row written to stdout
+ **/
+static void printResult(const BenchmarkSettings& settings, const BenchmarkResult& result)
+{
+   printf("%7s %7d %6d %9.0f %9.0f %7d %11.1f %7.2f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %6.1f %7.3f %6.2f\n",
+          (result.engine == kSimEngine) ? "sim" : "threads",
+          result.point.num_barbers, result.point.num_chairs,
+          result.requested_rate, result.achieved_rate, result.point.service_time,
+          result.served / result.elapsed_s,
+          100.0 * result.drops / result.customers,
+          result.wait.percentile(50) / 1e3, result.wait.percentile(99) / 1e3,
+          result.wait.percentile(99.9) / 1e3, result.total.get_mean() / 1e3,
+          result.total.percentile(50) / 1e3, result.total.percentile(99) / 1e3,
+          result.total.percentile(99.9) / 1e3,
+          result.stats.payment_.percentile(99) / 1e3,
+          100.0 * meanUtilization(result.stats), result.cpu_s, result.switches_per_customer);
+   if (result.reneges > 0) {
+      printf("#   reneges %ld (%.2f%%)\n", result.reneges, 100.0 * result.reneges / result.customers);
+   }
+   for (int c = 1; c < kMaxPriorityClasses; c++) {
+      if (result.stats.class_wait_[c].get_count() == 0 && result.stats.class_reneges_[c] == 0) {
+         continue;
+      }
+      /** a class other than 0 was used, so show every class */
+      for (int k = 0; k < kMaxPriorityClasses; k++) {
+         const Histogram& wait = result.stats.class_wait_[k];
+         if (wait.get_count() > 0 || result.stats.class_reneges_[k] > 0) {
+            printf("#   class %d: served %lu wait_p50 %.1f wait_p99 %.1f reneges %ld\n", k,
+                   (unsigned long) wait.get_count(), wait.percentile(50) / 1e3,
+                   wait.percentile(99) / 1e3, result.stats.class_reneges_[k]);
+         }
+      }
+      break;
+   }
+   if (!settings.speeds.empty() && result.engine == kThreadEngine) {
+      for (size_t i = 0; i < result.stats.barbers_.size(); i++) {
+         const BarberStats& barber = result.stats.barbers_[i];
+         if (barber.busy_ns_ + barber.idle_ns_ == 0) {
+            continue;
+         }
+         printf("#   barber %zu: speed %.2f served %ld util %.1f%%\n", i, barberSpeed(settings, (int) i),
+                barber.served_, 100.0 * barber.get_utilization());
+      }
+   }
+   if (!settings.stages.empty()) {
+      for (size_t s = 0; s < result.pipeline.stages_.size(); s++) {
+         const StageStats& stage = result.pipeline.stages_[s];
+         printf("#   stage %s: workers %d served %ld util %.1f%% blocked %.1f%% wait_p99 %.1f capacity %.0f/s\n",
+                stage.name_.c_str(), stage.workers_, stage.served_, 100.0 * stage.get_utilization(),
+                100.0 * stage.get_blocked(), stage.queue_wait_.percentile(99) / 1e3, stage.get_capacity());
+      }
+      int bottleneck = result.pipeline.get_bottleneck();
+      if (bottleneck >= 0) {
+         printf("#   bottleneck: %s\n", result.pipeline.stages_[bottleneck].name_.c_str());
+      }
+   }
+   if (SHOP_PROFILE_LOCKS && result.engine == kThreadEngine && settings.stages.empty()) {
+      LockProfiler::print(stdout, result.locks, "#   ");
+   }
+   fflush(stdout);
+}
+
+/**
+ * This returns the CPU time used by the process so far, in seconds.
+ * No other methods are called.
+ * @return user + system CPU seconds
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+static double cpuSeconds()
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+          (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+/**
+ * This returns the number of context switches of the process so far.
+ * No other methods are called.
+ * @return voluntary + involuntary context switches of all threads
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+static long contextSwitches()
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+/**
+ * Records the start of a run into the event log, so that shopTrace can 
+ * tell the runs of a trace apart, customer ids starting over in every 
+ * run. Runs are numbered from 1 over the whole benchmark.
+ * No other methods are called.
+ * Records events through SHOP_LOG.
+ * @param warmup true for a warm-up run
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  kEventRunStarts logged if the log is open
+ **/
+static void markRun(bool warmup)
+{
+   static int runs = 0;
+   SHOP_LOG(kLogDrops, 0, kEventRunStarts, ++runs, warmup ? 1 : 0);
+}
+
+/**
+ * Runs one grid point with a fresh shop, fresh barber threads and a fresh
+ * executor, and fills in the measurements of result. Warm-up runs go
+ * first on the same shop and barbers, the shop drained and reset after
+ * each. An elastic shop's barbers are run by a BarberPool and retired
+ * instead of drained.
+ * Calls barber, markRun, openGate, CustomerExecutor, BarberPool, Shop and
+ * Franchise methods.
+ * @param settings settings shared by every point
+ * @param result point to run, receives the measurements
+ * @return none
+ * @custom.preconditions  result->point is valid
+ * @custom.postconditions  result filled in, all threads of the run joined
+ **/
+static void runPoint(const BenchmarkSettings& settings, BenchmarkResult* result)
+{
+   const BenchmarkPoint& point = result->point;
+   markRun(settings.warmup_runs > 0);
+   ShopOptions options;
+   options.waiting_room_ = settings.waiting_room;
+   options.handoff_ = settings.handoff;
+   options.numa_node_ = settings.numa_node;
+   options.batch_size_ = settings.batch_size;
+   options.dispatch_ = settings.dispatch;
+   options.reneging_ = settings.patience_us > 0;
+   options.barber_dispatch_ = settings.barber_dispatch;
+   Shop* shop = NULL;
+   Franchise* franchise = NULL;
+   int num_shards = 1;
+   if (settings.num_shards > 0) {
+      num_shards = settings.num_shards;
+      franchise = new Franchise(num_shards, point.num_barbers, point.num_chairs, options, settings.routing);
+   } else {
+      options.barber_capacity_ = settings.elastic_barbers;
+      shop = new Shop(point.num_barbers, point.num_chairs, options);
+      for (int i = 0; i < shop->get_barber_capacity(); i++) {
+         shop->set_barber_speed(i, barberSpeed(settings, i));
+      }
+   }
+   int num_barbers = num_shards * point.num_barbers;
+   ServiceOptions service = settings.service;
+   service.mean_us_ = point.service_time;
+
+   BarberPool* pool = NULL;
+   if (settings.elastic_barbers > 0) {
+      BarberPoolOptions pool_options;
+      pool_options.min_barbers_ = point.num_barbers;
+      pool_options.shrink_after_ = settings.shrink_after;
+      pool = new BarberPool(shop, service, pool_options);
+      num_barbers = 0;
+   }
+   BarberGate gate;
+   pthread_mutex_init(&gate.mutex, NULL);
+   pthread_cond_init(&gate.cond, NULL);
+   gate.generation = 0;
+   gate.stop = false;
+   vector<pthread_t> barber_threads(num_barbers);
+   vector<BarberParam> barber_params(num_barbers);
+   for (int i = 0; i < num_barbers; i++) {
+      ServiceOptions barber_service = service;
+      barber_service.seed_ = service.seed_ + i;
+      barber_service.speed_ = barberSpeed(settings, i);
+      barber_params[i].shop = shop;
+      barber_params[i].franchise = franchise;
+      barber_params[i].id = i;
+      barber_params[i].service = new ServiceTime(barber_service);
+      barber_params[i].gate = &gate;
+      pthread_create(&barber_threads[i], NULL, barber, &barber_params[i]);
+      if (settings.pinning == kPinCpu) {
+         pinToCpu(barber_threads[i], i % cpuCount());
+      } else if (settings.pinning == kPinNode) {
+         pinToNode(barber_threads[i], (settings.numa_node < 0) ? 0 : settings.numa_node);
+      }
+   }
+
+   int num_workers = ((pool != NULL) ? shop->get_barber_capacity() : num_barbers) +
+                     num_shards * point.num_chairs + 1;
+   ArrivalOptions arrival_options = settings.arrivals;
+   arrival_options.rate_ = point.arrival_rate;
+   uniform_int_distribution<int> class_of(0, settings.num_classes - 1);
+
+   /** warm-up runs replay the measured run's customers and are forgotten */
+   for (int run = 0; run < settings.warmup_runs; run++) {
+      CustomerExecutor* warmup = (franchise != NULL) ?
+         new CustomerExecutor(franchise, num_workers, num_workers) :
+         new CustomerExecutor(shop, num_workers, num_workers);
+      ArrivalProcess warmup_arrivals(arrival_options);
+      mt19937_64 warmup_class_rng(settings.seed + 1);
+      warmup_arrivals.start();
+      long warmup_submitted = 0;
+      while (warmup_submitted < settings.num_customers && warmup_arrivals.waitNext()) {
+         int priority = class_of(warmup_class_rng);
+         warmup->submit((int) ++warmup_submitted, priority,
+                        (uint64_t) (settings.patience_us * 1000 * (priority + 1)));
+      }
+      warmup->join();
+      delete warmup;
+      if (franchise != NULL) {
+         franchise->drain();
+         franchise->reset();
+      } else {
+         shop->drain();
+         shop->reset();
+      }
+      markRun(run + 1 < settings.warmup_runs);
+      openGate(&gate, false);
+   }
+
+   StatsPublisher* publisher = NULL;
+   if (shop != NULL && settings.stats_page != NULL) {
+      publisher = new StatsPublisher(shop, settings.stats_page, settings.stats_interval_ms);
+      if (!publisher->good()) {
+         cerr << "cannot create stats page " << settings.stats_page << endl;
+      }
+   }
+
+   CustomerExecutor* customers = (franchise != NULL) ?
+      new CustomerExecutor(franchise, num_workers, num_workers) :
+      new CustomerExecutor(shop, num_workers, num_workers);
+   ArrivalProcess arrivals(arrival_options);
+   /** classes come from their own generator so arrivals stay the same */
+   mt19937_64 class_rng(settings.seed + 1);
+
+   double cpu_start = cpuSeconds();
+   long switches_start = contextSwitches();
+   LockProfiler::instance().reset();
+   uint64_t start_ns = monotonicNs();
+   arrivals.start();
+   long submitted = 0;
+   while (submitted < settings.num_customers && arrivals.waitNext()) {
+      int priority = class_of(class_rng);
+      customers->submit((int) ++submitted, priority,
+                        (uint64_t) (settings.patience_us * 1000 * (priority + 1)));
+   }
+   customers->join();
+   uint64_t end_ns = monotonicNs();
+   /** the last reading is taken while every barber is still working */
+   delete publisher;
+   result->locks = LockProfiler::instance().get_profile();
+   result->cpu_s = cpuSeconds() - cpu_start;
+   result->switches_per_customer = (submitted == 0) ? 0.0 :
+      (double) (contextSwitches() - switches_start) / submitted;
+
+   if (pool == NULL) {
+      if (franchise != NULL) {
+         franchise->drain();
+      } else {
+         shop->drain();
+      }
+      openGate(&gate, true);
+   }
+   for (int i = 0; i < num_barbers; i++) {
+      pthread_join(barber_threads[i], NULL);
+      delete barber_params[i].service;
+   }
+   pthread_cond_destroy(&gate.cond);
+   pthread_mutex_destroy(&gate.mutex);
+   result->peak_barbers = num_barbers;
+   if (pool != NULL) {
+      pool->stop();
+      result->peak_barbers = pool->get_peak_barbers();
+   }
+
+   result->customers = submitted;
+   result->requested_rate = arrivals.get_requested_rate();
+   result->achieved_rate = arrivals.get_achieved_rate();
+   result->lateness = arrivals.get_lateness();
+   result->drops = (franchise != NULL) ? franchise->get_cust_drops() : shop->get_cust_drops();
+   result->reneges = (franchise != NULL) ? 0 : shop->get_cust_reneges();
+   result->served = result->customers - result->drops - result->reneges;
+   result->elapsed_s = (end_ns - start_ns) / 1e9;
+   customers->mergeLatencies(&result->wait, &result->total);
+   result->stats = (franchise != NULL) ? franchise->get_stats() : shop->get_stats();
+   delete customers;
+   delete pool;
+   delete franchise;
+   delete shop;
+}
+
+/**
+ * Runs one grid point on a fresh PipelineShop built from the settings'
+ * stages, the point's chairs being the first stage's queue, and fills in
+ * the measurements of result. Every stage is reported as one barber.
+ * Calls CustomerExecutor and PipelineShop methods.
+ * @param settings settings shared by every point
+ * @param result point to run, receives the measurements
+ * @return none
+ * @custom.preconditions  result->point is valid, settings.stages not empty
+ * @custom.postconditions  result filled in, all threads of the run joined
+ **/
+static void runPipelinePoint(const BenchmarkSettings& settings, BenchmarkResult* result)
+{
+   BenchmarkPoint& point = result->point;
+   vector<PipelineStageOptions> stages = settings.stages;
+   int num_workers = 1;
+   point.num_barbers = 0;
+   point.service_time = 0;
+   for (size_t s = 0; s < stages.size(); s++) {
+      ServiceOptions service = settings.service;
+      service.mean_us_ = stages[s].service_.mean_us_;
+      service.seed_ = settings.service.seed_ + 100 * s;
+      stages[s].service_ = service;
+      stages[s].queue_capacity_ = (s == 0) ? point.num_chairs : settings.stage_queue;
+      num_workers += stages[s].workers_ + stages[s].queue_capacity_;
+      point.num_barbers += stages[s].workers_;
+      point.service_time += (int) service.mean_us_;
+   }
+   PipelineShop* pipeline = new PipelineShop(stages);
+   CustomerExecutor* customers = new CustomerExecutor(pipeline, num_workers, num_workers);
+   ArrivalOptions arrival_options = settings.arrivals;
+   arrival_options.rate_ = point.arrival_rate;
+   ArrivalProcess arrivals(arrival_options);
+
+   double cpu_start = cpuSeconds();
+   long switches_start = contextSwitches();
+   uint64_t start_ns = monotonicNs();
+   arrivals.start();
+   long submitted = 0;
+   while (submitted < settings.num_customers && arrivals.waitNext()) {
+      customers->submit((int) ++submitted);
+   }
+   customers->join();
+   uint64_t end_ns = monotonicNs();
+   result->cpu_s = cpuSeconds() - cpu_start;
+   result->switches_per_customer = (submitted == 0) ? 0.0 :
+      (double) (contextSwitches() - switches_start) / submitted;
+   pipeline->stop();
+
+   result->pipeline = pipeline->get_stats();
+   result->peak_barbers = point.num_barbers;
+   result->customers = submitted;
+   result->requested_rate = arrivals.get_requested_rate();
+   result->achieved_rate = arrivals.get_achieved_rate();
+   result->lateness = arrivals.get_lateness();
+   result->drops = pipeline->get_cust_drops();
+   result->reneges = 0;
+   result->served = result->customers - result->drops;
+   result->elapsed_s = (end_ns - start_ns) / 1e9;
+   customers->mergeLatencies(&result->wait, &result->total);
+   result->stats.arrivals_ = result->pipeline.arrivals_;
+   result->stats.served_ = result->pipeline.served_;
+   result->stats.drops_ = result->pipeline.drops_;
+   result->stats.queue_wait_ = result->pipeline.stages_[0].queue_wait_;
+   for (size_t s = 0; s < result->pipeline.stages_.size(); s++) {
+      const StageStats& stage = result->pipeline.stages_[s];
+      BarberStats barber;
+      barber.served_ = stage.served_;
+      barber.busy_ns_ = stage.busy_ns_;
+      barber.idle_ns_ = stage.idle_ns_ + stage.blocked_ns_;
+      result->stats.barbers_.push_back(barber);
+      result->stats.service_.merge(stage.service_);
+   }
+   delete customers;
+   delete pipeline;
+}
+
+/**
+ * Runs one grid point on a fresh ShopSimulator seeded like the threaded
+ * run, and fills in the measurements of result in virtual time. A 
+ * franchise is modelled as one shop with the barbers and chairs of all 
+ * its shops, the limit of perfect stealing.
+ * Calls ShopSimulator methods.
+ * @param settings settings shared by every point
+ * @param result point to run, receives the measurements
+ * @return none
+ * @custom.preconditions  result->point is valid
+ * @custom.postconditions  result filled in
+ **/
+static void simulatePoint(const BenchmarkSettings& settings, BenchmarkResult* result)
+{
+   const BenchmarkPoint& point = result->point;
+   int num_shards = (settings.num_shards > 0) ? settings.num_shards : 1;
+   ArrivalOptions arrival_options = settings.arrivals;
+   arrival_options.rate_ = point.arrival_rate;
+   ShopSimulator simulator(num_shards * point.num_barbers, num_shards * point.num_chairs, point.service_time,
+                           arrival_options);
+
+   double cpu_start = cpuSeconds();
+   simulator.run(settings.num_customers);
+   result->cpu_s = cpuSeconds() - cpu_start;
+   result->switches_per_customer = 0.0;
+
+   result->stats = simulator.get_stats();
+   result->peak_barbers = num_shards * point.num_barbers;
+   result->customers = result->stats.arrivals_;
+   /** virtual arrivals are never late, the lateness histogram stays empty */
+   result->requested_rate = ArrivalProcess(arrival_options).get_requested_rate();
+   result->achieved_rate = (simulator.get_last_arrival_ns() == 0) ? 0.0 :
+      result->customers / (simulator.get_last_arrival_ns() / 1e9);
+   result->drops = result->stats.drops_;
+   result->reneges = 0;
+   result->served = result->stats.served_;
+   result->elapsed_s = simulator.get_elapsed_ns() / 1e9;
+   result->wait = simulator.get_wait();
+   result->total = simulator.get_total();
+}
+
+/**
+ * This returns the mean utilization of the barbers of a run.
+ * No other methods are called.
+ * @param stats statistics of the run's shop
+ * @return mean of BarberStats::get_utilization, 0 without barbers
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+static double meanUtilization(const ShopStats& stats)
+{
+   double sum = 0.0;
+   int counted = 0;
+   for (size_t i = 0; i < stats.barbers_.size(); i++) {
+      /** slots of an elastic shop that never worked are left out */
+      if (stats.barbers_[i].busy_ns_ + stats.barbers_[i].idle_ns_ == 0) {
+         continue;
+      }
+      sum += stats.barbers_[i].get_utilization();
+      ++counted;
+   }
+   return (counted == 0) ? 0.0 : sum / counted;
+}
+
+/**
+ * This returns the command line name of an arrival process.
+ * No other methods are called.
+ * @param kind arrival process
+ * @return its name
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+static const char* arrivalName(ArrivalKind kind)
+{
+   switch (kind) {
+   case kUniformArrivals:
+      return "uniform";
+   case kBurstyArrivals:
+      return "bursty";
+   case kConstantArrivals:
+      return "constant";
+   case kTraceArrivals:
+      return "trace";
+   default:
+      return "poisson";
+   }
+}
+
+/**
+ * This returns the command line name of a dispatch policy.
+ * No other methods are called.
+ * @param policy dispatch policy
+ * @return its name
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+static const char* dispatchName(DispatchPolicy policy)
+{
+   switch (policy) {
+   case kDispatchStrict:
+      return "strict";
+   case kDispatchWeighted:
+      return "weighted";
+   case kDispatchEarliestDeadline:
+      return "edf";
+   default:
+      return "fifo";
+   }
+}
+
+/**
+ * This returns the command line name of a service time distribution.
+ * No other methods are called.
+ * @param kind service time distribution
+ * @return its name
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+static const char* serviceName(ServiceKind kind)
+{
+   switch (kind) {
+   case kExponentialService:
+      return "exp";
+   case kLognormalService:
+      return "lognormal";
+   case kTraceService:
+      return "trace";
+   default:
+      return "fixed";
+   }
+}
+
+/**
+ * This returns the command line name of a barber dispatch.
+ * No other methods are called.
+ * @param dispatch barber dispatch
+ * @return its name
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+static const char* barberDispatchName(BarberDispatch dispatch)
+{
+   switch (dispatch) {
+   case kBarberFastest:
+      return "fastest";
+   case kBarberShortestWait:
+      return "jsew";
+   default:
+      return "fifo";
+   }
+}
+
+/**
+ * This returns the speed factor of a barber, the --speeds list cycled.
+ * No other methods are called.
+ * @param settings settings shared by every point
+ * @param id id of the barber
+ * @return speed factor, 1 without --speeds
+ * @custom.preconditions  id >= 0
+ * @custom.postconditions  none
+ **/
+static double barberSpeed(const BenchmarkSettings& settings, int id)
+{
+   return settings.speeds.empty() ? 1.0 : settings.speeds[id % settings.speeds.size()];
+}
+
+/**
+ * Writes one CSV row per grid point, latencies in nanoseconds.
+ * No other methods are called.
+ * @param path output file
+ * @param results measured points
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  file written, or an error printed
+ **/
+static void writeCsv(const char* path, const vector<BenchmarkResult*>& results)
+{
+   ofstream out(path);
+   if (!out) {
+      cerr << "cannot write " << path << endl;
+      return;
+   }
+   out << "engine,num_barbers,num_chairs,arrival_rate,service_time_us,customers,served,drops,"
+       << "throughput,drop_rate,wait_p50_ns,wait_p99_ns,wait_p999_ns,wait_max_ns,"
+       << "e2e_p50_ns,e2e_p99_ns,e2e_p999_ns,e2e_max_ns,queue_wait_p99_ns,service_p50_ns,"
+       << "payment_p50_ns,payment_p99_ns,barber_utilization,elapsed_s,cpu_s,switches_per_customer,"
+       << "requested_rate,achieved_rate,lateness_p50_ns,lateness_p99_ns,lateness_max_ns,peak_barbers,"
+       << "reneges,renege_rate,e2e_mean_ns,bottleneck";
+   for (int c = 0; c < kMaxPriorityClasses; c++) {
+      out << ",class" << c << "_wait_p99_ns,class" << c << "_reneges";
+   }
+   out << endl;
+   for (size_t i = 0; i < results.size(); i++) {
+      const BenchmarkResult& r = *results[i];
+      out << ((r.engine == kSimEngine) ? "sim" : "threads") << ","
+          << r.point.num_barbers << "," << r.point.num_chairs << "," << r.point.arrival_rate << ","
+          << r.point.service_time << "," << r.customers << "," << r.served << "," << r.drops << ","
+          << r.served / r.elapsed_s << "," << (double) r.drops / r.customers << ","
+          << r.wait.percentile(50) << "," << r.wait.percentile(99) << ","
+          << r.wait.percentile(99.9) << "," << r.wait.get_max() << ","
+          << r.total.percentile(50) << "," << r.total.percentile(99) << ","
+          << r.total.percentile(99.9) << "," << r.total.get_max() << ","
+          << r.stats.queue_wait_.percentile(99) << "," << r.stats.service_.percentile(50) << ","
+          << r.stats.payment_.percentile(50) << "," << r.stats.payment_.percentile(99) << ","
+          << meanUtilization(r.stats) << "," << r.elapsed_s << "," << r.cpu_s << ","
+          << r.switches_per_customer << "," << r.requested_rate << "," << r.achieved_rate << ","
+          << r.lateness.percentile(50) << "," << r.lateness.percentile(99) << ","
+          << r.lateness.get_max() << "," << r.peak_barbers << ","
+          << r.reneges << "," << (double) r.reneges / r.customers << "," << r.total.get_mean() << ","
+          << ((r.pipeline.get_bottleneck() >= 0) ? r.pipeline.stages_[r.pipeline.get_bottleneck()].name_ : "");
+      for (int c = 0; c < kMaxPriorityClasses; c++) {
+         out << "," << r.stats.class_wait_[c].percentile(99) << "," << r.stats.class_reneges_[c];
+      }
+      out << endl;
+   }
+}
+
+/**
+ * Writes the settings and one object per grid point as JSON, latencies
+ * in nanoseconds.
+ * No other methods are called.
+ * @param path output file
+ * @param settings settings shared by every point
+ * @param results measured points
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  file written, or an error printed
+ **/
+static void writeJson(const char* path, const BenchmarkSettings& settings, const vector<BenchmarkResult*>& results)
+{
+   ofstream out(path);
+   if (!out) {
+      cerr << "cannot write " << path << endl;
+      return;
+   }
+   out << "{\n  \"customers\": " << settings.num_customers
+       << ",\n  \"seed\": " << settings.seed
+       << ",\n  \"waiting_room\": \"" << ((settings.waiting_room == kLockFreeWaitingRoom) ? "lockfree" :
+                                           (settings.waiting_room == kTicketWaitingRoom) ? "ticket" : "locked")
+       << "\",\n  \"handoff\": \"" << ((settings.handoff == kDirectHandoff) ? "direct" : "condvar")
+       << "\",\n  \"wait_strategy\": \"" << ShopWait::name()
+       << "\",\n  \"barber_layout\": \"" << ((SHOP_BARBER_LAYOUT == kBarberLayoutPadded) ? "padded" : "packed")
+       << "\",\n  \"pinning\": \"" << ((settings.pinning == kPinCpu) ? "cpu" : (settings.pinning == kPinNode) ? "node" : "none")
+       << "\",\n  \"numa_node\": " << settings.numa_node
+       << ",\n  \"shards\": " << settings.num_shards
+       << ",\n  \"routing\": \"" << ((settings.routing == kRouteHash) ? "hash" : "rr")
+       << "\",\n  \"arrivals\": \"" << arrivalName(settings.arrivals.kind_)
+       << "\",\n  \"arrival_spin_ns\": " << settings.arrivals.spin_ns_
+       << ",\n  \"elastic_barbers\": " << settings.elastic_barbers
+       << ",\n  \"batch_size\": " << settings.batch_size
+       << ",\n  \"classes\": " << settings.num_classes
+       << ",\n  \"dispatch\": \"" << dispatchName(settings.dispatch)
+       << "\",\n  \"patience_us\": " << settings.patience_us
+       << ",\n  \"service_dist\": \"" << serviceName(settings.service.kind_)
+       << "\",\n  \"barber_dispatch\": \"" << barberDispatchName(settings.barber_dispatch)
+       << "\",\n  \"speeds\": [";
+   for (size_t i = 0; i < settings.speeds.size(); i++) {
+      out << ((i == 0) ? "" : ", ") << settings.speeds[i];
+   }
+   out << "]"
+       << ",\n  \"results\": [";
+   for (size_t i = 0; i < results.size(); i++) {
+      const BenchmarkResult& r = *results[i];
+      out << ((i == 0) ? "\n" : ",\n")
+          << "    {\"engine\": \"" << ((r.engine == kSimEngine) ? "sim" : "threads") << "\""
+          << ", \"num_barbers\": " << r.point.num_barbers
+          << ", \"num_chairs\": " << r.point.num_chairs
+          << ", \"arrival_rate\": " << r.point.arrival_rate
+          << ", \"service_time_us\": " << r.point.service_time
+          << ", \"served\": " << r.served
+          << ", \"drops\": " << r.drops
+          << ", \"throughput\": " << r.served / r.elapsed_s
+          << ", \"drop_rate\": " << (double) r.drops / r.customers
+          << ", \"wait_ns\": {\"p50\": " << r.wait.percentile(50)
+          << ", \"p99\": " << r.wait.percentile(99)
+          << ", \"p999\": " << r.wait.percentile(99.9)
+          << ", \"max\": " << r.wait.get_max() << "}"
+          << ", \"e2e_ns\": {\"p50\": " << r.total.percentile(50)
+          << ", \"p99\": " << r.total.percentile(99)
+          << ", \"p999\": " << r.total.percentile(99.9)
+          << ", \"max\": " << r.total.get_max()
+          << ", \"mean\": " << r.total.get_mean() << "}"
+          << ", \"queue_wait_ns\": {\"p50\": " << r.stats.queue_wait_.percentile(50)
+          << ", \"p99\": " << r.stats.queue_wait_.percentile(99) << "}"
+          << ", \"service_ns\": {\"p50\": " << r.stats.service_.percentile(50)
+          << ", \"p99\": " << r.stats.service_.percentile(99) << "}"
+          << ", \"payment_ns\": {\"p50\": " << r.stats.payment_.percentile(50)
+          << ", \"p99\": " << r.stats.payment_.percentile(99) << "}"
+          << ", \"barber_utilization\": " << meanUtilization(r.stats)
+          << ", \"elapsed_s\": " << r.elapsed_s
+          << ", \"cpu_s\": " << r.cpu_s
+          << ", \"switches_per_customer\": " << r.switches_per_customer
+          << ", \"requested_rate\": " << r.requested_rate
+          << ", \"achieved_rate\": " << r.achieved_rate
+          << ", \"lateness_ns\": {\"p50\": " << r.lateness.percentile(50)
+          << ", \"p99\": " << r.lateness.percentile(99)
+          << ", \"max\": " << r.lateness.get_max() << "}"
+          << ", \"peak_barbers\": " << r.peak_barbers
+          << ", \"reneges\": " << r.reneges
+          << ", \"renege_rate\": " << (double) r.reneges / r.customers
+          << ", \"classes\": [";
+      for (int c = 0; c < settings.num_classes; c++) {
+         out << ((c == 0) ? "" : ", ")
+             << "{\"wait_ns\": {\"p50\": " << r.stats.class_wait_[c].percentile(50)
+             << ", \"p99\": " << r.stats.class_wait_[c].percentile(99) << "}"
+             << ", \"reneges\": " << r.stats.class_reneges_[c] << "}";
+      }
+      out << "], \"stages\": [";
+      for (size_t s = 0; s < r.pipeline.stages_.size(); s++) {
+         const StageStats& stage = r.pipeline.stages_[s];
+         out << ((s == 0) ? "" : ", ")
+             << "{\"name\": \"" << stage.name_ << "\""
+             << ", \"workers\": " << stage.workers_
+             << ", \"served\": " << stage.served_
+             << ", \"utilization\": " << stage.get_utilization()
+             << ", \"blocked\": " << stage.get_blocked()
+             << ", \"capacity\": " << stage.get_capacity()
+             << ", \"queue_wait_ns\": {\"p50\": " << stage.queue_wait_.percentile(50)
+             << ", \"p99\": " << stage.queue_wait_.percentile(99) << "}}";
+      }
+      out << "], \"bottleneck\": " << r.pipeline.get_bottleneck() << "}";
+   }
+   out << "\n  ]\n}" << endl;
+}
+
+/**
+ * Parses a comma separated list of numbers such as "1,2,4".
+ * No other methods are called.
+ * @param text the list
+ * @return the numbers in order
+ * @custom.preconditions  text != NULL
+ * @custom.postconditions  none
+ **/
+static vector<double> parseList(const char* text)
+{
+   vector<double> values;
+   string list = text;
+   size_t start = 0;
+   while (start <= list.size()) {
+      size_t comma = list.find(',', start);
+      if (comma == string::npos) {
+         comma = list.size();
+      }
+      if (comma > start) {
+         values.push_back(atof(list.substr(start, comma - start).c_str()));
+      }
+      start = comma + 1;
+   }
+   return values;
+}
+
+/**
+ * Parses a comma separated list of pipeline stages such as
+ * "wash:1:50,cut:2:200", each the stage's name, number of workers and
+ * mean service time in μ seconds.
+ * No other methods are called.
+ * @param text the list
+ * @param stages receives the stages in order
+ * @return false if a stage is malformed
+ * @custom.preconditions  text != NULL
+ * @custom.postconditions  stages holds the parsed stages on success
+ **/
+static bool parseStages(const char* text, vector<PipelineStageOptions>* stages)
+{
+   stages->clear();
+   string list = text;
+   size_t start = 0;
+   while (start < list.size()) {
+      size_t comma = list.find(',', start);
+      if (comma == string::npos) {
+         comma = list.size();
+      }
+      string stage = list.substr(start, comma - start);
+      size_t first = stage.find(':');
+      size_t second = (first == string::npos) ? string::npos : stage.find(':', first + 1);
+      if (second == string::npos) {
+         return false;
+      }
+      PipelineStageOptions options;
+      options.name_ = stage.substr(0, first);
+      options.workers_ = atoi(stage.substr(first + 1, second - first - 1).c_str());
+      options.service_.mean_us_ = atof(stage.substr(second + 1).c_str());
+      if (options.name_.empty() || options.workers_ < 1 || options.service_.mean_us_ <= 0) {
+         return false;
+      }
+      stages->push_back(options);
+      start = comma + 1;
+   }
+   return !stages->empty();
+}
+
+/**
+ * Called by barber threads of a benchmark point to service customers
+ * until the shop is drained, then to wait at the gate for the next run.
+ * Calls the helloCustomer and byeCustomer methods of the shop or franchise.
+ * @param arg BarberParam with the barber's shop, id, service times and gate
+ * @return none
+ * @custom.preconditions  arg stays valid until the thread is joined
+ * @custom.postconditions  barber services customers until the gate stops it
+ **/
+void *barber(void *arg)
+{
+   BarberParam* param = (BarberParam*) arg;
+   BarberGate* gate = param->gate;
+   int generation = 0;
+   while (true) {
+      if (param->franchise != NULL) {
+         while (param->franchise->helloCustomer(param->id)) {
+            usleep(param->service->next());
+            param->franchise->byeCustomer(param->id);
+         }
+      } else {
+         while (param->shop->helloCustomer(param->id)) {
+            usleep(param->service->next());
+            param->shop->byeCustomer(param->id);
+         }
+      }
+
+      /** drained, the shop is reset before the gate opens */
+      pthread_mutex_lock(&gate->mutex);
+      while (gate->generation == generation && !gate->stop) {
+         pthread_cond_wait(&gate->cond, &gate->mutex);
+      }
+      bool stop = gate->generation == generation;
+      generation = gate->generation;
+      pthread_mutex_unlock(&gate->mutex);
+      if (stop) {
+         break;
+      }
+   }
+   return nullptr;
+}
+
+/**
+ * Lets the barbers waiting at a point's gate into the next run, or out
+ * of the point.
+ * No other methods are called.
+ * @param gate gate of the point
+ * @param stop true if the point is done
+ * @return none
+ * @custom.preconditions  the shop is reset, or drained if stop
+ * @custom.postconditions  every waiting barber woken
+ **/
+static void openGate(BarberGate* gate, bool stop)
+{
+   pthread_mutex_lock(&gate->mutex);
+   if (stop) {
+      gate->stop = true;
+   } else {
+      gate->generation++;
+   }
+   pthread_cond_broadcast(&gate->cond);
+   pthread_mutex_unlock(&gate->mutex);
+}
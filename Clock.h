@@ -0,0 +1,25 @@
+/**
+ * Clock.h
+ *
+ * This is the Clock.h file that provides the monotonic clock used to
+ * timestamp shop events and measure latencies, in nanoseconds.
+ **/
+#ifndef CLOCK_H_
+#define CLOCK_H_
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * This returns the current CLOCK_MONOTONIC time in nanoseconds.
+ * No other methods are called.
+ * @return nanoseconds since an arbitrary fixed point
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+inline uint64_t monotonicNs()
+{
+   struct timespec now;
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (uint64_t) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+#endif
@@ -0,0 +1,124 @@
+/**
+ * CoDriver.cpp
+ *
+ * This is the CoDriver.cpp file that runs the shop with coroutines, the
+ * way Driver.cpp runs it with threads. It takes the number of barbers,
+ * number of waiting chairs, the number of customers, the service time of
+ * each barber and optionally the arrival rate per second and the number
+ * of scheduler threads. A rate of 0 lets every customer arrive at once.
+ *
+ * Every barber and every customer is a coroutine on one CoScheduler, so
+ * the waiting room can hold as many customers as memory allows: the
+ * program reports the peak number of waiting customers next to the
+ * coroutine frame bytes they took.
+ *
+ * Customers are waited upon to finish before the shop is closed, which
+ * lets the barber coroutines return.
+ **/
+#include <stdlib.h>
+#include <iostream>
+#include "ArrivalProcess.h"
+#include "CoScheduler.h"
+#include "CoShop.h"
+using namespace std;
+
+/**
+ * Visits the shop and, if a barber takes the customer, waits for the
+ * hair-cut to end.
+ * Calls the visit and leave methods in CoShop class.
+ * @param shop the shop
+ * @param id id of the customer
+ * @return task to spawn
+ * @custom.preconditions  none
+ * @custom.postconditions  customer served or gone
+ **/
+CoTask customer(CoShop* shop, int id)
+{
+   int barber_id = co_await shop->visit(id);
+   if (barber_id >= 0) {
+      co_await shop->leave(id, barber_id);
+   }
+}
+
+/**
+ * Serves customers until the shop closes.
+ * Calls the hello and bye methods in CoShop class.
+ * @param shop the shop
+ * @param scheduler scheduler whose timers time the hair-cuts
+ * @param id id of the barber
+ * @param service_time duration of a hair-cut in μ seconds
+ * @return task to spawn
+ * @custom.preconditions  none
+ * @custom.postconditions  barber gone once the shop closed
+ **/
+CoTask barber(CoShop* shop, CoScheduler* scheduler, int id, int service_time)
+{
+   /** co_await in a loop condition is miscompiled by g++ 12, so test in the body */
+   while (true) {
+      bool serving = co_await shop->hello(id);
+      if (!serving) {
+         break;
+      }
+      co_await scheduler->sleep(service_time);
+      shop->bye(id);
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   /** arguments read from command line */
+   if (argc < 5 || argc > 7) {
+      cerr << "usage: codriver #barbers #chairs #customers #servicetime [rate [threads]]" << endl;
+      return -1;
+   }
+   int num_barbers = atoi(argv[1]);
+   int num_chairs = atoi(argv[2]);
+   int num_customers = atoi(argv[3]);
+   int service_time = atoi(argv[4]);
+   double rate = (argc > 5) ? atof(argv[5]) : 2000.0;
+   int num_threads = (argc > 6) ? atoi(argv[6]) : 1;
+   if (num_barbers < 1 || num_chairs < 0 || num_customers < 0 || service_time <= 0 ||
+       rate < 0 || num_threads < 1) {
+      cerr << "where #barbers >= 1, #chairs >= 0, #customers >= 0, #servicetime > 0, "
+           << "rate >= 0 and threads >= 1" << endl;
+      return -1;
+   }
+
+   CoScheduler scheduler(num_threads);
+   CoShop shop(&scheduler, num_barbers, num_chairs);
+   for (int i = 0; i < num_barbers; i++) {
+      scheduler.spawn(barber(&shop, &scheduler, i, service_time));
+   }
+
+   ArrivalOptions arrival_options;
+   arrival_options.rate_ = (rate > 0) ? rate : 1.0;
+   ArrivalProcess arrivals(arrival_options);
+   arrivals.start();
+   for (int i = 0; i < num_customers; i++) {
+      if (rate > 0 && !arrivals.waitNext()) {
+         break;
+      }
+      scheduler.spawn(customer(&shop, i + 1));
+   }
+
+   /** only the barbers are left once every customer is done */
+   scheduler.waitTasks(num_barbers);
+   shop.close();
+   scheduler.join();
+
+   long peak_waiting = shop.get_peak_waiting();
+   long peak_tasks = scheduler.get_peak_tasks();
+   cout << "# customers who didn't receive a service = " << shop.get_cust_drops() << endl;
+   cout << "# customers served = " << shop.get_served() << endl;
+   if (rate > 0) {
+      cout << "# arrival rate requested = " << arrivals.get_requested_rate()
+           << "/s, achieved = " << arrivals.get_achieved_rate() << "/s" << endl;
+   }
+   cout << "# peak waiting customers = " << peak_waiting << ", peak coroutines = " << peak_tasks
+        << ", peak frame bytes = " << CoTask::get_peak_frame_bytes();
+   if (peak_tasks > 0) {
+      cout << " (" << CoTask::get_peak_frame_bytes() / peak_tasks << " per coroutine)";
+   }
+   cout << endl;
+   return 0;
+}
@@ -0,0 +1,329 @@
+/**
+ * CoScheduler.cpp
+ *
+ * This is the CoScheduler.cpp file that implements the methods of the
+ * CoTask and CoScheduler classes. The ready queue and the timers share
+ * one mutex, and a coroutine is always resumed with it unlocked, so a
+ * resumed task may post, sleep or return right away.
+ **/
+#include "CoScheduler.h"
+#include <time.h>
+#include "Clock.h"
+
+atomic<long> CoTask::frame_bytes_(0);
+atomic<long> CoTask::peak_frame_bytes_(0);
+
+/**
+ * Tells the scheduler the task is gone.
+ * Calls CoScheduler::taskDone method.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  scheduler no longer counts the task
+ **/
+CoTask::promise_type::~promise_type()
+{
+   if (scheduler_ != NULL) {
+      scheduler_->taskDone();
+   }
+}
+
+/**
+ * Allocates a coroutine frame and counts its bytes.
+ * No other methods are called.
+ * @param size size of the frame
+ * @return the frame
+ * @custom.preconditions  none
+ * @custom.postconditions  frame bytes counted
+ **/
+void* CoTask::promise_type::operator new(size_t size)
+{
+   long bytes = frame_bytes_.fetch_add((long) size, memory_order_relaxed) + (long) size;
+   long peak = peak_frame_bytes_.load(memory_order_relaxed);
+   while (bytes > peak && !peak_frame_bytes_.compare_exchange_weak(peak, bytes, memory_order_relaxed)) {
+   }
+   return ::operator new(size);
+}
+
+/**
+ * Frees a coroutine frame and uncounts its bytes.
+ * No other methods are called.
+ * @param frame the frame
+ * @param size size of the frame
+ * @return none
+ * @custom.preconditions  frame came from operator new
+ * @custom.postconditions  frame bytes uncounted
+ **/
+void CoTask::promise_type::operator delete(void* frame, size_t size)
+{
+   frame_bytes_.fetch_sub((long) size, memory_order_relaxed);
+   ::operator delete(frame);
+}
+
+/**
+ * This returns the bytes of all CoTask frames alive now.
+ * No other methods are called.
+ * @return bytes of live frames
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long CoTask::get_frame_bytes()
+{
+   return frame_bytes_.load();
+}
+
+/**
+ * This returns the most bytes of CoTask frames that were alive at once.
+ * No other methods are called.
+ * @return peak bytes of live frames
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long CoTask::get_peak_frame_bytes()
+{
+   return peak_frame_bytes_.load();
+}
+
+/**
+ * Starts the scheduler's threads, waiting for tasks to run.
+ * No other methods are called.
+ * @param num_threads number of threads resuming tasks
+ * @return none
+ * @custom.preconditions  num_threads >= 1
+ * @custom.postconditions  threads running
+ **/
+CoScheduler::CoScheduler(int num_threads) :
+   live_(0), peak_live_(0), stopping_(false), joined_(false)
+{
+   pthread_mutex_init(&mutex_, NULL);
+   /** timer deadlines are monotonic, so the timed waits are too */
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&cond_ready_, &attr);
+   pthread_condattr_destroy(&attr);
+   pthread_cond_init(&cond_task_done_, NULL);
+
+   if (num_threads < 1) {
+      num_threads = 1;
+   }
+   threads_.resize(num_threads);
+   for (int i = 0; i < num_threads; i++) {
+      pthread_create(&threads_[i], NULL, CoScheduler::run, this);
+   }
+}
+
+/**
+ * Destructor for CoScheduler class. Joins the threads if join has not
+ * been called yet.
+ * Calls join method.
+ * @return none
+ * @custom.preconditions  no task is suspended forever
+ * @custom.postconditions  threads joined
+ **/
+CoScheduler::~CoScheduler()
+{
+   if (!joined_) {
+      join();
+   }
+   pthread_cond_destroy(&cond_task_done_);
+   pthread_cond_destroy(&cond_ready_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * Hands a task to the scheduler, which runs it on one of its threads.
+ * Calls post method.
+ * @param task task that has not run yet
+ * @return none
+ * @custom.preconditions  join has not been called
+ * @custom.postconditions  task queued to run
+ **/
+void CoScheduler::spawn(CoTask task)
+{
+   task.handle_.promise().scheduler_ = this;
+   pthread_mutex_lock(&mutex_);
+   if (++live_ > peak_live_) {
+      peak_live_ = live_;
+   }
+   pthread_mutex_unlock(&mutex_);
+   post(task.handle_);
+}
+
+/**
+ * Queues a suspended coroutine to be resumed by one of the threads.
+ * No other methods are called.
+ * @param handle coroutine to resume
+ * @return none
+ * @custom.preconditions  handle is suspended and posted only once
+ * @custom.postconditions  handle queued to run
+ **/
+void CoScheduler::post(coroutine_handle<> handle)
+{
+   pthread_mutex_lock(&mutex_);
+   ready_.push_back(handle);
+   pthread_cond_signal(&cond_ready_);
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Puts the coroutine on the scheduler's timers.
+ * Calls CoScheduler::addTimer method.
+ * @param handle the sleeping coroutine
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  coroutine resumed once the deadline passed
+ **/
+void CoScheduler::SleepAwaiter::await_suspend(coroutine_handle<> handle)
+{
+   scheduler_->addTimer(handle, deadline_ns_);
+}
+
+/**
+ * This returns an awaitable that suspends the awaiting task for a while
+ * without holding a thread.
+ * No other methods are called.
+ * @param duration_us time to sleep in μ seconds
+ * @return awaitable to co_await
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+CoScheduler::SleepAwaiter CoScheduler::sleep(uint64_t duration_us)
+{
+   return SleepAwaiter{this, monotonicNs() + duration_us * 1000};
+}
+
+/**
+ * Puts a coroutine on the timers.
+ * No other methods are called.
+ * @param handle the sleeping coroutine
+ * @param deadline_ns time it is due again
+ * @return none
+ * @custom.preconditions  handle is suspended
+ * @custom.postconditions  handle resumed once the deadline passed
+ **/
+void CoScheduler::addTimer(coroutine_handle<> handle, uint64_t deadline_ns)
+{
+   pthread_mutex_lock(&mutex_);
+   bool earliest = timers_.empty() || deadline_ns < timers_.top().deadline_ns_;
+   timers_.push(Timer{deadline_ns, handle});
+   /** a thread sleeping until a later deadline must wait less */
+   if (earliest) {
+      pthread_cond_signal(&cond_ready_);
+   }
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Uncounts a task whose coroutine returned.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  task was spawned on this scheduler
+ * @custom.postconditions  live_ decremented, waiters woken
+ **/
+void CoScheduler::taskDone()
+{
+   pthread_mutex_lock(&mutex_);
+   --live_;
+   pthread_cond_broadcast(&cond_task_done_);
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Waits until at most count spawned tasks are still alive.
+ * No other methods are called.
+ * @param count number of tasks that may remain
+ * @return none
+ * @custom.preconditions  the remaining tasks do not wait on the caller
+ * @custom.postconditions  at most count tasks alive
+ **/
+void CoScheduler::waitTasks(long count)
+{
+   pthread_mutex_lock(&mutex_);
+   while (live_ > count) {
+      pthread_cond_wait(&cond_task_done_, &mutex_);
+   }
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Waits until every spawned task has returned, then stops and joins
+ * the threads.
+ * Calls waitTasks method.
+ * @return none
+ * @custom.preconditions  every task returns eventually
+ * @custom.postconditions  threads joined
+ **/
+void CoScheduler::join()
+{
+   waitTasks(0);
+   pthread_mutex_lock(&mutex_);
+   stopping_ = true;
+   pthread_cond_broadcast(&cond_ready_);
+   pthread_mutex_unlock(&mutex_);
+   for (size_t i = 0; i < threads_.size(); i++) {
+      pthread_join(threads_[i], NULL);
+   }
+   joined_ = true;
+}
+
+/**
+ * This returns the most tasks that were alive at once.
+ * No other methods are called.
+ * @return peak number of tasks
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long CoScheduler::get_peak_tasks()
+{
+   pthread_mutex_lock(&mutex_);
+   long peak = peak_live_;
+   pthread_mutex_unlock(&mutex_);
+   return peak;
+}
+
+/**
+ * Entry point of the threads. Resumes ready coroutines and wakes
+ * sleeping ones as their deadlines pass, until stopped.
+ * No other methods are called.
+ * @param arg the scheduler
+ * @return none
+ * @custom.preconditions  arg points to a live scheduler
+ * @custom.postconditions  thread exits once stopping_ is set
+ **/
+void* CoScheduler::run(void* arg)
+{
+   CoScheduler* self = (CoScheduler*) arg;
+   pthread_mutex_lock(&self->mutex_);
+   while (true) {
+      if (!self->ready_.empty()) {
+         coroutine_handle<> handle = self->ready_.front();
+         self->ready_.pop_front();
+         pthread_mutex_unlock(&self->mutex_);
+         handle.resume();
+         pthread_mutex_lock(&self->mutex_);
+         continue;
+      }
+      if (!self->timers_.empty()) {
+         uint64_t deadline_ns = self->timers_.top().deadline_ns_;
+         if (deadline_ns <= monotonicNs()) {
+            self->ready_.push_back(self->timers_.top().handle_);
+            self->timers_.pop();
+            continue;
+         }
+         if (self->stopping_) {
+            break;
+         }
+         struct timespec deadline;
+         deadline.tv_sec = deadline_ns / 1000000000ULL;
+         deadline.tv_nsec = deadline_ns % 1000000000ULL;
+         pthread_cond_timedwait(&self->cond_ready_, &self->mutex_, &deadline);
+         continue;
+      }
+      if (self->stopping_) {
+         break;
+      }
+      pthread_cond_wait(&self->cond_ready_, &self->mutex_);
+   }
+   pthread_mutex_unlock(&self->mutex_);
+   return nullptr;
+}
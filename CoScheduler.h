@@ -0,0 +1,328 @@
+/**
+ * CoScheduler.h
+ *
+ * This is the CoScheduler.h file that defines the CoTask coroutine type
+ * and the CoScheduler class, an M:N scheduler that runs any number of
+ * CoTasks on a few threads. A suspended task is only its coroutine
+ * frame, a few hundred bytes, instead of a thread with its own stack, so
+ * a shop can hold as many waiting customers as memory allows.
+ *
+ * A CoTask starts suspended and is handed to the scheduler with spawn.
+ * Its frame is freed when it returns. Whoever wakes a suspended task
+ * posts its handle to the run queue, and one of the scheduler's threads
+ * resumes it. A task can also sleep on the scheduler's timers.
+ *
+ * Coroutines need C++20: build the files that include this header with
+ * -std=c++20.
+ **/
+#ifndef CO_SCHEDULER_H_
+#define CO_SCHEDULER_H_
+#if __cplusplus < 202002L
+#error "CoScheduler.h needs C++20 coroutines, build with -std=c++20"
+#endif
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <queue>
+#include <vector>
+using namespace std;
+
+class CoScheduler;
+
+/** coroutine run by a CoScheduler, its frame freed when it returns */
+class CoTask
+{
+public:
+
+   /** coroutine promise of a CoTask */
+   struct promise_type {
+      /** scheduler running the task, set by spawn */
+      CoScheduler* scheduler_{NULL};
+
+      /**
+       * Tells the scheduler the task is gone.
+       * Calls CoScheduler::taskDone method.
+       * @return none
+       * @custom.preconditions  none
+       * @custom.postconditions  scheduler no longer counts the task
+       **/
+      ~promise_type();
+
+      /**
+       * This returns the CoTask the coroutine call evaluates to.
+       * No other methods are called.
+       * @return task holding the suspended coroutine
+       * @custom.preconditions  none
+       * @custom.postconditions  none
+       **/
+      CoTask get_return_object()
+      {
+         return CoTask(coroutine_handle<promise_type>::from_promise(*this));
+      }
+
+      /** a task first runs once spawned */
+      suspend_always initial_suspend() noexcept
+      {
+         return {};
+      }
+
+      /** a finished task frees its frame at once */
+      suspend_never final_suspend() noexcept
+      {
+         return {};
+      }
+
+      void return_void()
+      {
+      }
+
+      void unhandled_exception()
+      {
+         terminate();
+      }
+
+      /**
+       * Allocates a coroutine frame and counts its bytes.
+       * No other methods are called.
+       * @param size size of the frame
+       * @return the frame
+       * @custom.preconditions  none
+       * @custom.postconditions  frame bytes counted
+       **/
+      static void* operator new(size_t size);
+
+      /**
+       * Frees a coroutine frame and uncounts its bytes.
+       * No other methods are called.
+       * @param frame the frame
+       * @param size size of the frame
+       * @return none
+       * @custom.preconditions  frame came from operator new
+       * @custom.postconditions  frame bytes uncounted
+       **/
+      static void operator delete(void* frame, size_t size);
+   };
+
+   /**
+    * Creates a task from its suspended coroutine.
+    * No other methods are called.
+    * @param handle the coroutine
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  task holds the coroutine until spawned
+    **/
+   explicit CoTask(coroutine_handle<promise_type> handle) : handle_(handle)
+   {
+   }
+
+   /** the coroutine of the task, taken by CoScheduler::spawn */
+   coroutine_handle<promise_type> handle_;
+
+   /**
+    * This returns the bytes of all CoTask frames alive now.
+    * No other methods are called.
+    * @return bytes of live frames
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static long get_frame_bytes();
+
+   /**
+    * This returns the most bytes of CoTask frames that were alive at once.
+    * No other methods are called.
+    * @return peak bytes of live frames
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static long get_peak_frame_bytes();
+
+private:
+
+   /** bytes of the live frames and their peak */
+   static atomic<long> frame_bytes_;
+   static atomic<long> peak_frame_bytes_;
+};
+
+class CoScheduler
+{
+public:
+
+   /**
+    * Starts the scheduler's threads, waiting for tasks to run.
+    * No other methods are called.
+    * @param num_threads number of threads resuming tasks
+    * @return none
+    * @custom.preconditions  num_threads >= 1
+    * @custom.postconditions  threads running
+    **/
+   explicit CoScheduler(int num_threads);
+
+   /**
+    * Destructor for CoScheduler class. Joins the threads if join has not
+    * been called yet.
+    * Calls join method.
+    * @return none
+    * @custom.preconditions  no task is suspended forever
+    * @custom.postconditions  threads joined
+    **/
+   ~CoScheduler();
+
+   /**
+    * Hands a task to the scheduler, which runs it on one of its threads.
+    * Calls post method.
+    * @param task task that has not run yet
+    * @return none
+    * @custom.preconditions  join has not been called
+    * @custom.postconditions  task queued to run
+    **/
+   void spawn(CoTask task);
+
+   /**
+    * Queues a suspended coroutine to be resumed by one of the threads.
+    * No other methods are called.
+    * @param handle coroutine to resume
+    * @return none
+    * @custom.preconditions  handle is suspended and posted only once
+    * @custom.postconditions  handle queued to run
+    **/
+   void post(coroutine_handle<> handle);
+
+   /** awaitable that resumes its coroutine after a delay */
+   struct SleepAwaiter {
+      /** scheduler whose timers wake the coroutine */
+      CoScheduler* scheduler_;
+      /** time the coroutine is due again */
+      uint64_t deadline_ns_;
+
+      bool await_ready() const noexcept
+      {
+         return false;
+      }
+
+      /**
+       * Puts the coroutine on the scheduler's timers.
+       * Calls CoScheduler::addTimer method.
+       * @param handle the sleeping coroutine
+       * @return none
+       * @custom.preconditions  none
+       * @custom.postconditions  coroutine resumed once the deadline passed
+       **/
+      void await_suspend(coroutine_handle<> handle);
+
+      void await_resume() const noexcept
+      {
+      }
+   };
+
+   /**
+    * This returns an awaitable that suspends the awaiting task for a while
+    * without holding a thread.
+    * No other methods are called.
+    * @param duration_us time to sleep in μ seconds
+    * @return awaitable to co_await
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   SleepAwaiter sleep(uint64_t duration_us);
+
+   /**
+    * Waits until at most count spawned tasks are still alive.
+    * No other methods are called.
+    * @param count number of tasks that may remain
+    * @return none
+    * @custom.preconditions  the remaining tasks do not wait on the caller
+    * @custom.postconditions  at most count tasks alive
+    **/
+   void waitTasks(long count);
+
+   /**
+    * Waits until every spawned task has returned, then stops and joins
+    * the threads.
+    * Calls waitTasks method.
+    * @return none
+    * @custom.preconditions  every task returns eventually
+    * @custom.postconditions  threads joined
+    **/
+   void join();
+
+   /**
+    * This returns the most tasks that were alive at once.
+    * No other methods are called.
+    * @return peak number of tasks
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   long get_peak_tasks();
+
+private:
+
+   /** a coroutine sleeping until its deadline, the earliest on top */
+   struct Timer {
+      uint64_t deadline_ns_;
+      coroutine_handle<> handle_;
+      bool operator>(const Timer& other) const
+      {
+         return deadline_ns_ > other.deadline_ns_;
+      }
+   };
+
+   /** threads resuming tasks */
+   vector<pthread_t> threads_;
+   /** coroutines ready to be resumed, oldest first */
+   deque<coroutine_handle<>> ready_;
+   /** sleeping coroutines */
+   priority_queue<Timer, vector<Timer>, greater<Timer>> timers_;
+   /** number of spawned tasks alive and their peak */
+   long live_;
+   long peak_live_;
+   /** true once the threads are to exit */
+   bool stopping_;
+   /** true once join was called */
+   bool joined_;
+   /** guards every field above */
+   pthread_mutex_t mutex_;
+   /** signaled when a coroutine is ready or the threads are to exit,
+    *  waits on CLOCK_MONOTONIC */
+   pthread_cond_t cond_ready_;
+   /** signaled when a task returns */
+   pthread_cond_t cond_task_done_;
+
+   /** counts tasks out as their promises die */
+   friend struct CoTask::promise_type;
+
+   /**
+    * Entry point of the threads. Resumes ready coroutines and wakes
+    * sleeping ones as their deadlines pass, until stopped.
+    * No other methods are called.
+    * @param arg the scheduler
+    * @return none
+    * @custom.preconditions  arg points to a live scheduler
+    * @custom.postconditions  thread exits once stopping_ is set
+    **/
+   static void* run(void* arg);
+
+   /**
+    * Puts a coroutine on the timers.
+    * No other methods are called.
+    * @param handle the sleeping coroutine
+    * @param deadline_ns time it is due again
+    * @return none
+    * @custom.preconditions  handle is suspended
+    * @custom.postconditions  handle resumed once the deadline passed
+    **/
+   void addTimer(coroutine_handle<> handle, uint64_t deadline_ns);
+
+   /**
+    * Uncounts a task whose coroutine returned.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  task was spawned on this scheduler
+    * @custom.postconditions  live_ decremented, waiters woken
+    **/
+   void taskDone();
+};
+#endif
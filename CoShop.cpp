@@ -0,0 +1,378 @@
+/**
+ * CoShop.cpp
+ *
+ * This is the CoShop.cpp file that implements the methods of the CoShop
+ * class. Every awaitable decides under the shop's mutex whether its
+ * coroutine suspends, and whoever changes the state it waits on posts it
+ * back to the scheduler.
+ **/
+#include "CoShop.h"
+#include "EventLog.h"
+
+/**
+ * Creates the shop with every barber asleep.
+ * No other methods are called.
+ * @param scheduler scheduler running the customers and barbers
+ * @param num_barbers number of barbers
+ * @param num_chairs number of waiting chairs
+ * @return none
+ * @custom.preconditions  num_barbers >= 1, num_chairs >= 0
+ * @custom.postconditions  shop open
+ **/
+CoShop::CoShop(CoScheduler* scheduler, int num_barbers, int num_chairs) :
+   scheduler_(scheduler), num_chairs_(num_chairs), closed_(false),
+   cust_drops_(0), served_(0), peak_waiting_(0)
+{
+   if (num_barbers < 1) {
+      num_barbers = 1;
+   }
+   if (num_chairs_ < 0) {
+      num_chairs_ = 0;
+   }
+   barbers_.resize(num_barbers);
+   pthread_mutex_init(&mutex_, NULL);
+}
+
+/**
+ * Destructor for CoShop class.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  no coroutine is in the shop
+ * @custom.postconditions  mutex destroyed
+ **/
+CoShop::~CoShop()
+{
+   pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * This returns the awaitable a customer enters the shop with.
+ * No other methods are called.
+ * @param id id of the visiting customer
+ * @return awaitable resolving to the barber's id, -1 if they leave
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+CoShop::VisitAwaiter CoShop::visit(int id)
+{
+   return VisitAwaiter{this, id, -1, nullptr};
+}
+
+/**
+ * This returns the awaitable a served customer waits for the end of
+ * their hair-cut with.
+ * No other methods are called.
+ * @param customer_id id of the customer
+ * @param barber_id id visit resolved to
+ * @return awaitable resolving once the hair-cut is done
+ * @custom.preconditions  barber_id >= 0
+ * @custom.postconditions  none
+ **/
+CoShop::LeaveAwaiter CoShop::leave(int customer_id, int barber_id)
+{
+   return LeaveAwaiter{this, customer_id, barber_id};
+}
+
+/**
+ * This returns the awaitable a barber waits for the next customer with.
+ * No other methods are called.
+ * @param id id of the barber
+ * @return awaitable resolving to false once the shop is closed
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+CoShop::HelloAwaiter CoShop::hello(int id)
+{
+   return HelloAwaiter{this, id};
+}
+
+/**
+ * Seats the customer with a sleeping barber, in a waiting chair or
+ * sends them away.
+ * Calls CoShop::enter method.
+ * @param handle the customer
+ * @return true if the customer waits in a chair
+ * @custom.preconditions  none
+ * @custom.postconditions  customer in service, waiting or gone
+ **/
+bool CoShop::VisitAwaiter::await_suspend(coroutine_handle<> handle)
+{
+   handle_ = handle;
+   return shop_->enter(this);
+}
+
+/**
+ * Suspends the customer until the barber says bye, unless they
+ * already did.
+ * Calls CoShop::waitHaircut method.
+ * @param handle the customer
+ * @return true if the hair-cut is still going on
+ * @custom.preconditions  visit returned barber_id_
+ * @custom.postconditions  customer resumed after bye
+ **/
+bool CoShop::LeaveAwaiter::await_suspend(coroutine_handle<> handle)
+{
+   return shop_->waitHaircut(customer_id_, barber_id_, handle);
+}
+
+/**
+ * Takes the customer that waited longest or puts the barber to sleep.
+ * Calls CoShop::nextCustomer method.
+ * @param handle the barber
+ * @return true if the barber sleeps
+ * @custom.preconditions  the barber is not serving anyone
+ * @custom.postconditions  barber serving or sleeping
+ **/
+bool CoShop::HelloAwaiter::await_suspend(coroutine_handle<> handle)
+{
+   return shop_->nextCustomer(id_, handle);
+}
+
+/**
+ * This returns whether the barber has a customer to serve.
+ * Calls CoShop::in_service method.
+ * @return false once the shop closed and nobody is left to serve
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+bool CoShop::HelloAwaiter::await_resume() const
+{
+   return shop_->in_service(id_);
+}
+
+/**
+ * Seats a customer with a sleeping barber or in a waiting chair, or
+ * turns them away.
+ * Records events through SHOP_LOG.
+ * @param visit the customer's awaitable
+ * @return true if the customer waits in a chair
+ * @custom.preconditions  visit->handle_ is the suspended customer
+ * @custom.postconditions  customer in service, waiting or gone
+ **/
+bool CoShop::enter(VisitAwaiter* visit)
+{
+   int id = visit->id_;
+   pthread_mutex_lock(&mutex_);
+   if (closed_) {
+      ++cust_drops_;
+      pthread_mutex_unlock(&mutex_);
+      SHOP_LOG(kLogDrops, id, kEventBalkNoBarbers, 0, 0);
+      return false;
+   }
+
+   /** nobody waits ahead of the customer, so a sleeping barber is theirs */
+   if (waiting_.empty() && !sleeping_.empty()) {
+      int barber_id = sleeping_.front();
+      sleeping_.pop_front();
+      BarberState& barber = barbers_[barber_id];
+      barber.customer_ = id;
+      barber.in_service_ = true;
+      visit->barber_id_ = barber_id;
+      coroutine_handle<> barber_handle = barber.barber_handle_;
+      barber.barber_handle_ = nullptr;
+      int seats_available = num_chairs_ - (int) waiting_.size();
+      pthread_mutex_unlock(&mutex_);
+      scheduler_->post(barber_handle);
+      SHOP_LOG(kLogService, id, kEventMovesToChair, barber_id, seats_available);
+      SHOP_LOG(kLogService, 0 - barber_id, kEventStartsHaircut, id, 0);
+      return false;
+   }
+
+   if ((int) waiting_.size() >= num_chairs_) {
+      ++cust_drops_;
+      pthread_mutex_unlock(&mutex_);
+      SHOP_LOG(kLogDrops, id, (num_chairs_ == 0) ? kEventBalkNoBarbers : kEventBalkNoChairs, 0, 0);
+      return false;
+   }
+
+   /** visit lives in the suspended customer's frame until a barber takes it */
+   waiting_.push_back(visit);
+   if ((long) waiting_.size() > peak_waiting_) {
+      peak_waiting_ = (long) waiting_.size();
+   }
+   /** logged before a barber can take the customer and log them moving */
+   SHOP_LOG(kLogService, id, kEventTakesChair, num_chairs_ - (int) waiting_.size(), 0);
+   pthread_mutex_unlock(&mutex_);
+   return true;
+}
+
+/**
+ * Suspends a customer until their barber says bye.
+ * Records events through SHOP_LOG.
+ * @param customer_id id of the customer
+ * @param barber_id id of the barber
+ * @param handle the customer
+ * @return true if the hair-cut is still going on
+ * @custom.preconditions  the customer is in the barber's chair
+ * @custom.postconditions  customer resumed after bye if suspended
+ **/
+bool CoShop::waitHaircut(int customer_id, int barber_id, coroutine_handle<> handle)
+{
+   pthread_mutex_lock(&mutex_);
+   BarberState& barber = barbers_[barber_id];
+   bool waits = barber.in_service_ && barber.customer_ == customer_id;
+   if (waits) {
+      barber.customer_handle_ = handle;
+      SHOP_LOG(kLogVerbose, customer_id, kEventWaitsForHaircut, barber_id, 0);
+   }
+   pthread_mutex_unlock(&mutex_);
+   if (!waits) {
+      SHOP_LOG(kLogService, customer_id, kEventSaysGoodbye, barber_id, 0);
+   }
+   return waits;
+}
+
+/**
+ * Starts a barber on the customer that waited longest or puts the
+ * barber to sleep.
+ * Records events through SHOP_LOG.
+ * @param id id of the barber
+ * @param handle the barber
+ * @return true if the barber sleeps
+ * @custom.preconditions  the barber is not serving anyone
+ * @custom.postconditions  barber serving or sleeping
+ **/
+bool CoShop::nextCustomer(int id, coroutine_handle<> handle)
+{
+   pthread_mutex_lock(&mutex_);
+   BarberState& barber = barbers_[id];
+   if (waiting_.empty()) {
+      barber.customer_ = -1;
+      if (closed_) {
+         pthread_mutex_unlock(&mutex_);
+         return false;
+      }
+      barber.barber_handle_ = handle;
+      sleeping_.push_back(id);
+      SHOP_LOG(kLogVerbose, 0 - id, kEventBarberSleeps, 0, 0);
+      pthread_mutex_unlock(&mutex_);
+      return true;
+   }
+
+   VisitAwaiter* visit = waiting_.front();
+   waiting_.pop_front();
+   int customer_id = visit->id_;
+   visit->barber_id_ = id;
+   coroutine_handle<> customer_handle = visit->handle_;
+   barber.customer_ = customer_id;
+   barber.in_service_ = true;
+   int seats_available = num_chairs_ - (int) waiting_.size();
+   pthread_mutex_unlock(&mutex_);
+   /** visit is gone once the customer runs again */
+   scheduler_->post(customer_handle);
+   SHOP_LOG(kLogService, customer_id, kEventMovesToChair, id, seats_available);
+   SHOP_LOG(kLogService, 0 - id, kEventStartsHaircut, customer_id, 0);
+   return false;
+}
+
+/**
+ * This returns whether a barber is serving a customer.
+ * No other methods are called.
+ * @param id id of the barber
+ * @return true if the barber has a customer in the chair
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+bool CoShop::in_service(int id)
+{
+   pthread_mutex_lock(&mutex_);
+   bool serving = barbers_[id].in_service_;
+   pthread_mutex_unlock(&mutex_);
+   return serving;
+}
+
+/**
+ * Ends the hair-cut of the barber's customer and lets them go.
+ * Records events through SHOP_LOG.
+ * @param id id of the barber
+ * @return none
+ * @custom.preconditions  hello resolved to true for this barber
+ * @custom.postconditions  barber free, customer resumed
+ **/
+void CoShop::bye(int id)
+{
+   pthread_mutex_lock(&mutex_);
+   BarberState& barber = barbers_[id];
+   int customer_id = barber.customer_;
+   barber.in_service_ = false;
+   barber.customer_ = -1;
+   ++served_;
+   coroutine_handle<> customer_handle = barber.customer_handle_;
+   barber.customer_handle_ = nullptr;
+   pthread_mutex_unlock(&mutex_);
+   SHOP_LOG(kLogService, 0 - id, kEventDoneHaircut, customer_id, 0);
+   /** a customer not yet in leave finds the hair-cut done and goes */
+   if (customer_handle) {
+      SHOP_LOG(kLogService, customer_id, kEventSaysGoodbye, id, 0);
+      scheduler_->post(customer_handle);
+   }
+   SHOP_LOG(kLogVerbose, 0 - id, kEventCallsNext, 0, 0);
+}
+
+/**
+ * Closes the shop. Customers arriving afterwards leave, the waiting
+ * customers are still served and every barber's hello resolves to
+ * false once nobody is left.
+ * Calls CoScheduler::post method.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  sleeping barbers resumed
+ **/
+void CoShop::close()
+{
+   pthread_mutex_lock(&mutex_);
+   closed_ = true;
+   /** sleeping barbers have nobody waiting, so they wake only to leave */
+   while (!sleeping_.empty()) {
+      BarberState& barber = barbers_[sleeping_.front()];
+      sleeping_.pop_front();
+      scheduler_->post(barber.barber_handle_);
+      barber.barber_handle_ = nullptr;
+   }
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * This returns the number of customers that left without service.
+ * No other methods are called.
+ * @return number of customers that left without being serviced
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long CoShop::get_cust_drops()
+{
+   pthread_mutex_lock(&mutex_);
+   long drops = cust_drops_;
+   pthread_mutex_unlock(&mutex_);
+   return drops;
+}
+
+/**
+ * This returns the number of customers whose hair-cut is done.
+ * No other methods are called.
+ * @return number of customers served
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long CoShop::get_served()
+{
+   pthread_mutex_lock(&mutex_);
+   long served = served_;
+   pthread_mutex_unlock(&mutex_);
+   return served;
+}
+
+/**
+ * This returns the most customers that were waiting in chairs at once.
+ * No other methods are called.
+ * @return peak number of waiting customers
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long CoShop::get_peak_waiting()
+{
+   pthread_mutex_lock(&mutex_);
+   long peak = peak_waiting_;
+   pthread_mutex_unlock(&mutex_);
+   return peak;
+}
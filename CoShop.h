@@ -0,0 +1,324 @@
+/**
+ * CoShop.h
+ *
+ * This is the CoShop.h file that defines the CoShop class, the sleeping
+ * barbers shop for customers and barbers that are coroutines on a
+ * CoScheduler instead of threads. The calls of a Shop become awaitables:
+ *
+ *    int barber_id = co_await shop.visit(id);
+ *    if (barber_id >= 0) co_await shop.leave(id, barber_id);
+ *
+ * and a barber loops on
+ *
+ *    while (true) {
+ *       bool serving = co_await shop.hello(id);
+ *       if (!serving) break;
+ *       co_await scheduler.sleep(service_time);
+ *       shop.bye(id);
+ *    }
+ *
+ * A waiting customer is a suspended coroutine queued in arrival order,
+ * the awaitable in its frame linking it into the queue, so a waiting
+ * room of a hundred thousand chairs costs about a hundred bytes per
+ * customer sitting in it rather than a thread stack each.
+ *
+ * The rules are those of a Shop: a customer takes a sleeping barber if
+ * nobody waits, a free chair otherwise, and leaves if every chair is
+ * taken. A barber takes the customer that waited longest or sleeps. A
+ * barber is not kept waiting to be paid: bye wakes the customer and the
+ * barber goes straight on to the next one. Suspended coroutines are
+ * always resumed through the scheduler, never by the coroutine that
+ * wakes them, so one state change never runs another coroutine inline.
+ *
+ * One mutex guards the shop. Events are recorded through SHOP_LOG like a
+ * Shop's.
+ **/
+#ifndef CO_SHOP_H_
+#define CO_SHOP_H_
+#include <pthread.h>
+#include <deque>
+#include <vector>
+#include "CoScheduler.h"
+using namespace std;
+
+class CoShop
+{
+public:
+
+   /** awaitable of a customer entering the shop */
+   struct VisitAwaiter {
+      /** shop visited */
+      CoShop* shop_;
+      /** id of the visiting customer */
+      int id_;
+      /** barber serving the customer, -1 if they leave without service */
+      int barber_id_;
+      /** the customer, while waiting in a chair */
+      coroutine_handle<> handle_;
+
+      bool await_ready() const noexcept
+      {
+         return false;
+      }
+
+      /**
+       * Seats the customer with a sleeping barber, in a waiting chair or
+       * sends them away.
+       * Calls CoShop::enter method.
+       * @param handle the customer
+       * @return true if the customer waits in a chair
+       * @custom.preconditions  none
+       * @custom.postconditions  customer in service, waiting or gone
+       **/
+      bool await_suspend(coroutine_handle<> handle);
+
+      /** id of the barber, -1 if the customer left without service */
+      int await_resume() const noexcept
+      {
+         return barber_id_;
+      }
+   };
+
+   /** awaitable of a customer waiting for their hair-cut to end */
+   struct LeaveAwaiter {
+      /** shop visited */
+      CoShop* shop_;
+      /** id of the customer */
+      int customer_id_;
+      /** id of the barber serving the customer */
+      int barber_id_;
+
+      bool await_ready() const noexcept
+      {
+         return false;
+      }
+
+      /**
+       * Suspends the customer until the barber says bye, unless they
+       * already did.
+       * Calls CoShop::waitHaircut method.
+       * @param handle the customer
+       * @return true if the hair-cut is still going on
+       * @custom.preconditions  visit returned barber_id_
+       * @custom.postconditions  customer resumed after bye
+       **/
+      bool await_suspend(coroutine_handle<> handle);
+
+      void await_resume() const noexcept
+      {
+      }
+   };
+
+   /** awaitable of a barber waiting for the next customer */
+   struct HelloAwaiter {
+      /** shop the barber works in */
+      CoShop* shop_;
+      /** id of the barber */
+      int id_;
+
+      bool await_ready() const noexcept
+      {
+         return false;
+      }
+
+      /**
+       * Takes the customer that waited longest or puts the barber to sleep.
+       * Calls CoShop::nextCustomer method.
+       * @param handle the barber
+       * @return true if the barber sleeps
+       * @custom.preconditions  the barber is not serving anyone
+       * @custom.postconditions  barber serving or sleeping
+       **/
+      bool await_suspend(coroutine_handle<> handle);
+
+      /**
+       * This returns whether the barber has a customer to serve.
+       * Calls CoShop::in_service method.
+       * @return false once the shop closed and nobody is left to serve
+       * @custom.preconditions  none
+       * @custom.postconditions  none
+       **/
+      bool await_resume() const;
+   };
+
+   /**
+    * Creates the shop with every barber asleep.
+    * No other methods are called.
+    * @param scheduler scheduler running the customers and barbers
+    * @param num_barbers number of barbers
+    * @param num_chairs number of waiting chairs
+    * @return none
+    * @custom.preconditions  num_barbers >= 1, num_chairs >= 0
+    * @custom.postconditions  shop open
+    **/
+   CoShop(CoScheduler* scheduler, int num_barbers, int num_chairs);
+
+   /**
+    * Destructor for CoShop class.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  no coroutine is in the shop
+    * @custom.postconditions  mutex destroyed
+    **/
+   ~CoShop();
+
+   /**
+    * This returns the awaitable a customer enters the shop with.
+    * No other methods are called.
+    * @param id id of the visiting customer
+    * @return awaitable resolving to the barber's id, -1 if they leave
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   VisitAwaiter visit(int id);
+
+   /**
+    * This returns the awaitable a served customer waits for the end of
+    * their hair-cut with.
+    * No other methods are called.
+    * @param customer_id id of the customer
+    * @param barber_id id visit resolved to
+    * @return awaitable resolving once the hair-cut is done
+    * @custom.preconditions  barber_id >= 0
+    * @custom.postconditions  none
+    **/
+   LeaveAwaiter leave(int customer_id, int barber_id);
+
+   /**
+    * This returns the awaitable a barber waits for the next customer with.
+    * No other methods are called.
+    * @param id id of the barber
+    * @return awaitable resolving to false once the shop is closed
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   HelloAwaiter hello(int id);
+
+   /**
+    * Ends the hair-cut of the barber's customer and lets them go.
+    * Records events through SHOP_LOG.
+    * @param id id of the barber
+    * @return none
+    * @custom.preconditions  hello resolved to true for this barber
+    * @custom.postconditions  barber free, customer resumed
+    **/
+   void bye(int id);
+
+   /**
+    * Closes the shop. Customers arriving afterwards leave, the waiting
+    * customers are still served and every barber's hello resolves to
+    * false once nobody is left.
+    * Calls CoScheduler::post method.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  sleeping barbers resumed
+    **/
+   void close();
+
+   /**
+    * This returns the number of customers that left without service.
+    * No other methods are called.
+    * @return number of customers that left without being serviced
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   long get_cust_drops();
+
+   /**
+    * This returns the number of customers whose hair-cut is done.
+    * No other methods are called.
+    * @return number of customers served
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   long get_served();
+
+   /**
+    * This returns the most customers that were waiting in chairs at once.
+    * No other methods are called.
+    * @return peak number of waiting customers
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   long get_peak_waiting();
+
+private:
+
+   /** state of a barber, guarded by mutex_ */
+   struct BarberState {
+      /** customer in the barber's chair, -1 if none */
+      int customer_{-1};
+      /** true from the start of a hair-cut until bye */
+      bool in_service_{false};
+      /** the barber, while asleep */
+      coroutine_handle<> barber_handle_;
+      /** the customer, while waiting in leave */
+      coroutine_handle<> customer_handle_;
+   };
+
+   /** scheduler resuming the coroutines */
+   CoScheduler* scheduler_;
+   /** number of waiting chairs */
+   int num_chairs_;
+   /** every barber */
+   vector<BarberState> barbers_;
+   /** customers in the waiting chairs, oldest first */
+   deque<VisitAwaiter*> waiting_;
+   /** sleeping barbers, longest asleep first */
+   deque<int> sleeping_;
+   /** true once close was called */
+   bool closed_;
+   /** customers that left without service and customers served */
+   long cust_drops_;
+   long served_;
+   /** most customers waiting at once */
+   long peak_waiting_;
+   /** guards every field above */
+   pthread_mutex_t mutex_;
+
+   /**
+    * Seats a customer with a sleeping barber or in a waiting chair, or
+    * turns them away.
+    * Records events through SHOP_LOG.
+    * @param visit the customer's awaitable
+    * @return true if the customer waits in a chair
+    * @custom.preconditions  visit->handle_ is the suspended customer
+    * @custom.postconditions  customer in service, waiting or gone
+    **/
+   bool enter(VisitAwaiter* visit);
+
+   /**
+    * Suspends a customer until their barber says bye.
+    * Records events through SHOP_LOG.
+    * @param customer_id id of the customer
+    * @param barber_id id of the barber
+    * @param handle the customer
+    * @return true if the hair-cut is still going on
+    * @custom.preconditions  the customer is in the barber's chair
+    * @custom.postconditions  customer resumed after bye if suspended
+    **/
+   bool waitHaircut(int customer_id, int barber_id, coroutine_handle<> handle);
+
+   /**
+    * Starts a barber on the customer that waited longest or puts the
+    * barber to sleep.
+    * Records events through SHOP_LOG.
+    * @param id id of the barber
+    * @param handle the barber
+    * @return true if the barber sleeps
+    * @custom.preconditions  the barber is not serving anyone
+    * @custom.postconditions  barber serving or sleeping
+    **/
+   bool nextCustomer(int id, coroutine_handle<> handle);
+
+   /**
+    * This returns whether a barber is serving a customer.
+    * No other methods are called.
+    * @param id id of the barber
+    * @return true if the barber has a customer in the chair
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   bool in_service(int id);
+};
+#endif
@@ -0,0 +1,272 @@
+/**
+ * CustomerExecutor.cpp
+ *
+ * This is the CustomerExecutor.cpp file that implements the methods of the
+ * CustomerExecutor class. The producer (usually main) submits customer ids
+ * to a fixed-size ring buffer and each worker thread repeatedly takes one
+ * id, calls visitShop and, if the customer was seated with a barber,
+ * leaveShop before taking the next one.
+ **/
+#include "CustomerExecutor.h"
+#include "Clock.h"
+
+/**
+ * Creates the worker threads and the bounded queue of pending customers.
+ * Calls start method.
+ * @param shop shop visited by every customer run on this executor
+ * @param num_workers number of worker threads running customers
+ * @param queue_capacity number of customers that may wait for a worker
+ * @return none
+ * @custom.preconditions  shop != NULL, num_workers >= 1, queue_capacity >= 1
+ * @custom.postconditions  workers are started and waiting for customers
+ **/
+CustomerExecutor::CustomerExecutor(Shop* shop, int num_workers, int queue_capacity) :
+   shop_(shop), franchise_(NULL), pipeline_(NULL), num_workers_(num_workers), capacity_(queue_capacity), head_(0),
+   count_(0), completed_(0), closed_(false), joined_(false)
+{
+   start();
+}
+
+/**
+ * Creates the worker threads and the bounded queue of pending customers 
+ * of a franchise.
+ * Calls start method.
+ * @param franchise franchise visited by every customer run on this executor
+ * @param num_workers number of worker threads running customers
+ * @param queue_capacity number of customers that may wait for a worker
+ * @return none
+ * @custom.preconditions  franchise != NULL, num_workers >= 1, queue_capacity >= 1
+ * @custom.postconditions  workers are started and waiting for customers
+ **/
+CustomerExecutor::CustomerExecutor(Franchise* franchise, int num_workers, int queue_capacity) :
+   shop_(NULL), franchise_(franchise), pipeline_(NULL), num_workers_(num_workers), capacity_(queue_capacity),
+   head_(0), count_(0), completed_(0), closed_(false), joined_(false)
+{
+   start();
+}
+
+/**
+ * Creates the worker threads and the bounded queue of pending customers 
+ * of a pipeline shop.
+ * Calls start method.
+ * @param pipeline pipeline shop visited by every customer run on this executor
+ * @param num_workers number of worker threads running customers
+ * @param queue_capacity number of customers that may wait for a worker
+ * @return none
+ * @custom.preconditions  pipeline != NULL, num_workers >= 1, queue_capacity >= 1
+ * @custom.postconditions  workers are started and waiting for customers
+ **/
+CustomerExecutor::CustomerExecutor(PipelineShop* pipeline, int num_workers, int queue_capacity) :
+   shop_(NULL), franchise_(NULL), pipeline_(pipeline), num_workers_(num_workers), capacity_(queue_capacity),
+   head_(0), count_(0), completed_(0), closed_(false), joined_(false)
+{
+   start();
+}
+
+/**
+ * Allocates the queue and starts the worker threads.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  called once by a constructor
+ * @custom.postconditions  workers are started and waiting for customers
+ **/
+void CustomerExecutor::start()
+{
+   pthread_mutex_init(&mutex_, NULL);
+   pthread_cond_init(&cond_not_empty_, NULL);
+   pthread_cond_init(&cond_not_full_, NULL);
+   pending_ = new PendingCustomer[capacity_];
+   workers_ = new Worker[num_workers_];
+   for (int i = 0; i < num_workers_; i++) {
+      workers_[i].executor_ = this;
+      pthread_create(&workers_[i].thread_, NULL, worker, &workers_[i]);
+   }
+}
+
+/**
+ * Destructor for CustomerExecutor class. Joins the workers if join
+ * has not been called yet.
+ * Calls join method.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  workers stopped and queue released
+ **/
+CustomerExecutor::~CustomerExecutor()
+{
+   join();
+   delete[] workers_;
+   delete[] pending_;
+   pthread_cond_destroy(&cond_not_full_);
+   pthread_cond_destroy(&cond_not_empty_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * Hands a newly arrived customer to the executor. Blocks while the
+ * pending queue is full so the producer is throttled by the workers.
+ * Calls submit method.
+ * @param customer_id id of the arriving customer, > 0
+ * @return none
+ * @custom.preconditions  join has not been called
+ * @custom.postconditions  customer queued to visit the shop
+ **/
+void CustomerExecutor::submit(int customer_id)
+{
+   submit(customer_id, 0, 0);
+}
+
+/**
+ * Hands a newly arrived customer of a priority class to the executor, 
+ * which visits the shop with Shop::visitShop(id, priority, patience_ns). 
+ * A franchise or pipeline shop ignores class and patience. 
+ * No other methods are called.
+ * @param customer_id id of the arriving customer, > 0
+ * @param priority priority class of the customer, 0 first
+ * @param patience_ns longest wait for a barber, 0 for no limit
+ * @return none
+ * @custom.preconditions  join has not been called
+ * @custom.postconditions  customer queued to visit the shop
+ **/
+void CustomerExecutor::submit(int customer_id, int priority, uint64_t patience_ns)
+{
+   /** arrival is when the customer shows up, not when the queue has room */
+   uint64_t arrival_ns = monotonicNs();
+   pthread_mutex_lock(&mutex_);
+   while (count_ == capacity_) {
+      pthread_cond_wait(&cond_not_full_, &mutex_);
+   }
+   PendingCustomer& customer = pending_[(head_ + count_) % capacity_];
+   customer.id_ = customer_id;
+   customer.arrival_ns_ = arrival_ns;
+   customer.priority_ = priority;
+   customer.patience_ns_ = patience_ns;
+   ++count_;
+   pthread_cond_signal(&cond_not_empty_);
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Waits until every submitted customer has left the shop and then
+ * stops and joins the worker threads.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  all customers finished, workers terminated
+ **/
+void CustomerExecutor::join()
+{
+   pthread_mutex_lock(&mutex_);
+   if (joined_) {
+      pthread_mutex_unlock(&mutex_);
+      return;
+   }
+   joined_ = true;
+   closed_ = true;
+   pthread_cond_broadcast(&cond_not_empty_);
+   pthread_mutex_unlock(&mutex_);
+
+   for (int i = 0; i < num_workers_; i++) {
+      pthread_join(workers_[i].thread_, NULL);
+   }
+}
+
+/**
+ * This returns the number of customers that finished their visit.
+ * No other methods are called.
+ * @return number of customers run to completion
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long CustomerExecutor::get_completed()
+{
+   pthread_mutex_lock(&mutex_);
+   long completed = completed_;
+   pthread_mutex_unlock(&mutex_);
+   return completed;
+}
+
+/**
+ * Adds the latencies recorded by every worker to the given histograms.
+ * Wait is the time from submit until visitShop returns, total the time 
+ * from submit until leaveShop returns. Customers who left without 
+ * service are only counted in wait.
+ * No other methods are called.
+ * @param wait histogram receiving the wait times in nanoseconds
+ * @param total histogram receiving the end-to-end times in nanoseconds
+ * @return none
+ * @custom.preconditions  join has been called
+ * @custom.postconditions  histograms hold every customer's latencies
+ **/
+void CustomerExecutor::mergeLatencies(Histogram* wait, Histogram* total) const
+{
+   for (int i = 0; i < num_workers_; i++) {
+      wait->merge(workers_[i].wait_);
+      total->merge(workers_[i].total_);
+   }
+}
+
+/**
+ * Removes the next customer from the queue, blocking while it is empty.
+ * No other methods are called.
+ * @param customer set to the dequeued customer
+ * @return false if the executor is closed and no customers are left
+ * @custom.preconditions  none
+ * @custom.postconditions  one customer removed from the queue
+ **/
+bool CustomerExecutor::next(PendingCustomer& customer)
+{
+   pthread_mutex_lock(&mutex_);
+   while (count_ == 0 && !closed_) {
+      pthread_cond_wait(&cond_not_empty_, &mutex_);
+   }
+   if (count_ == 0) {
+      pthread_mutex_unlock(&mutex_);
+      return false;
+   }
+   customer = pending_[head_];
+   head_ = (head_ + 1) % capacity_;
+   --count_;
+   pthread_cond_signal(&cond_not_full_);
+   pthread_mutex_unlock(&mutex_);
+   return true;
+}
+
+/**
+ * Entry point of the worker threads. Takes customers off the queue
+ * and runs their visit until the executor is closed and drained.
+ * Calls next, visitShop and leaveShop of the shop, franchise or pipeline.
+ * @param arg the Worker the thread runs as
+ * @return none
+ * @custom.preconditions  arg points to a worker of a live executor
+ * @custom.postconditions  worker exits once the queue is drained
+ **/
+void* CustomerExecutor::worker(void* arg)
+{
+   Worker* self = (Worker*) arg;
+   CustomerExecutor* executor = self->executor_;
+   Shop* shop = executor->shop_;
+   Franchise* franchise = executor->franchise_;
+   PipelineShop* pipeline = executor->pipeline_;
+   PendingCustomer customer;
+
+   while (executor->next(customer)) {
+      int barber = (franchise != NULL) ? franchise->visitShop(customer.id_) :
+                   (pipeline != NULL) ? pipeline->visitShop(customer.id_) :
+                   shop->visitShop(customer.id_, customer.priority_, customer.patience_ns_);
+      self->wait_.record(monotonicNs() - customer.arrival_ns_);
+      if (barber != -1) {
+         if (franchise != NULL) {
+            franchise->leaveShop(customer.id_, barber);
+         } else if (pipeline != NULL) {
+            pipeline->leaveShop(customer.id_, barber);
+         } else {
+            shop->leaveShop(customer.id_, barber);
+         }
+         self->total_.record(monotonicNs() - customer.arrival_ns_);
+      }
+      pthread_mutex_lock(&executor->mutex_);
+      ++executor->completed_;
+      pthread_mutex_unlock(&executor->mutex_);
+   }
+   return nullptr;
+}
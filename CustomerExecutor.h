@@ -0,0 +1,224 @@
+/**
+ * CustomerExecutor.h
+ *
+ * This is the CustomerExecutor.h file that defines the CustomerExecutor
+ * class. Instead of spawning one thread per customer, customers are
+ * submitted by id to a bounded queue and a fixed pool of worker threads
+ * runs the visitShop/ leaveShop lifecycle for each of them in turn.
+ *
+ * Memory used by the executor depends only on the number of workers and
+ * the queue capacity, never on the number of customers pushed through
+ * the shop. A customer only occupies a worker while it is inside the
+ * shop, so num_barbers + num_chairs + 1 workers are enough for every
+ * arrival to find a worker unless the shop itself is full.
+ *
+ * Each worker also records, per customer, the wait from submission until
+ * a barber is assigned and the end-to-end time until the customer leaves.
+ **/
+#ifndef CUSTOMER_EXECUTOR_H_
+#define CUSTOMER_EXECUTOR_H_
+#include <pthread.h>
+#include <stdint.h>
+#include "Shop.h"
+#include "Franchise.h"
+#include "PipelineShop.h"
+#include "Histogram.h"
+
+class CustomerExecutor
+{
+public:
+
+   /**
+    * Creates the worker threads and the bounded queue of pending customers.
+    * Calls start method.
+    * @param shop shop visited by every customer run on this executor
+    * @param num_workers number of worker threads running customers
+    * @param queue_capacity number of customers that may wait for a worker
+    * @return none
+    * @custom.preconditions  shop != NULL, num_workers >= 1, queue_capacity >= 1
+    * @custom.postconditions  workers are started and waiting for customers
+    **/
+   CustomerExecutor(Shop* shop, int num_workers, int queue_capacity);
+
+   /**
+    * Creates the worker threads and the bounded queue of pending customers 
+    * of a franchise.
+    * Calls start method.
+    * @param franchise franchise visited by every customer run on this executor
+    * @param num_workers number of worker threads running customers
+    * @param queue_capacity number of customers that may wait for a worker
+    * @return none
+    * @custom.preconditions  franchise != NULL, num_workers >= 1, queue_capacity >= 1
+    * @custom.postconditions  workers are started and waiting for customers
+    **/
+   CustomerExecutor(Franchise* franchise, int num_workers, int queue_capacity);
+
+   /**
+    * Creates the worker threads and the bounded queue of pending customers 
+    * of a pipeline shop.
+    * Calls start method.
+    * @param pipeline pipeline shop visited by every customer run on this executor
+    * @param num_workers number of worker threads running customers
+    * @param queue_capacity number of customers that may wait for a worker
+    * @return none
+    * @custom.preconditions  pipeline != NULL, num_workers >= 1, queue_capacity >= 1
+    * @custom.postconditions  workers are started and waiting for customers
+    **/
+   CustomerExecutor(PipelineShop* pipeline, int num_workers, int queue_capacity);
+
+   /**
+    * Destructor for CustomerExecutor class. Joins the workers if join
+    * has not been called yet.
+    * Calls join method.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  workers stopped and queue released
+    **/
+   ~CustomerExecutor();
+
+   /**
+    * Hands a newly arrived customer to the executor. Blocks while the
+    * pending queue is full so the producer is throttled by the workers.
+    * Calls submit method.
+    * @param customer_id id of the arriving customer, > 0
+    * @return none
+    * @custom.preconditions  join has not been called
+    * @custom.postconditions  customer queued to visit the shop
+    **/
+   void submit(int customer_id);
+
+   /**
+    * Hands a newly arrived customer of a priority class to the executor, 
+    * which visits the shop with Shop::visitShop(id, priority, patience_ns). 
+    * A franchise or pipeline shop ignores class and patience. 
+    * No other methods are called.
+    * @param customer_id id of the arriving customer, > 0
+    * @param priority priority class of the customer, 0 first
+    * @param patience_ns longest wait for a barber, 0 for no limit
+    * @return none
+    * @custom.preconditions  join has not been called
+    * @custom.postconditions  customer queued to visit the shop
+    **/
+   void submit(int customer_id, int priority, uint64_t patience_ns);
+
+   /**
+    * Waits until every submitted customer has left the shop and then
+    * stops and joins the worker threads.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  all customers finished, workers terminated
+    **/
+   void join();
+
+   /**
+    * This returns the number of customers that finished their visit.
+    * No other methods are called.
+    * @return number of customers run to completion
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   long get_completed();
+
+   /**
+    * Adds the latencies recorded by every worker to the given histograms.
+    * Wait is the time from submit until visitShop returns, total the time 
+    * from submit until leaveShop returns. Customers who left without 
+    * service are only counted in wait.
+    * No other methods are called.
+    * @param wait histogram receiving the wait times in nanoseconds
+    * @param total histogram receiving the end-to-end times in nanoseconds
+    * @return none
+    * @custom.preconditions  join has been called
+    * @custom.postconditions  histograms hold every customer's latencies
+    **/
+   void mergeLatencies(Histogram* wait, Histogram* total) const;
+
+private:
+
+   /** a customer waiting for a worker */
+   struct PendingCustomer {
+      /** id of the customer */
+      int id_;
+      /** time the customer was submitted, in nanoseconds */
+      uint64_t arrival_ns_;
+      /** priority class of the customer */
+      int priority_;
+      /** longest wait for a barber, 0 for no limit */
+      uint64_t patience_ns_;
+   };
+
+   /** a worker thread and the latencies it recorded */
+   struct Worker {
+      /** executor the worker belongs to */
+      CustomerExecutor* executor_;
+      /** thread handle */
+      pthread_t thread_;
+      /** time from arrival until a barber was assigned */
+      Histogram wait_;
+      /** time from arrival until the customer left the shop */
+      Histogram total_;
+   };
+
+   /** shop visited by the customers, NULL for a franchise or pipeline */
+   Shop* shop_;
+   /** franchise visited by the customers, NULL otherwise */
+   Franchise* franchise_;
+   /** pipeline shop visited by the customers, NULL otherwise */
+   PipelineShop* pipeline_;
+   /** number of worker threads */
+   int num_workers_;
+   /** worker threads */
+   Worker* workers_;
+   /** ring buffer of pending customers */
+   PendingCustomer* pending_;
+   /** capacity of the pending ring buffer */
+   int capacity_;
+   /** index of the oldest pending customer */
+   int head_;
+   /** number of pending customers */
+   int count_;
+   /** number of customers that finished their visit */
+   long completed_;
+   /** true once no more customers will be submitted */
+   bool closed_;
+   /** true once the workers have been joined */
+   bool joined_;
+   /** mutex guarding the pending queue */
+   pthread_mutex_t mutex_;
+   /** signaled when a customer is queued or the executor closes */
+   pthread_cond_t cond_not_empty_;
+   /** signaled when a worker takes a customer from the queue */
+   pthread_cond_t cond_not_full_;
+
+   /**
+    * Entry point of the worker threads. Takes customers off the queue
+    * and runs their visit until the executor is closed and drained.
+    * Calls next, visitShop and leaveShop of the shop or franchise.
+    * @param arg the Worker the thread runs as
+    * @return none
+    * @custom.preconditions  arg points to a worker of a live executor
+    * @custom.postconditions  worker exits once the queue is drained
+    **/
+   static void* worker(void* arg);
+
+   /**
+    * Allocates the queue and starts the worker threads.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  called once by a constructor
+    * @custom.postconditions  workers are started and waiting for customers
+    **/
+   void start();
+
+   /**
+    * Removes the next customer from the queue, blocking while it is empty.
+    * No other methods are called.
+    * @param customer set to the dequeued customer
+    * @return false if the executor is closed and no customers are left
+    * @custom.preconditions  none
+    * @custom.postconditions  one customer removed from the queue
+    **/
+   bool next(PendingCustomer& customer);
+};
+#endif
@@ -0,0 +1,551 @@
+/**
+ * EventLog.cpp
+ *
+ * This is the EventLog.cpp file that implements the methods of the
+ * EventLog class. Threads append records to their own ring without
+ * locking. The drain thread wakes up every millisecond, collects the
+ * records of every ring, sorts them by timestamp and writes them to the
+ * sink, holding back the youngest for the next pass, so formatting and
+ * stdout flushing happen outside the shop's critical sections. The
+ * trace sink bypasses the rings: threads store straight into chunks of
+ * a mapped file.
+ **/
+#include "EventLog.h"
+#include "Clock.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/** how long the drain thread sleeps when there is nothing to drain */
+#define kDrainIntervalNs 1000000
+/**
+ * Age a record must reach before the drain thread writes it. A thread 
+ * descheduled between taking a timestamp and publishing the record has 
+ * this long before its record would come out of order.
+ */
+#define kHoldBackNs (10 * kDrainIntervalNs)
+
+thread_local EventLog::RingOwner EventLog::ring_owner_;
+
+/**
+ * Marks the ring of an exiting thread so the drain thread frees it once
+ * its records have been written.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  ring handed over to the drain thread
+ **/
+EventLog::RingOwner::~RingOwner()
+{
+   if (ring_ != NULL) {
+      ring_->orphaned_.store(true, memory_order_release);
+   }
+}
+
+/**
+ * This returns the process wide logger used by every Shop.
+ * No other methods are called.
+ * @return the logger
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+EventLog& EventLog::instance()
+{
+   /** never destroyed, threads may still log while the process exits */
+   static EventLog* log = new EventLog();
+   return *log;
+}
+
+/**
+ * Creates a closed logger.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  logger created, nothing recorded
+ **/
+EventLog::EventLog() : level_(kLogOff), dropped_(0), running_(false),
+   sink_(kNullSink), out_(NULL), tracing_(false), trace_map_(NULL),
+   trace_(NULL), trace_capacity_(0), trace_cursor_(0), trace_fd_(-1)
+{
+   pthread_mutex_init(&rings_mutex_, NULL);
+   pthread_mutex_init(&drain_mutex_, NULL);
+}
+
+/**
+ * Starts the background drain thread writing to the given sink and
+ * starts recording events up to level.
+ * Calls close if the logger is already open.
+ * @param sink where drained records are written
+ * @param path file for the binary and trace sinks, NULL writes text to
+ *        stdout
+ * @param level most detailed level to record
+ * @param capacity records the trace sink file is sized for, events
+ *        beyond it are dropped
+ * @return false if the file could not be created
+ * @custom.preconditions  path != NULL for the trace sink
+ * @custom.postconditions  events up to level are recorded
+ **/
+bool EventLog::open(LogSinkKind sink, const char* path, int level, size_t capacity)
+{
+   close();
+
+   out_ = stdout;
+   if (sink == kTraceSink) {
+      out_ = NULL;
+      if (path == NULL || !openTrace(path, capacity)) {
+         return false;
+      }
+   } else if (path != NULL) {
+      out_ = fopen(path, (sink == kBinarySink) ? "wb" : "w");
+      if (out_ == NULL) {
+         return false;
+      }
+   }
+   sink_ = sink;
+   if (sink_ == kBinarySink) {
+      EventFileHeader header;
+      memset(&header, 0, sizeof(header));
+      memcpy(header.magic_, "SBEV", 4);
+      header.version_ = 1;
+      header.record_size_ = sizeof(EventRecord);
+      fwrite(&header, sizeof(header), 1, out_);
+   }
+
+   running_.store(true);
+   pthread_create(&drainer_, NULL, drainLoop, this);
+   level_.store(level);
+   return true;
+}
+
+/**
+ * Stops recording, drains every buffered record to the sink and stops
+ * the background thread. A trace file is unmapped and cut to the
+ * records reserved.
+ * Calls flush and closeTrace methods.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  all recorded events written out
+ **/
+void EventLog::close()
+{
+   if (!running_.load()) {
+      return;
+   }
+   level_.store(kLogOff);
+   if (sink_ == kTraceSink) {
+      closeTrace();
+   }
+   running_.store(false);
+   pthread_join(drainer_, NULL);
+   flush();
+   if (out_ != NULL && out_ != stdout) {
+      fclose(out_);
+   }
+   out_ = NULL;
+   sink_ = kNullSink;
+}
+
+/**
+ * Writes every record buffered so far to the sink, including those
+ * held back for ordering.
+ * Calls drain method.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  records logged before the call written out
+ **/
+void EventLog::flush()
+{
+   pthread_mutex_lock(&drain_mutex_);
+   drain(UINT64_MAX);
+   if (out_ != NULL) {
+      fflush(out_);
+   }
+   pthread_mutex_unlock(&drain_mutex_);
+}
+
+/**
+ * Changes the most detailed level recorded at run time.
+ * No other methods are called.
+ * @param level kLogOff ~ kLogVerbose
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  later events filtered by level
+ **/
+void EventLog::set_level(int level)
+{
+   level_.store(running_.load() ? level : kLogOff);
+}
+
+/**
+ * This returns the number of events dropped because a ring or the
+ * trace file was full.
+ * No other methods are called.
+ * @return number of dropped events
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+long EventLog::get_dropped() const
+{
+   return dropped_.load();
+}
+
+/**
+ * Appends an event to the calling thread's ring. Never blocks, the
+ * event is dropped if the ring is full.
+ * No other methods are called.
+ * @param actor customer id (> 0) or minus the barber id (<= 0)
+ * @param code ShopEvent code
+ * @param arg0 first event argument
+ * @param arg1 second event argument
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  event buffered or counted as dropped
+ **/
+void EventLog::record(int actor, int code, int arg0, int arg1)
+{
+   ThreadRing* ring = ring_owner_.ring_;
+   if (ring == NULL) {
+      ring = registerThread();
+   }
+   if (tracing_.load(memory_order_relaxed)) {
+      recordTrace(ring, actor, code, arg0, arg1);
+      return;
+   }
+
+   uint64_t tail = ring->tail_.load(memory_order_relaxed);
+   if (tail - ring->head_.load(memory_order_acquire) == kEventRingSize) {
+      dropped_.fetch_add(1, memory_order_relaxed);
+      return;
+   }
+
+   EventRecord& slot = ring->records_[tail & (kEventRingSize - 1)];
+   slot.timestamp_ns_ = monotonicNs();
+   slot.actor_ = actor;
+   slot.code_ = code;
+   slot.arg0_ = arg0;
+   slot.arg1_ = arg1;
+   ring->tail_.store(tail + 1, memory_order_release);
+}
+
+/**
+ * Allocates and registers the calling thread's ring.
+ * No other methods are called.
+ * @return the new ring
+ * @custom.preconditions  calling thread has no ring yet
+ * @custom.postconditions  ring visible to the drain thread
+ **/
+EventLog::ThreadRing* EventLog::registerThread()
+{
+   ThreadRing* ring = new ThreadRing();
+   pthread_mutex_lock(&rings_mutex_);
+   rings_.push_back(ring);
+   pthread_mutex_unlock(&rings_mutex_);
+   ring_owner_.ring_ = ring;
+   return ring;
+}
+
+/**
+ * Stores an event into the calling thread's trace chunk, reserving a
+ * new chunk when it is used up.
+ * No other methods are called.
+ * @param ring ring of the calling thread
+ * @param actor customer id (> 0) or minus the barber id (<= 0)
+ * @param code ShopEvent code
+ * @param arg0 first event argument
+ * @param arg1 second event argument
+ * @return none
+ * @custom.preconditions  ring belongs to the calling thread
+ * @custom.postconditions  event stored or counted as dropped
+ **/
+void EventLog::recordTrace(ThreadRing* ring, int actor, int code, int arg0, int arg1)
+{
+   /** pairs with closeTrace: either it waits for this store or we see
+    * tracing_ cleared and keep off the mapping */
+   ring->writing_.store(true);
+   if (!tracing_.load()) {
+      ring->writing_.store(false, memory_order_release);
+      return;
+   }
+
+   if (ring->chunk_left_ == 0) {
+      size_t start = trace_cursor_.fetch_add(kEventChunkSize, memory_order_relaxed);
+      if (start >= trace_capacity_) {
+         dropped_.fetch_add(1, memory_order_relaxed);
+         ring->writing_.store(false, memory_order_release);
+         return;
+      }
+      ring->chunk_ = trace_ + start;
+      ring->chunk_left_ = min((size_t) kEventChunkSize, trace_capacity_ - start);
+   }
+
+   EventRecord* slot = ring->chunk_++;
+   ring->chunk_left_--;
+   slot->timestamp_ns_ = monotonicNs();
+   slot->actor_ = actor;
+   slot->code_ = code;
+   slot->arg0_ = arg0;
+   slot->arg1_ = arg1;
+   ring->writing_.store(false, memory_order_release);
+}
+
+/**
+ * Creates, sizes and maps the trace file.
+ * No other methods are called.
+ * @param path trace file
+ * @param capacity number of record slots
+ * @return false if the file could not be created or mapped
+ * @custom.preconditions  not tracing
+ * @custom.postconditions  trace_ maps capacity zeroed slots
+ **/
+bool EventLog::openTrace(const char* path, size_t capacity)
+{
+   int fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+   if (fd < 0) {
+      return false;
+   }
+   /** the file stays sparse, pages are allocated as chunks fill up */
+   size_t bytes = sizeof(EventFileHeader) + capacity * sizeof(EventRecord);
+   if (ftruncate(fd, (off_t) bytes) != 0) {
+      ::close(fd);
+      return false;
+   }
+   void* map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (map == MAP_FAILED) {
+      ::close(fd);
+      return false;
+   }
+
+   EventFileHeader* header = (EventFileHeader*) map;
+   memcpy(header->magic_, "SBEV", 4);
+   header->version_ = 1;
+   header->record_size_ = sizeof(EventRecord);
+
+   trace_map_ = map;
+   trace_ = (EventRecord*) ((char*) map + sizeof(EventFileHeader));
+   trace_capacity_ = capacity;
+   trace_cursor_.store(0);
+   trace_fd_ = fd;
+   tracing_.store(true);
+   return true;
+}
+
+/**
+ * Stops the threads storing into the trace file, unmaps it and cuts it
+ * to the records reserved.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  openTrace succeeded
+ * @custom.postconditions  trace file closed
+ **/
+void EventLog::closeTrace()
+{
+   tracing_.store(false);
+   pthread_mutex_lock(&rings_mutex_);
+   for (size_t i = 0; i < rings_.size(); i++) {
+      while (rings_[i]->writing_.load()) {
+         sched_yield();
+      }
+      rings_[i]->chunk_ = NULL;
+      rings_[i]->chunk_left_ = 0;
+   }
+   pthread_mutex_unlock(&rings_mutex_);
+
+   size_t used = min(trace_cursor_.load(), trace_capacity_);
+   munmap(trace_map_, sizeof(EventFileHeader) +
+          trace_capacity_ * sizeof(EventRecord));
+   off_t length = (off_t) (sizeof(EventFileHeader) +
+                           used * sizeof(EventRecord));
+   if (ftruncate(trace_fd_, length) != 0) {
+      perror("event trace");
+   }
+   ::close(trace_fd_);
+   trace_map_ = NULL;
+   trace_ = NULL;
+   trace_fd_ = -1;
+}
+
+/**
+ * Moves every buffered record to the sink, oldest first, and frees the
+ * rings of threads that have exited. Records stamped after horizon_ns
+ * are held back and written, in order, by a later pass.
+ * No other methods are called.
+ * @param horizon_ns newest timestamp written by this pass
+ * @return number of records taken off the rings
+ * @custom.preconditions  drain_mutex_ held
+ * @custom.postconditions  rings emptied, records up to horizon_ns written
+ **/
+size_t EventLog::drain(uint64_t horizon_ns)
+{
+   vector<EventRecord> batch;
+   batch.swap(held_);
+   size_t held = batch.size();
+
+   pthread_mutex_lock(&rings_mutex_);
+   for (size_t i = 0; i < rings_.size(); ) {
+      ThreadRing* ring = rings_[i];
+      /** read orphaned_ first, an exited thread appends nothing after it */
+      bool orphaned = ring->orphaned_.load(memory_order_acquire);
+      uint64_t head = ring->head_.load(memory_order_relaxed);
+      uint64_t tail = ring->tail_.load(memory_order_acquire);
+      for (; head != tail; head++) {
+         batch.push_back(ring->records_[head & (kEventRingSize - 1)]);
+      }
+      ring->head_.store(head, memory_order_release);
+
+      if (orphaned) {
+         delete ring;
+         rings_[i] = rings_.back();
+         rings_.pop_back();
+      } else {
+         i++;
+      }
+   }
+   pthread_mutex_unlock(&rings_mutex_);
+
+   size_t taken = batch.size() - held;
+   if (batch.empty() || out_ == NULL) {
+      return taken;
+   }
+   stable_sort(batch.begin(), batch.end(),
+      [](const EventRecord& a, const EventRecord& b) {
+         return a.timestamp_ns_ < b.timestamp_ns_;
+      });
+   size_t ready = batch.size();
+   while (ready > 0 && batch[ready - 1].timestamp_ns_ > horizon_ns) {
+      ready--;
+   }
+   held_.assign(batch.begin() + ready, batch.end());
+
+   if (sink_ == kTextSink) {
+      char line[160];
+      for (size_t i = 0; i < ready; i++) {
+         /** the shop never printed arrivals or runs, they are for traces */
+         int code = batch[i].code_;
+         if (code == kEventArrives || code == kEventRunStarts) {
+            continue;
+         }
+         format(batch[i], line, sizeof(line));
+         fputs(line, out_);
+         fputc('\n', out_);
+      }
+   } else if (sink_ == kBinarySink) {
+      fwrite(batch.data(), sizeof(EventRecord), ready, out_);
+   }
+   return taken;
+}
+
+/**
+ * Entry point of the drain thread.
+ * Calls drain method.
+ * @param arg the logger
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  thread exits once running_ is cleared
+ **/
+void* EventLog::drainLoop(void* arg)
+{
+   EventLog* log = (EventLog*) arg;
+   struct timespec interval = {0, kDrainIntervalNs};
+
+   while (log->running_.load()) {
+      /** the horizon is read before the rings, see kHoldBackNs */
+      uint64_t now_ns = monotonicNs();
+      pthread_mutex_lock(&log->drain_mutex_);
+      uint64_t horizon_ns = (now_ns > kHoldBackNs) ? now_ns - kHoldBackNs : 0;
+      size_t drained = log->drain(horizon_ns);
+      pthread_mutex_unlock(&log->drain_mutex_);
+      if (drained == 0) {
+         nanosleep(&interval, NULL);
+      }
+   }
+   return nullptr;
+}
+
+/**
+ * Formats one record the way the shop used to print it, without the
+ * trailing newline.
+ * No other methods are called.
+ * @param record the record to format
+ * @param out buffer receiving the line
+ * @param size size of out
+ * @return none
+ * @custom.preconditions  size > 0
+ * @custom.postconditions  out holds a NUL terminated line
+ **/
+void EventLog::format(const EventRecord& record, char* out, size_t size)
+{
+   if (record.code_ == kEventRunStarts) {
+      snprintf(out, size, "%s run %d starts",
+               record.arg1_ ? "warm-up" : "measured", record.arg0_);
+      return;
+   }
+   int n = (record.actor_ > 0) ? snprintf(out, size, "customer[%d]: ", record.actor_)
+                               : snprintf(out, size, "barber  [%d]: ", -record.actor_);
+   if (n < 0 || (size_t) n >= size) {
+      return;
+   }
+   out += n;
+   size -= n;
+
+   switch (record.code_) {
+   case kEventBalkNoChairs:
+      snprintf(out, size, "leaves the shop because of no available waiting chairs.");
+      break;
+   case kEventBalkNoBarbers:
+      snprintf(out, size, "leaves the shop because of no available barbers.");
+      break;
+   case kEventTakesChair:
+      snprintf(out, size, "takes a waiting chair. # waiting seats available = %d",
+               record.arg0_);
+      break;
+   case kEventMovesToChair:
+      snprintf(out, size, "moves to a service chair[%d]. # waiting seats available = %d",
+               record.arg0_, record.arg1_);
+      break;
+   case kEventWaitsForHaircut:
+      snprintf(out, size, "waits for barber[%d] to be done with hair-cut",
+               record.arg0_);
+      break;
+   case kEventSaysGoodbye:
+      snprintf(out, size, "says good-bye to the barber[%d]", record.arg0_);
+      break;
+   case kEventBarberSleeps:
+      snprintf(out, size, "sleeps because of no customers.");
+      break;
+   case kEventStartsHaircut:
+      snprintf(out, size, "starts a hair-cut service for customer[%d]",
+               record.arg0_);
+      break;
+   case kEventDoneHaircut:
+      snprintf(out, size, "says he's done with a hair-cut service for customer[%d]",
+               record.arg0_);
+      break;
+   case kEventCallsNext:
+      snprintf(out, size, "calls in another customer");
+      break;
+   case kEventBarberJoins:
+      snprintf(out, size, "joins the shop. # barbers working = %d",
+               record.arg0_);
+      break;
+   case kEventBarberRetires:
+      snprintf(out, size, "retires from the shop. # barbers working = %d",
+               record.arg0_);
+      break;
+   case kEventReneges:
+      snprintf(out, size, "gives up waiting and leaves the shop. priority class = %d",
+               record.arg0_);
+      break;
+   case kEventArrives:
+      snprintf(out, size, "walks into the shop. priority class = %d",
+               record.arg0_);
+      break;
+   default:
+      snprintf(out, size, "event %d (%d, %d)",
+               record.code_, record.arg0_, record.arg1_);
+      break;
+   }
+}
@@ -0,0 +1,391 @@
+/**
+ * EventLog.h
+ *
+ * This is the EventLog.h file that defines the EventLog class, the
+ * asynchronous logger used by the Shop class in place of printing to
+ * stdout. Each thread that logs gets its own single-producer ring of
+ * fixed-size binary EventRecords, so recording an event is a clock read
+ * and a few stores with no lock and no formatting. A background thread
+ * drains the rings, orders the records by timestamp and hands them to
+ * the selected sink. Records younger than a few drain intervals are held
+ * back for the next pass, so one a thread publishes late still comes out
+ * in order: the original human-readable text, a raw binary file,
+ * or nothing at all.
+ *
+ * The trace sink skips the rings and the drain thread. The file is sized
+ * up front and mapped, each thread reserves a chunk of kEventChunkSize
+ * records from a shared cursor and appends to it with plain stores, so a
+ * run of ten million events costs one atomic add per chunk. Slots of a
+ * chunk never written keep a zero timestamp, readers skip them. The file
+ * has the layout of the binary sink and is cut to the reserved records by
+ * close.
+ *
+ * Verbosity is selected twice. SHOP_LOG_LEVEL sets the most detailed
+ * level compiled in (0 removes logging from the build entirely) and
+ * set_level chooses what is recorded at run time. Nothing is recorded
+ * until open is called. A full ring drops the event and counts it
+ * rather than blocking the thread that logs.
+ **/
+#ifndef EVENT_LOG_H_
+#define EVENT_LOG_H_
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+using namespace std;
+
+/** verbosity levels, each includes the ones below it */
+#define kLogOff 0
+#define kLogDrops 1
+#define kLogService 2
+#define kLogVerbose 3
+
+/** most detailed level compiled in, -DSHOP_LOG_LEVEL=0 compiles logging out */
+#ifndef SHOP_LOG_LEVEL
+#define SHOP_LOG_LEVEL kLogVerbose
+#endif
+
+/** number of records buffered per thread, must be a power of two */
+#define kEventRingSize 1024
+
+/** records reserved at once by a thread writing to the trace sink */
+#define kEventChunkSize 4096
+
+/** default number of records the trace sink file is sized for */
+#define kEventTraceCapacity (1 << 24)
+
+/** Shop events, actor is a customer id (> 0) or minus a barber id (<= 0) */
+enum ShopEvent {
+   /** customer leaves because all waiting chairs are taken */
+   kEventBalkNoChairs,
+   /** customer leaves because there are no chairs and no free barber */
+   kEventBalkNoBarbers,
+   /** customer sits down, arg0 = waiting seats available */
+   kEventTakesChair,
+   /** customer moves to a barber, arg0 = barber, arg1 = seats available */
+   kEventMovesToChair,
+   /** customer waits for the hair-cut, arg0 = barber */
+   kEventWaitsForHaircut,
+   /** customer pays and leaves, arg0 = barber */
+   kEventSaysGoodbye,
+   /** barber goes to sleep */
+   kEventBarberSleeps,
+   /** barber starts a hair-cut, arg0 = customer */
+   kEventStartsHaircut,
+   /** barber finishes a hair-cut, arg0 = customer */
+   kEventDoneHaircut,
+   /** barber is free for the next customer */
+   kEventCallsNext,
+   /** barber joins the shop, arg0 = barbers working */
+   kEventBarberJoins,
+   /** barber retires from the shop, arg0 = barbers working */
+   kEventBarberRetires,
+   /** customer gives up waiting, arg0 = priority class */
+   kEventReneges,
+   /** customer walks in, arg0 = priority class, arg1 = patience in μs */
+   kEventArrives,
+   /** a benchmark run begins, arg0 = run, arg1 = 1 for a warm-up run */
+   kEventRunStarts
+};
+
+/** sinks the drained records can be written to */
+enum LogSinkKind {
+   /** one human-readable line per event, the original shop output */
+   kTextSink,
+   /** raw EventRecords preceded by an EventFileHeader */
+   kBinarySink,
+   /** records are drained and discarded */
+   kNullSink,
+   /** records stored straight into a mapped, pre-sized binary file */
+   kTraceSink
+};
+
+/** one logged event, fixed size so it can be written out as is */
+struct EventRecord {
+   /** CLOCK_MONOTONIC time of the event in nanoseconds */
+   uint64_t timestamp_ns_;
+   /** customer id (> 0) or minus the barber id (<= 0) */
+   int32_t actor_;
+   /** ShopEvent code */
+   int32_t code_;
+   /** first event argument */
+   int32_t arg0_;
+   /** second event argument */
+   int32_t arg1_;
+};
+
+/** header written at the start of a binary event file */
+struct EventFileHeader {
+   /** "SBEV" */
+   char magic_[4];
+   /** format version */
+   uint32_t version_;
+   /** sizeof(EventRecord) */
+   uint32_t record_size_;
+   /** padding, zero */
+   uint32_t reserved_;
+};
+
+class EventLog
+{
+public:
+
+   /**
+    * This returns the process wide logger used by every Shop.
+    * No other methods are called.
+    * @return the logger
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static EventLog& instance();
+
+   /**
+    * Starts the background drain thread writing to the given sink and
+    * starts recording events up to level.
+    * Calls close if the logger is already open.
+    * @param sink where drained records are written
+    * @param path file for the binary and trace sinks, NULL writes text to
+    *        stdout
+    * @param level most detailed level to record
+    * @param capacity records the trace sink file is sized for, events
+    *        beyond it are dropped
+    * @return false if the file could not be created
+    * @custom.preconditions  path != NULL for the trace sink
+    * @custom.postconditions  events up to level are recorded
+    **/
+   bool open(LogSinkKind sink, const char* path, int level, size_t capacity = kEventTraceCapacity);
+
+   /**
+    * Stops recording, drains every buffered record to the sink and stops
+    * the background thread. A trace file is unmapped and cut to the
+    * records reserved.
+    * Calls flush and closeTrace methods.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  all recorded events written out
+    **/
+   void close();
+
+   /**
+    * Writes every record buffered so far to the sink, including those
+    * held back for ordering.
+    * Calls drain method.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  records logged before the call written out
+    **/
+   void flush();
+
+   /**
+    * Changes the most detailed level recorded at run time.
+    * No other methods are called.
+    * @param level kLogOff ~ kLogVerbose
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  later events filtered by level
+    **/
+   void set_level(int level);
+
+   /**
+    * This returns true if events of this level are being recorded.
+    * No other methods are called.
+    * @param level level of the event
+    * @return true if the event should be recorded
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   bool enabled(int level) const
+   {
+      return level <= level_.load(memory_order_relaxed);
+   }
+
+   /**
+    * Appends an event to the calling thread's ring. Never blocks, the
+    * event is dropped if the ring is full.
+    * No other methods are called.
+    * @param actor customer id (> 0) or minus the barber id (<= 0)
+    * @param code ShopEvent code
+    * @param arg0 first event argument
+    * @param arg1 second event argument
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  event buffered or counted as dropped
+    **/
+   void record(int actor, int code, int arg0, int arg1);
+
+   /**
+    * This returns the number of events dropped because a ring or the
+    * trace file was full.
+    * No other methods are called.
+    * @return number of dropped events
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   long get_dropped() const;
+
+   /**
+    * Formats one record the way the shop used to print it, without the
+    * trailing newline.
+    * No other methods are called.
+    * @param record the record to format
+    * @param out buffer receiving the line
+    * @param size size of out
+    * @return none
+    * @custom.preconditions  size > 0
+    * @custom.postconditions  out holds a NUL terminated line
+    **/
+   static void format(const EventRecord& record, char* out, size_t size);
+
+private:
+
+   /** per-thread single-producer single-consumer ring of records */
+   struct ThreadRing {
+      /** buffered records */
+      EventRecord records_[kEventRingSize];
+      /** next slot written by the owning thread */
+      atomic<uint64_t> tail_{0};
+      /** next slot read by the drain thread */
+      atomic<uint64_t> head_{0};
+      /** set once the owning thread has exited */
+      atomic<bool> orphaned_{false};
+      /** next free slot of the thread's trace chunk */
+      EventRecord* chunk_{NULL};
+      /** free slots left in the trace chunk */
+      size_t chunk_left_{0};
+      /** true while the owning thread stores into the trace file */
+      atomic<bool> writing_{false};
+   };
+
+   /** deletes the calling thread's ring once its thread exits */
+   struct RingOwner {
+      ThreadRing* ring_{NULL};
+      ~RingOwner();
+   };
+
+   /** most detailed level recorded, kLogOff while closed */
+   atomic<int> level_;
+   /** events dropped because a ring or the trace file was full */
+   atomic<long> dropped_;
+   /** true while the drain thread should keep running */
+   atomic<bool> running_;
+   /** selected sink */
+   LogSinkKind sink_;
+   /** output file of the sink */
+   FILE* out_;
+   /** true while threads may store into the trace file */
+   atomic<bool> tracing_;
+   /** mapped trace file, header first, NULL unless tracing */
+   void* trace_map_;
+   /** first record slot of the trace file */
+   EventRecord* trace_;
+   /** number of record slots in the trace file */
+   size_t trace_capacity_;
+   /** next record slot not yet reserved by any thread */
+   atomic<size_t> trace_cursor_;
+   /** descriptor of the trace file, -1 unless tracing */
+   int trace_fd_;
+   /** rings of every thread that has logged */
+   vector<ThreadRing*> rings_;
+   /** guards rings_ */
+   pthread_mutex_t rings_mutex_;
+   /** serializes draining between the drain thread and flush */
+   pthread_mutex_t drain_mutex_;
+   /** background drain thread */
+   pthread_t drainer_;
+   /** drained records too young to write, guarded by drain_mutex_ */
+   vector<EventRecord> held_;
+   /** per-thread ring of the calling thread */
+   static thread_local RingOwner ring_owner_;
+
+   /**
+    * Creates a closed logger.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  logger created, nothing recorded
+    **/
+   EventLog();
+
+   /**
+    * Allocates and registers the calling thread's ring.
+    * No other methods are called.
+    * @return the new ring
+    * @custom.preconditions  calling thread has no ring yet
+    * @custom.postconditions  ring visible to the drain thread
+    **/
+   ThreadRing* registerThread();
+
+   /**
+    * Stores an event into the calling thread's trace chunk, reserving a
+    * new chunk when it is used up.
+    * No other methods are called.
+    * @param ring ring of the calling thread
+    * @param actor customer id (> 0) or minus the barber id (<= 0)
+    * @param code ShopEvent code
+    * @param arg0 first event argument
+    * @param arg1 second event argument
+    * @return none
+    * @custom.preconditions  ring belongs to the calling thread
+    * @custom.postconditions  event stored or counted as dropped
+    **/
+   void recordTrace(ThreadRing* ring, int actor, int code, int arg0, int arg1);
+
+   /**
+    * Creates, sizes and maps the trace file.
+    * No other methods are called.
+    * @param path trace file
+    * @param capacity number of record slots
+    * @return false if the file could not be created or mapped
+    * @custom.preconditions  not tracing
+    * @custom.postconditions  trace_ maps capacity zeroed slots
+    **/
+   bool openTrace(const char* path, size_t capacity);
+
+   /**
+    * Stops the threads storing into the trace file, unmaps it and cuts it
+    * to the records reserved.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  openTrace succeeded
+    * @custom.postconditions  trace file closed
+    **/
+   void closeTrace();
+
+   /**
+    * Moves every buffered record to the sink, oldest first, and frees the
+    * rings of threads that have exited. Records stamped after horizon_ns
+    * are held back and written, in order, by a later pass.
+    * No other methods are called.
+    * @param horizon_ns newest timestamp written by this pass
+    * @return number of records taken off the rings
+    * @custom.preconditions  drain_mutex_ held
+    * @custom.postconditions  rings emptied, records up to horizon_ns written
+    **/
+   size_t drain(uint64_t horizon_ns);
+
+   /**
+    * Entry point of the drain thread.
+    * Calls drain method.
+    * @param arg the logger
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  thread exits once running_ is cleared
+    **/
+   static void* drainLoop(void* arg);
+};
+
+/** records a Shop event if its level is compiled in and enabled */
+#if SHOP_LOG_LEVEL > 0
+#define SHOP_LOG(level, actor, code, arg0, arg1) \
+   do { \
+      if ((level) <= SHOP_LOG_LEVEL && EventLog::instance().enabled(level)) { \
+         EventLog::instance().record((actor), (code), (arg0), (arg1)); \
+      } \
+   } while (0)
+#else
+/** the arguments count as used but are never evaluated */
+#define SHOP_LOG(level, actor, code, arg0, arg1) \
+   do { (void) sizeof((actor), (code), (arg0), (arg1)); } while (0)
+#endif
+#endif
@@ -0,0 +1,88 @@
+/**
+ * EventTrace.cpp
+ *
+ * This is the EventTrace.cpp file that implements the methods of the
+ * EventTrace class. A thread's records are in timestamp order already,
+ * the stable sort only interleaves the threads.
+ **/
+#include "EventTrace.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Creates a trace with no file open.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  get_size() == 0
+ **/
+EventTrace::EventTrace() : map_(NULL), map_bytes_(0), records_(NULL)
+{
+}
+
+/**
+ * Destructor for EventTrace class. Unmaps the file.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  file unmapped
+ **/
+EventTrace::~EventTrace()
+{
+   if (map_ != NULL) {
+      munmap(map_, map_bytes_);
+   }
+}
+
+/**
+ * Maps an event file, checks its header and orders its records by
+ * timestamp.
+ * No other methods are called.
+ * @param path event file
+ * @return false if the file cannot be mapped or is not an event file
+ * @custom.preconditions  no file open yet
+ * @custom.postconditions  records available through at
+ **/
+bool EventTrace::open(const char* path)
+{
+   int fd = ::open(path, O_RDONLY);
+   if (fd < 0) {
+      return false;
+   }
+   struct stat info;
+   if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(EventFileHeader)) {
+      close(fd);
+      return false;
+   }
+   map_bytes_ = (size_t) info.st_size;
+   void* map = mmap(NULL, map_bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      return false;
+   }
+   map_ = map;
+
+   const EventFileHeader* header = (const EventFileHeader*) map_;
+   if (memcmp(header->magic_, "SBEV", 4) != 0 || header->version_ != 1 ||
+       header->record_size_ != sizeof(EventRecord)) {
+      return false;
+   }
+   madvise(map_, map_bytes_, MADV_SEQUENTIAL);
+   records_ = (const EventRecord*) ((const char*) map_ + sizeof(EventFileHeader));
+   size_t slots = (map_bytes_ - sizeof(EventFileHeader)) / sizeof(EventRecord);
+
+   order_.reserve(slots);
+   for (size_t i = 0; i < slots; i++) {
+      if (records_[i].timestamp_ns_ != 0) {
+         order_.push_back(i);
+      }
+   }
+   const EventRecord* records = records_;
+   stable_sort(order_.begin(), order_.end(),
+      [records](size_t a, size_t b) { return records[a].timestamp_ns_ < records[b].timestamp_ns_; });
+   return true;
+}
@@ -0,0 +1,91 @@
+/**
+ * EventTrace.h
+ *
+ * This is the EventTrace.h file that defines the EventTrace class, a read
+ * only view of an event file written by the binary or trace sink of the
+ * EventLog. The file is mapped rather than read, so a trace of ten million
+ * events is opened without copying a record: only an index of the used
+ * slots, ordered by timestamp, is built next to the mapping. Slots with a
+ * zero timestamp, the unused tail of a trace sink chunk, are skipped.
+ **/
+#ifndef EVENT_TRACE_H_
+#define EVENT_TRACE_H_
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "EventLog.h"
+using namespace std;
+
+class EventTrace
+{
+public:
+
+   /**
+    * Creates a trace with no file open.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  get_size() == 0
+    **/
+   EventTrace();
+
+   /**
+    * Destructor for EventTrace class. Unmaps the file.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  file unmapped
+    **/
+   ~EventTrace();
+
+   /**
+    * Maps an event file, checks its header and orders its records by
+    * timestamp.
+    * No other methods are called.
+    * @param path event file
+    * @return false if the file cannot be mapped or is not an event file
+    * @custom.preconditions  no file open yet
+    * @custom.postconditions  records available through at
+    **/
+   bool open(const char* path);
+
+   /**
+    * This returns the number of records in the trace.
+    * No other methods are called.
+    * @return number of used slots
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   size_t get_size() const
+   {
+      return order_.size();
+   }
+
+   /**
+    * This returns a record of the trace, oldest first.
+    * No other methods are called.
+    * @param i position in timestamp order
+    * @return the record, inside the mapping
+    * @custom.preconditions  i < get_size()
+    * @custom.postconditions  none
+    **/
+   const EventRecord& at(size_t i) const
+   {
+      return records_[order_[i]];
+   }
+
+private:
+
+   /** the mapped file, NULL if none */
+   void* map_;
+   /** size of the mapping */
+   size_t map_bytes_;
+   /** first record slot of the file */
+   const EventRecord* records_;
+   /** slots holding a record, in timestamp order */
+   vector<size_t> order_;
+
+   EventTrace(const EventTrace&) = delete;
+   EventTrace& operator=(const EventTrace&) = delete;
+};
+#endif
@@ -0,0 +1,259 @@
+/**
+ * Franchise.cpp
+ *
+ * This is the Franchise.cpp file that implements the methods of the
+ * Franchise class. The shops do the work: the franchise links them as
+ * peers so their dispatch serves each other's customers, routes arriving
+ * customers and translates between franchise-wide and per-shop barber
+ * ids. Per-thread statistics of every shop are recorded in the first
+ * shop, so a customer visiting several shops uses one set of histograms.
+ **/
+#include "Franchise.h"
+#include "EventLog.h"
+
+/**
+ * Creates num_shards shops of num_barbers barbers and num_chairs
+ * waiting chairs each, which serve each other's customers.
+ * Calls Shop constructor.
+ * @param num_shards number of shops
+ * @param num_barbers number of barbers of every shop
+ * @param num_chairs number of waiting chairs of every shop
+ * @param options settings of every shop, the waiting room is lock-free
+ * @param routing how customers pick their home shop
+ * @return none
+ * @custom.preconditions  num_shards >= 1, num_barbers >= 1, num_chairs >= 0
+ * @custom.postconditions  every shop open with its barbers free
+ **/
+Franchise::Franchise(int num_shards, int num_barbers, int num_chairs, const ShopOptions& options, FranchiseRouting routing) :
+   barbers_per_shard_(num_barbers), routing_(routing), next_shard_(0)
+{
+   /** only tickets of the lock-free waiting room can move between shops */
+   ShopOptions shard_options = options;
+   shard_options.waiting_room_ = kLockFreeWaitingRoom;
+   /** barber ids are numbered across shops, so every shop keeps its barbers */
+   shard_options.barber_capacity_ = 0;
+   for (int i = 0; i < num_shards; i++) {
+      shards_.push_back(new Shop(num_barbers, num_chairs, shard_options));
+   }
+   for (int i = 0; i < num_shards; i++) {
+      Shop* shard = shards_[i];
+      shard->shard_ = i;
+      shard->stats_owner_ = shards_[0];
+      /** nearest neighbours first, alternating between both sides */
+      for (int distance = 1; distance <= num_shards / 2; distance++) {
+         shard->peers_.push_back(shards_[(i + distance) % num_shards]);
+         int before = (i - distance + num_shards) % num_shards;
+         if (before != (i + distance) % num_shards) {
+            shard->peers_.push_back(shards_[before]);
+         }
+      }
+   }
+}
+
+/**
+ * Destructor for Franchise class.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  no thread uses the franchise
+ * @custom.postconditions  every shop destroyed
+ **/
+Franchise::~Franchise()
+{
+   for (size_t i = 0; i < shards_.size(); i++) {
+      delete shards_[i];
+   }
+}
+
+/**
+ * This returns the home shop of a customer.
+ * No other methods are called.
+ * @param id id of the customer
+ * @return index of the home shop
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Franchise::homeShard(int id)
+{
+   if (routing_ == kRouteHash) {
+      /** Fibonacci hashing spreads consecutive ids over the shops */
+      return (int) (((uint32_t) id * 2654435769u) % shards_.size());
+   }
+   return (int) (next_shard_.fetch_add(1, memory_order_relaxed) % shards_.size());
+}
+
+/**
+ * Franchise version of Shop::visitShop. The customer tries its home
+ * shop and then the following ones, and leaves only if all are full.
+ * Calls Shop::visitLockFree method.
+ * Records events through SHOP_LOG.
+ * @param id id of the visiting customer
+ * @return franchise-wide id of the barber servicing them, -1 if they
+ *         leave without service
+ * @custom.preconditions  none
+ * @custom.postconditions  customer thread possibly serviced
+ **/
+int Franchise::visitShop(int id)
+{
+   int num_shards = (int) shards_.size();
+   int home = homeShard(id);
+   Shop* first = shards_[home];
+   uint64_t arrival_ns = first->statsNow();
+   SHOP_LOG(kLogService, id, kEventArrives, 0, 0);
+   if (first->options_.collect_stats_) {
+      Shop::ThreadStats* stats = first->threadStats();
+      stats->arrivals_.store(stats->arrivals_.load(memory_order_relaxed) + 1, memory_order_relaxed);
+   }
+
+   for (int i = 0; i < num_shards; i++) {
+      Shop* server = NULL;
+      int barber_id = shards_[(home + i) % num_shards]->visitLockFree(id, arrival_ns, &server, false);
+      if (barber_id != -1) {
+         return server->shard_ * barbers_per_shard_ + barber_id;
+      }
+   }
+
+   /** Every shop is full, the customer counts as the home shop's drop */
+   SHOP_LOG(kLogDrops, id, (first->max_waiting_cust_ == 0) ? kEventBalkNoBarbers : kEventBalkNoChairs, 0, 0);
+   ++first->cust_drops_;
+   return -1;
+}
+
+/**
+ * Franchise version of Shop::leaveShop.
+ * Calls Shop::leaveShop method.
+ * @param customer_id id of the customer
+ * @param barber_id franchise-wide id returned by visitShop
+ * @return none
+ * @custom.preconditions  barber_id was returned by visitShop
+ * @custom.postconditions  customer thread service is completed
+ **/
+void Franchise::leaveShop(int customer_id, int barber_id)
+{
+   shards_[barber_id / barbers_per_shard_]->leaveShop(customer_id, barber_id % barbers_per_shard_);
+}
+
+/**
+ * Franchise version of Shop::helloCustomer.
+ * Calls Shop::helloCustomer method.
+ * @param id franchise-wide id of the barber
+ * @return true if a hair-cut started, false once the franchise is
+ *         closed and nobody is left waiting
+ * @custom.preconditions  0 <= id < get_num_barbers()
+ * @custom.postconditions  customer thread service is started
+ **/
+bool Franchise::helloCustomer(int id)
+{
+   return shards_[id / barbers_per_shard_]->helloCustomer(id % barbers_per_shard_);
+}
+
+/**
+ * Franchise version of Shop::byeCustomer.
+ * Calls Shop::byeCustomer method.
+ * @param id franchise-wide id of the barber
+ * @return none
+ * @custom.preconditions  0 <= id < get_num_barbers()
+ * @custom.postconditions  customer thread service is finished
+ **/
+void Franchise::byeCustomer(int id)
+{
+   shards_[id / barbers_per_shard_]->byeCustomer(id % barbers_per_shard_);
+}
+
+/**
+ * Franchise version of Shop::close, closing every shop.
+ * Calls Shop::close method.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  every shop closed
+ **/
+void Franchise::close()
+{
+   for (size_t i = 0; i < shards_.size(); i++) {
+      shards_[i]->close();
+   }
+}
+
+/**
+ * Franchise version of Shop::drain. Every shop is closed before any is
+ * waited for, since the shops serve each other's customers.
+ * Calls close and Shop::drain methods.
+ * @return none
+ * @custom.preconditions  every barber's thread keeps calling
+ *                        helloCustomer until it returns false
+ * @custom.postconditions  every barber out of the franchise
+ **/
+void Franchise::drain()
+{
+   close();
+   for (size_t i = 0; i < shards_.size(); i++) {
+      shards_[i]->drain();
+   }
+}
+
+/**
+ * Franchise version of Shop::reset, opening every shop again.
+ * Calls Shop::reset method.
+ * @return false if a shop was not drained
+ * @custom.preconditions  no customer thread is in the franchise
+ * @custom.postconditions  every drained shop open as if newly built
+ **/
+bool Franchise::reset()
+{
+   bool drained = true;
+   for (size_t i = 0; i < shards_.size(); i++) {
+      drained = shards_[i]->reset() && drained;
+   }
+   return drained;
+}
+
+/**
+ * This returns the number of customers no shop could take.
+ * No other methods are called.
+ * @return number of customers that left without being serviced
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Franchise::get_cust_drops() const
+{
+   int drops = 0;
+   for (size_t i = 0; i < shards_.size(); i++) {
+      drops += shards_[i]->get_cust_drops();
+   }
+   return drops;
+}
+
+/**
+ * This returns the number of barbers of all shops.
+ * No other methods are called.
+ * @return number of barbers
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Franchise::get_num_barbers() const
+{
+   return (int) shards_.size() * barbers_per_shard_;
+}
+
+/**
+ * This returns the statistics of all shops merged, barbers in
+ * franchise-wide order.
+ * Calls Shop::get_stats method.
+ * @return statistics recorded so far
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+ShopStats Franchise::get_stats() const
+{
+   ShopStats stats;
+   for (size_t i = 0; i < shards_.size(); i++) {
+      ShopStats shard = shards_[i]->get_stats();
+      stats.arrivals_ += shard.arrivals_;
+      stats.served_ += shard.served_;
+      stats.drops_ += shard.drops_;
+      stats.queue_wait_.merge(shard.queue_wait_);
+      stats.service_.merge(shard.service_);
+      stats.payment_.merge(shard.payment_);
+      stats.barbers_.insert(stats.barbers_.end(), shard.barbers_.begin(), shard.barbers_.end());
+   }
+   return stats;
+}
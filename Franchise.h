@@ -0,0 +1,188 @@
+/**
+ * Franchise.h
+ *
+ * This is the Franchise.h file that defines the Franchise class, a shop
+ * split into num_shards independent Shop shards so that no waiting room,
+ * free barber set or counter is shared by every thread. Each shard has
+ * its own barbers and its own lock-free waiting room.
+ *
+ * A customer is routed to a home shard, round-robin or by hashing its id,
+ * and moves on to the following shards when the home shard turns it
+ * away, so a customer is only dropped when every shard is full. Shards
+ * serve each other: a barber that becomes free in one shard steals the
+ * waiting customers of the other shards, nearest first, before it goes
+ * to sleep, and a customer that sits down while its shard has no free
+ * barber is handed to a free barber of another shard.
+ *
+ * Barbers are numbered across the franchise, barber i belongs to shard
+ * i / num_barbers, and the franchise is used with the same calls as a
+ * Shop.
+ **/
+#ifndef FRANCHISE_H_
+#define FRANCHISE_H_
+#include <atomic>
+#include <vector>
+#include "Shop.h"
+#include "ShopStats.h"
+using namespace std;
+
+/** ways a franchise picks the home shard of a customer */
+enum FranchiseRouting {
+   /** shards take turns */
+   kRouteRoundRobin,
+   /** the customer id is hashed, a customer always starts at the same shard */
+   kRouteHash
+};
+
+class Franchise
+{
+public:
+
+   /**
+    * Creates num_shards shops of num_barbers barbers and num_chairs
+    * waiting chairs each, which serve each other's customers.
+    * Calls Shop constructor.
+    * @param num_shards number of shops
+    * @param num_barbers number of barbers of every shop
+    * @param num_chairs number of waiting chairs of every shop
+    * @param options settings of every shop, the waiting room is lock-free
+    * @param routing how customers pick their home shop
+    * @return none
+    * @custom.preconditions  num_shards >= 1, num_barbers >= 1, num_chairs >= 0
+    * @custom.postconditions  every shop open with its barbers free
+    **/
+   Franchise(int num_shards, int num_barbers, int num_chairs, const ShopOptions& options, FranchiseRouting routing);
+
+   /**
+    * Destructor for Franchise class.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  no thread uses the franchise
+    * @custom.postconditions  every shop destroyed
+    **/
+   ~Franchise();
+
+   /**
+    * Franchise version of Shop::visitShop. The customer tries its home
+    * shop and then the following ones, and leaves only if all are full.
+    * Calls Shop::visitLockFree method.
+    * Records events through SHOP_LOG.
+    * @param id id of the visiting customer
+    * @return franchise-wide id of the barber servicing them, -1 if they
+    *         leave without service
+    * @custom.preconditions  none
+    * @custom.postconditions  customer thread possibly serviced
+    **/
+   int visitShop(int id);
+
+   /**
+    * Franchise version of Shop::leaveShop.
+    * Calls Shop::leaveShop method.
+    * @param customer_id id of the customer
+    * @param barber_id franchise-wide id returned by visitShop
+    * @return none
+    * @custom.preconditions  barber_id was returned by visitShop
+    * @custom.postconditions  customer thread service is completed
+    **/
+   void leaveShop(int customer_id, int barber_id);
+
+   /**
+    * Franchise version of Shop::helloCustomer.
+    * Calls Shop::helloCustomer method.
+    * @param id franchise-wide id of the barber
+    * @return true if a hair-cut started, false once the franchise is 
+    *         closed and nobody is left waiting
+    * @custom.preconditions  0 <= id < get_num_barbers()
+    * @custom.postconditions  customer thread service is started
+    **/
+   bool helloCustomer(int id);
+
+   /**
+    * Franchise version of Shop::byeCustomer.
+    * Calls Shop::byeCustomer method.
+    * @param id franchise-wide id of the barber
+    * @return none
+    * @custom.preconditions  0 <= id < get_num_barbers()
+    * @custom.postconditions  customer thread service is finished
+    **/
+   void byeCustomer(int id);
+
+   /**
+    * Franchise version of Shop::close, closing every shop.
+    * Calls Shop::close method.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  every shop closed
+    **/
+   void close();
+
+   /**
+    * Franchise version of Shop::drain. Every shop is closed before any is
+    * waited for, since the shops serve each other's customers.
+    * Calls close and Shop::drain methods.
+    * @return none
+    * @custom.preconditions  every barber's thread keeps calling
+    *                        helloCustomer until it returns false
+    * @custom.postconditions  every barber out of the franchise
+    **/
+   void drain();
+
+   /**
+    * Franchise version of Shop::reset, opening every shop again.
+    * Calls Shop::reset method.
+    * @return false if a shop was not drained
+    * @custom.preconditions  no customer thread is in the franchise
+    * @custom.postconditions  every drained shop open as if newly built
+    **/
+   bool reset();
+
+   /**
+    * This returns the number of customers no shop could take.
+    * No other methods are called.
+    * @return number of customers that left without being serviced
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_cust_drops() const;
+
+   /**
+    * This returns the number of barbers of all shops.
+    * No other methods are called.
+    * @return number of barbers
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_num_barbers() const;
+
+   /**
+    * This returns the statistics of all shops merged, barbers in
+    * franchise-wide order.
+    * Calls Shop::get_stats method.
+    * @return statistics recorded so far
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   ShopStats get_stats() const;
+
+private:
+
+   /** the shops of the franchise */
+   vector<Shop*> shards_;
+   /** number of barbers of every shop */
+   int barbers_per_shard_;
+   /** how customers pick their home shop */
+   FranchiseRouting routing_;
+   /** next home shop of round-robin routing */
+   atomic<unsigned int> next_shard_;
+
+   /**
+    * This returns the home shop of a customer.
+    * No other methods are called.
+    * @param id id of the customer
+    * @return index of the home shop
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int homeShard(int id);
+};
+#endif
@@ -0,0 +1,69 @@
+/**
+ * Futex.h
+ *
+ * This is the Futex.h file that wraps the Linux futex system call for the
+ * parts of the shop that park threads on a single atomic word instead of
+ * a mutex and a condition variable. A waiter sleeps only while the word
+ * still holds the value it expects, so a wake that happens before the
+ * wait is never lost.
+ **/
+#ifndef FUTEX_H_
+#define FUTEX_H_
+#include <atomic>
+#include <climits>
+#include <stdint.h>
+#include <time.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+using namespace std;
+
+/**
+ * Puts the calling thread to sleep while word == expected. May return
+ * spuriously, so callers re-check the word in a loop.
+ * No other methods are called.
+ * @param word 32 bit atomic the thread parks on
+ * @param expected value the word must still hold for the thread to sleep
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  word changed, the thread was woken, or spurious
+ **/
+inline void futexWait(atomic<int>* word, int expected)
+{
+   syscall(SYS_futex, (int*) word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+/**
+ * Puts the calling thread to sleep while word == expected, for at most 
+ * timeout_ns. May return spuriously, so callers re-check the word and 
+ * the time in a loop.
+ * No other methods are called.
+ * @param word 32 bit atomic the thread parks on
+ * @param expected value the word must still hold for the thread to sleep
+ * @param timeout_ns longest time to sleep in nanoseconds
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  word changed, the time is up, or spurious
+ **/
+inline void futexWaitFor(atomic<int>* word, int expected, uint64_t timeout_ns)
+{
+   struct timespec timeout;
+   timeout.tv_sec = timeout_ns / 1000000000ULL;
+   timeout.tv_nsec = timeout_ns % 1000000000ULL;
+   syscall(SYS_futex, (int*) word, FUTEX_WAIT_PRIVATE, expected, &timeout, NULL, 0);
+}
+
+/**
+ * Wakes up to count threads parked on word.
+ * No other methods are called.
+ * @param word 32 bit atomic the threads are parked on
+ * @param count maximum number of threads to wake
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  up to count waiters are runnable
+ **/
+inline void futexWake(atomic<int>* word, int count)
+{
+   syscall(SYS_futex, (int*) word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+#endif
@@ -0,0 +1,213 @@
+/**
+ * Histogram.cpp
+ *
+ * This is the Histogram.cpp file that implements the methods of the
+ * Histogram class that are not on the recording path: merging, resetting
+ * and reading percentiles and summary values.
+ **/
+#include "Histogram.h"
+using namespace std;
+
+/**
+ * Creates an empty histogram.
+ * Calls reset method.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  histogram holds no values
+ **/
+Histogram::Histogram()
+{
+   reset();
+}
+
+/**
+ * Creates a copy of other, which may still be recording.
+ * Calls reset and merge methods.
+ * @param other histogram to copy
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  histogram holds the values of other
+ **/
+Histogram::Histogram(const Histogram& other)
+{
+   reset();
+   merge(other);
+}
+
+/**
+ * Replaces the values of this histogram with those of other.
+ * Calls reset and merge methods.
+ * @param other histogram to copy
+ * @return this histogram
+ * @custom.preconditions  this histogram is not recording
+ * @custom.postconditions  histogram holds the values of other
+ **/
+Histogram& Histogram::operator=(const Histogram& other)
+{
+   if (this != &other) {
+      reset();
+      merge(other);
+   }
+   return *this;
+}
+
+/**
+ * Forgets every recorded value.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  no thread is recording
+ * @custom.postconditions  histogram holds no values
+ **/
+void Histogram::reset()
+{
+   for (int i = 0; i < kHistogramBuckets; i++) {
+      counts_[i].store(0, memory_order_relaxed);
+   }
+   count_.store(0, memory_order_relaxed);
+   sum_.store(0, memory_order_relaxed);
+   min_.store(UINT64_MAX, memory_order_relaxed);
+   max_.store(0, memory_order_relaxed);
+}
+
+/**
+ * Adds every value counted by other to this histogram.
+ * No other methods are called.
+ * @param other histogram to add
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  this histogram holds the values of both
+ **/
+void Histogram::merge(const Histogram& other)
+{
+   /** 
+    * The total is taken from the buckets rather than other.count_ so 
+    * percentiles stay consistent while other is still recording 
+    */
+   uint64_t total = 0;
+   for (int i = 0; i < kHistogramBuckets; i++) {
+      uint64_t n = other.counts_[i].load(memory_order_relaxed);
+      if (n != 0) {
+         counts_[i].store(counts_[i].load(memory_order_relaxed) + n, memory_order_relaxed);
+         total += n;
+      }
+   }
+   count_.store(count_.load(memory_order_relaxed) + total, memory_order_relaxed);
+   sum_.store(sum_.load(memory_order_relaxed) + other.sum_.load(memory_order_relaxed), memory_order_relaxed);
+   uint64_t other_min = other.min_.load(memory_order_relaxed);
+   uint64_t other_max = other.max_.load(memory_order_relaxed);
+   if (other_min < min_.load(memory_order_relaxed)) {
+      min_.store(other_min, memory_order_relaxed);
+   }
+   if (other_max > max_.load(memory_order_relaxed)) {
+      max_.store(other_max, memory_order_relaxed);
+   }
+}
+
+/**
+ * This returns the value below which the given percentage of the
+ * recorded values fall.
+ * No other methods are called.
+ * @param percent percentile in [0, 100]
+ * @return representative value of the percentile's bucket, 0 if empty
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+uint64_t Histogram::percentile(double percent) const
+{
+   uint64_t count = count_.load(memory_order_relaxed);
+   uint64_t min = min_.load(memory_order_relaxed);
+   uint64_t max = max_.load(memory_order_relaxed);
+   if (count == 0) {
+      return 0;
+   }
+   uint64_t rank = (uint64_t) (percent / 100.0 * count + 0.5);
+   if (rank < 1) {
+      rank = 1;
+   }
+   if (rank > count) {
+      rank = count;
+   }
+
+   uint64_t seen = 0;
+   for (int i = 0; i < kHistogramBuckets; i++) {
+      seen += counts_[i].load(memory_order_relaxed);
+      if (seen >= rank) {
+         uint64_t value = bucketValue(i);
+         /** never report beyond the values that were actually seen */
+         if (value < min) {
+            return min;
+         }
+         return (value > max) ? max : value;
+      }
+   }
+   return max;
+}
+
+/**
+ * This returns the number of recorded values.
+ * No other methods are called.
+ * @return number of recorded values
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+uint64_t Histogram::get_count() const
+{
+   return count_.load(memory_order_relaxed);
+}
+
+/**
+ * This returns the mean of the recorded values.
+ * No other methods are called.
+ * @return mean, 0 if empty
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+double Histogram::get_mean() const
+{
+   uint64_t count = count_.load(memory_order_relaxed);
+   return (count == 0) ? 0.0 : (double) sum_.load(memory_order_relaxed) / count;
+}
+
+/**
+ * This returns the smallest recorded value.
+ * No other methods are called.
+ * @return smallest value, 0 if empty
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+uint64_t Histogram::get_min() const
+{
+   return (count_.load(memory_order_relaxed) == 0) ? 0 : min_.load(memory_order_relaxed);
+}
+
+/**
+ * This returns the largest recorded value.
+ * No other methods are called.
+ * @return largest value, 0 if empty
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+uint64_t Histogram::get_max() const
+{
+   return max_.load(memory_order_relaxed);
+}
+
+/**
+ * This returns the value reported for a bucket, the middle of its range.
+ * No other methods are called.
+ * @param bucket bucket index
+ * @return representative value of the bucket
+ * @custom.preconditions  0 <= bucket < kHistogramBuckets
+ * @custom.postconditions  none
+ **/
+uint64_t Histogram::bucketValue(int bucket)
+{
+   if (bucket < (1 << kHistogramSubBits)) {
+      return (uint64_t) bucket;
+   }
+   int exponent = (bucket >> kHistogramSubBits) + kHistogramSubBits - 1;
+   uint64_t sub = (uint64_t) (bucket & ((1 << kHistogramSubBits) - 1));
+   int shift = exponent - kHistogramSubBits;
+   uint64_t lower = (((uint64_t) 1 << kHistogramSubBits) + sub) << shift;
+   return lower + (((uint64_t) 1 << shift) >> 1);
+}
@@ -0,0 +1,188 @@
+/**
+ * Histogram.h
+ *
+ * This is the Histogram.h file that defines the Histogram class used to
+ * collect latency distributions. Values are counted in log-linear buckets
+ * in the style of an HDR histogram: values below 2^kHistogramSubBits are
+ * exact, above that every power of two is split into 2^kHistogramSubBits
+ * equal buckets, so any recorded value is reported within about 3% of
+ * its true value while the whole 64 bit range fits in a fixed array.
+ *
+ * Recording is a couple of bit operations and an increment. A histogram
+ * has a single writer, but its counters are relaxed atomics so any thread
+ * may merge or read it while the writer keeps recording. Histograms
+ * recorded by different threads are combined with merge.
+ **/
+#ifndef HISTOGRAM_H_
+#define HISTOGRAM_H_
+#include <stdint.h>
+#include <atomic>
+
+/** log2 of the number of buckets each power of two is split into */
+#define kHistogramSubBits 5
+/** number of buckets covering all 64 bit values */
+#define kHistogramBuckets ((64 - kHistogramSubBits + 1) << kHistogramSubBits)
+
+class Histogram
+{
+public:
+
+   /**
+    * Creates an empty histogram.
+    * Calls reset method.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  histogram holds no values
+    **/
+   Histogram();
+
+   /**
+    * Creates a copy of other, which may still be recording.
+    * Calls reset and merge methods.
+    * @param other histogram to copy
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  histogram holds the values of other
+    **/
+   Histogram(const Histogram& other);
+
+   /**
+    * Replaces the values of this histogram with those of other.
+    * Calls reset and merge methods.
+    * @param other histogram to copy
+    * @return this histogram
+    * @custom.preconditions  this histogram is not recording
+    * @custom.postconditions  histogram holds the values of other
+    **/
+   Histogram& operator=(const Histogram& other);
+
+   /**
+    * Counts one value. Only one thread may record into a histogram.
+    * No other methods are called.
+    * @param value value to record, usually nanoseconds
+    * @return none
+    * @custom.preconditions  calling thread is the histogram's only writer
+    * @custom.postconditions  value counted in its bucket
+    **/
+   void record(uint64_t value)
+   {
+      std::atomic<uint64_t>& bucket = counts_[bucketOf(value)];
+      bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      sum_.store(sum_.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+      if (value < min_.load(std::memory_order_relaxed)) {
+         min_.store(value, std::memory_order_relaxed);
+      }
+      if (value > max_.load(std::memory_order_relaxed)) {
+         max_.store(value, std::memory_order_relaxed);
+      }
+   }
+
+   /**
+    * Adds every value counted by other to this histogram.
+    * No other methods are called.
+    * @param other histogram to add
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  this histogram holds the values of both
+    **/
+   void merge(const Histogram& other);
+
+   /**
+    * Forgets every recorded value.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  no thread is recording
+    * @custom.postconditions  histogram holds no values
+    **/
+   void reset();
+
+   /**
+    * This returns the value below which the given percentage of the
+    * recorded values fall.
+    * No other methods are called.
+    * @param percent percentile in [0, 100]
+    * @return representative value of the percentile's bucket, 0 if empty
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   uint64_t percentile(double percent) const;
+
+   /**
+    * This returns the number of recorded values.
+    * No other methods are called.
+    * @return number of recorded values
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   uint64_t get_count() const;
+
+   /**
+    * This returns the mean of the recorded values.
+    * No other methods are called.
+    * @return mean, 0 if empty
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_mean() const;
+
+   /**
+    * This returns the smallest recorded value.
+    * No other methods are called.
+    * @return smallest value, 0 if empty
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   uint64_t get_min() const;
+
+   /**
+    * This returns the largest recorded value.
+    * No other methods are called.
+    * @return largest value, 0 if empty
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   uint64_t get_max() const;
+
+private:
+
+   /** number of values in each bucket */
+   std::atomic<uint64_t> counts_[kHistogramBuckets];
+   /** number of recorded values */
+   std::atomic<uint64_t> count_;
+   /** sum of recorded values */
+   std::atomic<uint64_t> sum_;
+   /** smallest recorded value */
+   std::atomic<uint64_t> min_;
+   /** largest recorded value */
+   std::atomic<uint64_t> max_;
+
+   /**
+    * This returns the bucket a value is counted in.
+    * No other methods are called.
+    * @param value recorded value
+    * @return bucket index in [0, kHistogramBuckets)
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static int bucketOf(uint64_t value)
+   {
+      if (value < ((uint64_t) 1 << kHistogramSubBits)) {
+         return (int) value;
+      }
+      int exponent = 63 - __builtin_clzll(value);
+      int sub = (int) (value >> (exponent - kHistogramSubBits)) & ((1 << kHistogramSubBits) - 1);
+      return ((exponent - kHistogramSubBits + 1) << kHistogramSubBits) + sub;
+   }
+
+   /**
+    * This returns the value reported for a bucket, the middle of its range.
+    * No other methods are called.
+    * @param bucket bucket index
+    * @return representative value of the bucket
+    * @custom.preconditions  0 <= bucket < kHistogramBuckets
+    * @custom.postconditions  none
+    **/
+   static uint64_t bucketValue(int bucket);
+};
+#endif
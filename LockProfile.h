@@ -0,0 +1,474 @@
+/**
+ * LockProfile.h
+ *
+ * This is the LockProfile.h file that defines the LockProfiler, which
+ * measures where Shop threads lose time to one another. Every mutex
+ * acquisition and condition variable wait of the shop's handshake is
+ * tagged with the LockSite it belongs to, and the profiler records per
+ * site:
+ *
+ * acquisitions, the acquisitions that found the mutex taken and the time
+ * spent getting it, the time the mutex was held, the waits that had to
+ * sleep and the time asleep, and the wake-ups, counting apart those that
+ * found the awaited condition still false and went back to sleep, such
+ * as a barber woken with nobody in the chair. With the spinning wait
+ * strategies every poll counts as a wake-up.
+ *
+ * Profiling is compiled in with -DSHOP_PROFILE_LOCKS=1. Without it the
+ * SHOP_LOCK, SHOP_UNLOCK and SHOP_WAIT macros are the plain pthread and
+ * ShopWait calls, so the default build pays nothing. Every thread counts
+ * into its own counters, merged when the profile is read, so recording
+ * adds no shared cache line of its own; a contended acquisition costs a
+ * failed trylock and two clock reads, and every acquisition two more for
+ * its hold time.
+ *
+ * Only the handshake of the condvar hand-off is profiled: visitShop,
+ * leaveShop, helloCustomer and byeCustomer with the locked and ticket
+ * waiting rooms. The lock-free room and direct hand-off park on futexes
+ * and are not counted, nor are the shop mutex's other users such as
+ * addBarber and the getters.
+ **/
+#ifndef LOCK_PROFILE_H_
+#define LOCK_PROFILE_H_
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+#include "Clock.h"
+#include "WaitStrategy.h"
+using namespace std;
+
+/** 1 compiles the lock profiler into Shop */
+#ifndef SHOP_PROFILE_LOCKS
+#define SHOP_PROFILE_LOCKS 0
+#endif
+
+/** steps of the shop's handshake that take a mutex or wait */
+enum LockSite {
+   /** customer checks for a chair and waits for a free barber, shop mutex */
+   kSiteVisitRoom,
+   /** customer sits in the barber's chair and wakes them, barber mutex */
+   kSiteVisitChair,
+   /** customer waits for the hair-cut to end and pays, barber mutex */
+   kSiteLeaveServed,
+   /** barber looks for waiting customers before sleeping, shop mutex */
+   kSiteHelloRoom,
+   /** barber sleeps until a customer is in the chair, barber mutex */
+   kSiteHelloChair,
+   /** barber ends the hair-cut and waits to be paid, barber mutex */
+   kSiteByePaid,
+   /** barber rejoins the free barbers and calls the next, shop mutex */
+   kSiteByeRoom,
+   /** number of sites */
+   kNumLockSites
+};
+
+/** what the profiler recorded for one site */
+struct LockSiteStats {
+   /** mutex acquisitions */
+   uint64_t acquisitions_{0};
+   /** acquisitions that found the mutex taken */
+   uint64_t contended_{0};
+   /** time spent acquiring contended mutexes */
+   uint64_t wait_ns_{0};
+   /** time the mutex was held, not counting condition variable sleeps */
+   uint64_t hold_ns_{0};
+   /** condition variable waits that had to sleep */
+   uint64_t sleeps_{0};
+   /** time spent in those waits */
+   uint64_t sleep_ns_{0};
+   /** times a sleeping waiter woke up */
+   uint64_t wakeups_{0};
+   /** wake-ups that found the condition still false */
+   uint64_t futile_wakeups_{0};
+};
+
+/** the profile of every site */
+struct LockProfile {
+   /** every site, indexed by LockSite */
+   LockSiteStats sites_[kNumLockSites];
+   /** time since the profiler was reset */
+   uint64_t elapsed_ns_{0};
+
+   /**
+    * This returns the step threads lost the most time to contention in,
+    * the one that limits how far the shop scales.
+    * No other methods are called.
+    * @return LockSite with the most time spent acquiring its mutex, -1
+    *         if no acquisition was contended
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_limiting_site() const
+   {
+      int limiting = -1;
+      for (int s = 0; s < kNumLockSites; s++) {
+         if (sites_[s].wait_ns_ > 0 && (limiting < 0 || sites_[s].wait_ns_ > sites_[limiting].wait_ns_)) {
+            limiting = s;
+         }
+      }
+      return limiting;
+   }
+
+   /**
+    * This returns the fraction of the elapsed time the shop mutex was
+    * held by the handshake, which bounds the customers served per second
+    * as it nears 1.
+    * No other methods are called.
+    * @return hold time of the shop mutex sites over the elapsed time
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_room_busy() const
+   {
+      uint64_t held = sites_[kSiteVisitRoom].hold_ns_ + sites_[kSiteHelloRoom].hold_ns_ +
+                      sites_[kSiteByeRoom].hold_ns_;
+      return (elapsed_ns_ == 0) ? 0.0 : (double) held / elapsed_ns_;
+   }
+};
+
+class LockProfiler
+{
+public:
+
+   /**
+    * This returns the process wide profiler used by every Shop.
+    * No other methods are called.
+    * @return the profiler
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static LockProfiler& instance()
+   {
+      static LockProfiler profiler;
+      return profiler;
+   }
+
+   /**
+    * Locks mutex for a site, timing the acquisition if it is contended.
+    * Calls threadSites method.
+    * @param site LockSite of the acquisition
+    * @param mutex mutex to lock
+    * @return none
+    * @custom.preconditions  mutex not held by the caller
+    * @custom.postconditions  mutex held
+    **/
+   void lock(int site, pthread_mutex_t* mutex)
+   {
+      ThreadSites* sites = threadSites();
+      SiteCounters& counters = sites->counters_[site];
+      if (pthread_mutex_trylock(mutex) != 0) {
+         uint64_t start_ns = monotonicNs();
+         pthread_mutex_lock(mutex);
+         sites->acquired_ns_[site] = monotonicNs();
+         add(counters.contended_, 1);
+         add(counters.wait_ns_, sites->acquired_ns_[site] - start_ns);
+      } else {
+         sites->acquired_ns_[site] = monotonicNs();
+      }
+      add(counters.acquisitions_, 1);
+   }
+
+   /**
+    * Unlocks mutex for a site and records how long it was held.
+    * Calls threadSites method.
+    * @param site LockSite the mutex was locked for
+    * @param mutex mutex to unlock
+    * @return none
+    * @custom.preconditions  mutex locked by lock for the same site
+    * @custom.postconditions  mutex released
+    **/
+   void unlock(int site, pthread_mutex_t* mutex)
+   {
+      ThreadSites* sites = threadSites();
+      add(sites->counters_[site].hold_ns_, monotonicNs() - sites->acquired_ns_[site]);
+      pthread_mutex_unlock(mutex);
+   }
+
+   /**
+    * Waits through ShopWait until done() holds, counting the sleep, its
+    * duration and every wake-up that found done() still false. The time
+    * asleep does not count as holding the mutex.
+    * Calls threadSites and ShopWait::wait methods.
+    * @param site LockSite of the wait
+    * @param cond condition variable signaled after done() may have changed
+    * @param mutex mutex guarding the state done() reads
+    * @param done predicate to wait for
+    * @return none
+    * @custom.preconditions  mutex locked by lock for the same site
+    * @custom.postconditions  mutex held, done() is true
+    **/
+   template<class Predicate>
+   void wait(int site, pthread_cond_t* cond, pthread_mutex_t* mutex, Predicate done)
+   {
+      if (done()) {
+         return;
+      }
+      ThreadSites* sites = threadSites();
+      SiteCounters& counters = sites->counters_[site];
+      uint64_t sleep_ns = monotonicNs();
+      add(counters.hold_ns_, sleep_ns - sites->acquired_ns_[site]);
+      add(counters.sleeps_, 1);
+      /** the first poll repeats the check above, every later one follows a wake-up */
+      bool first = true;
+      ShopWait::wait(cond, mutex, [&] {
+         if (first) {
+            first = false;
+            return false;
+         }
+         add(counters.wakeups_, 1);
+         if (done()) {
+            return true;
+         }
+         add(counters.futile_wakeups_, 1);
+         return false;
+      });
+      sites->acquired_ns_[site] = monotonicNs();
+      add(counters.sleep_ns_, sites->acquired_ns_[site] - sleep_ns);
+   }
+
+   /**
+    * Zeroes every counter and restarts the elapsed time.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  none, counts recorded concurrently may be lost
+    * @custom.postconditions  profile empty
+    **/
+   void reset()
+   {
+      pthread_mutex_lock(&threads_mutex_);
+      for (size_t i = 0; i < threads_.size(); i++) {
+         for (int s = 0; s < kNumLockSites; s++) {
+            threads_[i]->counters_[s].clear();
+         }
+      }
+      for (int s = 0; s < kNumLockSites; s++) {
+         exited_[s] = LockSiteStats();
+      }
+      start_ns_ = monotonicNs();
+      pthread_mutex_unlock(&threads_mutex_);
+   }
+
+   /**
+    * This returns the counters of every thread merged, including threads
+    * that exited. Safe to call while the shop is running.
+    * No other methods are called.
+    * @return profile since the last reset
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   LockProfile get_profile()
+   {
+      LockProfile profile;
+      pthread_mutex_lock(&threads_mutex_);
+      for (int s = 0; s < kNumLockSites; s++) {
+         profile.sites_[s] = exited_[s];
+         for (size_t i = 0; i < threads_.size(); i++) {
+            threads_[i]->counters_[s].addTo(&profile.sites_[s]);
+         }
+      }
+      profile.elapsed_ns_ = monotonicNs() - start_ns_;
+      pthread_mutex_unlock(&threads_mutex_);
+      return profile;
+   }
+
+   /**
+    * This returns the name a site is reported by.
+    * No other methods are called.
+    * @param site LockSite
+    * @return name of the handshake step
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static const char* siteName(int site)
+   {
+      static const char* const names[kNumLockSites] = {
+         "visit:room", "visit:chair", "leave:served", "hello:room",
+         "hello:chair", "bye:paid", "bye:room"
+      };
+      return (site >= 0 && site < kNumLockSites) ? names[site] : "?";
+   }
+
+   /**
+    * Prints one line per site that was used, times in μ seconds, then
+    * how busy the shop mutex was and the limiting step.
+    * Calls siteName, get_room_busy and get_limiting_site methods.
+    * @param out stream to print to
+    * @param profile profile to print
+    * @param prefix text printed before every line
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  report written to out
+    **/
+   static void print(FILE* out, const LockProfile& profile, const char* prefix)
+   {
+      fprintf(out, "%s%-12s %10s %7s %9s %9s %9s %9s %9s %9s\n", prefix, "site", "acquires",
+              "contend", "wait_avg", "hold_avg", "sleeps", "sleep_avg", "wakeups", "futile");
+      for (int s = 0; s < kNumLockSites; s++) {
+         const LockSiteStats& site = profile.sites_[s];
+         if (site.acquisitions_ == 0) {
+            continue;
+         }
+         fprintf(out, "%s%-12s %10lu %6.1f%% %9.2f %9.2f %9lu %9.1f %9lu %9lu\n", prefix, siteName(s),
+                 (unsigned long) site.acquisitions_, 100.0 * site.contended_ / site.acquisitions_,
+                 (site.contended_ == 0) ? 0.0 : site.wait_ns_ / 1e3 / site.contended_,
+                 site.hold_ns_ / 1e3 / site.acquisitions_, (unsigned long) site.sleeps_,
+                 (site.sleeps_ == 0) ? 0.0 : site.sleep_ns_ / 1e3 / site.sleeps_,
+                 (unsigned long) site.wakeups_, (unsigned long) site.futile_wakeups_);
+      }
+      int limiting = profile.get_limiting_site();
+      fprintf(out, "%sshop mutex busy %.1f%%, limiting step: %s\n", prefix, 100.0 * profile.get_room_busy(),
+              (limiting < 0) ? "none contended" : siteName(limiting));
+   }
+
+private:
+
+   /** one thread's counters of a site, written by that thread only */
+   struct SiteCounters {
+      atomic<uint64_t> acquisitions_{0};
+      atomic<uint64_t> contended_{0};
+      atomic<uint64_t> wait_ns_{0};
+      atomic<uint64_t> hold_ns_{0};
+      atomic<uint64_t> sleeps_{0};
+      atomic<uint64_t> sleep_ns_{0};
+      atomic<uint64_t> wakeups_{0};
+      atomic<uint64_t> futile_wakeups_{0};
+
+      /** zeroes the counters */
+      void clear()
+      {
+         acquisitions_.store(0, memory_order_relaxed);
+         contended_.store(0, memory_order_relaxed);
+         wait_ns_.store(0, memory_order_relaxed);
+         hold_ns_.store(0, memory_order_relaxed);
+         sleeps_.store(0, memory_order_relaxed);
+         sleep_ns_.store(0, memory_order_relaxed);
+         wakeups_.store(0, memory_order_relaxed);
+         futile_wakeups_.store(0, memory_order_relaxed);
+      }
+
+      /** adds the counters to stats */
+      void addTo(LockSiteStats* stats) const
+      {
+         stats->acquisitions_ += acquisitions_.load(memory_order_relaxed);
+         stats->contended_ += contended_.load(memory_order_relaxed);
+         stats->wait_ns_ += wait_ns_.load(memory_order_relaxed);
+         stats->hold_ns_ += hold_ns_.load(memory_order_relaxed);
+         stats->sleeps_ += sleeps_.load(memory_order_relaxed);
+         stats->sleep_ns_ += sleep_ns_.load(memory_order_relaxed);
+         stats->wakeups_ += wakeups_.load(memory_order_relaxed);
+         stats->futile_wakeups_ += futile_wakeups_.load(memory_order_relaxed);
+      }
+   };
+
+   /** counters of one thread and the time it took each site's mutex */
+   struct ThreadSites {
+      SiteCounters counters_[kNumLockSites];
+      uint64_t acquired_ns_[kNumLockSites];
+   };
+
+   /** folds the calling thread's counters into exited_ once its thread exits */
+   struct SitesOwner {
+      ThreadSites* sites_{NULL};
+      ~SitesOwner()
+      {
+         if (sites_ != NULL) {
+            LockProfiler::instance().unregisterThread(sites_);
+         }
+      }
+   };
+
+   /** counters of every live thread that has taken a profiled mutex */
+   vector<ThreadSites*> threads_;
+   /** counters of the threads that exited */
+   LockSiteStats exited_[kNumLockSites];
+   /** time of the last reset */
+   uint64_t start_ns_;
+   /** guards every field above */
+   pthread_mutex_t threads_mutex_;
+
+   /**
+    * Creates the profiler with every counter zero.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  profiler empty
+    **/
+   LockProfiler() : start_ns_(monotonicNs())
+   {
+      pthread_mutex_init(&threads_mutex_, NULL);
+   }
+
+   /**
+    * Adds to a counter only the calling thread writes.
+    * No other methods are called.
+    * @param counter counter of the calling thread
+    * @param value amount to add
+    * @return none
+    * @custom.preconditions  counter belongs to the calling thread
+    * @custom.postconditions  counter increased
+    **/
+   static void add(atomic<uint64_t>& counter, uint64_t value)
+   {
+      counter.store(counter.load(memory_order_relaxed) + value, memory_order_relaxed);
+   }
+
+   /**
+    * This returns the calling thread's counters, registering them on
+    * first use.
+    * No other methods are called.
+    * @return counters of the calling thread
+    * @custom.preconditions  none
+    * @custom.postconditions  counters visible to get_profile
+    **/
+   ThreadSites* threadSites()
+   {
+      static thread_local SitesOwner owner;
+      if (owner.sites_ == NULL) {
+         owner.sites_ = new ThreadSites();
+         pthread_mutex_lock(&threads_mutex_);
+         threads_.push_back(owner.sites_);
+         pthread_mutex_unlock(&threads_mutex_);
+      }
+      return owner.sites_;
+   }
+
+   /**
+    * Folds an exiting thread's counters into exited_ and frees them.
+    * No other methods are called.
+    * @param sites counters of the exiting thread
+    * @return none
+    * @custom.preconditions  sites registered by threadSites
+    * @custom.postconditions  sites freed, its counts kept
+    **/
+   void unregisterThread(ThreadSites* sites)
+   {
+      pthread_mutex_lock(&threads_mutex_);
+      for (int s = 0; s < kNumLockSites; s++) {
+         sites->counters_[s].addTo(&exited_[s]);
+      }
+      for (size_t i = 0; i < threads_.size(); i++) {
+         if (threads_[i] == sites) {
+            threads_[i] = threads_.back();
+            threads_.pop_back();
+            break;
+         }
+      }
+      pthread_mutex_unlock(&threads_mutex_);
+      delete sites;
+   }
+};
+
+/** profiled or plain lock, unlock and wait of a handshake site */
+#if SHOP_PROFILE_LOCKS
+#define SHOP_LOCK(site, mutex) LockProfiler::instance().lock((site), (mutex))
+#define SHOP_UNLOCK(site, mutex) LockProfiler::instance().unlock((site), (mutex))
+#define SHOP_WAIT(site, cond, mutex, ...) LockProfiler::instance().wait((site), (cond), (mutex), __VA_ARGS__)
+#else
+/** the site still counts as used, a site passed in as a parameter included */
+#define SHOP_LOCK(site, mutex) ((void) (site), pthread_mutex_lock(mutex))
+#define SHOP_UNLOCK(site, mutex) ((void) (site), pthread_mutex_unlock(mutex))
+#define SHOP_WAIT(site, cond, mutex, ...) ((void) (site), ShopWait::wait((cond), (mutex), __VA_ARGS__))
+#endif
+#endif
@@ -0,0 +1,348 @@
+/**
+ * PipelineShop.cpp
+ *
+ * This is the PipelineShop.cpp file that implements the methods of the
+ * PipelineShop class. Each stage's queue is a ring guarded by the
+ * stage's mutex, and customers park on their job through ShopWait.
+ **/
+#include "PipelineShop.h"
+#include <unistd.h>
+#include "Clock.h"
+#include "Futex.h"
+#include "WaitStrategy.h"
+
+/**
+ * Creates the stages and starts the worker threads of every stage.
+ * No other methods are called.
+ * @param stages settings of the stages in the order customers pass them
+ * @return none
+ * @custom.preconditions  at least one stage, every stage has a worker
+ *                        and queue_capacity_ >= 0
+ * @custom.postconditions  every worker waiting for a customer
+ **/
+PipelineShop::PipelineShop(const vector<PipelineStageOptions>& stages) :
+   arrivals_(0), cust_drops_(0), stopped_(false)
+{
+   pthread_mutex_init(&jobs_mutex_, NULL);
+   int seed_offset = 0;
+   for (size_t s = 0; s < stages.size(); s++) {
+      Stage* stage = new Stage();
+      stage->options_ = stages[s];
+      if (stage->options_.workers_ < 1) {
+         stage->options_.workers_ = 1;
+      }
+      if (stage->options_.queue_capacity_ < 0) {
+         stage->options_.queue_capacity_ = 0;
+      }
+      /** waiting workers can be handed customers beyond the capacity */
+      stage->size_ = stage->options_.queue_capacity_ + stage->options_.workers_;
+      stage->ring_ = new Job*[stage->size_];
+      stage->head_ = 0;
+      stage->count_ = 0;
+      stage->idle_ = 0;
+      stage->closed_ = false;
+      pthread_mutex_init(&stage->mutex_, NULL);
+      pthread_cond_init(&stage->cond_not_empty_, NULL);
+      pthread_cond_init(&stage->cond_not_full_, NULL);
+      stages_.push_back(stage);
+   }
+   for (size_t s = 0; s < stages_.size(); s++) {
+      Stage* stage = stages_[s];
+      for (int i = 0; i < stage->options_.workers_; i++) {
+         ServiceOptions service = stage->options_.service_;
+         service.seed_ += seed_offset++;
+         Worker* worker = new Worker();
+         worker->shop_ = this;
+         worker->stage_ = (int) s;
+         worker->id_ = i;
+         worker->service_ = new ServiceTime(service);
+         stage->workers_.push_back(worker);
+         pthread_create(&worker->thread_, NULL, PipelineShop::worker, worker);
+      }
+   }
+}
+
+/**
+ * Destructor for PipelineShop class. Stops the shop if stop has not
+ * been called yet.
+ * Calls stop method.
+ * @return none
+ * @custom.preconditions  no customer is in the shop
+ * @custom.postconditions  every thread joined
+ **/
+PipelineShop::~PipelineShop()
+{
+   stop();
+   for (size_t s = 0; s < stages_.size(); s++) {
+      Stage* stage = stages_[s];
+      for (size_t i = 0; i < stage->workers_.size(); i++) {
+         delete stage->workers_[i]->service_;
+         delete stage->workers_[i];
+      }
+      pthread_cond_destroy(&stage->cond_not_full_);
+      pthread_cond_destroy(&stage->cond_not_empty_);
+      pthread_mutex_destroy(&stage->mutex_);
+      delete[] stage->ring_;
+      delete stage;
+   }
+   pthread_mutex_destroy(&jobs_mutex_);
+}
+
+/**
+ * Closes the shop stage by stage, letting every customer inside pass
+ * the remaining stages, and joins all worker threads. Customers
+ * arriving afterwards leave without service.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  no customer is visiting concurrently
+ * @custom.postconditions  every worker thread joined
+ **/
+void PipelineShop::stop()
+{
+   if (stopped_) {
+      return;
+   }
+   stopped_ = true;
+   /** a stage closes once the stage before it can hand it nobody more */
+   for (size_t s = 0; s < stages_.size(); s++) {
+      Stage* stage = stages_[s];
+      pthread_mutex_lock(&stage->mutex_);
+      stage->closed_ = true;
+      pthread_cond_broadcast(&stage->cond_not_empty_);
+      pthread_cond_broadcast(&stage->cond_not_full_);
+      pthread_mutex_unlock(&stage->mutex_);
+      for (size_t i = 0; i < stage->workers_.size(); i++) {
+         pthread_join(stage->workers_[i]->thread_, NULL);
+      }
+   }
+}
+
+/**
+ * This is to be called by the customer threads to visit the shop. The
+ * customer leaves if the first stage's queue is full, otherwise it
+ * waits until a worker of the first stage starts on it.
+ * No other methods are called.
+ * @param id id of the visiting customer
+ * @return id of the first stage's worker, -1 if they leave without service
+ * @custom.preconditions  no customer with the same id is in the shop
+ * @custom.postconditions  customer thread possibly in service
+ **/
+int PipelineShop::visitShop(int id)
+{
+   arrivals_.fetch_add(1, memory_order_relaxed);
+   Job* job = new Job();
+   job->customer_id_ = id;
+   if (!push(stages_[0], job, false)) {
+      ++cust_drops_;
+      delete job;
+      return -1;
+   }
+   pthread_mutex_lock(&jobs_mutex_);
+   jobs_[id] = job;
+   pthread_mutex_unlock(&jobs_mutex_);
+   ShopWait::waitWhile(&job->worker_id_, -1);
+   return job->worker_id_.load(memory_order_acquire);
+}
+
+/**
+ * This is to be called by the customer threads that visitShop let in.
+ * Waits until the customer has passed the last stage.
+ * No other methods are called.
+ * @param customer_id id of the customer
+ * @param worker_id id returned by visitShop
+ * @return none
+ * @custom.preconditions  visitShop returned worker_id for customer_id
+ * @custom.postconditions  customer thread service is completed
+ **/
+void PipelineShop::leaveShop(int customer_id, int worker_id)
+{
+   pthread_mutex_lock(&jobs_mutex_);
+   map<int, Job*>::iterator it = jobs_.find(customer_id);
+   Job* job = (it != jobs_.end() && it->second->worker_id_.load(memory_order_acquire) == worker_id) ?
+      it->second : NULL;
+   if (job != NULL) {
+      jobs_.erase(it);
+   }
+   pthread_mutex_unlock(&jobs_mutex_);
+   /** a customer visitShop did not let in has nothing to wait for */
+   if (job == NULL) {
+      return;
+   }
+   ShopWait::waitWhile(&job->done_, 0);
+   delete job;
+}
+
+/**
+ * Entry point of the worker threads. Serves the stage's customers and
+ * hands them on until the stage closes and its queue is empty.
+ * Calls pop and push methods.
+ * @param arg the Worker the thread runs as
+ * @return none
+ * @custom.preconditions  arg points to a worker of a live shop
+ * @custom.postconditions  thread exits once its stage is drained
+ **/
+void* PipelineShop::worker(void* arg)
+{
+   Worker* self = (Worker*) arg;
+   PipelineShop* shop = self->shop_;
+   Stage* stage = shop->stages_[self->stage_];
+   Stage* next = (self->stage_ + 1 < (int) shop->stages_.size()) ? shop->stages_[self->stage_ + 1] : NULL;
+
+   uint64_t idle_start_ns = monotonicNs();
+   Job* job;
+   while ((job = pop(stage)) != NULL) {
+      uint64_t start_ns = monotonicNs();
+      self->idle_ns_.store(self->idle_ns_.load(memory_order_relaxed) + (start_ns - idle_start_ns),
+                           memory_order_relaxed);
+      self->queue_wait_.record(start_ns - job->enqueued_ns_);
+      if (self->stage_ == 0) {
+         job->worker_id_.store(self->id_, memory_order_release);
+         futexWake(&job->worker_id_, 1);
+      }
+
+      usleep(self->service_->next());
+      uint64_t done_ns = monotonicNs();
+      self->service_time_.record(done_ns - start_ns);
+      self->busy_ns_.store(self->busy_ns_.load(memory_order_relaxed) + (done_ns - start_ns),
+                           memory_order_relaxed);
+      self->served_.store(self->served_.load(memory_order_relaxed) + 1, memory_order_relaxed);
+
+      if (next != NULL) {
+         /** hold the customer until the next stage has room for it */
+         push(next, job, true);
+         idle_start_ns = monotonicNs();
+         self->blocked_ns_.store(self->blocked_ns_.load(memory_order_relaxed) + (idle_start_ns - done_ns),
+                                 memory_order_relaxed);
+      } else {
+         /** the job may vanish once done_ is set, waking it late is harmless */
+         job->done_.store(1, memory_order_release);
+         futexWake(&job->done_, 1);
+         idle_start_ns = done_ns;
+      }
+   }
+   return nullptr;
+}
+
+/**
+ * Puts a customer in the queue of a stage. A customer is let in while
+ * the queue has room or a worker waits for one.
+ * No other methods are called.
+ * @param stage stage to join
+ * @param job customer joining it
+ * @param wait true to wait for room, false to give up at once
+ * @return false if the queue was full and wait is false, or the stage is closed
+ * @custom.preconditions  none
+ * @custom.postconditions  customer queued on success
+ **/
+bool PipelineShop::push(Stage* stage, Job* job, bool wait)
+{
+   pthread_mutex_lock(&stage->mutex_);
+   while (!stage->closed_ && stage->count_ >= stage->options_.queue_capacity_ + stage->idle_) {
+      if (!wait) {
+         pthread_mutex_unlock(&stage->mutex_);
+         return false;
+      }
+      pthread_cond_wait(&stage->cond_not_full_, &stage->mutex_);
+   }
+   if (stage->closed_) {
+      pthread_mutex_unlock(&stage->mutex_);
+      return false;
+   }
+   job->enqueued_ns_ = monotonicNs();
+   stage->ring_[(stage->head_ + stage->count_) % stage->size_] = job;
+   ++stage->count_;
+   pthread_cond_signal(&stage->cond_not_empty_);
+   pthread_mutex_unlock(&stage->mutex_);
+   return true;
+}
+
+/**
+ * Takes the oldest customer off the queue of a stage, waiting for one.
+ * No other methods are called.
+ * @param stage stage of the calling worker
+ * @return customer, NULL once the stage is closed and empty
+ * @custom.preconditions  called by a worker of the stage
+ * @custom.postconditions  customer off the queue
+ **/
+PipelineShop::Job* PipelineShop::pop(Stage* stage)
+{
+   pthread_mutex_lock(&stage->mutex_);
+   if (stage->count_ == 0 && !stage->closed_) {
+      /** a waiting worker makes room for one more customer */
+      ++stage->idle_;
+      pthread_cond_signal(&stage->cond_not_full_);
+      while (stage->count_ == 0 && !stage->closed_) {
+         pthread_cond_wait(&stage->cond_not_empty_, &stage->mutex_);
+      }
+      --stage->idle_;
+   }
+   if (stage->count_ == 0) {
+      pthread_mutex_unlock(&stage->mutex_);
+      return NULL;
+   }
+   Job* job = stage->ring_[stage->head_];
+   stage->head_ = (stage->head_ + 1) % stage->size_;
+   --stage->count_;
+   pthread_cond_signal(&stage->cond_not_full_);
+   pthread_mutex_unlock(&stage->mutex_);
+   return job;
+}
+
+/**
+ * This returns the number of customers that found the first queue full.
+ * No other methods are called.
+ * @return number of customers that left without being serviced
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int PipelineShop::get_cust_drops() const
+{
+   return cust_drops_.load();
+}
+
+/**
+ * This returns the number of stages.
+ * No other methods are called.
+ * @return number of stages
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int PipelineShop::get_num_stages() const
+{
+   return (int) stages_.size();
+}
+
+/**
+ * This returns the shop's statistics, merged from every worker. Safe
+ * to call while the shop is running.
+ * No other methods are called.
+ * @return statistics recorded so far
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+PipelineStats PipelineShop::get_stats() const
+{
+   PipelineStats stats;
+   stats.arrivals_ = arrivals_.load();
+   stats.drops_ = cust_drops_.load();
+   stats.stages_.resize(stages_.size());
+   for (size_t s = 0; s < stages_.size(); s++) {
+      const Stage* stage = stages_[s];
+      StageStats& out = stats.stages_[s];
+      out.name_ = stage->options_.name_;
+      out.workers_ = stage->options_.workers_;
+      for (size_t i = 0; i < stage->workers_.size(); i++) {
+         const Worker* worker = stage->workers_[i];
+         out.served_ += worker->served_.load();
+         out.busy_ns_ += worker->busy_ns_.load();
+         out.blocked_ns_ += worker->blocked_ns_.load();
+         out.idle_ns_ += worker->idle_ns_.load();
+         out.queue_wait_.merge(worker->queue_wait_);
+         out.service_.merge(worker->service_time_);
+      }
+   }
+   if (!stats.stages_.empty()) {
+      stats.served_ = stats.stages_.back().served_;
+   }
+   return stats;
+}
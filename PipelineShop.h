@@ -0,0 +1,346 @@
+/**
+ * PipelineShop.h
+ *
+ * This is the PipelineShop.h file that defines the PipelineShop class, a
+ * shop where a customer passes through several stages in order, for
+ * example wash, cut and checkout, instead of being served and paid by a
+ * single barber. Every stage has its own pool of workers and its own
+ * bounded queue, and the shop runs the worker threads itself.
+ *
+ * A worker takes the oldest customer off its stage's queue, serves it
+ * for a duration drawn from the stage's ServiceTime and hands it on to
+ * the next stage's queue, so a cutter is free again as soon as the
+ * customer moves to checkout instead of waiting to be paid. A worker
+ * whose next queue is full holds on to its customer and waits, blocked,
+ * until the next stage takes it, which fills its own queue in turn: a
+ * slow stage pushes back up the line until arriving customers find the
+ * first queue full and leave.
+ *
+ * A queue of capacity 0 only hands a customer to a worker that is
+ * waiting for one. The first stage's queue is the waiting room.
+ *
+ * Customers use the same calls as with a Shop: visitShop returns once a
+ * worker of the first stage started on the customer, and leaveShop once
+ * the last stage is done. get_stats reports every stage's utilization,
+ * the time its workers spent blocked by the stage after them and the
+ * stage with the least capacity, which bounds the shop's throughput.
+ **/
+#ifndef PIPELINE_SHOP_H_
+#define PIPELINE_SHOP_H_
+#include <pthread.h>
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+#include "Histogram.h"
+#include "ServiceTime.h"
+using namespace std;
+
+/** settings of one stage of a PipelineShop */
+struct PipelineStageOptions {
+   /** name the stage is reported by */
+   string name_{"stage"};
+   /** number of workers of the stage */
+   int workers_{1};
+   /** customers that may wait for the stage, the waiting chairs of the
+    *  first stage */
+   int queue_capacity_{2};
+   /** durations of the stage's work, every worker seeded apart */
+   ServiceOptions service_;
+};
+
+/** statistics of one stage of a PipelineShop */
+struct StageStats {
+   /** name of the stage */
+   string name_;
+   /** number of workers of the stage */
+   int workers_{0};
+   /** number of customers the stage finished */
+   long served_{0};
+   /** time the workers spent serving customers */
+   uint64_t busy_ns_{0};
+   /** time the workers spent holding a finished customer because the
+    *  next stage's queue was full */
+   uint64_t blocked_ns_{0};
+   /** time the workers spent waiting for a customer */
+   uint64_t idle_ns_{0};
+   /** time from entering the stage's queue until a worker took the customer */
+   Histogram queue_wait_;
+   /** time a worker spent serving a customer */
+   Histogram service_;
+
+   /**
+    * This returns the fraction of the workers' accounted time spent serving.
+    * No other methods are called.
+    * @return busy / (busy + blocked + idle), 0 if nothing was accounted yet
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_utilization() const
+   {
+      uint64_t accounted = busy_ns_ + blocked_ns_ + idle_ns_;
+      return (accounted == 0) ? 0.0 : (double) busy_ns_ / accounted;
+   }
+
+   /**
+    * This returns the fraction of the workers' accounted time spent blocked.
+    * No other methods are called.
+    * @return blocked / (busy + blocked + idle), 0 if nothing was accounted yet
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_blocked() const
+   {
+      uint64_t accounted = busy_ns_ + blocked_ns_ + idle_ns_;
+      return (accounted == 0) ? 0.0 : (double) blocked_ns_ / accounted;
+   }
+
+   /**
+    * This returns the most customers per second the stage can serve,
+    * from the mean service time measured so far.
+    * No other methods are called.
+    * @return workers over mean service time, 0 before the first customer
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_capacity() const
+   {
+      double mean_ns = service_.get_mean();
+      return (service_.get_count() == 0 || mean_ns <= 0) ? 0.0 : workers_ * 1e9 / mean_ns;
+   }
+};
+
+/** statistics of a PipelineShop */
+struct PipelineStats {
+   /** number of customers that entered visitShop */
+   long arrivals_{0};
+   /** number of customers the last stage finished */
+   long served_{0};
+   /** number of customers that found the first queue full */
+   long drops_{0};
+   /** every stage in order */
+   vector<StageStats> stages_;
+
+   /**
+    * This returns the stage that limits the shop's throughput, the one
+    * with the least capacity.
+    * Calls StageStats::get_capacity method.
+    * @return index of the stage, -1 if no stage served anyone yet
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_bottleneck() const
+   {
+      int bottleneck = -1;
+      for (size_t s = 0; s < stages_.size(); s++) {
+         double capacity = stages_[s].get_capacity();
+         if (capacity > 0 && (bottleneck < 0 || capacity < stages_[bottleneck].get_capacity())) {
+            bottleneck = (int) s;
+         }
+      }
+      return bottleneck;
+   }
+};
+
+class PipelineShop
+{
+public:
+
+   /**
+    * Creates the stages and starts the worker threads of every stage.
+    * No other methods are called.
+    * @param stages settings of the stages in the order customers pass them
+    * @return none
+    * @custom.preconditions  at least one stage, every stage has a worker
+    *                        and queue_capacity_ >= 0
+    * @custom.postconditions  every worker waiting for a customer
+    **/
+   explicit PipelineShop(const vector<PipelineStageOptions>& stages);
+
+   /**
+    * Destructor for PipelineShop class. Stops the shop if stop has not
+    * been called yet.
+    * Calls stop method.
+    * @return none
+    * @custom.preconditions  no customer is in the shop
+    * @custom.postconditions  every thread joined
+    **/
+   ~PipelineShop();
+
+   /**
+    * This is to be called by the customer threads to visit the shop. The
+    * customer leaves if the first stage's queue is full, otherwise it
+    * waits until a worker of the first stage starts on it.
+    * No other methods are called.
+    * @param id id of the visiting customer
+    * @return id of the first stage's worker, -1 if they leave without service
+    * @custom.preconditions  no customer with the same id is in the shop
+    * @custom.postconditions  customer thread possibly in service
+    **/
+   int visitShop(int id);
+
+   /**
+    * This is to be called by the customer threads that visitShop let in.
+    * Waits until the customer has passed the last stage.
+    * No other methods are called.
+    * @param customer_id id of the customer
+    * @param worker_id id returned by visitShop
+    * @return none
+    * @custom.preconditions  visitShop returned worker_id for customer_id
+    * @custom.postconditions  customer thread service is completed
+    **/
+   void leaveShop(int customer_id, int worker_id);
+
+   /**
+    * Closes the shop stage by stage, letting every customer inside pass
+    * the remaining stages, and joins all worker threads. Customers
+    * arriving afterwards leave without service.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  no customer is visiting concurrently
+    * @custom.postconditions  every worker thread joined
+    **/
+   void stop();
+
+   /**
+    * This returns the number of customers that found the first queue full.
+    * No other methods are called.
+    * @return number of customers that left without being serviced
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_cust_drops() const;
+
+   /**
+    * This returns the number of stages.
+    * No other methods are called.
+    * @return number of stages
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_num_stages() const;
+
+   /**
+    * This returns the shop's statistics, merged from every worker. Safe
+    * to call while the shop is running.
+    * No other methods are called.
+    * @return statistics recorded so far
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   PipelineStats get_stats() const;
+
+private:
+
+   /**
+    * A customer passing through the stages. It is kept in jobs_ under
+    * the customer's id from visitShop until leaveShop.
+    */
+   struct Job {
+      /** unique id of the customer */
+      int customer_id_{0};
+      /** id of the first stage's worker, -1 until one starts on the customer */
+      atomic<int> worker_id_{-1};
+      /** 1 once the last stage is done, the customer parks on it */
+      atomic<int> done_{0};
+      /** time the customer entered the queue of its current stage */
+      uint64_t enqueued_ns_{0};
+   };
+
+   /** worker thread of a stage and the times only it records */
+   struct Worker {
+      /** shop the worker belongs to */
+      PipelineShop* shop_;
+      /** index of the worker's stage */
+      int stage_;
+      /** id of the worker within its stage */
+      int id_;
+      /** thread handle */
+      pthread_t thread_;
+      /** durations of the worker's services */
+      ServiceTime* service_;
+      /** number of customers the worker finished */
+      atomic<long> served_{0};
+      /** time spent serving, blocked by the next stage and waiting */
+      atomic<uint64_t> busy_ns_{0};
+      atomic<uint64_t> blocked_ns_{0};
+      atomic<uint64_t> idle_ns_{0};
+      /** queue wait of the customers the worker took */
+      Histogram queue_wait_;
+      /** service time of the customers the worker served */
+      Histogram service_time_;
+   };
+
+   /** a stage, its bounded queue and its workers */
+   struct Stage {
+      /** settings of the stage */
+      PipelineStageOptions options_;
+      /** ring of the waiting customers, capacity plus one per worker */
+      Job** ring_;
+      int size_;
+      /** index of the oldest waiting customer and number waiting */
+      int head_;
+      int count_;
+      /** number of workers waiting for a customer */
+      int idle_;
+      /** true once the stage takes no more customers */
+      bool closed_;
+      /** guards every field above */
+      pthread_mutex_t mutex_;
+      /** signaled when a customer joins the queue or the stage closes */
+      pthread_cond_t cond_not_empty_;
+      /** signaled when the queue has room or a worker waits */
+      pthread_cond_t cond_not_full_;
+      /** workers of the stage */
+      vector<Worker*> workers_;
+   };
+
+   /** the stages in order */
+   vector<Stage*> stages_;
+   /** number of customers that entered visitShop */
+   atomic<long> arrivals_;
+   /** number of customers that found the first queue full */
+   atomic<int> cust_drops_;
+   /** true once stop was called */
+   bool stopped_;
+   /** customers between visitShop and leaveShop by id */
+   map<int, Job*> jobs_;
+   /** guards jobs_ */
+   pthread_mutex_t jobs_mutex_;
+
+   /**
+    * Entry point of the worker threads. Serves the stage's customers and
+    * hands them on until the stage closes and its queue is empty.
+    * Calls pop and push methods.
+    * @param arg the Worker the thread runs as
+    * @return none
+    * @custom.preconditions  arg points to a worker of a live shop
+    * @custom.postconditions  thread exits once its stage is drained
+    **/
+   static void* worker(void* arg);
+
+   /**
+    * Puts a customer in the queue of a stage. A customer is let in while
+    * the queue has room or a worker waits for one.
+    * No other methods are called.
+    * @param stage stage to join
+    * @param job customer joining it
+    * @param wait true to wait for room, false to give up at once
+    * @return false if the queue was full and wait is false, or the stage is closed
+    * @custom.preconditions  none
+    * @custom.postconditions  customer queued on success
+    **/
+   static bool push(Stage* stage, Job* job, bool wait);
+
+   /**
+    * Takes the oldest customer off the queue of a stage, waiting for one.
+    * No other methods are called.
+    * @param stage stage of the calling worker
+    * @return customer, NULL once the stage is closed and empty
+    * @custom.preconditions  called by a worker of the stage
+    * @custom.postconditions  customer off the queue
+    **/
+   static Job* pop(Stage* stage);
+};
+#endif
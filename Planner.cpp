@@ -0,0 +1,380 @@
+/**
+ * Planner.cpp
+ *
+ * This is the Planner.cpp file that sizes a shop for a load. Given the
+ * arrival rate, the hair-cut duration and a service level objective, a
+ * drop rate and a p99 queue wait not to exceed, it finds the cheapest
+ * number of barbers and waiting chairs that meets the objective, a
+ * barber and a chair each having a cost.
+ *
+ * Every configuration up to --max-barbers and --max-chairs is first
+ * solved as an M/M/c/K queue (QueueModel). Configurations the model says
+ * miss the objective by more than --slack times are pruned, and the rest
+ * are measured, cheapest first, in batches of --jobs: each job runs its
+ * configuration on a Shop of its own with its own barber threads and
+ * CustomerExecutor, fed by the same seeded arrivals. The cheapest
+ * configuration of the first batch that meets the objective when measured
+ * is the answer, since every configuration left is at least as costly.
+ * A measured miss also rules out the configurations that cannot do
+ * better: one whose p99 wait is too long rules out those with as many
+ * chairs or more and no more barbers, one that drops too many rules out
+ * those with no more chairs and no more barbers.
+ * Every measured configuration is printed with the model's prediction
+ * next to the measurement.
+ *
+ * Jobs share the machine's cores with each other, so the default is one
+ * job per core; with fewer cores than barbers the measured waits grow.
+ *
+ * Usage: shopPlanner [--rate 2000] [--service 100]
+ *        [--service-dist fixed|exp|lognormal] [--customers 20000]
+ *        [--drop-slo 0.1] [--wait-slo 1000] [--max-barbers 16]
+ *        [--max-chairs 32] [--barber-cost 10] [--chair-cost 1]
+ *        [--slack 2] [--jobs N] [--seed 1]
+ **/
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "Shop.h"
+#include "CustomerExecutor.h"
+#include "ArrivalProcess.h"
+#include "ServiceTime.h"
+#include "QueueModel.h"
+#include "Affinity.h"
+using namespace std;
+
+/** settings of a planning run */
+struct PlannerSettings {
+   /** customers arriving per second */
+   double arrival_rate{2000};
+   /** hair-cut durations, mean_us_ being the mean */
+   ServiceOptions service;
+   /** customers per measured run */
+   long num_customers{20000};
+   /** most dropped customers allowed, in percent */
+   double drop_slo{0.1};
+   /** longest p99 queue wait allowed, in μ seconds */
+   double wait_slo{1000};
+   int max_barbers{16};
+   int max_chairs{32};
+   double barber_cost{10};
+   double chair_cost{1};
+   /** factor by which the model may miss the objective before pruning */
+   double slack{2};
+   int jobs{1};
+   unsigned long seed{1};
+};
+
+/** one configuration of the search */
+struct Candidate {
+   int num_barbers;
+   int num_chairs;
+   double cost;
+   /** model predictions, drop rate in percent, wait in μ seconds */
+   double predicted_drop;
+   double predicted_p99;
+   /** measurements */
+   double measured_drop;
+   double measured_p99;
+   double measured_utilization;
+   bool meets_slo;
+   /** true once a measured miss rules the candidate out */
+   bool dominated;
+};
+
+/** a batch of candidates measured by the jobs */
+struct MeasureBatch {
+   const PlannerSettings* settings;
+   vector<Candidate*> candidates;
+   /** next candidate to be taken by a job */
+   size_t next;
+   pthread_mutex_t mutex;
+};
+
+/** method called by barber threads */
+static void* barber(void* arg);
+/** method called by job threads */
+static void* measureJob(void* arg);
+/** runs one candidate on a fresh shop */
+static void measure(const PlannerSettings& settings, Candidate* candidate);
+
+/** parameters of a planner barber thread */
+struct BarberParam {
+   Shop* shop;
+   int id;
+   ServiceTime* service;
+};
+
+/**
+ * Parses the command line, prunes the configurations with the model,
+ * measures the rest cheapest first and reports the cheapest one that
+ * meets the objective.
+ * Calls measureJob method.
+ * @return 0 if a configuration meets the objective, 1 if none does, -1
+ *         on bad arguments
+ * @custom.preconditions  none
+ * @custom.postconditions  plan written to stdout
+ **/
+int main(int argc, char *argv[])
+{
+   PlannerSettings settings;
+   settings.service.kind_ = kExponentialService;
+   settings.jobs = cpuCount();
+
+   for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      if (i + 1 >= argc) {
+         cerr << "missing value for " << arg << endl;
+         return -1;
+      }
+      const char* value = argv[++i];
+      if (arg == "--rate") {
+         settings.arrival_rate = atof(value);
+      } else if (arg == "--service") {
+         settings.service.mean_us_ = atof(value);
+      } else if (arg == "--service-dist") {
+         string kind = value;
+         settings.service.kind_ = (kind == "fixed") ? kFixedService :
+                                  (kind == "lognormal") ? kLognormalService : kExponentialService;
+      } else if (arg == "--customers") {
+         settings.num_customers = atol(value);
+      } else if (arg == "--drop-slo") {
+         settings.drop_slo = atof(value);
+      } else if (arg == "--wait-slo") {
+         settings.wait_slo = atof(value);
+      } else if (arg == "--max-barbers") {
+         settings.max_barbers = atoi(value);
+      } else if (arg == "--max-chairs") {
+         settings.max_chairs = atoi(value);
+      } else if (arg == "--barber-cost") {
+         settings.barber_cost = atof(value);
+      } else if (arg == "--chair-cost") {
+         settings.chair_cost = atof(value);
+      } else if (arg == "--slack") {
+         settings.slack = atof(value);
+      } else if (arg == "--jobs") {
+         settings.jobs = atoi(value);
+      } else if (arg == "--seed") {
+         settings.seed = strtoul(value, NULL, 10);
+      } else {
+         cerr << "usage: shopPlanner [--rate 2000] [--service 100] [--service-dist fixed|exp|lognormal]" << endl;
+         cerr << "       [--customers 20000] [--drop-slo 0.1] [--wait-slo 1000]" << endl;
+         cerr << "       [--max-barbers 16] [--max-chairs 32] [--barber-cost 10] [--chair-cost 1]" << endl;
+         cerr << "       [--slack 2] [--jobs N] [--seed 1]" << endl;
+         return -1;
+      }
+   }
+   if (settings.arrival_rate <= 0 || settings.service.mean_us_ <= 0 || settings.num_customers < 1 ||
+       settings.max_barbers < 1 || settings.max_chairs < 0) {
+      cerr << "rate, service, customers and max-barbers must be positive" << endl;
+      return -1;
+   }
+   if (settings.jobs < 1) {
+      settings.jobs = 1;
+   }
+   if (settings.slack < 1) {
+      settings.slack = 1;
+   }
+
+   /** solve every configuration, keep those the model does not rule out */
+   vector<Candidate> all;
+   long pruned = 0;
+   for (int b = 1; b <= settings.max_barbers; b++) {
+      for (int c = 0; c <= settings.max_chairs; c++) {
+         QueueModel model(settings.arrival_rate, settings.service.mean_us_, b, c);
+         Candidate candidate = {};
+         candidate.num_barbers = b;
+         candidate.num_chairs = c;
+         candidate.cost = b * settings.barber_cost + c * settings.chair_cost;
+         candidate.predicted_drop = 100.0 * model.get_drop_rate();
+         candidate.predicted_p99 = model.waitPercentile(99);
+         if (candidate.predicted_drop > settings.slack * settings.drop_slo ||
+             candidate.predicted_p99 > settings.slack * settings.wait_slo) {
+            pruned++;
+            continue;
+         }
+         all.push_back(candidate);
+      }
+   }
+   stable_sort(all.begin(), all.end(),
+      [](const Candidate& a, const Candidate& b) { return a.cost < b.cost; });
+
+   printf("# load %.0f/s, %s service of %.0f us, SLO drop < %.3f%% and wait p99 < %.0f us\n",
+          settings.arrival_rate,
+          (settings.service.kind_ == kFixedService) ? "fixed" :
+          (settings.service.kind_ == kLognormalService) ? "lognormal" : "exponential",
+          settings.service.mean_us_, settings.drop_slo, settings.wait_slo);
+   printf("# %ld configurations, %ld pruned by the M/M/c/K model, measuring %d at a time\n",
+          (long) all.size() + pruned, pruned, settings.jobs);
+   printf("%7s %6s %7s %10s %10s %9s %9s %6s %4s\n", "barbers", "chairs", "cost",
+          "pred_drop%", "meas_drop%", "pred_p99", "meas_p99", "util%", "slo");
+
+   MeasureBatch batch;
+   batch.settings = &settings;
+   pthread_mutex_init(&batch.mutex, NULL);
+   Candidate* best = NULL;
+   long measured = 0;
+   size_t first = 0;
+   while (best == NULL) {
+      batch.candidates.clear();
+      for (; first < all.size() && batch.candidates.size() < (size_t) settings.jobs; first++) {
+         if (!all[first].dominated) {
+            batch.candidates.push_back(&all[first]);
+         }
+      }
+      if (batch.candidates.empty()) {
+         break;
+      }
+      batch.next = 0;
+      measured += batch.candidates.size();
+
+      vector<pthread_t> jobs(batch.candidates.size());
+      for (size_t j = 0; j < jobs.size(); j++) {
+         pthread_create(&jobs[j], NULL, measureJob, &batch);
+      }
+      for (size_t j = 0; j < jobs.size(); j++) {
+         pthread_join(jobs[j], NULL);
+      }
+
+      for (size_t i = 0; i < batch.candidates.size(); i++) {
+         Candidate* candidate = batch.candidates[i];
+         printf("%7d %6d %7.1f %10.3f %10.3f %9.1f %9.1f %6.1f %4s\n", candidate->num_barbers,
+                candidate->num_chairs, candidate->cost, candidate->predicted_drop,
+                candidate->measured_drop, candidate->predicted_p99, candidate->measured_p99,
+                100.0 * candidate->measured_utilization, candidate->meets_slo ? "ok" : "miss");
+         if (candidate->meets_slo && (best == NULL || candidate->cost < best->cost)) {
+            best = candidate;
+         }
+         /** fewer barbers or more chairs only wait longer, fewer of both
+          * only drop more, so a miss rules those out unmeasured */
+         for (size_t i = first; i < all.size() && !candidate->meets_slo; i++) {
+            bool fewer_barbers = all[i].num_barbers <= candidate->num_barbers;
+            if ((candidate->measured_p99 > settings.wait_slo && fewer_barbers &&
+                 all[i].num_chairs >= candidate->num_chairs) ||
+                (candidate->measured_drop > settings.drop_slo && fewer_barbers &&
+                 all[i].num_chairs <= candidate->num_chairs)) {
+               all[i].dominated = true;
+            }
+         }
+      }
+      fflush(stdout);
+   }
+   pthread_mutex_destroy(&batch.mutex);
+   printf("# measured %ld configurations, %ld ruled out by the measurements\n", measured,
+          (long) (first - measured));
+
+   if (best == NULL) {
+      printf("# no configuration up to %d barbers and %d chairs meets the SLO\n",
+             settings.max_barbers, settings.max_chairs);
+      return 1;
+   }
+   printf("# cheapest: %d barbers, %d chairs, cost %.1f: drop %.3f%% (model %.3f%%), wait p99 %.1f us (model %.1f us)\n",
+          best->num_barbers, best->num_chairs, best->cost, best->measured_drop, best->predicted_drop,
+          best->measured_p99, best->predicted_p99);
+   return 0;
+}
+
+/**
+ * Called by job threads to measure the candidates of a batch until none
+ * is left.
+ * Calls measure method.
+ * @param arg the MeasureBatch
+ * @return none
+ * @custom.preconditions  arg stays valid until the thread is joined
+ * @custom.postconditions  candidates taken by the job measured
+ **/
+static void* measureJob(void* arg)
+{
+   MeasureBatch* batch = (MeasureBatch*) arg;
+   while (true) {
+      pthread_mutex_lock(&batch->mutex);
+      Candidate* candidate = (batch->next < batch->candidates.size()) ? batch->candidates[batch->next++] : NULL;
+      pthread_mutex_unlock(&batch->mutex);
+      if (candidate == NULL) {
+         break;
+      }
+      measure(*batch->settings, candidate);
+   }
+   return nullptr;
+}
+
+/**
+ * Runs one candidate on a fresh shop with fresh barber threads and a
+ * fresh executor, and fills in its measurements.
+ * Calls barber, CustomerExecutor and Shop methods.
+ * @param settings load and objective
+ * @param candidate configuration to run, receives the measurements
+ * @return none
+ * @custom.preconditions  candidate->num_barbers >= 1
+ * @custom.postconditions  measurements filled in, all threads joined
+ **/
+static void measure(const PlannerSettings& settings, Candidate* candidate)
+{
+   Shop* shop = new Shop(candidate->num_barbers, candidate->num_chairs, ShopOptions());
+   int num_barbers = candidate->num_barbers;
+   vector<pthread_t> barber_threads(num_barbers);
+   vector<BarberParam> barber_params(num_barbers);
+   for (int i = 0; i < num_barbers; i++) {
+      ServiceOptions service = settings.service;
+      service.seed_ = settings.seed + 2 + i;
+      barber_params[i].shop = shop;
+      barber_params[i].id = i;
+      barber_params[i].service = new ServiceTime(service);
+      pthread_create(&barber_threads[i], NULL, barber, &barber_params[i]);
+   }
+
+   int num_workers = num_barbers + candidate->num_chairs + 1;
+   CustomerExecutor* customers = new CustomerExecutor(shop, num_workers, num_workers);
+   ArrivalOptions arrival_options;
+   arrival_options.rate_ = settings.arrival_rate;
+   arrival_options.seed_ = settings.seed;
+   ArrivalProcess arrivals(arrival_options);
+   arrivals.start();
+   long submitted = 0;
+   while (submitted < settings.num_customers && arrivals.waitNext()) {
+      customers->submit((int) ++submitted);
+   }
+   customers->join();
+   shop->drain();
+
+   for (int i = 0; i < num_barbers; i++) {
+      pthread_join(barber_threads[i], NULL);
+      delete barber_params[i].service;
+   }
+
+   ShopStats stats = shop->get_stats();
+   double busy = 0;
+   for (size_t i = 0; i < stats.barbers_.size(); i++) {
+      busy += stats.barbers_[i].get_utilization();
+   }
+   candidate->measured_drop = (submitted == 0) ? 0.0 : 100.0 * shop->get_cust_drops() / submitted;
+   candidate->measured_p99 = stats.queue_wait_.percentile(99) / 1e3;
+   candidate->measured_utilization = stats.barbers_.empty() ? 0.0 : busy / stats.barbers_.size();
+   candidate->meets_slo = candidate->measured_drop <= settings.drop_slo &&
+                          candidate->measured_p99 <= settings.wait_slo;
+   delete customers;
+   delete shop;
+}
+
+/**
+ * Called by barber threads of a measured run to service customers until
+ * the run drains the shop.
+ * Calls the helloCustomer and byeCustomer methods in Shop class.
+ * @param arg BarberParam with the barber's shop, id and service times
+ * @return none
+ * @custom.preconditions  arg stays valid until the thread is joined
+ * @custom.postconditions  barber services customers until the shop closes
+ **/
+static void* barber(void* arg)
+{
+   BarberParam* param = (BarberParam*) arg;
+   while (param->shop->helloCustomer(param->id)) {
+      usleep(param->service->next());
+      param->shop->byeCustomer(param->id);
+   }
+   return nullptr;
+}
@@ -0,0 +1,159 @@
+/**
+ * QueueModel.cpp
+ *
+ * This is the QueueModel.cpp file that implements the methods of the
+ * QueueModel class. A customer let in with n >= c others in the shop
+ * waits for n - c + 1 departures at rate c mu, an Erlang wait, so the
+ * tail of the wait is a mixture of Poisson sums.
+ **/
+#include "QueueModel.h"
+#include <math.h>
+
+/**
+ * Solves the model of a shop.
+ * No other methods are called.
+ * @param arrival_rate customers arriving per second
+ * @param service_us mean hair-cut duration in μ seconds
+ * @param num_barbers number of barbers
+ * @param num_chairs number of waiting chairs
+ * @return none
+ * @custom.preconditions  arrival_rate > 0, service_us > 0,
+ *                        num_barbers >= 1, num_chairs >= 0
+ * @custom.postconditions  state probabilities computed
+ **/
+QueueModel::QueueModel(double arrival_rate, double service_us, int num_barbers, int num_chairs) :
+   lambda_(arrival_rate / 1e6), mu_(1.0 / service_us), c_(num_barbers), k_(num_barbers + num_chairs),
+   p_(num_barbers + num_chairs + 1)
+{
+   /** log of the unnormalized probabilities, a^n / n! up to c and
+    * a^c / c! (a / c)^(n - c) beyond */
+   double log_a = log(lambda_ / mu_);
+   double log_max = 0;
+   for (int n = 0; n <= k_; n++) {
+      p_[n] = (n <= c_) ? n * log_a - lgamma(n + 1.0)
+                        : c_ * log_a - lgamma(c_ + 1.0) + (n - c_) * (log_a - log((double) c_));
+      if (n == 0 || p_[n] > log_max) {
+         log_max = p_[n];
+      }
+   }
+   double sum = 0;
+   for (int n = 0; n <= k_; n++) {
+      p_[n] = exp(p_[n] - log_max);
+      sum += p_[n];
+   }
+   for (int n = 0; n <= k_; n++) {
+      p_[n] /= sum;
+   }
+}
+
+/**
+ * This returns the fraction of arrivals that find the shop full.
+ * No other methods are called.
+ * @return probability of balking
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+double QueueModel::get_drop_rate() const
+{
+   return p_[k_];
+}
+
+/**
+ * This returns the fraction of the time a barber is busy.
+ * No other methods are called.
+ * @return mean utilization of the barbers
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+double QueueModel::get_utilization() const
+{
+   return lambda_ * (1 - p_[k_]) / (c_ * mu_);
+}
+
+/**
+ * This returns the mean number of customers in the waiting chairs.
+ * No other methods are called.
+ * @return mean queue length
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+double QueueModel::get_mean_waiting() const
+{
+   double waiting = 0;
+   for (int n = c_ + 1; n <= k_; n++) {
+      waiting += (n - c_) * p_[n];
+   }
+   return waiting;
+}
+
+/**
+ * This returns the mean queue wait of the customers let in.
+ * Calls get_mean_waiting method.
+ * @return mean wait in μ seconds
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+double QueueModel::get_mean_wait_us() const
+{
+   double admitted = lambda_ * (1 - p_[k_]);
+   return (admitted > 0) ? get_mean_waiting() / admitted : 0.0;
+}
+
+/**
+ * This returns the probability that a customer let in waits longer
+ * than a given time.
+ * No other methods are called.
+ * @param wait_us wait in μ seconds
+ * @return P(wait > wait_us)
+ * @custom.preconditions  wait_us >= 0
+ * @custom.postconditions  none
+ **/
+double QueueModel::waitTail(double wait_us) const
+{
+   double admitted = 1 - p_[k_];
+   if (admitted <= 0) {
+      return 0.0;
+   }
+   /** P(Erlang(j + 1, c mu) > t) = P(Poisson(c mu t) <= j), summed as j
+    * grows, one Poisson term per state */
+   double x = c_ * mu_ * wait_us;
+   double poisson_cdf = 0;
+   double tail = 0;
+   for (int n = c_; n < k_; n++) {
+      int j = n - c_;
+      poisson_cdf += (x > 0) ? exp(-x + j * log(x) - lgamma(j + 1.0)) : ((j == 0) ? 1.0 : 0.0);
+      tail += p_[n] * poisson_cdf;
+   }
+   return tail / admitted;
+}
+
+/**
+ * This returns a percentile of the queue wait of the customers let in.
+ * Calls waitTail method.
+ * @param percent percentile, such as 99 or 99.9
+ * @return wait in μ seconds
+ * @custom.preconditions  0 < percent < 100
+ * @custom.postconditions  none
+ **/
+double QueueModel::waitPercentile(double percent) const
+{
+   double target = 1 - percent / 100;
+   if (waitTail(0) <= target) {
+      return 0.0;
+   }
+   double low = 0;
+   double high = 1 / mu_;
+   while (waitTail(high) > target) {
+      low = high;
+      high *= 2;
+   }
+   for (int i = 0; i < 50 && high - low > 1e-3 * high; i++) {
+      double middle = (low + high) / 2;
+      if (waitTail(middle) > target) {
+         low = middle;
+      } else {
+         high = middle;
+      }
+   }
+   return high;
+}
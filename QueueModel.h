@@ -0,0 +1,110 @@
+/**
+ * QueueModel.h
+ *
+ * This is the QueueModel.h file that defines the QueueModel class, the
+ * M/M/c/K estimate of a shop: Poisson arrivals, exponential hair-cuts,
+ * c barbers and K = c + chairs customers in the shop at most, arrivals
+ * finding it full balking. It gives the drop rate, the utilization of the
+ * barbers and the distribution of the queue wait of the customers let in,
+ * in closed form, so a capacity planner can rule out configurations
+ * without running them.
+ *
+ * The state probabilities are computed in log space, so the model stays
+ * finite for thousands of chairs and loads far above capacity. A shop
+ * with fixed hair-cuts waits less than the model says, about half as
+ * long under heavy load.
+ **/
+#ifndef QUEUE_MODEL_H_
+#define QUEUE_MODEL_H_
+#include <vector>
+using namespace std;
+
+class QueueModel
+{
+public:
+
+   /**
+    * Solves the model of a shop.
+    * No other methods are called.
+    * @param arrival_rate customers arriving per second
+    * @param service_us mean hair-cut duration in μ seconds
+    * @param num_barbers number of barbers
+    * @param num_chairs number of waiting chairs
+    * @return none
+    * @custom.preconditions  arrival_rate > 0, service_us > 0,
+    *                        num_barbers >= 1, num_chairs >= 0
+    * @custom.postconditions  state probabilities computed
+    **/
+   QueueModel(double arrival_rate, double service_us, int num_barbers, int num_chairs);
+
+   /**
+    * This returns the fraction of arrivals that find the shop full.
+    * No other methods are called.
+    * @return probability of balking
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_drop_rate() const;
+
+   /**
+    * This returns the fraction of the time a barber is busy.
+    * No other methods are called.
+    * @return mean utilization of the barbers
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_utilization() const;
+
+   /**
+    * This returns the mean number of customers in the waiting chairs.
+    * No other methods are called.
+    * @return mean queue length
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_mean_waiting() const;
+
+   /**
+    * This returns the mean queue wait of the customers let in.
+    * Calls get_mean_waiting method.
+    * @return mean wait in μ seconds
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_mean_wait_us() const;
+
+   /**
+    * This returns the probability that a customer let in waits longer
+    * than a given time.
+    * No other methods are called.
+    * @param wait_us wait in μ seconds
+    * @return P(wait > wait_us)
+    * @custom.preconditions  wait_us >= 0
+    * @custom.postconditions  none
+    **/
+   double waitTail(double wait_us) const;
+
+   /**
+    * This returns a percentile of the queue wait of the customers let in.
+    * Calls waitTail method.
+    * @param percent percentile, such as 99 or 99.9
+    * @return wait in μ seconds
+    * @custom.preconditions  0 < percent < 100
+    * @custom.postconditions  none
+    **/
+   double waitPercentile(double percent) const;
+
+private:
+
+   /** customers arriving per μ second */
+   double lambda_;
+   /** hair-cuts one barber finishes per μ second */
+   double mu_;
+   /** number of barbers */
+   int c_;
+   /** most customers in the shop */
+   int k_;
+   /** probability of n customers in the shop, 0 <= n <= k_ */
+   vector<double> p_;
+};
+#endif
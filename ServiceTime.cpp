@@ -0,0 +1,141 @@
+/**
+ * ServiceTime.cpp
+ *
+ * This is the ServiceTime.cpp file that implements the methods of the
+ * ServiceTime class. Durations are drawn at speed 1 and then divided by
+ * the barber's speed.
+ **/
+#include "ServiceTime.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/**
+ * Creates the generator and, for a trace, reads the trace file.
+ * No other methods are called.
+ * @param options distribution, its parameters and the barber's speed
+ * @return none
+ * @custom.preconditions  mean_us_ > 0 unless replaying a trace, speed_ > 0
+ * @custom.postconditions  good() tells whether the trace could be read
+ **/
+ServiceTime::ServiceTime(const ServiceOptions& options) :
+   options_(options), rng_(options.seed_), log_mean_(0), trace_next_(0), good_(true)
+{
+   if (options_.speed_ <= 0) {
+      options_.speed_ = 1.0;
+   }
+   if (options_.kind_ == kTraceService) {
+      good_ = loadTrace();
+      if (good_) {
+         trace_next_ = rng_() % trace_.size();
+      }
+   } else if (options_.kind_ == kLognormalService) {
+      /** E[exp(N(mu, sigma))] = exp(mu + sigma^2 / 2), solved for the mean */
+      log_mean_ = log(options_.mean_us_) - options_.sigma_ * options_.sigma_ / 2;
+   }
+}
+
+/**
+ * This returns the settings of fixed service of a given duration.
+ * No other methods are called.
+ * @param mean_us duration of every hair-cut in μ seconds
+ * @return settings for the constructor
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+ServiceOptions ServiceTime::fixed(double mean_us)
+{
+   ServiceOptions options;
+   options.mean_us_ = mean_us;
+   return options;
+}
+
+/**
+ * This returns false if a trace was requested but could not be read.
+ * No other methods are called.
+ * @return true if the generator can draw durations
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+bool ServiceTime::good() const
+{
+   return good_;
+}
+
+/**
+ * Reads the trace file.
+ * No other methods are called.
+ * @return false if the file could not be read or holds no durations
+ * @custom.preconditions  options_.trace_path_ != NULL
+ * @custom.postconditions  trace_ holds the durations in file order
+ **/
+bool ServiceTime::loadTrace()
+{
+   FILE* file = (options_.trace_path_ != NULL) ? fopen(options_.trace_path_, "r") : NULL;
+   if (file == NULL) {
+      return false;
+   }
+   char line[128];
+   while (fgets(line, sizeof(line), file) != NULL) {
+      if (line[0] == '#') {
+         continue;
+      }
+      char* end = NULL;
+      double duration_us = strtod(line, &end);
+      if (end != line && duration_us >= 0) {
+         trace_.push_back(duration_us);
+      }
+   }
+   fclose(file);
+   return !trace_.empty();
+}
+
+/**
+ * Draws the duration of the next hair-cut.
+ * No other methods are called.
+ * @return duration in μ seconds, divided by the speed
+ * @custom.preconditions  good()
+ * @custom.postconditions  generator advanced by one hair-cut
+ **/
+int ServiceTime::next()
+{
+   double duration_us = options_.mean_us_;
+   switch (options_.kind_) {
+   case kExponentialService:
+      duration_us = exponential_distribution<double>(1.0 / options_.mean_us_)(rng_);
+      break;
+   case kLognormalService:
+      duration_us = lognormal_distribution<double>(log_mean_, options_.sigma_)(rng_);
+      break;
+   case kTraceService:
+      if (trace_.empty()) {
+         return 0;
+      }
+      /** the trace is replayed in a loop */
+      duration_us = trace_[trace_next_];
+      trace_next_ = (trace_next_ + 1) % trace_.size();
+      break;
+   default:
+      break;
+   }
+   return (int) (duration_us / options_.speed_ + 0.5);
+}
+
+/**
+ * This returns the mean duration of the barber's hair-cuts.
+ * No other methods are called.
+ * @return mean in μ seconds, divided by the speed
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+double ServiceTime::get_mean_us() const
+{
+   if (options_.kind_ != kTraceService) {
+      return options_.mean_us_ / options_.speed_;
+   }
+   double sum = 0.0;
+   for (size_t i = 0; i < trace_.size(); i++) {
+      sum += trace_[i];
+   }
+   return trace_.empty() ? 0.0 : sum / trace_.size() / options_.speed_;
+}
@@ -0,0 +1,129 @@
+/**
+ * ServiceTime.h
+ *
+ * This is the ServiceTime.h file that defines the ServiceTime class, which
+ * draws the duration of each hair-cut of one barber. Durations come from a
+ * seeded generator, so a barber does the same work in every run:
+ *
+ * Fixed service takes exactly the mean, exponential service has
+ * exponential durations and lognormal service has lognormal durations of
+ * the given shape, scaled so their mean is the mean asked for. A trace
+ * replays durations read from a file, one duration in μ seconds per line,
+ * lines starting with # ignored, from an offset picked by the seed so
+ * barbers sharing a trace do not work in lock step.
+ *
+ * Every barber has a speed factor: a barber of speed 2 takes half as long
+ * for every hair-cut. The shop is told the same factor through
+ * Shop::set_barber_speed when it dispatches by speed.
+ **/
+#ifndef SERVICE_TIME_H_
+#define SERVICE_TIME_H_
+#include <stdint.h>
+#include <random>
+#include <vector>
+using namespace std;
+
+/** service time distributions a ServiceTime can draw from */
+enum ServiceKind {
+   /** every hair-cut takes the mean */
+   kFixedService,
+   /** exponential durations */
+   kExponentialService,
+   /** lognormal durations */
+   kLognormalService,
+   /** durations read from a trace file */
+   kTraceService
+};
+
+/** settings of a ServiceTime */
+struct ServiceOptions {
+   /** service time distribution */
+   ServiceKind kind_{kFixedService};
+   /** mean hair-cut duration at speed 1 in μ seconds, unused by traces */
+   double mean_us_{100.0};
+   /** lognormal, standard deviation of the log of the duration */
+   double sigma_{0.5};
+   /** trace, file of durations in μ seconds */
+   const char* trace_path_{NULL};
+   /** seed of the generator */
+   unsigned long seed_{1};
+   /** speed factor of the barber, every duration is divided by it */
+   double speed_{1.0};
+};
+
+class ServiceTime
+{
+public:
+
+   /**
+    * Creates the generator and, for a trace, reads the trace file.
+    * No other methods are called.
+    * @param options distribution, its parameters and the barber's speed
+    * @return none
+    * @custom.preconditions  mean_us_ > 0 unless replaying a trace, speed_ > 0
+    * @custom.postconditions  good() tells whether the trace could be read
+    **/
+   explicit ServiceTime(const ServiceOptions& options);
+
+   /**
+    * This returns the settings of fixed service of a given duration.
+    * No other methods are called.
+    * @param mean_us duration of every hair-cut in μ seconds
+    * @return settings for the constructor
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static ServiceOptions fixed(double mean_us);
+
+   /**
+    * This returns false if a trace was requested but could not be read.
+    * No other methods are called.
+    * @return true if the generator can draw durations
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   bool good() const;
+
+   /**
+    * Draws the duration of the next hair-cut.
+    * No other methods are called.
+    * @return duration in μ seconds, divided by the speed
+    * @custom.preconditions  good()
+    * @custom.postconditions  generator advanced by one hair-cut
+    **/
+   int next();
+
+   /**
+    * This returns the mean duration of the barber's hair-cuts.
+    * No other methods are called.
+    * @return mean in μ seconds, divided by the speed
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_mean_us() const;
+
+private:
+
+   /** settings of the generator */
+   ServiceOptions options_;
+   /** generator of all random durations */
+   mt19937_64 rng_;
+   /** lognormal, mean of the log of the duration */
+   double log_mean_;
+   /** trace, durations in μ seconds */
+   vector<double> trace_;
+   /** trace, index of the next duration */
+   size_t trace_next_;
+   /** false if the trace could not be read */
+   bool good_;
+
+   /**
+    * Reads the trace file.
+    * No other methods are called.
+    * @return false if the file could not be read or holds no durations
+    * @custom.preconditions  options_.trace_path_ != NULL
+    * @custom.postconditions  trace_ holds the durations in file order
+    **/
+   bool loadTrace();
+};
+#endif
@@ -0,0 +1,316 @@
+/**
+ * SharedBenchmark.cpp
+ *
+ * This is the SharedBenchmark.cpp file that measures what placing the shop
+ * in shared memory costs. The same closed loop runs three ways: customer
+ * threads visiting a Shop, customer threads visiting a SharedShop, and
+ * customer processes, forked from this one, visiting a SharedShop they
+ * attach to by name. Barbers are threads of this process in every run.
+ *
+ * Each customer worker visits the shop again as soon as its last visit
+ * ends, and the time from visitShop to the return of leaveShop of every
+ * served customer is recorded. With no service time that is the cost of
+ * the hand-off itself: seating a customer, waking the barber, the barber
+ * waking the customer and the customer paying. The workers' histograms
+ * live in an anonymous shared mapping, so forked workers record into the
+ * same histograms as threads do.
+ *
+ * Usage: shopShared [--barbers 4] [--chairs 8] [--workers 4]
+ *        [--customers 100000] [--service 0] [--name /sleeping_barbers]
+ **/
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Shop.h"
+#include "SharedShop.h"
+#include "Histogram.h"
+#include "Clock.h"
+using namespace std;
+
+/** how the customers reach the shop */
+enum SharedRunKind {
+   /** threads of this process visit a Shop */
+   kRunShopThreads,
+   /** threads of this process visit a SharedShop */
+   kRunSharedThreads,
+   /** forked processes visit a SharedShop */
+   kRunSharedProcesses
+};
+
+/** settings of the benchmark */
+struct SharedSettings {
+   int num_barbers{4};
+   int num_chairs{8};
+   int num_workers{4};
+   long num_customers{100000};
+   /** hair-cut duration in μ seconds, 0 for none */
+   int service_time{0};
+   const char* name{"/sleeping_barbers"};
+};
+
+/** parameters of a barber thread */
+struct SharedBarberParam {
+   Shop* shop;
+   SharedShop* shared;
+   int id;
+   int service_time;
+};
+
+/** parameters of a customer worker */
+struct SharedWorkerParam {
+   Shop* shop;
+   SharedShop* shared;
+   /** first customer id of the worker */
+   int first_id;
+   long visits;
+   /** round trips of served customers, in shared memory */
+   Histogram* round_trip;
+};
+
+/** method called by barber threads */
+static void* barber(void* arg);
+/** method called by customer workers */
+static void* customerWorker(void* arg);
+/** runs the closed loop one way */
+static void runKind(const SharedSettings& settings, SharedRunKind kind, Histogram* histograms);
+
+/**
+ * Parses the command line and runs the closed loop on the in-process and
+ * the shared shop.
+ * Calls runKind method.
+ * @return 0 on success, -1 on bad arguments or if the shared shop cannot
+ *         be created
+ * @custom.preconditions  none
+ * @custom.postconditions  one row per run written to stdout
+ **/
+int main(int argc, char *argv[])
+{
+   SharedSettings settings;
+   for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      if (i + 1 >= argc) {
+         cerr << "missing value for " << arg << endl;
+         return -1;
+      }
+      const char* value = argv[++i];
+      if (arg == "--barbers") {
+         settings.num_barbers = atoi(value);
+      } else if (arg == "--chairs") {
+         settings.num_chairs = atoi(value);
+      } else if (arg == "--workers") {
+         settings.num_workers = atoi(value);
+      } else if (arg == "--customers") {
+         settings.num_customers = atol(value);
+      } else if (arg == "--service") {
+         settings.service_time = atoi(value);
+      } else if (arg == "--name") {
+         settings.name = value;
+      } else {
+         cerr << "usage: shopShared [--barbers 4] [--chairs 8] [--workers 4]" << endl;
+         cerr << "       [--customers 100000] [--service 0] [--name /sleeping_barbers]" << endl;
+         return -1;
+      }
+   }
+   if (settings.num_barbers < 1 || settings.num_barbers > kMaxSharedBarbers ||
+       settings.num_chairs < 0 || settings.num_chairs > kMaxSharedChairs ||
+       settings.num_workers < 1 || settings.num_customers < settings.num_workers) {
+      cerr << "need 1 ~ " << kMaxSharedBarbers << " barbers, 0 ~ " << kMaxSharedChairs
+           << " chairs and at least one customer per worker" << endl;
+      return -1;
+   }
+
+   /** one histogram per worker, visible to forked workers */
+   size_t bytes = settings.num_workers * sizeof(Histogram);
+   void* map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+   if (map == MAP_FAILED) {
+      perror("mmap");
+      return -1;
+   }
+   Histogram* histograms = (Histogram*) map;
+
+   printf("# %d barbers, %d chairs, %d customer workers, %ld customers, service %d us\n",
+          settings.num_barbers, settings.num_chairs, settings.num_workers,
+          settings.num_customers, settings.service_time);
+   printf("%-16s %10s %7s %9s %9s %9s %9s\n", "run", "served/s", "drop%", "rt_mean", "rt_p50", "rt_p99", "rt_p999");
+   runKind(settings, kRunShopThreads, histograms);
+   runKind(settings, kRunSharedThreads, histograms);
+   runKind(settings, kRunSharedProcesses, histograms);
+   munmap(map, bytes);
+   return 0;
+}
+
+/**
+ * Runs the closed loop one way with fresh barbers and a fresh shop, and
+ * prints the throughput and round trip latency.
+ * Calls barber and customerWorker methods.
+ * @param settings settings of the benchmark
+ * @param kind how the customers reach the shop
+ * @param histograms one slot per worker, in shared memory
+ * @return none
+ * @custom.preconditions  no segment named settings.name exists
+ * @custom.postconditions  row written to stdout, every thread and
+ *                         process of the run joined
+ **/
+static void runKind(const SharedSettings& settings, SharedRunKind kind, Histogram* histograms)
+{
+   Shop* shop = NULL;
+   SharedShop* shared = NULL;
+   if (kind == kRunShopThreads) {
+      shop = new Shop(settings.num_barbers, settings.num_chairs);
+   } else {
+      shared = new SharedShop(settings.name, settings.num_barbers, settings.num_chairs);
+      if (!shared->good()) {
+         cerr << "cannot create shared shop " << settings.name << endl;
+         delete shared;
+         return;
+      }
+   }
+   for (int w = 0; w < settings.num_workers; w++) {
+      new (&histograms[w]) Histogram();
+   }
+
+   vector<pthread_t> barber_threads(settings.num_barbers);
+   vector<SharedBarberParam> barber_params(settings.num_barbers);
+   for (int i = 0; i < settings.num_barbers; i++) {
+      barber_params[i].shop = shop;
+      barber_params[i].shared = shared;
+      barber_params[i].id = i;
+      barber_params[i].service_time = settings.service_time;
+      pthread_create(&barber_threads[i], NULL, barber, &barber_params[i]);
+   }
+
+   long per_worker = settings.num_customers / settings.num_workers;
+   vector<SharedWorkerParam> workers(settings.num_workers);
+   for (int w = 0; w < settings.num_workers; w++) {
+      workers[w].shop = shop;
+      workers[w].shared = shared;
+      workers[w].first_id = (int) (w * per_worker + 1);
+      workers[w].visits = per_worker;
+      workers[w].round_trip = &histograms[w];
+   }
+
+   uint64_t start_ns = monotonicNs();
+   if (kind == kRunSharedProcesses) {
+      vector<pid_t> children;
+      for (int w = 0; w < settings.num_workers; w++) {
+         pid_t pid = fork();
+         if (pid == 0) {
+            /** a process of its own attaches by name, as an unrelated one would */
+            SharedShop attached(settings.name);
+            if (!attached.good()) {
+               _exit(1);
+            }
+            workers[w].shared = &attached;
+            customerWorker(&workers[w]);
+            _exit(0);
+         }
+         children.push_back(pid);
+      }
+      for (size_t c = 0; c < children.size(); c++) {
+         waitpid(children[c], NULL, 0);
+      }
+   } else {
+      vector<pthread_t> threads(settings.num_workers);
+      for (int w = 0; w < settings.num_workers; w++) {
+         pthread_create(&threads[w], NULL, customerWorker, &workers[w]);
+      }
+      for (int w = 0; w < settings.num_workers; w++) {
+         pthread_join(threads[w], NULL);
+      }
+   }
+   uint64_t end_ns = monotonicNs();
+
+   long drops = 0;
+   if (shared != NULL) {
+      drops = shared->get_cust_drops();
+      shared->close();
+   } else {
+      drops = shop->get_cust_drops();
+      shop->close();
+   }
+   for (int i = 0; i < settings.num_barbers; i++) {
+      pthread_join(barber_threads[i], NULL);
+   }
+
+   Histogram round_trip;
+   for (int w = 0; w < settings.num_workers; w++) {
+      round_trip.merge(histograms[w]);
+      histograms[w].~Histogram();
+   }
+   long visits = per_worker * settings.num_workers;
+   double elapsed_s = (end_ns - start_ns) / 1e9;
+   printf("%-16s %10.0f %7.2f %9.1f %9.1f %9.1f %9.1f\n",
+          (kind == kRunShopThreads) ? "shop/threads" :
+          (kind == kRunSharedThreads) ? "shared/threads" : "shared/processes",
+          round_trip.get_count() / elapsed_s, 100.0 * drops / visits,
+          round_trip.get_mean() / 1e3, round_trip.percentile(50) / 1e3,
+          round_trip.percentile(99) / 1e3, round_trip.percentile(99.9) / 1e3);
+   fflush(stdout);
+   delete shared;
+   delete shop;
+}
+
+/**
+ * Called by barber threads to service customers until the shop closes.
+ * Calls the helloCustomer and byeCustomer methods of the shop.
+ * @param arg SharedBarberParam with the barber's shop, id and service time
+ * @return none
+ * @custom.preconditions  arg stays valid until the thread is joined
+ * @custom.postconditions  barber services customers until done
+ **/
+static void* barber(void* arg)
+{
+   SharedBarberParam* param = (SharedBarberParam*) arg;
+   while (true) {
+      bool started = (param->shared != NULL) ? param->shared->helloCustomer(param->id)
+                                             : param->shop->helloCustomer(param->id);
+      if (!started) {
+         break;
+      }
+      if (param->service_time > 0) {
+         usleep(param->service_time);
+      }
+      if (param->shared != NULL) {
+         param->shared->byeCustomer(param->id);
+      } else {
+         param->shop->byeCustomer(param->id);
+      }
+   }
+   return nullptr;
+}
+
+/**
+ * Called by customer workers to visit the shop over and over, recording
+ * the round trip of every served visit.
+ * Calls the visitShop and leaveShop methods of the shop.
+ * @param arg SharedWorkerParam with the worker's shop, ids and histogram
+ * @return none
+ * @custom.preconditions  arg stays valid until the worker is joined
+ * @custom.postconditions  the worker's visits done
+ **/
+static void* customerWorker(void* arg)
+{
+   SharedWorkerParam* param = (SharedWorkerParam*) arg;
+   for (long i = 0; i < param->visits; i++) {
+      int id = param->first_id + (int) i;
+      uint64_t start_ns = monotonicNs();
+      int barber_id = (param->shared != NULL) ? param->shared->visitShop(id) : param->shop->visitShop(id);
+      if (barber_id < 0) {
+         continue;
+      }
+      if (param->shared != NULL) {
+         param->shared->leaveShop(id, barber_id);
+      } else {
+         param->shop->leaveShop(id, barber_id);
+      }
+      param->round_trip->record(monotonicNs() - start_ns);
+   }
+   return nullptr;
+}
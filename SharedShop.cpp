@@ -0,0 +1,528 @@
+/**
+ * SharedShop.cpp
+ *
+ * This is the SharedShop.cpp file that implements the methods of the
+ * SharedShop class. The creator sizes and maps the segment, sets up the
+ * process-shared mutex and condition variables and only then marks it
+ * ready, so a process attaching early waits instead of using a half
+ * built shop.
+ **/
+#include "SharedShop.h"
+#include "EventLog.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/** value of ready_ once the segment is set up */
+#define kSegmentReady 0x53425250
+/** how long an attaching process waits for the creator, in milliseconds */
+#define kAttachTimeoutMs 1000
+
+/**
+ * Creates a shop in a new shared memory segment of the given name.
+ * No other methods are called.
+ * @param name name of the segment, such as "/barbers"
+ * @param num_barbers number of barbers, 1 ~ kMaxSharedBarbers
+ * @param num_chairs number of waiting chairs, 0 ~ kMaxSharedChairs
+ * @return none
+ * @custom.preconditions  no segment of that name exists
+ * @custom.postconditions  good() tells whether the shop was created
+ **/
+SharedShop::SharedShop(const char* name, int num_barbers, int num_chairs) :
+   segment_(NULL), name_(name), creator_(false)
+{
+   if (num_barbers < 1 || num_barbers > kMaxSharedBarbers || num_chairs < 0 || num_chairs > kMaxSharedChairs) {
+      return;
+   }
+   int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+   if (fd < 0) {
+      return;
+   }
+   if (ftruncate(fd, sizeof(Segment)) != 0) {
+      ::close(fd);
+      shm_unlink(name);
+      return;
+   }
+   void* map = mmap(NULL, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if (map == MAP_FAILED) {
+      shm_unlink(name);
+      return;
+   }
+   segment_ = (Segment*) map;
+   creator_ = true;
+
+   /** the segment is zero filled, only what is not zero is set */
+   memcpy(segment_->magic_, "SBSHOP", 7);
+   segment_->size_ = sizeof(Segment);
+   segment_->num_barbers_ = num_barbers;
+   segment_->num_chairs_ = num_chairs;
+
+   pthread_mutexattr_t mutex_attr;
+   pthread_mutexattr_init(&mutex_attr);
+   pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+   pthread_mutexattr_setrobust(&mutex_attr, PTHREAD_MUTEX_ROBUST);
+   pthread_mutex_init(&segment_->mutex_, &mutex_attr);
+   pthread_mutexattr_destroy(&mutex_attr);
+
+   pthread_condattr_t cond_attr;
+   pthread_condattr_init(&cond_attr);
+   pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+   pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+   for (int i = 0; i < kMaxSharedChairs; i++) {
+      pthread_cond_init(&segment_->cond_ticket_[i], &cond_attr);
+   }
+   for (int i = 0; i < kMaxSharedBarbers; i++) {
+      pthread_cond_init(&segment_->barbers_[i].cond_barber_sleeping_, &cond_attr);
+      pthread_cond_init(&segment_->barbers_[i].cond_cust_served_, &cond_attr);
+      pthread_cond_init(&segment_->barbers_[i].cond_barber_paid_, &cond_attr);
+   }
+   pthread_condattr_destroy(&cond_attr);
+
+   /** every barber starts free */
+   for (int i = 0; i < num_barbers; i++) {
+      segment_->free_[i] = i;
+   }
+   segment_->free_count_ = num_barbers;
+   segment_->ready_.store(kSegmentReady, memory_order_release);
+}
+
+/**
+ * Attaches to the shop another process created under the given name,
+ * waiting up to a second for it to be set up.
+ * No other methods are called.
+ * @param name name of the segment
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  good() tells whether the shop was attached
+ **/
+SharedShop::SharedShop(const char* name) : segment_(NULL), name_(name), creator_(false)
+{
+   struct timespec pause = {0, 1000000};
+   int fd = -1;
+   struct stat info;
+   for (int waited = 0; waited < kAttachTimeoutMs; waited++) {
+      if (fd < 0) {
+         fd = shm_open(name, O_RDWR, 0);
+      }
+      /** the creator may not have sized the segment yet */
+      if (fd >= 0 && fstat(fd, &info) == 0 && (size_t) info.st_size >= sizeof(Segment)) {
+         break;
+      }
+      nanosleep(&pause, NULL);
+   }
+   if (fd < 0) {
+      return;
+   }
+   if (fstat(fd, &info) != 0 || (size_t) info.st_size != sizeof(Segment)) {
+      ::close(fd);
+      return;
+   }
+   void* map = mmap(NULL, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if (map == MAP_FAILED) {
+      return;
+   }
+
+   Segment* segment = (Segment*) map;
+   for (int waited = 0; waited < kAttachTimeoutMs; waited++) {
+      if (segment->ready_.load(memory_order_acquire) == kSegmentReady) {
+         break;
+      }
+      nanosleep(&pause, NULL);
+   }
+   if (segment->ready_.load(memory_order_acquire) != kSegmentReady ||
+       memcmp(segment->magic_, "SBSHOP", 7) != 0 || segment->size_ != sizeof(Segment)) {
+      munmap(map, sizeof(Segment));
+      return;
+   }
+   segment_ = segment;
+}
+
+/**
+ * Destructor for SharedShop class. Unmaps the segment, and the process
+ * that created it also removes its name, the memory going away once
+ * every process has unmapped it.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  no thread of this process is in the shop
+ * @custom.postconditions  segment unmapped
+ **/
+SharedShop::~SharedShop()
+{
+   if (segment_ != NULL) {
+      munmap(segment_, sizeof(Segment));
+   }
+   if (creator_) {
+      shm_unlink(name_.c_str());
+   }
+}
+
+/**
+ * This returns false if the shop could not be created or attached.
+ * No other methods are called.
+ * @return true if the shop can be used
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+bool SharedShop::good() const
+{
+   return segment_ != NULL;
+}
+
+/**
+ * Locks the shop's mutex, taking it over if its owner died.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  good()
+ * @custom.postconditions  mutex held
+ **/
+void SharedShop::lock()
+{
+   if (pthread_mutex_lock(&segment_->mutex_) == EOWNERDEAD) {
+      segment_->owner_deaths_++;
+      pthread_mutex_consistent(&segment_->mutex_);
+   }
+}
+
+/**
+ * Waits on a condition variable of the shop, taking the mutex over if
+ * its owner died meanwhile.
+ * No other methods are called.
+ * @param cond the condition variable
+ * @return none
+ * @custom.preconditions  mutex held
+ * @custom.postconditions  mutex held
+ **/
+void SharedShop::wait(pthread_cond_t* cond)
+{
+   if (pthread_cond_wait(cond, &segment_->mutex_) == EOWNERDEAD) {
+      segment_->owner_deaths_++;
+      pthread_mutex_consistent(&segment_->mutex_);
+   }
+}
+
+/**
+ * Waits on a condition variable of the shop for at most timeout_ms,
+ * taking the mutex over if its owner died meanwhile.
+ * No other methods are called.
+ * @param cond the condition variable
+ * @param timeout_ms longest wait in milliseconds
+ * @return false if the wait timed out
+ * @custom.preconditions  mutex held
+ * @custom.postconditions  mutex held
+ **/
+bool SharedShop::waitFor(pthread_cond_t* cond, int timeout_ms)
+{
+   struct timespec deadline;
+   clock_gettime(CLOCK_MONOTONIC, &deadline);
+   deadline.tv_sec += timeout_ms / 1000;
+   deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+   if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+   }
+   int result = pthread_cond_timedwait(cond, &segment_->mutex_, &deadline);
+   if (result == EOWNERDEAD) {
+      segment_->owner_deaths_++;
+      pthread_mutex_consistent(&segment_->mutex_);
+   }
+   return result != ETIMEDOUT;
+}
+
+/**
+ * Skips the waiting customers served next whose process died, and
+ * wakes the next live one if a barber is free.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  mutex held
+ * @custom.postconditions  the customer served next is alive or none waits
+ **/
+void SharedShop::skipDeadCustomers()
+{
+   Segment* shop = segment_;
+   bool skipped = false;
+   while (waiting() > 0 && !alive(shop->ticket_pid_[shop->now_serving_ % kMaxSharedChairs])) {
+      shop->now_serving_++;
+      shop->dead_customers_++;
+      skipped = true;
+   }
+   if (skipped && waiting() > 0 && shop->free_count_ > 0) {
+      pthread_cond_signal(&shop->cond_ticket_[shop->now_serving_ % kMaxSharedChairs]);
+   }
+}
+
+/**
+ * This returns false once the given process is gone.
+ * No other methods are called.
+ * @param pid the process
+ * @return true unless kill reports no such process
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+bool SharedShop::alive(pid_t pid)
+{
+   return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * This returns the number of customers in the waiting chairs.
+ * No other methods are called.
+ * @return tickets taken and not served yet
+ * @custom.preconditions  mutex held
+ * @custom.postconditions  none
+ **/
+int SharedShop::waiting() const
+{
+   return (int) (segment_->next_ticket_ - segment_->now_serving_);
+}
+
+/**
+ * This is to be called by the customers to visit the shop. They take a
+ * free barber if nobody is waiting, a waiting chair otherwise, and
+ * leave if all chairs are taken or the shop is closed.
+ * Records events through SHOP_LOG.
+ * @param id id of the visiting customer, unique across processes
+ * @return id of barber servicing them, -1 if they leave without service
+ * @custom.preconditions  good()
+ * @custom.postconditions  customer possibly seated with a barber
+ **/
+int SharedShop::visitShop(int id)
+{
+   Segment* shop = segment_;
+   SHOP_LOG(kLogService, id, kEventArrives, 0, 0);
+   lock();
+   if (shop->closed_ || (shop->free_count_ == 0 && shop->num_chairs_ == 0)) {
+      SHOP_LOG(kLogDrops, id, kEventBalkNoBarbers, 0, 0);
+      ++shop->cust_drops_;
+      pthread_mutex_unlock(&shop->mutex_);
+      return -1;
+   }
+   if (shop->free_count_ == 0 || waiting() > 0) {
+      if (waiting() == shop->num_chairs_) {
+         SHOP_LOG(kLogDrops, id, kEventBalkNoChairs, 0, 0);
+         ++shop->cust_drops_;
+         pthread_mutex_unlock(&shop->mutex_);
+         return -1;
+      }
+      uint64_t ticket = shop->next_ticket_++;
+      shop->ticket_pid_[ticket % kMaxSharedChairs] = getpid();
+      SHOP_LOG(kLogService, id, kEventTakesChair, shop->num_chairs_ - waiting(), 0);
+      /** Wait for our turn and a free barber, passing over the dead */
+      while (shop->now_serving_ != ticket || shop->free_count_ == 0) {
+         if (!waitFor(&shop->cond_ticket_[ticket % kMaxSharedChairs], kLeaseCheckMs)) {
+            skipDeadCustomers();
+         }
+      }
+      shop->now_serving_++;
+   }
+
+   int barber_id = shop->free_[shop->free_head_];
+   shop->free_head_ = (shop->free_head_ + 1) % kMaxSharedBarbers;
+   shop->free_count_--;
+   /** Another barber may be free for the next in line */
+   if (waiting() > 0 && shop->free_count_ > 0) {
+      pthread_cond_signal(&shop->cond_ticket_[shop->now_serving_ % kMaxSharedChairs]);
+   }
+   int seats_available = shop->num_chairs_ - waiting();
+
+   BarberChair& chair = shop->barbers_[barber_id];
+   chair.customer_ = id;
+   chair.customer_pid_ = getpid();
+   chair.in_service_ = true;
+   SHOP_LOG(kLogService, id, kEventMovesToChair, barber_id, seats_available);
+   /** Wake up the barber in case he is sleeping */
+   pthread_cond_signal(&chair.cond_barber_sleeping_);
+   /** The last customer of a closed shop lets the idle barbers go */
+   if (shop->closed_ && waiting() == 0) {
+      for (int i = 0; i < shop->num_barbers_; i++) {
+         pthread_cond_signal(&shop->barbers_[i].cond_barber_sleeping_);
+      }
+   }
+   pthread_mutex_unlock(&shop->mutex_);
+   return barber_id;
+}
+
+/**
+ * This is to be called by the customers that visitShop seated with a
+ * barber. They wait for the hair-cut to end and pay.
+ * Records events through SHOP_LOG.
+ * @param customer_id id of the customer
+ * @param barber_id id visitShop returned
+ * @return none
+ * @custom.preconditions  barber_id >= 0
+ * @custom.postconditions  barber paid
+ **/
+void SharedShop::leaveShop(int customer_id, int barber_id)
+{
+   BarberChair& chair = segment_->barbers_[barber_id];
+   lock();
+   SHOP_LOG(kLogVerbose, customer_id, kEventWaitsForHaircut, barber_id, 0);
+   while (chair.in_service_) {
+      wait(&chair.cond_cust_served_);
+   }
+   /** Pay the barber and signal barber appropriately */
+   chair.money_paid_ = true;
+   pthread_cond_signal(&chair.cond_barber_paid_);
+   SHOP_LOG(kLogService, customer_id, kEventSaysGoodbye, barber_id, 0);
+   pthread_mutex_unlock(&segment_->mutex_);
+}
+
+/**
+ * This is to be called by the barbers. They sleep until a customer
+ * sits in their chair and start the hair-cut.
+ * Records events through SHOP_LOG.
+ * @param id id of the barber, 0 ~ num_barbers - 1
+ * @return true if a hair-cut started, false once the shop is closed
+ *         and nobody is left waiting
+ * @custom.preconditions  one caller per barber id across processes
+ * @custom.postconditions  hair-cut started or barber done
+ **/
+bool SharedShop::helloCustomer(int id)
+{
+   Segment* shop = segment_;
+   BarberChair& chair = shop->barbers_[id];
+   lock();
+   if (chair.customer_ == 0 && !shop->closed_) {
+      SHOP_LOG(kLogVerbose, 0 - id, kEventBarberSleeps, 0, 0);
+   }
+   /** Sleep until a customer sat in barber chair or nobody will */
+   while (chair.customer_ == 0 && !(shop->closed_ && waiting() == 0)) {
+      wait(&chair.cond_barber_sleeping_);
+   }
+   if (chair.customer_ == 0) {
+      pthread_mutex_unlock(&shop->mutex_);
+      return false;
+   }
+   SHOP_LOG(kLogService, 0 - id, kEventStartsHaircut, chair.customer_, 0);
+   pthread_mutex_unlock(&shop->mutex_);
+   return true;
+}
+
+/**
+ * This is to be called by the barbers to end the hair-cut, wait for
+ * the payment and call in the next customer.
+ * Records events through SHOP_LOG.
+ * @param id id of the barber
+ * @return none
+ * @custom.preconditions  helloCustomer returned true
+ * @custom.postconditions  barber free
+ **/
+void SharedShop::byeCustomer(int id)
+{
+   Segment* shop = segment_;
+   BarberChair& chair = shop->barbers_[id];
+   lock();
+   /** Hair Cut-Service is completed, signal customer and wait for payment */
+   SHOP_LOG(kLogService, 0 - id, kEventDoneHaircut, chair.customer_, 0);
+   chair.in_service_ = false;
+   chair.money_paid_ = false;
+   pthread_cond_signal(&chair.cond_cust_served_);
+   while (!chair.money_paid_) {
+      /** A customer that died before paying never will */
+      if (!waitFor(&chair.cond_barber_paid_, kLeaseCheckMs) && !alive(chair.customer_pid_)) {
+         break;
+      }
+   }
+   if (chair.money_paid_) {
+      ++shop->served_;
+   } else {
+      ++shop->dead_customers_;
+   }
+   chair.customer_ = 0;
+
+   /** Signal to customer to get next one */
+   SHOP_LOG(kLogVerbose, 0 - id, kEventCallsNext, 0, 0);
+   shop->free_[(shop->free_head_ + shop->free_count_) % kMaxSharedBarbers] = id;
+   shop->free_count_++;
+   if (waiting() > 0) {
+      pthread_cond_signal(&shop->cond_ticket_[shop->now_serving_ % kMaxSharedChairs]);
+   }
+   pthread_mutex_unlock(&shop->mutex_);
+}
+
+/**
+ * Closes the shop. Customers arriving afterwards leave, the waiting
+ * customers are still served and every barber's helloCustomer returns
+ * false once nobody is left.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  sleeping barbers woken
+ **/
+void SharedShop::close()
+{
+   lock();
+   segment_->closed_ = true;
+   for (int i = 0; i < segment_->num_barbers_; i++) {
+      pthread_cond_signal(&segment_->barbers_[i].cond_barber_sleeping_);
+   }
+   pthread_mutex_unlock(&segment_->mutex_);
+}
+
+/**
+ * This returns the number of customers that left without service.
+ * No other methods are called.
+ * @return number of customers that left without being serviced
+ * @custom.preconditions  good()
+ * @custom.postconditions  none
+ **/
+long SharedShop::get_cust_drops()
+{
+   lock();
+   long drops = segment_->cust_drops_;
+   pthread_mutex_unlock(&segment_->mutex_);
+   return drops;
+}
+
+/**
+ * This returns the number of customers whose hair-cut is done.
+ * No other methods are called.
+ * @return number of customers served
+ * @custom.preconditions  good()
+ * @custom.postconditions  none
+ **/
+long SharedShop::get_served()
+{
+   lock();
+   long served = segment_->served_;
+   pthread_mutex_unlock(&segment_->mutex_);
+   return served;
+}
+
+/**
+ * This returns the number of times a process died holding the shop's
+ * mutex.
+ * No other methods are called.
+ * @return number of mutexes taken over
+ * @custom.preconditions  good()
+ * @custom.postconditions  none
+ **/
+long SharedShop::get_owner_deaths()
+{
+   lock();
+   long deaths = segment_->owner_deaths_;
+   pthread_mutex_unlock(&segment_->mutex_);
+   return deaths;
+}
+
+/**
+ * This returns the number of customers whose process died while they
+ * waited for their turn or before they paid.
+ * No other methods are called.
+ * @return number of dead customers skipped or let go unpaid
+ * @custom.preconditions  good()
+ * @custom.postconditions  none
+ **/
+long SharedShop::get_dead_customers()
+{
+   lock();
+   long dead = segment_->dead_customers_;
+   pthread_mutex_unlock(&segment_->mutex_);
+   return dead;
+}
@@ -0,0 +1,316 @@
+/**
+ * SharedShop.h
+ *
+ * This is the SharedShop.h file that defines the SharedShop class, the
+ * sleeping barbers shop placed in a named POSIX shared memory segment so
+ * customers of any process on the machine can visit it. One process
+ * creates the shop under a name, any other attaches to it by the same
+ * name and calls visitShop/leaveShop directly, with no broker process in
+ * between. Barbers may run in any of the processes too.
+ *
+ * The segment has a fixed layout with no pointers, so it maps at any
+ * address: the barbers' chairs, the ring of free barbers and the tickets
+ * of the waiting room are arrays of at most kMaxSharedBarbers and
+ * kMaxSharedChairs entries. One mutex guards the whole shop. It is
+ * process-shared and robust: if a process dies holding it, the next
+ * process to lock it takes it over and counts the death instead of
+ * blocking forever. The segment also records the process of every
+ * waiting customer and of the customer in every barber's chair. Those
+ * waiting check every kLeaseCheckMs that the customer served next is
+ * still alive and skip it if its process is gone, and a barber waiting
+ * for a payment lets a dead customer go unpaid, so a customer process
+ * dying in the shop does not wedge it. The check is kill(pid, 0), so
+ * every process must share one pid namespace, and a pid reused within
+ * kLeaseCheckMs passes for the dead customer. A barber whose process
+ * dies during a hair-cut still leaves its customer waiting.
+ *
+ * The rules are those of the locked waiting room of a Shop: a customer
+ * takes a free barber if nobody waits, a chair otherwise, and leaves if
+ * every chair is taken; waiting customers go to barbers in arrival order,
+ * each parked on the condition variable of its own ticket; a barber waits
+ * to be paid before calling in the next customer. Events are recorded
+ * through SHOP_LOG in the logging process's own EventLog.
+ **/
+#ifndef SHARED_SHOP_H_
+#define SHARED_SHOP_H_
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+#include <string>
+using namespace std;
+
+/** most barbers of a shared shop */
+#define kMaxSharedBarbers 64
+/** most waiting chairs of a shared shop */
+#define kMaxSharedChairs 1024
+/** how often a waiting process checks for dead customers, in milliseconds */
+#define kLeaseCheckMs 100
+
+class SharedShop
+{
+public:
+
+   /**
+    * Creates a shop in a new shared memory segment of the given name.
+    * No other methods are called.
+    * @param name name of the segment, such as "/barbers"
+    * @param num_barbers number of barbers, 1 ~ kMaxSharedBarbers
+    * @param num_chairs number of waiting chairs, 0 ~ kMaxSharedChairs
+    * @return none
+    * @custom.preconditions  no segment of that name exists
+    * @custom.postconditions  good() tells whether the shop was created
+    **/
+   SharedShop(const char* name, int num_barbers, int num_chairs);
+
+   /**
+    * Attaches to the shop another process created under the given name,
+    * waiting up to a second for it to be set up.
+    * No other methods are called.
+    * @param name name of the segment
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  good() tells whether the shop was attached
+    **/
+   explicit SharedShop(const char* name);
+
+   /**
+    * Destructor for SharedShop class. Unmaps the segment, and the process
+    * that created it also removes its name, the memory going away once
+    * every process has unmapped it.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  no thread of this process is in the shop
+    * @custom.postconditions  segment unmapped
+    **/
+   ~SharedShop();
+
+   /**
+    * This returns false if the shop could not be created or attached.
+    * No other methods are called.
+    * @return true if the shop can be used
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   bool good() const;
+
+   /**
+    * This is to be called by the customers to visit the shop. They take a
+    * free barber if nobody is waiting, a waiting chair otherwise, and
+    * leave if all chairs are taken or the shop is closed.
+    * Records events through SHOP_LOG.
+    * @param id id of the visiting customer, unique across processes
+    * @return id of barber servicing them, -1 if they leave without service
+    * @custom.preconditions  good()
+    * @custom.postconditions  customer possibly seated with a barber
+    **/
+   int visitShop(int id);
+
+   /**
+    * This is to be called by the customers that visitShop seated with a
+    * barber. They wait for the hair-cut to end and pay.
+    * Records events through SHOP_LOG.
+    * @param customer_id id of the customer
+    * @param barber_id id visitShop returned
+    * @return none
+    * @custom.preconditions  barber_id >= 0
+    * @custom.postconditions  barber paid
+    **/
+   void leaveShop(int customer_id, int barber_id);
+
+   /**
+    * This is to be called by the barbers. They sleep until a customer
+    * sits in their chair and start the hair-cut.
+    * Records events through SHOP_LOG.
+    * @param id id of the barber, 0 ~ num_barbers - 1
+    * @return true if a hair-cut started, false once the shop is closed
+    *         and nobody is left waiting
+    * @custom.preconditions  one caller per barber id across processes
+    * @custom.postconditions  hair-cut started or barber done
+    **/
+   bool helloCustomer(int id);
+
+   /**
+    * This is to be called by the barbers to end the hair-cut, wait for
+    * the payment and call in the next customer.
+    * Records events through SHOP_LOG.
+    * @param id id of the barber
+    * @return none
+    * @custom.preconditions  helloCustomer returned true
+    * @custom.postconditions  barber free
+    **/
+   void byeCustomer(int id);
+
+   /**
+    * Closes the shop. Customers arriving afterwards leave, the waiting
+    * customers are still served and every barber's helloCustomer returns
+    * false once nobody is left.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  sleeping barbers woken
+    **/
+   void close();
+
+   /**
+    * This returns the number of customers that left without service.
+    * No other methods are called.
+    * @return number of customers that left without being serviced
+    * @custom.preconditions  good()
+    * @custom.postconditions  none
+    **/
+   long get_cust_drops();
+
+   /**
+    * This returns the number of customers whose hair-cut is done.
+    * No other methods are called.
+    * @return number of customers served
+    * @custom.preconditions  good()
+    * @custom.postconditions  none
+    **/
+   long get_served();
+
+   /**
+    * This returns the number of times a process died holding the shop's
+    * mutex.
+    * No other methods are called.
+    * @return number of mutexes taken over
+    * @custom.preconditions  good()
+    * @custom.postconditions  none
+    **/
+   long get_owner_deaths();
+
+   /**
+    * This returns the number of customers whose process died while they
+    * waited for their turn or before they paid.
+    * No other methods are called.
+    * @return number of dead customers skipped or let go unpaid
+    * @custom.preconditions  good()
+    * @custom.postconditions  none
+    **/
+   long get_dead_customers();
+
+private:
+
+   /** one barber's chair */
+   struct BarberChair {
+      /** customer in the chair, 0 if none */
+      int customer_;
+      /** process of the customer in the chair */
+      pid_t customer_pid_;
+      /** true from seating until the hair-cut is done */
+      int in_service_;
+      /** true once the customer paid */
+      int money_paid_;
+      /** the barber sleeps on it until a customer sits down */
+      pthread_cond_t cond_barber_sleeping_;
+      /** the customer waits on it for the hair-cut to end */
+      pthread_cond_t cond_cust_served_;
+      /** the barber waits on it for the payment */
+      pthread_cond_t cond_barber_paid_;
+   };
+
+   /** the shared memory segment */
+   struct Segment {
+      /** "SBSHOP" */
+      char magic_[8];
+      /** sizeof(Segment), differs between incompatible builds */
+      uint32_t size_;
+      /** set once the creator has set everything up */
+      atomic<uint32_t> ready_;
+      int num_barbers_;
+      int num_chairs_;
+      /** true once close was called */
+      int closed_;
+      /** guards every field below */
+      pthread_mutex_t mutex_;
+      /** free barbers, longest free first */
+      int free_[kMaxSharedBarbers];
+      int free_head_;
+      int free_count_;
+      /** ticket the next waiting customer takes, ticket served next */
+      uint64_t next_ticket_;
+      uint64_t now_serving_;
+      /** customer holding ticket t waits on cond_ticket_[t % kMaxSharedChairs] */
+      pthread_cond_t cond_ticket_[kMaxSharedChairs];
+      /** process of the customer holding ticket t, at t % kMaxSharedChairs */
+      pid_t ticket_pid_[kMaxSharedChairs];
+      BarberChair barbers_[kMaxSharedBarbers];
+      long cust_drops_;
+      long served_;
+      long owner_deaths_;
+      long dead_customers_;
+   };
+
+   /** the mapped segment, NULL if not good */
+   Segment* segment_;
+   /** name of the segment */
+   string name_;
+   /** true in the process that created the segment */
+   bool creator_;
+
+   /**
+    * Locks the shop's mutex, taking it over if its owner died.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  good()
+    * @custom.postconditions  mutex held
+    **/
+   void lock();
+
+   /**
+    * Waits on a condition variable of the shop, taking the mutex over if
+    * its owner died meanwhile.
+    * No other methods are called.
+    * @param cond the condition variable
+    * @return none
+    * @custom.preconditions  mutex held
+    * @custom.postconditions  mutex held
+    **/
+   void wait(pthread_cond_t* cond);
+
+   /**
+    * Waits on a condition variable of the shop for at most timeout_ms,
+    * taking the mutex over if its owner died meanwhile.
+    * No other methods are called.
+    * @param cond the condition variable
+    * @param timeout_ms longest wait in milliseconds
+    * @return false if the wait timed out
+    * @custom.preconditions  mutex held
+    * @custom.postconditions  mutex held
+    **/
+   bool waitFor(pthread_cond_t* cond, int timeout_ms);
+
+   /**
+    * Skips the waiting customers served next whose process died, and
+    * wakes the next live one if a barber is free.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  mutex held
+    * @custom.postconditions  the customer served next is alive or none waits
+    **/
+   void skipDeadCustomers();
+
+   /**
+    * This returns false once the given process is gone.
+    * No other methods are called.
+    * @param pid the process
+    * @return true unless kill reports no such process
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static bool alive(pid_t pid);
+
+   /**
+    * This returns the number of customers in the waiting chairs.
+    * No other methods are called.
+    * @return tickets taken and not served yet
+    * @custom.preconditions  mutex held
+    * @custom.postconditions  none
+    **/
+   int waiting() const;
+
+   SharedShop(const SharedShop&) = delete;
+   SharedShop& operator=(const SharedShop&) = delete;
+};
+#endif
@@ -1,243 +1,1759 @@
-/**
- * @author  Marissa Christenson
- * @since   05/01/21
- * Shop.cpp
- * 
- * This is the Shop.cpp file that is implements the methods of the Shop class. 
- * It includes several public methods, a default constructor and an overloaded 
- * constructor that takes the number of barbers and the number of waiting 
- * chairs. visitShop and leaveShop are called by customer threads to visit 
- * the shop and be serviced. If there are no waiting chairs the customer 
- * threads leave. Otherwise, it stays and waits or sits in a barber chair 
- * to be serviced. The helloCustomer and byeCustomer are used by the barber 
- * threads to service the customer threads and then process them before they 
- * leave. 
- * 
- * The private methods are used to initialize the shop variable and to turn 
- * integers to string/ to print data to stdout. 
- **/
-#include "Shop.h"
-
-/**
- * This initializes the shops mutexes and conditional variables.
- * No other methods are called. 
- * @return none
- * @custom.preconditions  none
- * @custom.postconditions  objects mutexes/ cond variables initialized
- **/
-void Shop::init() 
-{
-   pthread_mutex_init(&mutex_, NULL);
-   pthread_cond_init(&cond_customers_waiting_, NULL);
-   barber_info_ = new PersonInfo[max_barbers_];
-   for(int i = 0; i < max_barbers_; i++) {
-      barber_info_[i].barber_id_ = i;
-      sleeping_barbers_.push(i);
-   }
-}
-
-/**
- * Destructor for Shop class. 
- * No other methods are called. 
- * @return none
- * @custom.preconditions  none
- * @custom.postconditions  Shop class destroyed. 
- **/
-Shop::~Shop() 
-{
-   delete[] barber_info_;
-}
-
-/**
- * This initializes the shops mutexes and conditional variables.
- * No other methods are called. 
- * @return none
- * @custom.preconditions  none
- * @custom.postconditions  objects mutexes/ cond variables initialized
- **/
-string Shop::int2string(int i) 
-{
-   stringstream out;
-   out << i;
-   return out.str( );
-}
-
-/**
- * This takes a number and appends ‘barber’ for negative number and 
- * ‘customer’ for positive numbers to a string message that is 
- * printed to stdout.
- * Uses to_string(). No other methods are called. 
- * @param person number indicating person, <0 are barbers, >0 are customers
- * @return none
- * @custom.preconditions  none
- * @custom.postconditions  data sent to stdout
- **/
-void Shop::print(int person, string message)
-{
-   cout << ((person > 0) ? "customer[" + to_string(person) : "barber  [" + to_string((person * -1))) << "]: " << message << endl;
-}
-
-/**
- * This returns the number of customers that did not get serviced
- * No other methods are called. 
- * @return number of customers that left shop without being serviced
- * @custom.preconditions  none
- * @custom.postconditions  none
- **/
-int Shop::get_cust_drops() const
-{
-    return cust_drops_;
-}
-
-/**
- * This is to be called by the customer threads to visit the shop. They 
- * will check if there is a waiting chair, if not, they leave. If all 
- * barbers are busy and there is a chair, they sit. Otherwise, they sit 
- * in the next available barber chair. 
- * Calls print and int2string methods. 
- * @return id of barber servicing them, -1 if they leave without service
- * @custom.preconditions  none
- * @custom.postconditions  customer thread possibly serviced
- **/
-int Shop::visitShop(int id)
-{
-   pthread_mutex_lock(&mutex_);
-   
-   /** If all chairs are full then leave shop */
-   if (max_waiting_cust_ > 0) {
-      /** If someone is being served or transitioning waiting to service
-       * then take a chair and wait for service chair */
-      if (waiting_chairs_.size() == max_waiting_cust_) {
-         print(id,"leaves the shop because of no available waiting chairs.");
-         ++cust_drops_;
-         pthread_mutex_unlock(&mutex_);
-         return -1;
-      } else {
-         if (sleeping_barbers_.size() == 0 || !waiting_chairs_.empty()) {
-            waiting_chairs_.push(id);
-            print(id, "takes a waiting chair. # waiting seats available = " + 
-            int2string(max_waiting_cust_ - waiting_chairs_.size()));
-            pthread_cond_wait(&cond_customers_waiting_, &mutex_);
-            waiting_chairs_.pop();
-         }
-      }
-   }else {
-      if (sleeping_barbers_.size() == 0) {
-         print(id,"leaves the shop because of no available barbers.");
-         ++cust_drops_;
-         pthread_mutex_unlock(&mutex_);
-         return -1;
-      }
-   }
-   
-   int barber_id = sleeping_barbers_.front();
-   sleeping_barbers_.pop();
-
-   print(id, "moves to a service chair[" + int2string(barber_id) + "]" 
-   + ". # waiting seats available = " 
-   + int2string(max_waiting_cust_ - waiting_chairs_.size()));
-
-   pthread_mutex_unlock(&mutex_); 
-   pthread_mutex_lock(&(barber_info_[barber_id].mutex_lock_));
-
-   barber_info_[barber_id].cust_in_chair_ = id;
-   barber_info_[barber_id].in_service_ = true;
-
-   /** Wake up the barber in case he is sleeping */
-   pthread_cond_signal(&(barber_info_[barber_id].cond_barber_sleeping_));
-   pthread_mutex_unlock(&(barber_info_[barber_id].mutex_lock_));
-   return barber_id;
-}
-
-/**
- * This is to be called by the customer threads who have been seen by a 
- * barber. Their service will be finished and then they wait before paying. 
- * Calls print method.
- * @return none
- * @custom.preconditions  none
- * @custom.postconditions  customer thread service is completed. 
- **/
-void Shop::leaveShop(int customer_id, int barber_id)
-{
-   pthread_mutex_lock(&(barber_info_[barber_id].mutex_lock_));
-   /** Wait for service to be completed */
-   print(customer_id, "waits for barber[" + int2string(barber_id) + "]" + " to be done with hair-cut");
-   
-   while (barber_info_[barber_id].in_service_ == true) {
-      pthread_cond_wait(&(barber_info_[barber_id].cond_cust_served_), &(barber_info_[barber_id].mutex_lock_));
-   }
-
-   /** Pay the barber and signal barber appropriately */
-   barber_info_[barber_id].money_paid_ = true;
-   pthread_cond_signal(&(barber_info_[barber_id].cond_barber_paid_));
-   print(customer_id, "says good-bye to the barber[" + int2string(barber_id) + "]");
-   pthread_mutex_unlock(&(barber_info_[barber_id].mutex_lock_));
-}
- 
-/**
- * This is to be called by the barber threads. Barber checks if 
- * there are any customers waiting or in their chair and then service 
- * them. If not, they sleep and wait to be signaled by a customer. 
- * Once they have a customer, they begin the haircut.
- * Calls print method. 
- * @return none
- * @custom.preconditions  none
- * @custom.postconditions  customer thread service is started. 
- **/
-void Shop::helloCustomer(int id)
-{
-   pthread_mutex_lock(&mutex_);
-   pthread_mutex_lock(&(barber_info_[id].mutex_lock_));
-
-   /** If no customers then barber can sleep */
-   if (waiting_chairs_.empty() && barber_info_[id].cust_in_chair_ == 0) {
-      print(0 - id, "sleeps because of no customers.");
-      pthread_mutex_unlock(&mutex_);
-      pthread_cond_wait(&(barber_info_[id].cond_barber_sleeping_), &(barber_info_[id].mutex_lock_));
-   }
-
-   /** check if the customer sat in barber chair. */
-   if (barber_info_[id].cust_in_chair_ == 0) {
-      pthread_mutex_unlock(&mutex_);
-      //cout << "--------------Barber sleeps again because nobody in chair: ------------------" << id <<endl;
-      pthread_cond_wait(&(barber_info_[id].cond_barber_sleeping_), &(barber_info_[id].mutex_lock_));
-   }else {
-      pthread_mutex_unlock(&mutex_);
-   }
-   print(0 - id, "starts a hair-cut service for customer[" + int2string(barber_info_[id].cust_in_chair_) + "]");
-   pthread_mutex_unlock(&(barber_info_[id].mutex_lock_));
-}
-
-/**
- * This is to be called by the barber threads. This is where they finish 
- * the haircut and take payment from one customer thread and then signal 
- * another waiting customer thread. 
- * Calls print and int2string methods.  
- * @return none
- * @custom.preconditions  none
- * @custom.postconditions  customer thread service is finished
- **/
-void Shop::byeCustomer(int id)
-{
-   pthread_mutex_lock(&(barber_info_[id].mutex_lock_));
-
-  /** Hair Cut-Service is completed, signal customer and wait for payment */
-  print(0 - id, "says he's done with a hair-cut service for customer[" + int2string(barber_info_[id].cust_in_chair_) + "]");
-  
-  barber_info_[id].in_service_ = false;
-  barber_info_[id].money_paid_ = false;
-  pthread_cond_signal(&(barber_info_[id].cond_cust_served_));
-  
-  while (barber_info_[id].money_paid_ == false) {
-      pthread_cond_wait(&(barber_info_[id].cond_barber_paid_), &(barber_info_[id].mutex_lock_));
-  }
-
-  barber_info_[id].cust_in_chair_ = 0;
-  /** Signal to customer to get next one */
-  print(0 - id, "calls in another customer");
-  pthread_mutex_unlock(&(barber_info_[id].mutex_lock_));
-  pthread_mutex_lock(&mutex_);
-  sleeping_barbers_.push(id);
-  pthread_cond_signal(&cond_customers_waiting_);
-  pthread_mutex_unlock(&mutex_);
-}
+/**
+ * @author  Marissa Christenson
+ * @since   05/01/21
+ * Shop.cpp
+ * 
+ * This is the Shop.cpp file that is implements the methods of the Shop class. 
+ * It includes several public methods, a default constructor and an overloaded 
+ * constructor that takes the number of barbers and the number of waiting 
+ * chairs. visitShop and leaveShop are called by customer threads to visit 
+ * the shop and be serviced. If there are no waiting chairs the customer 
+ * threads leave. Otherwise, it stays and waits or sits in a barber chair 
+ * to be serviced. The helloCustomer and byeCustomer are used by the barber 
+ * threads to service the customer threads and then process them before they 
+ * leave. 
+ * 
+ * The private methods are used to initialize the shop variables and to run 
+ * the lock-free waiting room. Events are recorded through SHOP_LOG and 
+ * written out by the EventLog drain thread, never from a critical section. 
+ * The handshake takes its mutexes and waits through SHOP_LOCK, SHOP_UNLOCK 
+ * and SHOP_WAIT, which the lock profiler can be compiled into. 
+ **/
+#include "Shop.h"
+#include "WaitStrategy.h"
+#include "Affinity.h"
+#include "EventLog.h"
+#include "LockProfile.h"
+#include <sched.h>
+#include <algorithm>
+
+/** direct handoff, mailbox value waking a barber that was retired */
+#define kMailboxRetired -1
+
+atomic<uint64_t> Shop::next_serial_(1);
+thread_local uint64_t Shop::tls_stats_serial_ = 0;
+thread_local Shop::ThreadStats* Shop::tls_stats_ = NULL;
+
+/**
+ * This initializes the shops mutexes and conditional variables. With a 
+ * NUMA node in the options, the barber state and the waiting room are 
+ * allocated and first touched while the calling thread runs on that node. 
+ * Calls pinToNode method. 
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  objects mutexes/ cond variables initialized
+ **/
+void Shop::init() 
+{
+   pthread_mutex_init(&mutex_, NULL);
+   pthread_cond_init(&cond_customers_waiting_, NULL);
+   pthread_cond_init(&cond_barbers_out_, NULL);
+   pthread_mutex_init(&stats_mutex_, NULL);
+   closed_ = false;
+   barbers_out_ = 0;
+   serial_ = next_serial_.fetch_add(1);
+   shard_ = 0;
+   stats_owner_ = this;
+   /** slots beyond the barbers we start with stay closed until addBarber */
+   int num_working = max_barbers_;
+   if (options_.barber_capacity_ > max_barbers_) {
+      max_barbers_ = options_.barber_capacity_;
+   }
+   active_barbers_ = num_working;
+
+   cpu_set_t caller_cpus;
+   bool on_node = false;
+   if (options_.numa_node_ >= 0 &&
+       pthread_getaffinity_np(pthread_self(), sizeof(caller_cpus), &caller_cpus) == 0) {
+      on_node = pinToNode(pthread_self(), options_.numa_node_);
+   }
+   barber_info_ = new PersonInfo[max_barbers_];
+   if (options_.handoff_ == kDirectHandoff) {
+      options_.waiting_room_ = kLockFreeWaitingRoom;
+   }
+   /** batches, classes, reneging and barber queues need the ticket waiting room */
+   if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+      options_.batch_size_ = 1;
+      options_.dispatch_ = kDispatchFifo;
+      options_.reneging_ = false;
+      options_.barber_dispatch_ = kBarberFifo;
+   } else if (options_.batch_size_ > 1 || options_.dispatch_ != kDispatchFifo || options_.reneging_ ||
+              options_.barber_dispatch_ == kBarberShortestWait) {
+      options_.waiting_room_ = kTicketWaitingRoom;
+   }
+   if (options_.batch_size_ < 1) {
+      options_.batch_size_ = 1;
+   } else if (options_.batch_size_ > kMaxBatchSize) {
+      options_.batch_size_ = kMaxBatchSize;
+   }
+   num_tickets_ = 0;
+   next_ticket_seq_ = 0;
+   for (int c = 0; c < kMaxPriorityClasses; c++) {
+      class_credit_[c] = 0;
+      class_reneges_[c] = 0;
+      if (options_.class_weights_[c] < 1) {
+         options_.class_weights_[c] = 1;
+      }
+   }
+   waiting_ring_ = NULL;
+   free_barbers_ = NULL;
+   waiting_count_ = 0;
+   if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+      waiting_ring_ = new LockFreeRing<Ticket*>(max_waiting_cust_);
+      free_barbers_ = new BarberSet(max_barbers_);
+   }
+   for(int i = 0; i < max_barbers_; i++) {
+      barber_info_[i].barber_id_ = i;
+      if (i >= num_working) {
+         barber_info_[i].slot_ = kSlotIdle;
+      } else if (free_barbers_ != NULL) {
+         free_barbers_->release(i);
+      } else {
+         sleeping_barbers_.push_back(i);
+      }
+   }
+   updateGauges();
+   if (on_node) {
+      pthread_setaffinity_np(pthread_self(), sizeof(caller_cpus), &caller_cpus);
+   }
+}
+
+/**
+ * Destructor for Shop class. 
+ * No other methods are called. 
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  Shop class destroyed. 
+ **/
+Shop::~Shop() 
+{
+   delete[] barber_info_;
+   delete waiting_ring_;
+   delete free_barbers_;
+   for (map<pthread_t, ThreadStats*>::iterator it = thread_stats_.begin(); it != thread_stats_.end(); ++it) {
+      delete it->second;
+   }
+   pthread_mutex_destroy(&stats_mutex_);
+}
+
+/**
+ * This returns the number of customers that did not get serviced
+ * No other methods are called. 
+ * @return number of customers that left shop without being serviced
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Shop::get_cust_drops() const
+{
+    return cust_drops_;
+}
+
+/**
+ * This returns the number of customers that gave up waiting. 
+ * No other methods are called. 
+ * @return number of customers that reneged
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Shop::get_cust_reneges() const
+{
+   int reneges = 0;
+   for (int c = 0; c < kMaxPriorityClasses; c++) {
+      reneges += class_reneges_[c].load();
+   }
+   return reneges;
+}
+
+/**
+ * This returns the number of customers in the waiting chairs. Takes no 
+ * lock, so monitors can poll it while the shop is busy. 
+ * No other methods are called. 
+ * @return number of waiting customers
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Shop::get_waiting() const
+{
+   if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+      return waiting_count_.load();
+   }
+   return waiting_gauge_.load(memory_order_relaxed);
+}
+
+/**
+ * This returns the number of working barbers that are free. Takes no 
+ * lock, so monitors can poll it while the shop is busy. 
+ * No other methods are called. 
+ * @return number of free barbers
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Shop::get_free_barbers() const
+{
+   if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+      return free_barbers_->count();
+   }
+   return sleeping_gauge_.load(memory_order_relaxed);
+}
+
+/**
+ * Copies the sizes of the waiting chairs, tickets and sleeping barbers 
+ * to the gauges get_waiting and get_free_barbers read. 
+ * No other methods are called. 
+ * @return none
+ * @custom.preconditions  mutex_ held, or no other thread uses the shop
+ * @custom.postconditions  gauges match the queues
+ **/
+void Shop::updateGauges()
+{
+   waiting_gauge_.store((int) waiting_chairs_.size() + num_tickets_, memory_order_relaxed);
+   sleeping_gauge_.store((int) sleeping_barbers_.size(), memory_order_relaxed);
+}
+
+/**
+ * This returns the number of working barbers, not counting barbers 
+ * that are retiring. 
+ * No other methods are called. 
+ * @return number of working barbers
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Shop::get_active_barbers() const
+{
+   return active_barbers_.load();
+}
+
+/**
+ * This returns the number of barber slots, working or not. 
+ * No other methods are called. 
+ * @return largest barber id + 1
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Shop::get_barber_capacity() const
+{
+   return max_barbers_;
+}
+
+/**
+ * This returns the number of waiting chairs. 
+ * No other methods are called. 
+ * @return most customers that can wait at once
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+int Shop::get_num_chairs() const
+{
+   return max_waiting_cust_;
+}
+
+/**
+ * Sets the speed factor a barber is dispatched by, a barber of speed 
+ * 2 being expected to finish a hair-cut in half the time. The barber 
+ * thread is what actually takes that long. 
+ * No other methods are called. 
+ * @param id id of the barber
+ * @param speed speed factor, 1 for every barber unless set
+ * @return none
+ * @custom.preconditions  0 <= id < get_barber_capacity(), speed > 0
+ * @custom.postconditions  barber dispatched by the new speed
+ **/
+void Shop::set_barber_speed(int id, double speed)
+{
+   if (id < 0 || id >= max_barbers_ || speed <= 0) {
+      return;
+   }
+   pthread_mutex_lock(&mutex_);
+   barber_info_[id].speed_ = speed;
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * This returns the speed factor of a barber. 
+ * No other methods are called. 
+ * @param id id of the barber
+ * @return speed factor set by set_barber_speed, 1 by default
+ * @custom.preconditions  0 <= id < get_barber_capacity()
+ * @custom.postconditions  none
+ **/
+double Shop::get_barber_speed(int id) const
+{
+   pthread_mutex_lock(const_cast<pthread_mutex_t*>(&mutex_));
+   double speed = barber_info_[id].speed_;
+   pthread_mutex_unlock(const_cast<pthread_mutex_t*>(&mutex_));
+   return speed;
+}
+
+/**
+ * Opens a retired barber slot. The barber is free at once, customers 
+ * may be seated with it before its thread calls helloCustomer. 
+ * Records events through SHOP_LOG. 
+ * @return id of the new barber, -1 if every slot is working
+ * @custom.preconditions  none
+ * @custom.postconditions  one more barber working on success
+ **/
+int Shop::addBarber()
+{
+   if (closed_.load()) {
+      return -1;
+   }
+   for (int id = 0; id < max_barbers_; id++) {
+      int idle = kSlotIdle;
+      if (!barber_info_[id].slot_.compare_exchange_strong(idle, kSlotActive)) {
+         continue;
+      }
+      int working = ++active_barbers_;
+      SHOP_LOG(kLogService, 0 - id, kEventBarberJoins, working, 0);
+      if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+         free_barbers_->release(id);
+         dispatch();
+      } else if (ticketed()) {
+         claimBatch(id);
+      } else {
+         pthread_mutex_lock(&mutex_);
+         sleeping_barbers_.push_back(id);
+         updateGauges();
+         pthread_cond_signal(&cond_customers_waiting_);
+         /** close may have run since we looked */
+         if (closed_.load()) {
+            closeOutFreeBarbers();
+         }
+         pthread_mutex_unlock(&mutex_);
+      }
+      return id;
+   }
+   return -1;
+}
+
+/**
+ * Retires a working barber. A free barber is taken out of the free 
+ * barbers and woken, a busy one finishes its customer first. Either 
+ * way the barber's next helloCustomer returns false. 
+ * Calls markRetired method. 
+ * @param id id of the barber
+ * @return false if the barber is not working or already retiring
+ * @custom.preconditions  none
+ * @custom.postconditions  no new customer is seated with the barber
+ **/
+bool Shop::retireBarber(int id)
+{
+   int active = kSlotActive;
+   if (id < 0 || id >= max_barbers_ || closed_.load() ||
+       !barber_info_[id].slot_.compare_exchange_strong(active, kSlotRetiring)) {
+      return false;
+   }
+   --active_barbers_;
+
+   /** 
+    * Whoever takes the barber out of the free barbers wakes it: we do if 
+    * it is free now, otherwise the barber does once its customer is gone 
+    */
+   bool was_free = false;
+   if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+      was_free = free_barbers_->tryRemove(id);
+   } else {
+      pthread_mutex_lock(&mutex_);
+      deque<int>::iterator it = find(sleeping_barbers_.begin(), sleeping_barbers_.end(), id);
+      if (it != sleeping_barbers_.end()) {
+         sleeping_barbers_.erase(it);
+         updateGauges();
+         was_free = true;
+      }
+      pthread_mutex_unlock(&mutex_);
+   }
+   if (was_free) {
+      markRetired(id);
+   }
+   return true;
+}
+
+/**
+ * Wakes a retiring barber, or a barber of a closed shop, that is out of 
+ * the free barbers, so its next helloCustomer returns false. 
+ * No other methods are called. 
+ * @param id id of the barber
+ * @return none
+ * @custom.preconditions  barber retiring or shop closed, no customer 
+ *                        can reach it
+ * @custom.postconditions  barber's helloCustomer returns false
+ **/
+void Shop::markRetired(int id)
+{
+   PersonInfo& barber = barber_info_[id];
+   if (options_.handoff_ == kDirectHandoff) {
+      barber.mailbox_.store(kMailboxRetired);
+      futexWake(&barber.mailbox_, INT_MAX);
+      return;
+   }
+   pthread_mutex_lock(&(barber.mutex_lock_));
+   barber.retired_ = true;
+   pthread_cond_signal(&(barber.cond_barber_sleeping_));
+   pthread_mutex_unlock(&(barber.mutex_lock_));
+}
+
+/**
+ * Closes the slot of a barber leaving helloCustomer retired. 
+ * Records events through SHOP_LOG. 
+ * @param id id of the barber
+ * @return none
+ * @custom.preconditions  called by the barber thread
+ * @custom.postconditions  slot can be opened by addBarber
+ **/
+void Shop::finishRetire(int id)
+{
+   SHOP_LOG(kLogService, 0 - id, kEventBarberRetires, active_barbers_.load(), 0);
+   barber_info_[id].slot_.store(kSlotIdle);
+   /** a barber retired while the shop closed is one fewer for drain */
+   if (closed_.load()) {
+      pthread_mutex_lock(&mutex_);
+      pthread_cond_broadcast(&cond_barbers_out_);
+      pthread_mutex_unlock(&mutex_);
+   }
+}
+
+/**
+ * Closes the shop. Customers arriving afterwards leave and are counted 
+ * as drops, the waiting customers are still served, and once nobody is 
+ * left waiting every barber's helloCustomer returns false instead of 
+ * sleeping. Barbers are neither added nor retired while closed. 
+ * Calls closeOutFreeBarbers method. 
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  free barbers woken if nobody waits
+ **/
+void Shop::close()
+{
+   if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+      closed_.store(true);
+      closeOutFreeBarbers();
+      return;
+   }
+   pthread_mutex_lock(&mutex_);
+   closed_.store(true);
+   closeOutFreeBarbers();
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Closes the shop and waits until every working barber's helloCustomer 
+ * has returned false, so no customer is left in the shop. 
+ * Calls close method. 
+ * @return none
+ * @custom.preconditions  every working barber's thread keeps calling 
+ *                        helloCustomer until it returns false
+ * @custom.postconditions  every working barber out of the shop
+ **/
+void Shop::drain()
+{
+   close();
+   pthread_mutex_lock(&mutex_);
+   while (barbers_out_ < active_barbers_.load()) {
+      pthread_cond_wait(&cond_barbers_out_, &mutex_);
+   }
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * Opens a drained shop again. Every working barber is free, and the 
+ * drops, reneges and statistics start over from zero. The barber 
+ * threads may call helloCustomer again once reset returns. 
+ * No other methods are called. 
+ * @return false if the shop is not drained
+ * @custom.preconditions  no customer thread is in the shop
+ * @custom.postconditions  shop open as if newly built
+ **/
+bool Shop::reset()
+{
+   pthread_mutex_lock(&mutex_);
+   if (!closed_.load() || barbers_out_ < active_barbers_.load()) {
+      pthread_mutex_unlock(&mutex_);
+      return false;
+   }
+   sleeping_barbers_.clear();
+   num_tickets_ = 0;
+   next_ticket_seq_ = 0;
+   for (int c = 0; c < kMaxPriorityClasses; c++) {
+      ticket_queues_[c].clear();
+      class_credit_[c] = 0;
+      class_reneges_[c] = 0;
+   }
+   cust_drops_ = 0;
+   for (int i = 0; i < max_barbers_; i++) {
+      PersonInfo& barber = barber_info_[i];
+      barber.served_ = 0;
+      barber.busy_ns_ = 0;
+      barber.idle_ns_ = 0;
+      barber.queued_ = 0;
+      if (barber.slot_.load() != kSlotActive) {
+         continue;
+      }
+      if (free_barbers_ != NULL) {
+         free_barbers_->release(i);
+      } else {
+         sleeping_barbers_.push_back(i);
+      }
+   }
+   updateGauges();
+   barbers_out_ = 0;
+   closed_.store(false);
+   pthread_mutex_unlock(&mutex_);
+
+   /** the threads that recorded them are out of the shop */
+   pthread_mutex_lock(&stats_mutex_);
+   for (map<pthread_t, ThreadStats*>::iterator it = thread_stats_.begin(); it != thread_stats_.end(); ++it) {
+      ThreadStats* stats = it->second;
+      stats->arrivals_ = 0;
+      stats->queue_wait_.reset();
+      stats->service_.reset();
+      stats->payment_.reset();
+      for (int c = 0; c < kMaxPriorityClasses; c++) {
+         stats->class_wait_[c].reset();
+      }
+   }
+   pthread_mutex_unlock(&stats_mutex_);
+   return true;
+}
+
+/**
+ * Wakes every free barber of a closed shop out of the free barbers, 
+ * unless customers are still waiting for one. 
+ * Calls markRetired method. 
+ * @return none
+ * @custom.preconditions  shop closed, mutex_ held unless the waiting 
+ *                        room is lock-free
+ * @custom.postconditions  no barber sleeps while nobody waits
+ **/
+void Shop::closeOutFreeBarbers()
+{
+   if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+      /** 
+       * A customer takes its chair before it looks at closed_ and we set 
+       * closed_ before looking at the chairs, so either it leaves or we 
+       * see it waiting and its barber closes us out later 
+       */
+      if (waiting_count_.load() > 0) {
+         return;
+      }
+      for (int id = 0; id < max_barbers_; id++) {
+         if (free_barbers_->tryRemove(id)) {
+            markRetired(id);
+         }
+      }
+      return;
+   }
+   /** a ticket room barber only sleeps when nobody waits for it */
+   if (!ticketed() && !waiting_chairs_.empty()) {
+      return;
+   }
+   while (!sleeping_barbers_.empty()) {
+      int id = sleeping_barbers_.front();
+      sleeping_barbers_.pop_front();
+      markRetired(id);
+   }
+   updateGauges();
+}
+
+/**
+ * Counts a barber leaving helloCustomer because the shop is closed. 
+ * No other methods are called. 
+ * @return none
+ * @custom.preconditions  called by the barber thread
+ * @custom.postconditions  drain woken
+ **/
+void Shop::finishClose()
+{
+   pthread_mutex_lock(&mutex_);
+   ++barbers_out_;
+   pthread_cond_broadcast(&cond_barbers_out_);
+   pthread_mutex_unlock(&mutex_);
+}
+
+/**
+ * This returns the shop's statistics, merged from the histograms of 
+ * every thread that used the shop. Safe to call while the shop is 
+ * running, values recorded concurrently may or may not be included. 
+ * No other methods are called. 
+ * @return statistics recorded so far
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+ShopStats Shop::get_stats() const
+{
+   ShopStats stats;
+   stats.drops_ = cust_drops_.load();
+   for (int c = 0; c < kMaxPriorityClasses; c++) {
+      stats.class_reneges_[c] = class_reneges_[c].load();
+      stats.reneges_ += stats.class_reneges_[c];
+   }
+
+   pthread_mutex_lock(&stats_mutex_);
+   for (map<pthread_t, ThreadStats*>::const_iterator it = thread_stats_.begin(); it != thread_stats_.end(); ++it) {
+      stats.arrivals_ += it->second->arrivals_.load(memory_order_relaxed);
+      stats.queue_wait_.merge(it->second->queue_wait_);
+      stats.service_.merge(it->second->service_);
+      stats.payment_.merge(it->second->payment_);
+      for (int c = 0; c < kMaxPriorityClasses; c++) {
+         stats.class_wait_[c].merge(it->second->class_wait_[c]);
+      }
+   }
+   pthread_mutex_unlock(&stats_mutex_);
+
+   stats.barbers_.resize(max_barbers_);
+   for (int i = 0; i < max_barbers_; i++) {
+      stats.barbers_[i].served_ = barber_info_[i].served_.load(memory_order_relaxed);
+      stats.barbers_[i].busy_ns_ = barber_info_[i].busy_ns_.load(memory_order_relaxed);
+      stats.barbers_[i].idle_ns_ = barber_info_[i].idle_ns_.load(memory_order_relaxed);
+      stats.served_ += stats.barbers_[i].served_;
+   }
+   return stats;
+}
+
+/**
+ * This returns the calling thread's statistics for this shop, creating 
+ * them on the thread's first use of the shop. 
+ * No other methods are called. 
+ * @return stats written only by the calling thread
+ * @custom.preconditions  none
+ * @custom.postconditions  stats registered with the shop
+ **/
+Shop::ThreadStats* Shop::threadStats()
+{
+   if (stats_owner_ != this) {
+      return stats_owner_->threadStats();
+   }
+   if (tls_stats_serial_ == serial_) {
+      return tls_stats_;
+   }
+
+   /** a thread id is only reused once its previous owner has exited */
+   pthread_t self = pthread_self();
+   pthread_mutex_lock(&stats_mutex_);
+   ThreadStats*& stats = thread_stats_[self];
+   if (stats == NULL) {
+      stats = new ThreadStats();
+   }
+   tls_stats_ = stats;
+   pthread_mutex_unlock(&stats_mutex_);
+   tls_stats_serial_ = serial_;
+   return tls_stats_;
+}
+
+/**
+ * Accounts the time a barber slept and starts timing its hair-cut. 
+ * No other methods are called. 
+ * @param id id of the barber
+ * @param hello_ns time the barber entered helloCustomer
+ * @return none
+ * @custom.preconditions  stats collected, called by the barber thread
+ * @custom.postconditions  idle time added, service start recorded
+ **/
+void Shop::statsStartService(int id, uint64_t hello_ns)
+{
+   PersonInfo& info = barber_info_[id];
+   uint64_t now = monotonicNs();
+   info.idle_ns_.store(info.idle_ns_.load(memory_order_relaxed) + (now - hello_ns), memory_order_relaxed);
+   info.service_start_ns_ = now;
+}
+
+/**
+ * Records the hair-cut and payment latencies of a finished customer 
+ * and the barber's busy time. 
+ * Calls threadStats method. 
+ * @param id id of the barber
+ * @param done_ns time the barber finished the hair-cut
+ * @return none
+ * @custom.preconditions  stats collected, called by the barber thread
+ * @custom.postconditions  service, payment and busy time recorded
+ **/
+void Shop::statsFinishService(int id, uint64_t done_ns)
+{
+   PersonInfo& info = barber_info_[id];
+   ThreadStats* stats = threadStats();
+   uint64_t now = monotonicNs();
+   stats->service_.record(done_ns - info.service_start_ns_);
+   stats->payment_.record(now - done_ns);
+   info.busy_ns_.store(info.busy_ns_.load(memory_order_relaxed) + (now - info.service_start_ns_), memory_order_relaxed);
+   info.served_.store(info.served_.load(memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+/**
+ * This is to be called by the customer threads to visit the shop. They 
+ * will check if there is a waiting chair, if not, they leave. If all 
+ * barbers are busy and there is a chair, they sit. Otherwise, they sit 
+ * in the next available barber chair. 
+ * Records events through SHOP_LOG. 
+ * @return id of barber servicing them, -1 if they leave without service
+ * @custom.preconditions  none
+ * @custom.postconditions  customer thread possibly serviced
+ **/
+int Shop::visitShop(int id)
+{
+   return visitShop(id, 0, 0);
+}
+
+/**
+ * This is to be called by customer threads of a priority class that 
+ * wait only so long for a barber. Class and patience are used by the 
+ * ticket waiting room, any other shop treats the customer like 
+ * visitShop(id). 
+ * Records events through SHOP_LOG. 
+ * @param id id of the visiting customer
+ * @param priority priority class, 0 to kMaxPriorityClasses - 1, 0 first
+ * @param patience_ns longest wait for a barber before the customer 
+ *        reneges, 0 to wait as long as it takes
+ * @return id of barber servicing them, -1 if they leave without service
+ * @custom.preconditions  none
+ * @custom.postconditions  customer thread possibly serviced
+ **/
+int Shop::visitShop(int id, int priority, uint64_t patience_ns)
+{
+   uint64_t arrival_ns = statsNow();
+   SHOP_LOG(kLogService, id, kEventArrives, priority, (int) min(patience_ns / 1000, (uint64_t) INT32_MAX));
+   if (options_.collect_stats_) {
+      ThreadStats* stats = threadStats();
+      stats->arrivals_.store(stats->arrivals_.load(memory_order_relaxed) + 1, memory_order_relaxed);
+   }
+   if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+      Shop* server = this;
+      return visitLockFree(id, arrival_ns, &server, true);
+   }
+   if (ticketed()) {
+      return visitTicket(id, priority, patience_ns, arrival_ns);
+   }
+   SHOP_LOCK(kSiteVisitRoom, &mutex_);
+
+   /** A closed shop lets nobody in */
+   if (closed_.load()) {
+      SHOP_LOG(kLogDrops, id, kEventBalkNoBarbers, 0, 0);
+      ++cust_drops_;
+      SHOP_UNLOCK(kSiteVisitRoom, &mutex_);
+      return -1;
+   }
+   
+   /** If all chairs are full then leave shop */
+   if (max_waiting_cust_ > 0) {
+      /** If someone is being served or transitioning waiting to service
+       * then take a chair and wait for service chair */
+      if (waiting_chairs_.size() == max_waiting_cust_) {
+         SHOP_LOG(kLogDrops, id, kEventBalkNoChairs, 0, 0);
+         ++cust_drops_;
+         SHOP_UNLOCK(kSiteVisitRoom, &mutex_);
+         return -1;
+      } else {
+         if (sleeping_barbers_.size() == 0 || !waiting_chairs_.empty()) {
+            waiting_chairs_.push(id);
+            updateGauges();
+            SHOP_LOG(kLogService, id, kEventTakesChair, 
+            max_waiting_cust_ - (int) waiting_chairs_.size(), 0);
+            /** Wait until a barber has gone back to sleep */
+            SHOP_WAIT(kSiteVisitRoom, &cond_customers_waiting_, &mutex_,
+                      [this] { return !sleeping_barbers_.empty(); });
+            waiting_chairs_.pop();
+            updateGauges();
+         }
+      }
+   }else {
+      if (sleeping_barbers_.size() == 0) {
+         SHOP_LOG(kLogDrops, id, kEventBalkNoBarbers, 0, 0);
+         ++cust_drops_;
+         SHOP_UNLOCK(kSiteVisitRoom, &mutex_);
+         return -1;
+      }
+   }
+   
+   int barber_id = takeFreeBarber();
+   int seats_available = max_waiting_cust_ - waiting_chairs_.size();
+   /** The last customer waiting in a closed shop lets the free barbers go */
+   if (closed_.load()) {
+      closeOutFreeBarbers();
+   }
+
+   SHOP_UNLOCK(kSiteVisitRoom, &mutex_);
+   seatWithBarber(id, barber_id, seats_available, arrival_ns);
+   return barber_id;
+}
+
+/**
+ * Lock-free waiting room version of visitShop. A free barber takes 
+ * the customer directly when nobody waits, otherwise it waits in a 
+ * chair until dispatch pairs it with a barber. 
+ * Calls reserveSeat, seatFree, dispatch and seatWithBarber methods. 
+ * @param id id of the visiting customer
+ * @param arrival_ns time the customer entered visitShop
+ * @param server receives the shop of the barber, a peer if stolen
+ * @param count_drop false to leave a turned away customer uncounted
+ * @return id of barber servicing them, -1 if they leave without service
+ * @custom.preconditions  lock-free waiting room selected
+ * @custom.postconditions  customer thread possibly serviced
+ **/
+int Shop::visitLockFree(int id, uint64_t arrival_ns, Shop** server, bool count_drop)
+{
+   int barber_id = -1;
+   *server = this;
+
+   /** A closed shop lets nobody in */
+   if (closed_.load()) {
+      if (count_drop) {
+         SHOP_LOG(kLogDrops, id, kEventBalkNoBarbers, 0, 0);
+         ++cust_drops_;
+      }
+      return -1;
+   }
+
+   /** 
+    * Like a sleeping barber of the locked room, a free barber takes the 
+    * customer at once when nobody waits, so no chair is needed 
+    */
+   if ((max_waiting_cust_ == 0 || waiting_count_.load() == 0) && free_barbers_->tryClaim(barber_id)) {
+      seatFree(id, barber_id, arrival_ns);
+      return barber_id;
+   }
+
+   /** Without waiting chairs only a free barber keeps the customer */
+   if (max_waiting_cust_ == 0) {
+      if (count_drop) {
+         SHOP_LOG(kLogDrops, id, kEventBalkNoBarbers, 0, 0);
+         ++cust_drops_;
+      }
+      return -1;
+   }
+
+   /** 
+    * If all chairs are full then leave shop, unless a barber came free 
+    * while the customers holding the chairs were still sitting down 
+    */
+   if (!reserveSeat()) {
+      if (free_barbers_->tryClaim(barber_id)) {
+         seatFree(id, barber_id, arrival_ns);
+         return barber_id;
+      }
+      if (count_drop) {
+         SHOP_LOG(kLogDrops, id, kEventBalkNoChairs, 0, 0);
+         ++cust_drops_;
+      }
+      return -1;
+   }
+   /** The shop may have closed while we sat down, see closeOutFreeBarbers */
+   if (closed_.load()) {
+      --waiting_count_;
+      closeOutFreeBarbers();
+      if (count_drop) {
+         SHOP_LOG(kLogDrops, id, kEventBalkNoBarbers, 0, 0);
+         ++cust_drops_;
+      }
+      return -1;
+   }
+
+   /** 
+    * The chair is ours, so the ring has room for the ticket once the 
+    * customer that last used the slot has finished reading it 
+    */
+   Ticket ticket;
+   ticket.customer_id_ = id;
+   while (!waiting_ring_->tryPush(&ticket)) {
+      sched_yield();
+   }
+   dispatch();
+
+   if (ticket.barber_id_.load(memory_order_acquire) == -1) {
+      SHOP_LOG(kLogService, id, kEventTakesChair, 
+      max_waiting_cust_ - waiting_count_.load(), 0);
+      ShopWait::waitWhile(&ticket.barber_id_, -1);
+   }
+   barber_id = ticket.barber_id_.load(memory_order_acquire);
+   *server = ticket.server_;
+
+   /** With the direct handoff whoever paired us already seated us */
+   if (options_.handoff_ == kDirectHandoff) {
+      if (options_.collect_stats_) {
+         threadStats()->queue_wait_.record(monotonicNs() - arrival_ns);
+      }
+      SHOP_LOG(kLogService, id, kEventMovesToChair, barber_id, max_waiting_cust_ - waiting_count_.load());
+      return barber_id;
+   }
+   (*server)->seatWithBarber(id, barber_id, max_waiting_cust_ - waiting_count_.load(), arrival_ns);
+   return barber_id;
+}
+
+/**
+ * Moves a customer of the lock-free waiting room straight into the 
+ * chair of a free barber it claimed, without taking a waiting chair. 
+ * Calls seatWithBarber method. 
+ * Records events through SHOP_LOG. 
+ * @param id id of the customer
+ * @param barber_id barber claimed from the free barbers
+ * @param arrival_ns time the customer entered visitShop
+ * @return none
+ * @custom.preconditions  lock-free waiting room selected
+ * @custom.postconditions  customer in the barber's chair, barber woken
+ **/
+void Shop::seatFree(int id, int barber_id, uint64_t arrival_ns)
+{
+   if (options_.handoff_ == kDirectHandoff) {
+      if (options_.collect_stats_) {
+         threadStats()->queue_wait_.record(monotonicNs() - arrival_ns);
+      }
+      SHOP_LOG(kLogService, id, kEventMovesToChair, barber_id, max_waiting_cust_ - waiting_count_.load());
+      barber_info_[barber_id].mailbox_.store(id);
+      futexWake(&barber_info_[barber_id].mailbox_, INT_MAX);
+      return;
+   }
+   seatWithBarber(id, barber_id, max_waiting_cust_ - waiting_count_.load(), arrival_ns);
+}
+
+/**
+ * Takes a waiting chair in the lock-free waiting room if one is free. 
+ * No other methods are called. 
+ * @return false if all waiting chairs are occupied
+ * @custom.preconditions  lock-free waiting room selected
+ * @custom.postconditions  waiting_count_ incremented on success
+ **/
+bool Shop::reserveSeat()
+{
+   int occupied = waiting_count_.load();
+   while (occupied < max_waiting_cust_) {
+      if (waiting_count_.compare_exchange_weak(occupied, occupied + 1)) {
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * Pairs free barbers with waiting customers of the lock-free waiting 
+ * room until one of the two runs out, waking each paired customer. 
+ * Called by customers after sitting down and by barbers after 
+ * becoming free, so whichever comes last makes the pairing. In a 
+ * franchise our waiting customers then go to free barbers of the 
+ * peers, and our free barbers steal the peers' waiting customers. 
+ * Calls dispatchBetween method. 
+ * @return none
+ * @custom.preconditions  lock-free waiting room selected
+ * @custom.postconditions  no customer waits while a barber is free
+ **/
+void Shop::dispatch()
+{
+   dispatchBetween(this, this);
+   for (size_t i = 0; i < peers_.size(); i++) {
+      dispatchBetween(this, peers_[i]);
+      dispatchBetween(peers_[i], this);
+   }
+   /** whoever empties the waiting room of a closed shop lets its barbers go */
+   if (closed_.load()) {
+      closeOutFreeBarbers();
+   }
+   for (size_t i = 0; i < peers_.size(); i++) {
+      if (peers_[i]->closed_.load()) {
+         peers_[i]->closeOutFreeBarbers();
+      }
+   }
+}
+
+/**
+ * Pairs free barbers of server with waiting customers of room until 
+ * one of the two runs out. 
+ * Calls assignBarber method. 
+ * @param room shop whose waiting customers are served
+ * @param server shop whose free barbers serve them
+ * @return none
+ * @custom.preconditions  both use the lock-free waiting room
+ * @custom.postconditions  room has no waiting customer or server no free barber
+ **/
+void Shop::dispatchBetween(Shop* room, Shop* server)
+{
+   /** 
+    * Both sides publish themselves before looking at the other, so at 
+    * least one of a racing customer and barber sees the pair 
+    */
+   while (room->waiting_count_.load() > 0 && !server->free_barbers_->empty()) {
+      int barber_id = -1;
+      if (!server->free_barbers_->tryClaim(barber_id)) {
+         return;
+      }
+      Ticket* ticket = NULL;
+      if (!room->waiting_ring_->tryPop(ticket)) {
+         /** seated customer has not pushed its ticket yet, try again */
+         server->free_barbers_->release(barber_id);
+         continue;
+      }
+      --room->waiting_count_;
+      server->assignBarber(ticket, barber_id);
+   }
+}
+
+/**
+ * Hands a waiting customer's ticket to a barber and wakes the customer. 
+ * With the direct handoff the customer is also put in the barber's 
+ * chair, waking the barber. 
+ * No other methods are called. 
+ * @param ticket ticket of the waiting customer
+ * @param barber_id free barber reserved for the customer
+ * @return none
+ * @custom.preconditions  ticket taken off the waiting room
+ * @custom.postconditions  customer woken with its barber
+ **/
+void Shop::assignBarber(Ticket* ticket, int barber_id)
+{
+   /** 
+    * The chair is filled before the customer learns its barber, so its 
+    * leaveShop never sees the previous customer's mailbox value 
+    */
+   if (options_.handoff_ == kDirectHandoff) {
+      barber_info_[barber_id].mailbox_.store(ticket->customer_id_);
+      futexWake(&barber_info_[barber_id].mailbox_, INT_MAX);
+   }
+   /** the ticket may vanish once barber_id_ is set, waking it late is harmless */
+   ticket->server_ = this;
+   ticket->barber_id_.store(barber_id, memory_order_release);
+   futexWake(&ticket->barber_id_, 1);
+}
+
+/**
+ * Moves a customer into the service chair of a barber they were 
+ * paired with and wakes the barber. 
+ * Records events through SHOP_LOG. 
+ * @param id id of the customer
+ * @param barber_id id of the barber the customer was paired with
+ * @param seats_available number of free waiting chairs to report
+ * @param arrival_ns time the customer entered visitShop
+ * @return none
+ * @custom.preconditions  barber_id is reserved for this customer
+ * @custom.postconditions  barber signaled to start the hair-cut
+ **/
+void Shop::seatWithBarber(int id, int barber_id, int seats_available, uint64_t arrival_ns)
+{
+   if (options_.collect_stats_) {
+      threadStats()->queue_wait_.record(monotonicNs() - arrival_ns);
+   }
+   SHOP_LOG(kLogService, id, kEventMovesToChair, barber_id, seats_available);
+
+   SHOP_LOCK(kSiteVisitChair, &(barber_info_[barber_id].mutex_lock_));
+
+   barber_info_[barber_id].cust_in_chair_ = id;
+   barber_info_[barber_id].in_service_ = true;
+
+   /** Wake up the barber in case he is sleeping */
+   pthread_cond_signal(&(barber_info_[barber_id].cond_barber_sleeping_));
+   SHOP_UNLOCK(kSiteVisitChair, &(barber_info_[barber_id].mutex_lock_));
+}
+
+/**
+ * This is to be called by the customer threads who have been seen by a 
+ * barber. Their service will be finished and then they wait before paying. 
+ * Records events through SHOP_LOG.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  customer thread service is completed. 
+ **/
+void Shop::leaveShop(int customer_id, int barber_id)
+{
+   /** The barber empties or refills the mailbox once paid and done */
+   if (options_.handoff_ == kDirectHandoff) {
+      atomic<int>& mailbox = barber_info_[barber_id].mailbox_;
+      SHOP_LOG(kLogVerbose, customer_id, kEventWaitsForHaircut, barber_id, 0);
+      ShopWait::waitWhile(&mailbox, customer_id);
+      SHOP_LOG(kLogService, customer_id, kEventSaysGoodbye, barber_id, 0);
+      return;
+   }
+   if (ticketed()) {
+      leaveBatch(customer_id, barber_id);
+      return;
+   }
+
+   PersonInfo& barber = barber_info_[barber_id];
+   SHOP_LOCK(kSiteLeaveServed, &(barber.mutex_lock_));
+   /** Wait for service to be completed */
+   SHOP_LOG(kLogVerbose, customer_id, kEventWaitsForHaircut, barber_id, 0);
+   
+   SHOP_WAIT(kSiteLeaveServed, &(barber.cond_cust_served_), &(barber.mutex_lock_),
+             [&barber] { return !barber.in_service_; });
+
+   /** Pay the barber and signal barber appropriately */
+   barber_info_[barber_id].money_paid_ = true;
+   pthread_cond_signal(&(barber_info_[barber_id].cond_barber_paid_));
+   SHOP_LOG(kLogService, customer_id, kEventSaysGoodbye, barber_id, 0);
+   SHOP_UNLOCK(kSiteLeaveServed, &(barber_info_[barber_id].mutex_lock_));
+}
+ 
+/**
+ * This is to be called by the barber threads. Barber checks if 
+ * there are any customers waiting or in their chair and then service 
+ * them. If not, they sleep and wait to be signaled by a customer. 
+ * Once they have a customer, they begin the haircut.
+ * Records events through SHOP_LOG. 
+ * @return true if a hair-cut started, false if the barber was retired 
+ *         and must not call the shop again until it is added back
+ * @custom.preconditions  none
+ * @custom.postconditions  customer thread service is started. 
+ **/
+bool Shop::helloCustomer(int id)
+{
+   uint64_t hello_ns = statsNow();
+   if (options_.handoff_ == kDirectHandoff) {
+      return helloDirect(id, hello_ns);
+   }
+
+   PersonInfo& barber = barber_info_[id];
+   /** 
+    * Free barbers of the lock-free waiting room only wait for their chair, 
+    * and so do batching barbers, which claim their customers themselves 
+    */
+   if (options_.waiting_room_ == kLockFreeWaitingRoom || ticketed()) {
+      SHOP_LOCK(kSiteHelloChair, &(barber.mutex_lock_));
+      if (barber.cust_in_chair_ == 0 && !barber.retired_) {
+         SHOP_LOG(kLogVerbose, 0 - id, kEventBarberSleeps, 0, 0);
+      }
+   } else {
+      SHOP_LOCK(kSiteHelloRoom, &mutex_);
+      SHOP_LOCK(kSiteHelloChair, &(barber_info_[id].mutex_lock_));
+
+      /** If no customers then barber can sleep */
+      if (waiting_chairs_.empty() && barber_info_[id].cust_in_chair_ == 0 && !barber.retired_) {
+         SHOP_LOG(kLogVerbose, 0 - id, kEventBarberSleeps, 0, 0);
+      }
+      SHOP_UNLOCK(kSiteHelloRoom, &mutex_);
+   }
+
+   /** Sleep until a customer sat in barber chair or we are retired */
+   SHOP_WAIT(kSiteHelloChair, &(barber.cond_barber_sleeping_), &(barber.mutex_lock_),
+             [&barber] { return barber.cust_in_chair_ != 0 || barber.retired_; });
+   if (barber.cust_in_chair_ == 0) {
+      barber.retired_ = false;
+      SHOP_UNLOCK(kSiteHelloChair, &(barber.mutex_lock_));
+      if (barber.slot_.load() == kSlotRetiring) {
+         finishRetire(id);
+      } else {
+         finishClose();
+      }
+      return false;
+   }
+   SHOP_LOG(kLogService, 0 - id, kEventStartsHaircut, barber_info_[id].cust_in_chair_, 0);
+   if (options_.collect_stats_) {
+      statsStartService(id, hello_ns);
+   }
+   SHOP_UNLOCK(kSiteHelloChair, &(barber_info_[id].mutex_lock_));
+   return true;
+}
+
+/**
+ * This is to be called by the barber threads. This is where they finish 
+ * the haircut and take payment from one customer thread and then signal 
+ * another waiting customer thread. 
+ * Records events through SHOP_LOG.  
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  customer thread service is finished
+ **/
+void Shop::byeCustomer(int id)
+{
+   if (options_.handoff_ == kDirectHandoff) {
+      byeDirect(id);
+      return;
+   }
+   if (ticketed()) {
+      byeBatch(id);
+      return;
+   }
+
+   SHOP_LOCK(kSiteByePaid, &(barber_info_[id].mutex_lock_));
+   uint64_t done_ns = statsNow();
+
+  /** Hair Cut-Service is completed, signal customer and wait for payment */
+  SHOP_LOG(kLogService, 0 - id, kEventDoneHaircut, barber_info_[id].cust_in_chair_, 0);
+  
+  barber_info_[id].in_service_ = false;
+  barber_info_[id].money_paid_ = false;
+  pthread_cond_signal(&(barber_info_[id].cond_cust_served_));
+  
+  PersonInfo& barber = barber_info_[id];
+  SHOP_WAIT(kSiteByePaid, &(barber.cond_barber_paid_), &(barber.mutex_lock_),
+            [&barber] { return barber.money_paid_; });
+  if (options_.collect_stats_) {
+     statsFinishService(id, done_ns);
+  }
+
+  barber_info_[id].cust_in_chair_ = 0;
+  /** Signal to customer to get next one */
+  SHOP_LOG(kLogVerbose, 0 - id, kEventCallsNext, 0, 0);
+  SHOP_UNLOCK(kSiteByePaid, &(barber_info_[id].mutex_lock_));
+  atomic<int>& slot = barber_info_[id].slot_;
+  if (options_.waiting_room_ == kLockFreeWaitingRoom) {
+     if (slot.load() == kSlotRetiring) {
+        markRetired(id);
+        return;
+     }
+     free_barbers_->release(id);
+     /** retireBarber may have looked for us before we were free */
+     if (slot.load() == kSlotRetiring && free_barbers_->tryRemove(id)) {
+        markRetired(id);
+        return;
+     }
+     dispatch();
+     return;
+  }
+  SHOP_LOCK(kSiteByeRoom, &mutex_);
+  if (slot.load() == kSlotRetiring) {
+     SHOP_UNLOCK(kSiteByeRoom, &mutex_);
+     markRetired(id);
+     return;
+  }
+  sleeping_barbers_.push_back(id);
+  updateGauges();
+  pthread_cond_signal(&cond_customers_waiting_);
+  if (closed_.load()) {
+     closeOutFreeBarbers();
+  }
+  SHOP_UNLOCK(kSiteByeRoom, &mutex_);
+}
+
+/**
+ * Direct handoff version of helloCustomer. 
+ * Records events through SHOP_LOG. 
+ * @param id id of the barber
+ * @param hello_ns time the barber entered helloCustomer
+ * @return false if the barber was retired
+ * @custom.preconditions  direct handoff selected
+ * @custom.postconditions  customer in chair, hair-cut started
+ **/
+bool Shop::helloDirect(int id, uint64_t hello_ns)
+{
+   atomic<int>& mailbox = barber_info_[id].mailbox_;
+   int customer_id = mailbox.load(memory_order_acquire);
+   if (customer_id == 0) {
+      SHOP_LOG(kLogVerbose, 0 - id, kEventBarberSleeps, 0, 0);
+      ShopWait::waitWhile(&mailbox, 0);
+      customer_id = mailbox.load(memory_order_acquire);
+   }
+   if (customer_id == kMailboxRetired) {
+      mailbox.store(0);
+      if (barber_info_[id].slot_.load() == kSlotRetiring) {
+         finishRetire(id);
+      } else {
+         finishClose();
+      }
+      return false;
+   }
+   SHOP_LOG(kLogService, 0 - id, kEventStartsHaircut, customer_id, 0);
+   if (options_.collect_stats_) {
+      statsStartService(id, hello_ns);
+   }
+   return true;
+}
+
+/**
+ * Direct handoff version of byeCustomer. Finishes the hair-cut and 
+ * releases the customer with one mailbox store that also seats the 
+ * next waiting customer, if any. 
+ * Calls dispatch and assignBarber methods. 
+ * @param id id of the barber
+ * @return none
+ * @custom.preconditions  direct handoff selected
+ * @custom.postconditions  customer released, barber busy or free
+ **/
+void Shop::byeDirect(int id)
+{
+   atomic<int>& mailbox = barber_info_[id].mailbox_;
+   uint64_t done_ns = statsNow();
+   SHOP_LOG(kLogService, 0 - id, kEventDoneHaircut, mailbox.load(memory_order_relaxed), 0);
+
+   /** Pull the next waiting customer straight into our own chair */
+   Ticket* next = NULL;
+   bool retiring = barber_info_[id].slot_.load() == kSlotRetiring;
+   if (!retiring && waiting_count_.load() > 0 && waiting_ring_->tryPop(next)) {
+      --waiting_count_;
+   }
+   if (options_.collect_stats_) {
+      statsFinishService(id, done_ns);
+   }
+
+   SHOP_LOG(kLogVerbose, 0 - id, kEventCallsNext, 0, 0);
+   if (next != NULL) {
+      assignBarber(next, id);
+      return;
+   }
+
+   /** Retiring: the retired mark releases the customer as well */
+   if (retiring) {
+      markRetired(id);
+      return;
+   }
+
+   /** Nobody waiting: empty the chair, which releases the customer */
+   mailbox.store(0);
+   futexWake(&mailbox, INT_MAX);
+   free_barbers_->release(id);
+   /** retireBarber may have looked for us before we were free */
+   if (barber_info_[id].slot_.load() == kSlotRetiring && free_barbers_->tryRemove(id)) {
+      markRetired(id);
+      return;
+   }
+   dispatch();
+}
+
+/**
+ * Ticket waiting room version of visitShop. A 
+ * customer that finds no free barber parks on a ticket until a barber 
+ * claims it or, with reneging, until its patience runs out. 
+ * Calls takeFreeBarber, shortestWaitBarber, seatBatch and removeTicket methods. 
+ * Records events through SHOP_LOG. 
+ * @param id id of the visiting customer
+ * @param priority priority class of the customer
+ * @param patience_ns longest wait for a barber, 0 for no limit
+ * @param arrival_ns time the customer entered visitShop
+ * @return id of barber servicing them, -1 if they leave without service
+ * @custom.preconditions  ticket waiting room selected
+ * @custom.postconditions  customer thread possibly serviced
+ **/
+int Shop::visitTicket(int id, int priority, uint64_t patience_ns, uint64_t arrival_ns)
+{
+   if (priority < 0) {
+      priority = 0;
+   } else if (priority >= kMaxPriorityClasses) {
+      priority = kMaxPriorityClasses - 1;
+   }
+   Ticket ticket;
+   ticket.customer_id_ = id;
+   ticket.priority_ = priority;
+   if (options_.reneging_ && patience_ns > 0) {
+      ticket.deadline_ns_ = monotonicNs() + patience_ns;
+   }
+
+   SHOP_LOCK(kSiteVisitRoom, &mutex_);
+
+   /** A closed shop lets nobody in */
+   if (closed_.load()) {
+      SHOP_LOG(kLogDrops, id, kEventBalkNoBarbers, 0, 0);
+      ++cust_drops_;
+      SHOP_UNLOCK(kSiteVisitRoom, &mutex_);
+      return -1;
+   }
+
+   /** A barber only sleeps after finding nobody to claim, so it is ours */
+   if (!sleeping_barbers_.empty()) {
+      int barber_id = takeFreeBarber();
+      int seats_available = max_waiting_cust_ - num_tickets_;
+      SHOP_UNLOCK(kSiteVisitRoom, &mutex_);
+      if (options_.collect_stats_) {
+         ThreadStats* stats = threadStats();
+         uint64_t wait_ns = monotonicNs() - arrival_ns;
+         stats->queue_wait_.record(wait_ns);
+         stats->class_wait_[priority].record(wait_ns);
+      }
+      SHOP_LOG(kLogService, id, kEventMovesToChair, barber_id, seats_available);
+      seatBatch(kSiteVisitChair, barber_id, &id, 1);
+      return barber_id;
+   }
+
+   /** If all chairs are full then leave shop */
+   if (num_tickets_ == max_waiting_cust_) {
+      SHOP_LOG(kLogDrops, id, (max_waiting_cust_ > 0) ? kEventBalkNoChairs : kEventBalkNoBarbers, 0, 0);
+      ++cust_drops_;
+      SHOP_UNLOCK(kSiteVisitRoom, &mutex_);
+      return -1;
+   }
+   ticket.seq_ = next_ticket_seq_++;
+   if (options_.barber_dispatch_ == kBarberShortestWait) {
+      ticket.barber_pick_ = shortestWaitBarber();
+      if (ticket.barber_pick_ >= 0) {
+         ++barber_info_[ticket.barber_pick_].queued_;
+      }
+   }
+   ticket_queues_[priority].push_back(&ticket);
+   ++num_tickets_;
+   updateGauges();
+   int seats_available = max_waiting_cust_ - num_tickets_;
+   SHOP_UNLOCK(kSiteVisitRoom, &mutex_);
+   SHOP_LOG(kLogService, id, kEventTakesChair, seats_available, 0);
+
+   /** Wait until a free barber claims us, mutex_ is not taken again */
+   while (ticket.barber_id_.load(memory_order_acquire) == -1) {
+      if (ticket.deadline_ns_ == UINT64_MAX) {
+         ShopWait::waitWhile(&ticket.barber_id_, -1);
+         break;
+      }
+      uint64_t now_ns = monotonicNs();
+      if (now_ns < ticket.deadline_ns_) {
+         futexWaitFor(&ticket.barber_id_, -1, ticket.deadline_ns_ - now_ns);
+         continue;
+      }
+
+      /** Out of patience: leave unless a barber took the ticket meanwhile */
+      SHOP_LOCK(kSiteVisitRoom, &mutex_);
+      bool reneged = removeTicket(&ticket);
+      SHOP_UNLOCK(kSiteVisitRoom, &mutex_);
+      if (reneged) {
+         SHOP_LOG(kLogDrops, id, kEventReneges, priority, 0);
+         ++class_reneges_[priority];
+         return -1;
+      }
+      ShopWait::waitWhile(&ticket.barber_id_, -1);
+   }
+   int barber_id = ticket.barber_id_.load(memory_order_acquire);
+   if (options_.collect_stats_) {
+      ThreadStats* stats = threadStats();
+      uint64_t wait_ns = monotonicNs() - arrival_ns;
+      stats->queue_wait_.record(wait_ns);
+      stats->class_wait_[priority].record(wait_ns);
+   }
+   SHOP_LOG(kLogService, id, kEventMovesToChair, barber_id, seats_available);
+   return barber_id;
+}
+
+/**
+ * Takes a free barber out of the sleeping barbers by the barber 
+ * dispatch of ShopOptions. 
+ * No other methods are called. 
+ * @return id of the barber
+ * @custom.preconditions  sleeping_barbers_ not empty, mutex_ held
+ * @custom.postconditions  barber reserved for the caller
+ **/
+int Shop::takeFreeBarber()
+{
+   size_t best = 0;
+   if (options_.barber_dispatch_ != kBarberFifo) {
+      /** ties go to the barber that has been free longest */
+      for (size_t i = 1; i < sleeping_barbers_.size(); i++) {
+         if (barber_info_[sleeping_barbers_[i]].speed_ > barber_info_[sleeping_barbers_[best]].speed_) {
+            best = i;
+         }
+      }
+   }
+   int barber_id = sleeping_barbers_[best];
+   sleeping_barbers_.erase(sleeping_barbers_.begin() + best);
+   updateGauges();
+   return barber_id;
+}
+
+/**
+ * This returns the working barber whose queue a customer that finds 
+ * every barber busy is expected to leave first. 
+ * No other methods are called. 
+ * @return id of the barber, -1 if no barber is working
+ * @custom.preconditions  kBarberShortestWait, mutex_ held
+ * @custom.postconditions  none
+ **/
+int Shop::shortestWaitBarber()
+{
+   int best = -1;
+   double best_wait = 0.0;
+   for (int id = 0; id < max_barbers_; id++) {
+      if (barber_info_[id].slot_.load() != kSlotActive) {
+         continue;
+      }
+      /** the customer in the chair and the queued ones, in mean hair-cuts */
+      double wait = (barber_info_[id].queued_ + 1) / barber_info_[id].speed_;
+      if (best < 0 || wait < best_wait) {
+         best = id;
+         best_wait = wait;
+      }
+   }
+   return best;
+}
+
+/**
+ * Takes the next waiting customer of a free barber off the ticket 
+ * queues, from the barber's own queue first with shortest expected 
+ * wait dispatch. 
+ * Calls pickTicket method. 
+ * @param now_ns current time, 0 to ignore patience
+ * @param barber_id id of the free barber
+ * @return ticket of the customer, NULL if nobody waits
+ * @custom.preconditions  ticket waiting room selected, mutex_ held
+ * @custom.postconditions  ticket off the queues
+ **/
+Shop::Ticket* Shop::nextTicket(uint64_t now_ns, int barber_id)
+{
+   Ticket* ticket = NULL;
+   if (options_.barber_dispatch_ == kBarberShortestWait) {
+      ticket = pickTicket(now_ns, barber_id);
+   }
+   /** with our own queue empty, help the other barbers rather than sleep */
+   if (ticket == NULL) {
+      ticket = pickTicket(now_ns, -1);
+   }
+   return ticket;
+}
+
+/**
+ * Takes the next waiting customer off the ticket queues by the 
+ * dispatch policy. Customers whose patience has run out are left for 
+ * themselves to take back. 
+ * No other methods are called. 
+ * @param now_ns current time, 0 to ignore patience
+ * @param owner only take customers that joined this barber's queue, 
+ *        -1 to take any customer
+ * @return ticket of the customer, NULL if nobody eligible waits
+ * @custom.preconditions  ticket waiting room selected, mutex_ held
+ * @custom.postconditions  ticket off the queues
+ **/
+Shop::Ticket* Shop::pickTicket(uint64_t now_ns, int owner)
+{
+   /** first ticket of each class still worth serving, -1 if none */
+   int first[kMaxPriorityClasses];
+   for (int c = 0; c < kMaxPriorityClasses; c++) {
+      first[c] = -1;
+      for (size_t i = 0; i < ticket_queues_[c].size(); i++) {
+         if (ticket_queues_[c][i]->deadline_ns_ > now_ns &&
+             (owner < 0 || ticket_queues_[c][i]->barber_pick_ == owner)) {
+            first[c] = (int) i;
+            break;
+         }
+      }
+   }
+
+   int best_class = -1;
+   int best_index = -1;
+   switch (options_.dispatch_) {
+   case kDispatchStrict:
+      for (int c = 0; c < kMaxPriorityClasses && best_class < 0; c++) {
+         if (first[c] >= 0) {
+            best_class = c;
+            best_index = first[c];
+         }
+      }
+      break;
+   case kDispatchWeighted: {
+      /** smooth weighted round robin over the classes that have someone */
+      int total_weight = 0;
+      for (int c = 0; c < kMaxPriorityClasses; c++) {
+         if (first[c] < 0) {
+            continue;
+         }
+         class_credit_[c] += options_.class_weights_[c];
+         total_weight += options_.class_weights_[c];
+         if (best_class < 0 || class_credit_[c] > class_credit_[best_class]) {
+            best_class = c;
+            best_index = first[c];
+         }
+      }
+      if (best_class >= 0) {
+         class_credit_[best_class] -= total_weight;
+      }
+      break;
+   }
+   case kDispatchEarliestDeadline:
+      /** deadlines are not ordered within a class, the chairs are few */
+      for (int c = 0; c < kMaxPriorityClasses; c++) {
+         if (first[c] < 0) {
+            continue;
+         }
+         for (size_t i = first[c]; i < ticket_queues_[c].size(); i++) {
+            Ticket* ticket = ticket_queues_[c][i];
+            if (ticket->deadline_ns_ <= now_ns || (owner >= 0 && ticket->barber_pick_ != owner)) {
+               continue;
+            }
+            if (best_class < 0) {
+               best_class = c;
+               best_index = (int) i;
+               continue;
+            }
+            Ticket* best = ticket_queues_[best_class][best_index];
+            if (ticket->deadline_ns_ < best->deadline_ns_ ||
+                (ticket->deadline_ns_ == best->deadline_ns_ && ticket->seq_ < best->seq_)) {
+               best_class = c;
+               best_index = (int) i;
+            }
+         }
+      }
+      break;
+   default:
+      for (int c = 0; c < kMaxPriorityClasses; c++) {
+         if (first[c] >= 0 && (best_class < 0 ||
+             ticket_queues_[c][first[c]]->seq_ < ticket_queues_[best_class][best_index]->seq_)) {
+            best_class = c;
+            best_index = first[c];
+         }
+      }
+      break;
+   }
+   if (best_class < 0) {
+      return NULL;
+   }
+   Ticket* ticket = ticket_queues_[best_class][best_index];
+   ticket_queues_[best_class].erase(ticket_queues_[best_class].begin() + best_index);
+   --num_tickets_;
+   updateGauges();
+   if (ticket->barber_pick_ >= 0) {
+      --barber_info_[ticket->barber_pick_].queued_;
+   }
+   return ticket;
+}
+
+/**
+ * Takes a ticket off the ticket queues if it is still there. 
+ * No other methods are called. 
+ * @param ticket ticket of a waiting customer
+ * @return false if a barber already claimed the ticket
+ * @custom.preconditions  ticket waiting room selected, mutex_ held
+ * @custom.postconditions  ticket off the queues
+ **/
+bool Shop::removeTicket(Ticket* ticket)
+{
+   deque<Ticket*>& tickets = ticket_queues_[ticket->priority_];
+   for (deque<Ticket*>::iterator it = tickets.begin(); it != tickets.end(); ++it) {
+      if (*it == ticket) {
+         tickets.erase(it);
+         --num_tickets_;
+         updateGauges();
+         if (ticket->barber_pick_ >= 0) {
+            --barber_info_[ticket->barber_pick_].queued_;
+         }
+         return true;
+      }
+   }
+   return false;
+}
+
+/**
+ * Claims up to batch_size_ waiting customers for a free barber in one 
+ * critical section and wakes them, or puts the barber to sleep if 
+ * nobody waits. 
+ * Calls nextTicket, seatBatch and markRetired methods. 
+ * @param id id of the free barber
+ * @return none
+ * @custom.preconditions  ticket waiting room selected, barber has no batch
+ * @custom.postconditions  barber has a batch, sleeps or is retired
+ **/
+void Shop::claimBatch(int id)
+{
+   Ticket* tickets[kMaxBatchSize];
+   int ids[kMaxBatchSize];
+   int count = 0;
+   uint64_t now_ns = options_.reneging_ ? monotonicNs() : 0;
+
+   SHOP_LOCK(kSiteByeRoom, &mutex_);
+   if (barber_info_[id].slot_.load() == kSlotRetiring) {
+      SHOP_UNLOCK(kSiteByeRoom, &mutex_);
+      markRetired(id);
+      return;
+   }
+   while (count < options_.batch_size_ && (tickets[count] = nextTicket(now_ns, id)) != NULL) {
+      ids[count] = tickets[count]->customer_id_;
+      ++count;
+   }
+   /** Nobody left to claim in a closed shop: the barber goes, not sleeps */
+   bool closed_out = count == 0 && closed_.load();
+   if (count == 0 && !closed_out) {
+      sleeping_barbers_.push_back(id);
+      updateGauges();
+   }
+   SHOP_UNLOCK(kSiteByeRoom, &mutex_);
+   if (closed_out) {
+      markRetired(id);
+      return;
+   }
+   if (count == 0) {
+      return;
+   }
+
+   /** The batch is in place before any of its customers can leave */
+   seatBatch(kSiteHelloChair, id, ids, count);
+   for (int i = 0; i < count; i++) {
+      /** the ticket may vanish once barber_id_ is set, waking it late is harmless */
+      tickets[i]->barber_id_.store(id, memory_order_release);
+      futexWake(&tickets[i]->barber_id_, 1);
+   }
+}
+
+/**
+ * Hands a batch of customers to a barber, the first one in its chair, 
+ * and wakes the barber. 
+ * No other methods are called. 
+ * @param site LockSite the barber's mutex is profiled at
+ * @param barber_id id of the barber
+ * @param ids ids of the customers in service order
+ * @param count number of customers, 1 to batch_size_
+ * @return none
+ * @custom.preconditions  barber reserved for the batch
+ * @custom.postconditions  barber signaled to start the first hair-cut
+ **/
+void Shop::seatBatch(int site, int barber_id, const int* ids, int count)
+{
+   PersonInfo& barber = barber_info_[barber_id];
+   SHOP_LOCK(site, &(barber.mutex_lock_));
+   for (int i = 0; i < count; i++) {
+      barber.batch_[i] = ids[i];
+   }
+   barber.batch_count_ = count;
+   barber.batch_next_ = 0;
+   barber.cust_in_chair_ = ids[0];
+
+   /** Wake up the barber in case he is sleeping */
+   pthread_cond_signal(&(barber.cond_barber_sleeping_));
+   SHOP_UNLOCK(site, &(barber.mutex_lock_));
+}
+
+/**
+ * Ticket waiting room version of leaveShop, where barbers serve 
+ * batches of one or more. Waits until the customer's whole batch is 
+ * done and pays. 
+ * Records events through SHOP_LOG. 
+ * @param customer_id id of the customer
+ * @param barber_id id of the barber servicing them
+ * @return none
+ * @custom.preconditions  ticket waiting room selected
+ * @custom.postconditions  customer thread service is completed
+ **/
+void Shop::leaveBatch(int customer_id, int barber_id)
+{
+   PersonInfo& barber = barber_info_[barber_id];
+   SHOP_LOCK(kSiteLeaveServed, &(barber.mutex_lock_));
+   SHOP_LOG(kLogVerbose, customer_id, kEventWaitsForHaircut, barber_id, 0);
+
+   /** The barber starts no other batch until all of ours have paid */
+   SHOP_WAIT(kSiteLeaveServed, &(barber.cond_cust_served_), &(barber.mutex_lock_),
+             [&barber] { return barber.batch_done_; });
+
+   /** Pay the barber, the last one to pay signals him */
+   if (++barber.batch_paid_ == barber.batch_count_) {
+      pthread_cond_signal(&(barber.cond_barber_paid_));
+   }
+   SHOP_LOG(kLogService, customer_id, kEventSaysGoodbye, barber_id, 0);
+   SHOP_UNLOCK(kSiteLeaveServed, &(barber.mutex_lock_));
+}
+
+/**
+ * Ticket waiting room version of byeCustomer. Calls the next customer 
+ * of the batch into the chair, or releases the whole batch, waits for 
+ * all payments and claims the next batch. 
+ * Calls claimBatch method. 
+ * Records events through SHOP_LOG. 
+ * @param id id of the barber
+ * @return none
+ * @custom.preconditions  ticket waiting room selected
+ * @custom.postconditions  next hair-cut due, or batch finished
+ **/
+void Shop::byeBatch(int id)
+{
+   PersonInfo& barber = barber_info_[id];
+   SHOP_LOCK(kSiteByePaid, &(barber.mutex_lock_));
+   uint64_t done_ns = statsNow();
+   SHOP_LOG(kLogService, 0 - id, kEventDoneHaircut, barber.cust_in_chair_, 0);
+
+   /** More of the batch left: call the next one in, nobody is woken */
+   if (++barber.batch_next_ < barber.batch_count_) {
+      if (options_.collect_stats_) {
+         statsFinishService(id, done_ns);
+      }
+      barber.cust_in_chair_ = barber.batch_[barber.batch_next_];
+      SHOP_UNLOCK(kSiteByePaid, &(barber.mutex_lock_));
+      return;
+   }
+
+   /** Batch done: release every customer at once and wait for all payments */
+   barber.batch_done_ = true;
+   pthread_cond_broadcast(&(barber.cond_cust_served_));
+   SHOP_WAIT(kSiteByePaid, &(barber.cond_barber_paid_), &(barber.mutex_lock_),
+             [&barber] { return barber.batch_paid_ == barber.batch_count_; });
+   if (options_.collect_stats_) {
+      statsFinishService(id, done_ns);
+   }
+   barber.batch_done_ = false;
+   barber.batch_count_ = 0;
+   barber.batch_next_ = 0;
+   barber.batch_paid_ = 0;
+   barber.cust_in_chair_ = 0;
+   SHOP_LOG(kLogVerbose, 0 - id, kEventCallsNext, 0, 0);
+   SHOP_UNLOCK(kSiteByePaid, &(barber.mutex_lock_));
+   claimBatch(id);
+}
@@ -1,204 +1,1014 @@
-/**
- * @author  Marissa Christenson
- * @since   05/01/21
- * Shop.h
- * 
- * This is the Shop.h file that defines the Shop class. This class consists 
- * of several private variables, some of which include max_waiting_cust_, the 
- * maximum number of customer threads that are allowed to wait, max_barbers_, 
- * the number of barber threads that will be using the Shop object, 
- * waiting_chairs, the number of customer threads waiting, sleeping_barbers_,  
- * the number of sleeping barber threads. 
- *
- * This class has many private variables that are stated below, as well as 
- * PersonInfo struct that includes information that is unique amongst each 
- * barber. The maximum number of waiting chairs, the number of barbers, the 
- * available barbers, the waiting customer threads, mutex_ and 
- * cond_customers_waiting_ are available to all the threads as public data. 
- * 
- * Each struct that barber_info_ points to is unique to each barber thread 
- * and is only access by the barber thread and its associated customer 
- * thread. It includes the barber id, id of customer in the barber's chair, 
- * info on whether the customer is being serviced, info about barber payments, 
- * a mutex and conditional variables used to synchronize access to this data. 
- **/
-#ifndef SHOP_ORG_H_
-#define SHOP_ORG_H_
-#include <pthread.h>
-#include <iostream>
-#include <sstream>
-#include <string>
-#include <queue>
-using namespace std;
-
-#define kDefaultNumChairs 3
-#define kDefaultNumBarbers 1
-
-class Shop 
-{
-public:
-
-   /**
-    * This is the overloaded constructor that takes an integer for the number of 
-    * specified barbers and an integer for the number of specified chairs. 
-    * Calls init method to initialize mutex and conditional variables
-    * @param num_barbers number of barbers 
-    * @param num_chairs maximum number of waiting customers there can be
-    * @return none
-    * @custom.preconditions  num_barbers >= 1, num_chairs >= 0
-    * @custom.postconditions  A Shop object is instantiated
-    **/
-   Shop(int num_barbers, int num_chairs) : max_barbers_(num_barbers), max_waiting_cust_(num_chairs), cust_drops_(0)
-   { 
-      init(); 
-   };
-
-   /**
-    * This is the default constructor that generates a new Shop with default 
-    * values, 3 chairs and 1 barber. 
-    * Calls init method to initialize mutex and conditional variables
-    * @return none
-    * @custom.preconditions  none
-    * @custom.postconditions  A Shop object is instantiated
-    **/
-   Shop() : max_barbers_(kDefaultNumBarbers), max_waiting_cust_(kDefaultNumChairs), cust_drops_(0)
-   { 
-      init();
-   };
-
-   /**
-    * Destructor for Shop class. 
-    * No other methods are called. 
-    * @return none
-    * @custom.preconditions  none
-    * @custom.postconditions  Shop class destroyed. 
-    **/
-   ~Shop();
-
-   /**
-    * This is to be called by the customer threads to visit the shop. They 
-    * will check if there is a waiting chair, if not, they leave. If all 
-    * barbers are busy and there is a chair, they sit. Otherwise, they sit 
-    * in the next available barber chair. 
-    * Calls print and int2string methods. 
-    * @return id of barber servicing them, -1 if they leave without service
-    * @custom.preconditions  none
-    * @custom.postconditions  customer thread possibly serviced
-    **/
-   int visitShop(int id);
-   
-   /**
-    * This is to be called by the customer threads who have been seen by a 
-    * barber. Their service will be finished and then they wait before paying. 
-    * Calls print method.
-    * @return none
-    * @custom.preconditions  none
-    * @custom.postconditions  customer thread service is completed. 
-    **/
-   void leaveShop(int customer_id, int barber_id);
-   
-   /**
-    * This is to be called by the barber threads. Barber checks if 
-    * there are any customers waiting or in their chair and then service 
-    * them. If not, they sleep and wait to be signaled by a customer. 
-    * Once they have a customer, they begin the haircut.
-    * Calls print method. 
-    * @return none
-    * @custom.preconditions  none
-    * @custom.postconditions  customer thread service is started. 
-    **/
-   void helloCustomer(int id);
-   
-   /**
-    * This is to be called by the barber threads. This is where they finish 
-    * the haircut and take payment from one customer thread and then signal 
-    * another waiting customer thread. 
-    * Calls print and int2string methods. 
-    * @return none
-    * @custom.preconditions  none
-    * @custom.postconditions  customer thread service is finished
-    **/
-   void byeCustomer(int id);
-   
-   /**
-    * This returns the number of customers that did not get serviced
-    * No other methods are called. 
-    * @return number of customers that left shop without being serviced
-    * @custom.preconditions  none
-    * @custom.postconditions  none
-    **/
-   int get_cust_drops() const;
-
- private:
-
-    struct PersonInfo {
-      /** unique id of barber */
-      int barber_id_{0};
-      /** unique id of customer in barber chair, 0 if chair is empty*/
-      int cust_in_chair_{0};
-      /** Boolean, true if customer paid for service and false otherwise */
-      bool money_paid_{false};
-      /** Boolean, true if customer is being serviced, false otherwise*/
-      bool in_service_{false};
-      /** conditional variable related to sleeping barber */
-      pthread_cond_t cond_barber_sleeping_ = PTHREAD_COND_INITIALIZER;
-      /** conditional variable related to servive payment */
-      pthread_cond_t cond_barber_paid_ = PTHREAD_COND_INITIALIZER;
-      /** conditional variable related to barber servicing a customer */
-      pthread_cond_t cond_cust_served_ = PTHREAD_COND_INITIALIZER;
-      /** mutex used to access shared resources within struct */
-      pthread_mutex_t mutex_lock_ = PTHREAD_MUTEX_INITIALIZER;
-   };
-
-   /** the max number of customer threads that can wait */
-   const int max_waiting_cust_;    
-   /** the number of barber threads using the Shop object */
-   int max_barbers_;
-   /** includes the ids of all waiting customer threads */
-   queue<int> waiting_chairs_;  
-   /** includes the ids of all sleeping barber threads */
-   queue<int> sleeping_barbers_;  
-   /** number of customer threads not serviced before leaving shop */
-   int cust_drops_;
-
-   /** Mutexes and condition variables to coordinate threads*/
-   /** pointer to PersonInfo struct with all barber data */
-   PersonInfo* barber_info_;
-   /** mutex used to enter methods where shared class resources are accessed */
-   pthread_mutex_t mutex_;
-   /** conditional variables related to waiting customers */
-   pthread_cond_t  cond_customers_waiting_;
-
-   /**
-    * This initializes the shops mutexes and conditional variables.
-    * No other methods are called. 
-    * @return none
-    * @custom.preconditions  none
-    * @custom.postconditions  objects mutexes/ cond variables initialized
-    **/
-   void init();
-
-   /**
-    * This produces a string representation of an integer
-    * No other methods are called. 
-    * @param i integer to be translated to string 
-    * @return none
-    * @custom.preconditions  none
-    * @custom.postconditions  string representation of integer produced
-    **/
-   string int2string(int i);
-
-   /**
-    * This takes a number and appends ‘barber’ for negative number and 
-    * ‘customer’ for positive numbers to a string message that is 
-    * printed to stdout.
-    * Uses to_string(). No other methods are called. 
-    * @param person number indicating person, <0 are barbers, >0 are customers
-    * @return none
-    * @custom.preconditions  none
-    * @custom.postconditions  data sent to stdout
-    **/
-   void print(int person, string message);
-
-};
-#endif
+/**
+ * @author  Marissa Christenson
+ * @since   05/01/21
+ * Shop.h
+ * 
+ * This is the Shop.h file that defines the Shop class. This class consists 
+ * of several private variables, some of which include max_waiting_cust_, the 
+ * maximum number of customer threads that are allowed to wait, max_barbers_, 
+ * the number of barber threads that will be using the Shop object, 
+ * waiting_chairs, the number of customer threads waiting, sleeping_barbers_,  
+ * the number of sleeping barber threads. 
+ *
+ * This class has many private variables that are stated below, as well as 
+ * PersonInfo struct that includes information that is unique amongst each 
+ * barber. The maximum number of waiting chairs, the number of barbers, the 
+ * available barbers, the waiting customer threads, mutex_ and 
+ * cond_customers_waiting_ are available to all the threads as public data. 
+ * 
+ * Each struct that barber_info_ points to is unique to each barber thread 
+ * and is only access by the barber thread and its associated customer 
+ * thread. It includes the barber id, id of customer in the barber's chair, 
+ * info on whether the customer is being serviced, info about barber payments, 
+ * a mutex and conditional variables used to synchronize access to this data. 
+ * 
+ * The waiting room is selected through ShopOptions. The locked waiting room 
+ * keeps the waiting customers and sleeping barbers in queues guarded by 
+ * mutex_. The lock-free waiting room seats customers in a LockFreeRing 
+ * sized from the number of chairs and keeps free barbers in a BarberSet, 
+ * so arrivals and departures never take mutex_. The ticket waiting room 
+ * is the locked one with every waiting customer parked on a ticket of its 
+ * own instead of cond_customers_waiting_: a free barber takes the oldest 
+ * ticket and wakes exactly that customer, so customers are served in the 
+ * order they sat down and no other waiter is woken. 
+ * 
+ * The handoff between a customer and a barber is selected as well. The 
+ * condition variable handoff is the original protocol of PersonInfo's 
+ * mutex and condition variables. The direct handoff gives every barber a 
+ * futex mailbox holding the id of the customer in its chair: a finishing 
+ * barber pulls the next waiting customer into its own chair, and ending 
+ * the hair-cut, taking payment and releasing the customer is a single 
+ * store to the mailbox. 
+ * 
+ * Each barber's PersonInfo is cache line aligned unless built with the 
+ * packed layout, and ShopOptions can place the barber state and the 
+ * waiting room on a NUMA node. 
+ * 
+ * The pool of barbers is elastic: ShopOptions can reserve barber slots 
+ * beyond num_barbers, addBarber opens one of them and retireBarber 
+ * closes one again. A retired barber finishes the customer in its chair, 
+ * if any, and its next helloCustomer returns false instead of sleeping, 
+ * so its thread can leave. BarberPool drives both from the waiting room 
+ * depth and drops. 
+ * 
+ * The ticket waiting room can serve customers in batches: a barber that 
+ * becomes free claims up to batch_size_ waiting customers in one critical 
+ * section of mutex_, serves them back to back without a handshake in 
+ * between, and releases them and takes their payments together, so a 
+ * batch costs one acquisition of mutex_ and one wait for payment. A 
+ * customer leaves only once its whole batch is done. 
+ * 
+ * The ticket waiting room can also tell priority classes apart and let 
+ * customers give up. Each class has its own queue of tickets, and a free 
+ * barber picks the next customer by the DispatchPolicy of ShopOptions. 
+ * A customer with patience sleeps on its ticket with a timeout and, if 
+ * no barber claimed it by then, takes its ticket back and reneges, 
+ * counted apart from the customers that balk at a full shop. 
+ * 
+ * Barbers need not be alike. Each has a speed factor, and ShopOptions 
+ * can hand an arriving customer to the fastest free barber instead of 
+ * the one that has been free longest. With shortest expected wait 
+ * dispatch, a customer that finds every barber busy joins the queue of 
+ * the barber expected to reach it first, its queued customers plus the 
+ * one in its chair over its speed, and that barber serves its own queue 
+ * first. A barber whose queue is empty serves the other barbers' queues 
+ * before it sleeps, so no barber idles while a customer waits. 
+ * 
+ * Unless disabled in ShopOptions, the shop times every customer's wait, 
+ * service and payment into histograms owned by the recording thread, and 
+ * every barber's busy and sleeping time. get_stats merges them on read, 
+ * so statistics can be queried while the shop is running. 
+ * 
+ * Barber threads are shut down cooperatively. close turns every new 
+ * customer away while the barbers finish the waiting room; a barber that 
+ * finds nobody left to serve is woken out of the free barbers the way a 
+ * retired one is, and its helloCustomer returns false. drain closes the 
+ * shop and waits until every working barber has returned. reset then 
+ * opens the shop again with its counters and statistics cleared, so the 
+ * same shop and barber threads can run any number of measurements. 
+ **/
+#ifndef SHOP_ORG_H_
+#define SHOP_ORG_H_
+#include <pthread.h>
+#include <iostream>
+#include <string>
+#include <queue>
+#include <deque>
+#include <atomic>
+#include <map>
+#include <vector>
+#include "WaitingRoom.h"
+#include "ShopStats.h"
+#include "Clock.h"
+using namespace std;
+
+#define kDefaultNumChairs 3
+#define kDefaultNumBarbers 1
+/** most customers a barber claims at once with batched service */
+#define kMaxBatchSize 64
+
+/** barber state layouts SHOP_BARBER_LAYOUT can select */
+#define kBarberLayoutPacked 0
+#define kBarberLayoutPadded 1
+
+/** layout compiled into Shop, -DSHOP_BARBER_LAYOUT=kBarberLayoutPacked 
+ *  keeps every barber's state back to back */
+#ifndef SHOP_BARBER_LAYOUT
+#define SHOP_BARBER_LAYOUT kBarberLayoutPadded
+#endif
+
+/** starts a new cache line in the padded layout */
+#if SHOP_BARBER_LAYOUT == kBarberLayoutPadded
+#define BARBER_LINE alignas(kCacheLineSize)
+#else
+#define BARBER_LINE
+#endif
+
+/** waiting room implementations a Shop can be built with */
+enum WaitingRoomKind {
+   /** queue of waiting customers guarded by the shop mutex */
+   kLockedWaitingRoom,
+   /** lock-free ring of waiting customers and atomic free barber set */
+   kLockFreeWaitingRoom,
+   /** queues of tickets guarded by the shop mutex, each waiting customer 
+    *  parks on its own ticket and is woken in order by the barber */
+   kTicketWaitingRoom
+};
+
+/** customer/ barber handoff protocols a Shop can be built with */
+enum HandoffKind {
+   /** per-barber mutex and condition variables, separate payment step */
+   kCondvarHandoff,
+   /** per-barber futex mailbox, needs the lock-free waiting room */
+   kDirectHandoff
+};
+
+/** ways a free barber of the ticket waiting room picks the next customer */
+enum DispatchPolicy {
+   /** longest waiting customer, whatever its class */
+   kDispatchFifo,
+   /** longest waiting customer of the first class that has one */
+   kDispatchStrict,
+   /** classes take turns in proportion to their weights */
+   kDispatchWeighted,
+   /** customer whose patience runs out first */
+   kDispatchEarliestDeadline
+};
+
+/** ways a customer is matched with a barber when there is a choice */
+enum BarberDispatch {
+   /** the barber that has been free longest */
+   kBarberFifo,
+   /** the fastest free barber */
+   kBarberFastest,
+   /** the fastest free barber, or with none free the queue of the 
+    *  barber with the shortest expected wait, ticket waiting room only */
+   kBarberShortestWait
+};
+
+/** optional settings of a Shop, the defaults give the original shop */
+struct ShopOptions {
+   /** waiting room implementation */
+   WaitingRoomKind waiting_room_{kLockedWaitingRoom};
+   /** handoff protocol, kDirectHandoff implies kLockFreeWaitingRoom. The 
+    *  options below apply to the ticket waiting room, and any of them 
+    *  turns a locked waiting room into one */
+   HandoffKind handoff_{kCondvarHandoff};
+   /** true to record the latencies and barber times reported by get_stats */
+   bool collect_stats_{true};
+   /** NUMA node to place barber state and the waiting room on, -1 for 
+    *  the node of the constructing thread */
+   int numa_node_{-1};
+   /** number of barber slots addBarber can open, 0 for exactly the 
+    *  barbers the shop is built with */
+   int barber_capacity_{0};
+   /** most waiting customers a free barber claims at once, 1 for one at 
+    *  a time */
+   int batch_size_{1};
+   /** how a free barber picks among waiting customers */
+   DispatchPolicy dispatch_{kDispatchFifo};
+   /** kDispatchWeighted, share of the turns of each priority class */
+   int class_weights_[kMaxPriorityClasses] = {8, 4, 2, 1};
+   /** true to let customers with patience renege */
+   bool reneging_{false};
+   /** how a customer picks among the barbers, kBarberShortestWait turns 
+    *  a locked waiting room into a ticket one. The lock-free waiting room 
+    *  always takes the free barber with the lowest id */
+   BarberDispatch barber_dispatch_{kBarberFifo};
+};
+
+class Shop 
+{
+   /** shards a franchise into several shops that serve each other */
+   friend class Franchise;
+
+public:
+
+   /**
+    * This is the overloaded constructor that takes an integer for the number of 
+    * specified barbers and an integer for the number of specified chairs. 
+    * Calls init method to initialize mutex and conditional variables
+    * @param num_barbers number of barbers 
+    * @param num_chairs maximum number of waiting customers there can be
+    * @return none
+    * @custom.preconditions  num_barbers >= 1, num_chairs >= 0
+    * @custom.postconditions  A Shop object is instantiated
+    **/
+   Shop(int num_barbers, int num_chairs) : max_waiting_cust_(num_chairs), max_barbers_(num_barbers), cust_drops_(0)
+   { 
+      init(); 
+   };
+
+   /**
+    * This is the overloaded constructor that also takes the optional 
+    * settings of the shop, such as the waiting room implementation. 
+    * Calls init method to initialize mutex and conditional variables
+    * @param num_barbers number of barbers 
+    * @param num_chairs maximum number of waiting customers there can be
+    * @param options optional settings of the shop
+    * @return none
+    * @custom.preconditions  num_barbers >= 1, num_chairs >= 0
+    * @custom.postconditions  A Shop object is instantiated
+    **/
+   Shop(int num_barbers, int num_chairs, const ShopOptions& options) : max_waiting_cust_(num_chairs), max_barbers_(num_barbers), cust_drops_(0), options_(options)
+   { 
+      init(); 
+   };
+
+   /**
+    * This is the default constructor that generates a new Shop with default 
+    * values, 3 chairs and 1 barber. 
+    * Calls init method to initialize mutex and conditional variables
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  A Shop object is instantiated
+    **/
+   Shop() : max_waiting_cust_(kDefaultNumChairs), max_barbers_(kDefaultNumBarbers), cust_drops_(0)
+   { 
+      init();
+   };
+
+   /**
+    * Destructor for Shop class. 
+    * No other methods are called. 
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  Shop class destroyed. 
+    **/
+   ~Shop();
+
+   /**
+    * This is to be called by the customer threads to visit the shop. They 
+    * will check if there is a waiting chair, if not, they leave. If all 
+    * barbers are busy and there is a chair, they sit. Otherwise, they sit 
+    * in the next available barber chair. 
+    * Records events through SHOP_LOG. 
+    * @return id of barber servicing them, -1 if they leave without service
+    * @custom.preconditions  none
+    * @custom.postconditions  customer thread possibly serviced
+    **/
+   int visitShop(int id);
+
+   /**
+    * This is to be called by customer threads of a priority class that 
+    * wait only so long for a barber. Class and patience are used by the 
+    * ticket waiting room, any other shop treats the customer like 
+    * visitShop(id). 
+    * Records events through SHOP_LOG. 
+    * @param id id of the visiting customer
+    * @param priority priority class, 0 to kMaxPriorityClasses - 1, 0 first
+    * @param patience_ns longest wait for a barber before the customer 
+    *        reneges, 0 to wait as long as it takes
+    * @return id of barber servicing them, -1 if they leave without service
+    * @custom.preconditions  none
+    * @custom.postconditions  customer thread possibly serviced
+    **/
+   int visitShop(int id, int priority, uint64_t patience_ns);
+   
+   /**
+    * This is to be called by the customer threads who have been seen by a 
+    * barber. Their service will be finished and then they wait before paying. 
+    * Records events through SHOP_LOG.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  customer thread service is completed. 
+    **/
+   void leaveShop(int customer_id, int barber_id);
+   
+   /**
+    * This is to be called by the barber threads. Barber checks if 
+    * there are any customers waiting or in their chair and then service 
+    * them. If not, they sleep and wait to be signaled by a customer. 
+    * Once they have a customer, they begin the haircut.
+    * Records events through SHOP_LOG. 
+    * @return true if a hair-cut started, false if the barber was retired 
+    *         and must not call the shop again until it is added back, or 
+    *         the shop is closed and must not be called again until reset
+    * @custom.preconditions  none
+    * @custom.postconditions  customer thread service is started. 
+    **/
+   bool helloCustomer(int id);
+   
+   /**
+    * This is to be called by the barber threads. This is where they finish 
+    * the haircut and take payment from one customer thread and then signal 
+    * another waiting customer thread. 
+    * Records events through SHOP_LOG. 
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  customer thread service is finished
+    **/
+   void byeCustomer(int id);
+   
+   /**
+    * Opens a retired barber slot. The barber is free at once, customers 
+    * may be seated with it before its thread calls helloCustomer. 
+    * Records events through SHOP_LOG. 
+    * @return id of the new barber, -1 if every slot is working or the 
+    *         shop is closed
+    * @custom.preconditions  none
+    * @custom.postconditions  one more barber working on success
+    **/
+   int addBarber();
+
+   /**
+    * Retires a working barber. A free barber is taken out of the free 
+    * barbers and woken, a busy one finishes its customer first. Either 
+    * way the barber's next helloCustomer returns false. 
+    * Calls markRetired method. 
+    * @param id id of the barber
+    * @return false if the barber is not working or already retiring, or 
+    *         the shop is closed
+    * @custom.preconditions  none
+    * @custom.postconditions  no new customer is seated with the barber
+    **/
+   bool retireBarber(int id);
+
+   /**
+    * Closes the shop. Customers arriving afterwards leave and are counted 
+    * as drops, the waiting customers are still served, and once nobody is 
+    * left waiting every barber's helloCustomer returns false instead of 
+    * sleeping. Barbers are neither added nor retired while closed. 
+    * Calls closeOutFreeBarbers method. 
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  free barbers woken if nobody waits
+    **/
+   void close();
+
+   /**
+    * Closes the shop and waits until every working barber's helloCustomer 
+    * has returned false, so no customer is left in the shop. 
+    * Calls close method. 
+    * @return none
+    * @custom.preconditions  every working barber's thread keeps calling 
+    *                        helloCustomer until it returns false
+    * @custom.postconditions  every working barber out of the shop
+    **/
+   void drain();
+
+   /**
+    * Opens a drained shop again. Every working barber is free, and the 
+    * drops, reneges and statistics start over from zero. The barber 
+    * threads may call helloCustomer again once reset returns. 
+    * No other methods are called. 
+    * @return false if the shop is not drained
+    * @custom.preconditions  no customer thread is in the shop
+    * @custom.postconditions  shop open as if newly built
+    **/
+   bool reset();
+
+   /**
+    * This returns the number of customers that did not get serviced
+    * No other methods are called. 
+    * @return number of customers that left shop without being serviced
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_cust_drops() const;
+
+   /**
+    * This returns the number of customers that gave up waiting. 
+    * No other methods are called. 
+    * @return number of customers that reneged
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_cust_reneges() const;
+
+   /**
+    * This returns the number of customers in the waiting chairs. Takes no 
+    * lock, so monitors can poll it while the shop is busy. 
+    * No other methods are called. 
+    * @return number of waiting customers
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_waiting() const;
+
+   /**
+    * This returns the number of working barbers that are free. Takes no 
+    * lock, so monitors can poll it while the shop is busy. 
+    * No other methods are called. 
+    * @return number of free barbers
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_free_barbers() const;
+
+   /**
+    * This returns the number of working barbers, not counting barbers 
+    * that are retiring. 
+    * No other methods are called. 
+    * @return number of working barbers
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_active_barbers() const;
+
+   /**
+    * This returns the number of barber slots, working or not. 
+    * No other methods are called. 
+    * @return largest barber id + 1
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_barber_capacity() const;
+
+   /**
+    * This returns the number of waiting chairs. 
+    * No other methods are called. 
+    * @return most customers that can wait at once
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int get_num_chairs() const;
+
+   /**
+    * Sets the speed factor a barber is dispatched by, a barber of speed 
+    * 2 being expected to finish a hair-cut in half the time. The barber 
+    * thread is what actually takes that long. 
+    * No other methods are called. 
+    * @param id id of the barber
+    * @param speed speed factor, 1 for every barber unless set
+    * @return none
+    * @custom.preconditions  0 <= id < get_barber_capacity(), speed > 0
+    * @custom.postconditions  barber dispatched by the new speed
+    **/
+   void set_barber_speed(int id, double speed);
+
+   /**
+    * This returns the speed factor of a barber. 
+    * No other methods are called. 
+    * @param id id of the barber
+    * @return speed factor set by set_barber_speed, 1 by default
+    * @custom.preconditions  0 <= id < get_barber_capacity()
+    * @custom.postconditions  none
+    **/
+   double get_barber_speed(int id) const;
+
+   /**
+    * This returns the shop's statistics, merged from the histograms of 
+    * every thread that used the shop. Safe to call while the shop is 
+    * running, values recorded concurrently may or may not be included. 
+    * No other methods are called. 
+    * @return statistics recorded so far
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   ShopStats get_stats() const;
+
+ private:
+
+   /** lifecycle of a barber slot */
+   enum BarberSlot {
+      /** no barber, addBarber can open the slot */
+      kSlotIdle,
+      /** barber working */
+      kSlotActive,
+      /** barber asked to retire, its thread has not left yet */
+      kSlotRetiring
+   };
+
+   /** 
+    * State of one barber. The fields the barber and its customer hand 
+    * back and forth come first, with the mutex guarding them, so in the 
+    * padded layout they share the barber's first cache line and no line 
+    * with another barber. Statistics only the barber writes, and fields 
+    * nobody writes, start a line of their own. 
+    */
+    struct BARBER_LINE PersonInfo {
+      /** direct handoff, id of customer in barber chair, 0 if empty. 
+       *  Barber and customer both park on it through ShopWait */
+      atomic<int> mailbox_{0};
+      /** unique id of customer in barber chair, 0 if chair is empty*/
+      int cust_in_chair_{0};
+      /** Boolean, true if customer paid for service and false otherwise */
+      bool money_paid_{false};
+      /** Boolean, true if customer is being serviced, false otherwise*/
+      bool in_service_{false};
+      /** Boolean, true once a retiring barber, or any barber of a closed 
+       *  shop, is out of the free barbers */
+      bool retired_{false};
+      /** mutex used to access shared resources within struct */
+      pthread_mutex_t mutex_lock_ = PTHREAD_MUTEX_INITIALIZER;
+      /** conditional variable related to sleeping barber */
+      pthread_cond_t cond_barber_sleeping_ = PTHREAD_COND_INITIALIZER;
+      /** conditional variable related to servive payment */
+      pthread_cond_t cond_barber_paid_ = PTHREAD_COND_INITIALIZER;
+      /** conditional variable related to barber servicing a customer */
+      pthread_cond_t cond_cust_served_ = PTHREAD_COND_INITIALIZER;
+      /** batched service, number of customers claimed, index of the one in 
+       *  the chair and number that paid */
+      int batch_count_{0};
+      int batch_next_{0};
+      int batch_paid_{0};
+      /** batched service, true once every claimed hair-cut is done */
+      bool batch_done_{false};
+      /** batched service, ids of the claimed customers in service order */
+      int batch_[kMaxBatchSize] = {};
+      /** time the current hair-cut started */
+      BARBER_LINE uint64_t service_start_ns_{0};
+      /** number of customers the barber finished */
+      atomic<long> served_{0};
+      /** time spent from starting a hair-cut until free again */
+      atomic<uint64_t> busy_ns_{0};
+      /** time spent asleep waiting for a customer */
+      atomic<uint64_t> idle_ns_{0};
+      /** unique id of barber */
+      int barber_id_{0};
+      /** BarberSlot of the barber */
+      atomic<int> slot_{kSlotActive};
+      /** speed factor the barber is dispatched by, guarded by mutex_ */
+      double speed_{1.0};
+      /** kBarberShortestWait, number of waiting customers that joined 
+       *  the barber's queue, guarded by mutex_ */
+      int queued_{0};
+   };
+
+   /** latencies recorded by one thread, only that thread writes them */
+   struct ThreadStats {
+      /** number of customers this thread entered the shop as */
+      atomic<long> arrivals_{0};
+      /** customer wait until a barber is assigned */
+      Histogram queue_wait_;
+      /** barber hair-cut durations */
+      Histogram service_;
+      /** barber wait for payment */
+      Histogram payment_;
+      /** customer wait until a barber is assigned, by priority class */
+      Histogram class_wait_[kMaxPriorityClasses];
+   };
+
+   /** 
+    * Seat of a customer in the lock-free waiting room, or in the locked 
+    * one with tickets. It lives on the customer's stack while the customer 
+    * is parked in visitShop.
+    */
+   struct Ticket {
+      /** unique id of the waiting customer */
+      int customer_id_{0};
+      /** id of the barber assigned to the customer, -1 while waiting */
+      atomic<int> barber_id_{-1};
+      /** shop of the assigned barber, set before barber_id_ */
+      Shop* server_{NULL};
+      /** ticket waiting room, priority class of the customer */
+      int priority_{0};
+      /** ticket waiting room, time the customer reneges, UINT64_MAX for never */
+      uint64_t deadline_ns_{UINT64_MAX};
+      /** ticket waiting room, order in which the customers sat down */
+      uint64_t seq_{0};
+      /** kBarberShortestWait, barber whose queue the customer joined */
+      int barber_pick_{-1};
+   };
+
+   /** the max number of customer threads that can wait */
+   const int max_waiting_cust_;    
+   /** the number of barber slots of the Shop object */
+   int max_barbers_;
+   /** number of barbers working */
+   atomic<int> active_barbers_;
+   /** includes the ids of all waiting customer threads */
+   queue<int> waiting_chairs_;  
+   /** includes the ids of all sleeping barber threads */
+   deque<int> sleeping_barbers_;  
+   /** ticket waiting room, tickets of the waiting customer threads of 
+    *  each priority class in the order they sat down */
+   deque<Ticket*> ticket_queues_[kMaxPriorityClasses];
+   /** ticket waiting room, number of waiting customers */
+   int num_tickets_;
+   /** waiting_chairs_ and num_tickets_ combined, readable without mutex_ */
+   atomic<int> waiting_gauge_;
+   /** size of sleeping_barbers_, readable without mutex_ */
+   atomic<int> sleeping_gauge_;
+   /** ticket waiting room, seq_ of the next ticket */
+   uint64_t next_ticket_seq_;
+   /** kDispatchWeighted, running credit of each priority class */
+   int class_credit_[kMaxPriorityClasses];
+   /** number of customer threads not serviced before leaving shop */
+   atomic<int> cust_drops_;
+   /** true from close until reset */
+   atomic<bool> closed_;
+   /** number of barbers whose helloCustomer returned false since close, 
+    *  guarded by mutex_ */
+   int barbers_out_;
+   /** number of customer threads of each priority class that reneged */
+   atomic<int> class_reneges_[kMaxPriorityClasses];
+   /** optional settings the shop was built with */
+   ShopOptions options_;
+   /** lock-free waiting room, tickets of all waiting customer threads */
+   LockFreeRing<Ticket*>* waiting_ring_;
+   /** lock-free waiting room, number of occupied waiting chairs */
+   atomic<int> waiting_count_;
+   /** lock-free waiting room, ids of all free barber threads */
+   BarberSet* free_barbers_;
+
+   /** Mutexes and condition variables to coordinate threads*/
+   /** pointer to PersonInfo struct with all barber data */
+   PersonInfo* barber_info_;
+   /** mutex used to enter methods where shared class resources are accessed */
+   pthread_mutex_t mutex_;
+   /** conditional variables related to waiting customers */
+   pthread_cond_t  cond_customers_waiting_;
+   /** conditional variable drain waits on for the barbers to leave */
+   pthread_cond_t  cond_barbers_out_;
+
+   /** statistics of every thread that used the shop, by thread */
+   map<pthread_t, ThreadStats*> thread_stats_;
+   /** guards thread_stats_ */
+   mutable pthread_mutex_t stats_mutex_;
+   /** unique serial number of this shop, never reused */
+   uint64_t serial_;
+   /** serial number handed to the next shop */
+   static atomic<uint64_t> next_serial_;
+   /** serial of the shop whose stats the calling thread used last */
+   static thread_local uint64_t tls_stats_serial_;
+   /** stats of the calling thread in that shop */
+   static thread_local ThreadStats* tls_stats_;
+
+   /** other shards of the franchise, nearest first, empty if standalone */
+   vector<Shop*> peers_;
+   /** index of the shop in its franchise, 0 if standalone */
+   int shard_;
+   /** shop recording the per-thread stats, this unless in a franchise */
+   Shop* stats_owner_;
+
+   /**
+    * This initializes the shops mutexes and conditional variables.
+    * No other methods are called. 
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  objects mutexes/ cond variables initialized
+    **/
+   void init();
+
+   /**
+    * Lock-free waiting room version of visitShop. A free barber takes 
+    * the customer directly when nobody waits, otherwise it waits in a 
+    * chair until dispatch pairs it with a barber. 
+    * Calls reserveSeat, seatFree, dispatch and seatWithBarber methods. 
+    * @param id id of the visiting customer
+    * @param arrival_ns time the customer entered visitShop
+    * @param server receives the shop of the barber, a peer if stolen
+    * @param count_drop false to leave a turned away customer uncounted
+    * @return id of barber servicing them, -1 if they leave without service
+    * @custom.preconditions  lock-free waiting room selected
+    * @custom.postconditions  customer thread possibly serviced
+    **/
+   int visitLockFree(int id, uint64_t arrival_ns, Shop** server, bool count_drop);
+
+   /**
+    * Moves a customer of the lock-free waiting room straight into the 
+    * chair of a free barber it claimed, without taking a waiting chair. 
+    * Calls seatWithBarber method. 
+    * Records events through SHOP_LOG. 
+    * @param id id of the customer
+    * @param barber_id barber claimed from the free barbers
+    * @param arrival_ns time the customer entered visitShop
+    * @return none
+    * @custom.preconditions  lock-free waiting room selected
+    * @custom.postconditions  customer in the barber's chair, barber woken
+    **/
+   void seatFree(int id, int barber_id, uint64_t arrival_ns);
+
+   /**
+    * Takes a waiting chair in the lock-free waiting room if one is free. 
+    * No other methods are called. 
+    * @return false if all waiting chairs are occupied
+    * @custom.preconditions  lock-free waiting room selected
+    * @custom.postconditions  waiting_count_ incremented on success
+    **/
+   bool reserveSeat();
+
+   /**
+    * Pairs free barbers with waiting customers of the lock-free waiting 
+    * room until one of the two runs out, waking each paired customer. 
+    * Called by customers after sitting down and by barbers after 
+    * becoming free, so whichever comes last makes the pairing. In a 
+    * franchise our waiting customers then go to free barbers of the 
+    * peers, and our free barbers steal the peers' waiting customers. 
+    * Calls dispatchBetween method. 
+    * @return none
+    * @custom.preconditions  lock-free waiting room selected
+    * @custom.postconditions  no customer waits while a barber is free
+    **/
+   void dispatch();
+
+   /**
+    * Pairs free barbers of server with waiting customers of room until 
+    * one of the two runs out. 
+    * Calls assignBarber method. 
+    * @param room shop whose waiting customers are served
+    * @param server shop whose free barbers serve them
+    * @return none
+    * @custom.preconditions  both use the lock-free waiting room
+    * @custom.postconditions  room has no waiting customer or server no free barber
+    **/
+   static void dispatchBetween(Shop* room, Shop* server);
+
+   /**
+    * Moves a customer into the service chair of a barber they were 
+    * paired with and wakes the barber. 
+    * Records events through SHOP_LOG. 
+    * @param id id of the customer
+    * @param barber_id id of the barber the customer was paired with
+    * @param seats_available number of free waiting chairs to report
+    * @param arrival_ns time the customer entered visitShop
+    * @return none
+    * @custom.preconditions  barber_id is reserved for this customer
+    * @custom.postconditions  barber signaled to start the hair-cut
+    **/
+   void seatWithBarber(int id, int barber_id, int seats_available, uint64_t arrival_ns);
+
+   /**
+    * Hands a waiting customer's ticket to a barber and wakes the customer. 
+    * With the direct handoff the customer is also put in the barber's 
+    * chair, waking the barber. 
+    * No other methods are called. 
+    * @param ticket ticket of the waiting customer
+    * @param barber_id free barber reserved for the customer
+    * @return none
+    * @custom.preconditions  ticket taken off the waiting room
+    * @custom.postconditions  customer woken with its barber
+    **/
+   void assignBarber(Ticket* ticket, int barber_id);
+
+   /**
+    * Direct handoff version of helloCustomer. 
+    * Records events through SHOP_LOG. 
+    * @param id id of the barber
+    * @param hello_ns time the barber entered helloCustomer
+    * @return false if the barber was retired
+    * @custom.preconditions  direct handoff selected
+    * @custom.postconditions  customer in chair, hair-cut started
+    **/
+   bool helloDirect(int id, uint64_t hello_ns);
+
+   /**
+    * Direct handoff version of byeCustomer. Finishes the hair-cut and 
+    * releases the customer with one mailbox store that also seats the 
+    * next waiting customer, if any. 
+    * Calls dispatch and assignBarber methods. 
+    * @param id id of the barber
+    * @return none
+    * @custom.preconditions  direct handoff selected
+    * @custom.postconditions  customer released, barber busy or free
+    **/
+   void byeDirect(int id);
+
+   /**
+    * This returns true if the shop uses the ticket waiting room. 
+    * No other methods are called. 
+    * @return true if waiting customers park on tickets
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   bool ticketed() const
+   {
+      return options_.waiting_room_ == kTicketWaitingRoom;
+   }
+
+   /**
+    * Ticket waiting room version of visitShop. A 
+    * customer that finds no free barber parks on a ticket until a barber 
+    * claims it or, with reneging, until its patience runs out. 
+    * Calls seatBatch and removeTicket methods. 
+    * Records events through SHOP_LOG. 
+    * @param id id of the visiting customer
+    * @param priority priority class of the customer
+    * @param patience_ns longest wait for a barber, 0 for no limit
+    * @param arrival_ns time the customer entered visitShop
+    * @return id of barber servicing them, -1 if they leave without service
+    * @custom.preconditions  ticket waiting room selected
+    * @custom.postconditions  customer thread possibly serviced
+    **/
+   int visitTicket(int id, int priority, uint64_t patience_ns, uint64_t arrival_ns);
+
+   /**
+    * Takes a free barber out of the sleeping barbers by the barber 
+    * dispatch of ShopOptions. 
+    * No other methods are called. 
+    * @return id of the barber
+    * @custom.preconditions  sleeping_barbers_ not empty, mutex_ held
+    * @custom.postconditions  barber reserved for the caller
+    **/
+   int takeFreeBarber();
+
+   /**
+    * This returns the working barber whose queue a customer that finds 
+    * every barber busy is expected to leave first. 
+    * No other methods are called. 
+    * @return id of the barber, -1 if no barber is working
+    * @custom.preconditions  kBarberShortestWait, mutex_ held
+    * @custom.postconditions  none
+    **/
+   int shortestWaitBarber();
+
+   /**
+    * Takes the next waiting customer of a free barber off the ticket 
+    * queues, from the barber's own queue first with shortest expected 
+    * wait dispatch. 
+    * Calls pickTicket method. 
+    * @param now_ns current time, 0 to ignore patience
+    * @param barber_id id of the free barber
+    * @return ticket of the customer, NULL if nobody waits
+    * @custom.preconditions  ticket waiting room selected, mutex_ held
+    * @custom.postconditions  ticket off the queues
+    **/
+   Ticket* nextTicket(uint64_t now_ns, int barber_id);
+
+   /**
+    * Takes the next waiting customer off the ticket queues by the 
+    * dispatch policy. Customers whose patience has run out are left for 
+    * themselves to take back. 
+    * No other methods are called. 
+    * @param now_ns current time, 0 to ignore patience
+    * @param owner only take customers that joined this barber's queue, 
+    *        -1 to take any customer
+    * @return ticket of the customer, NULL if nobody eligible waits
+    * @custom.preconditions  ticket waiting room selected, mutex_ held
+    * @custom.postconditions  ticket off the queues
+    **/
+   Ticket* pickTicket(uint64_t now_ns, int owner);
+
+   /**
+    * Takes a ticket off the ticket queues if it is still there. 
+    * No other methods are called. 
+    * @param ticket ticket of a waiting customer
+    * @return false if a barber already claimed the ticket
+    * @custom.preconditions  ticket waiting room selected, mutex_ held
+    * @custom.postconditions  ticket off the queues
+    **/
+   bool removeTicket(Ticket* ticket);
+
+   /**
+    * Claims up to batch_size_ waiting customers for a free barber in one 
+    * critical section and wakes them, or puts the barber to sleep if 
+    * nobody waits. 
+    * Calls nextTicket, seatBatch and markRetired methods. 
+    * @param id id of the free barber
+    * @return none
+    * @custom.preconditions  ticket waiting room selected, barber has no batch
+    * @custom.postconditions  barber has a batch, sleeps or is retired
+    **/
+   void claimBatch(int id);
+
+   /**
+    * Hands a batch of customers to a barber, the first one in its chair, 
+    * and wakes the barber. 
+    * No other methods are called. 
+    * @param site LockSite the barber's mutex is profiled at
+    * @param barber_id id of the barber
+    * @param ids ids of the customers in service order
+    * @param count number of customers, 1 to batch_size_
+    * @return none
+    * @custom.preconditions  barber reserved for the batch
+    * @custom.postconditions  barber signaled to start the first hair-cut
+    **/
+   void seatBatch(int site, int barber_id, const int* ids, int count);
+
+   /**
+    * Ticket waiting room version of leaveShop, where barbers serve 
+    * batches of one or more. Waits until the customer's whole batch is 
+    * done and pays. 
+    * Records events through SHOP_LOG. 
+    * @param customer_id id of the customer
+    * @param barber_id id of the barber servicing them
+    * @return none
+    * @custom.preconditions  ticket waiting room selected
+    * @custom.postconditions  customer thread service is completed
+    **/
+   void leaveBatch(int customer_id, int barber_id);
+
+   /**
+    * Ticket waiting room version of byeCustomer. Calls the next customer 
+    * of the batch into the chair, or releases the whole batch, waits for 
+    * all payments and claims the next batch. 
+    * Calls claimBatch method. 
+    * Records events through SHOP_LOG. 
+    * @param id id of the barber
+    * @return none
+    * @custom.preconditions  ticket waiting room selected
+    * @custom.postconditions  next hair-cut due, or batch finished
+    **/
+   void byeBatch(int id);
+
+   /**
+    * Wakes a retiring barber, or a barber of a closed shop, that is out 
+    * of the free barbers, so its next helloCustomer returns false. 
+    * No other methods are called. 
+    * @param id id of the barber
+    * @return none
+    * @custom.preconditions  barber retiring or shop closed, no customer 
+    *                        can reach it
+    * @custom.postconditions  barber's helloCustomer returns false
+    **/
+   void markRetired(int id);
+
+   /**
+    * Copies the sizes of the waiting chairs, tickets and sleeping barbers 
+    * to the gauges get_waiting and get_free_barbers read. 
+    * No other methods are called. 
+    * @return none
+    * @custom.preconditions  mutex_ held, or no other thread uses the shop
+    * @custom.postconditions  gauges match the queues
+    **/
+   void updateGauges();
+
+   /**
+    * Wakes every free barber of a closed shop out of the free barbers, 
+    * unless customers are still waiting for one. 
+    * Calls markRetired method. 
+    * @return none
+    * @custom.preconditions  shop closed, mutex_ held unless the waiting 
+    *                        room is lock-free
+    * @custom.postconditions  no barber sleeps while nobody waits
+    **/
+   void closeOutFreeBarbers();
+
+   /**
+    * Counts a barber leaving helloCustomer because the shop is closed. 
+    * No other methods are called. 
+    * @return none
+    * @custom.preconditions  called by the barber thread
+    * @custom.postconditions  drain woken
+    **/
+   void finishClose();
+
+   /**
+    * Closes the slot of a barber leaving helloCustomer retired. 
+    * Records events through SHOP_LOG. 
+    * @param id id of the barber
+    * @return none
+    * @custom.preconditions  called by the barber thread
+    * @custom.postconditions  slot can be opened by addBarber
+    **/
+   void finishRetire(int id);
+
+   /**
+    * This returns the calling thread's statistics for this shop, creating 
+    * them on the thread's first use of the shop. 
+    * No other methods are called. 
+    * @return stats written only by the calling thread
+    * @custom.preconditions  none
+    * @custom.postconditions  stats registered with the shop
+    **/
+   ThreadStats* threadStats();
+
+   /**
+    * This returns the current time if statistics are collected. 
+    * No other methods are called. 
+    * @return monotonic time in nanoseconds, 0 if stats are disabled
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   uint64_t statsNow() const
+   {
+      return options_.collect_stats_ ? monotonicNs() : 0;
+   }
+
+   /**
+    * Accounts the time a barber slept and starts timing its hair-cut. 
+    * No other methods are called. 
+    * @param id id of the barber
+    * @param hello_ns time the barber entered helloCustomer
+    * @return none
+    * @custom.preconditions  stats collected, called by the barber thread
+    * @custom.postconditions  idle time added, service start recorded
+    **/
+   void statsStartService(int id, uint64_t hello_ns);
+
+   /**
+    * Records the hair-cut and payment latencies of a finished customer 
+    * and the barber's busy time. 
+    * Calls threadStats method. 
+    * @param id id of the barber
+    * @param done_ns time the barber finished the hair-cut
+    * @return none
+    * @custom.preconditions  stats collected, called by the barber thread
+    * @custom.postconditions  service, payment and busy time recorded
+    **/
+   void statsFinishService(int id, uint64_t done_ns);
+
+};
+#endif
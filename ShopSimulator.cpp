@@ -0,0 +1,264 @@
+/**
+ * ShopSimulator.cpp
+ *
+ * This is the ShopSimulator.cpp file that implements the methods of the
+ * ShopSimulator class. run repeatedly takes the earlier of the next
+ * arrival and the earliest barber completion, advances the virtual clock
+ * to it and applies the shop's rules, until every customer has arrived
+ * and every barber is asleep again.
+ **/
+#include "ShopSimulator.h"
+
+/**
+ * This returns the options of a Poisson arrival process.
+ * No other methods are called.
+ * @param arrival_rate mean number of arrivals per second
+ * @param seed seed of the arrival generator
+ * @return arrival options
+ * @custom.preconditions  arrival_rate > 0
+ * @custom.postconditions  none
+ **/
+static ArrivalOptions poissonArrivals(double arrival_rate, unsigned long seed)
+{
+   ArrivalOptions options;
+   options.kind_ = kPoissonArrivals;
+   options.rate_ = arrival_rate;
+   options.seed_ = seed;
+   return options;
+}
+
+/**
+ * Creates a simulated shop with every barber asleep and an empty room.
+ * No other methods are called.
+ * @param num_barbers number of barbers
+ * @param num_chairs maximum number of waiting customers there can be
+ * @param service_time duration of every hair-cut in μ seconds
+ * @param arrival_rate mean number of arrivals per virtual second
+ * @param seed seed of the arrival generator
+ * @return none
+ * @custom.preconditions  num_barbers >= 1, num_chairs >= 0,
+ *                        service_time > 0, arrival_rate > 0
+ * @custom.postconditions  simulator ready to run at virtual time 0
+ **/
+ShopSimulator::ShopSimulator(int num_barbers, int num_chairs, int service_time, double arrival_rate, unsigned long seed) :
+   ShopSimulator(num_barbers, num_chairs, service_time, poissonArrivals(arrival_rate, seed))
+{
+}
+
+/**
+ * Creates a simulated shop whose customers arrive as the given
+ * arrival process, so the simulator sees the same arrival times as a
+ * threaded run paced by an ArrivalProcess with the same options.
+ * No other methods are called.
+ * @param num_barbers number of barbers
+ * @param num_chairs maximum number of waiting customers there can be
+ * @param service_time duration of every hair-cut in μ seconds
+ * @param arrivals arrival process of the customers
+ * @return none
+ * @custom.preconditions  num_barbers >= 1, num_chairs >= 0,
+ *                        service_time > 0, arrivals.rate_ > 0
+ * @custom.postconditions  simulator ready to run at virtual time 0
+ **/
+ShopSimulator::ShopSimulator(int num_barbers, int num_chairs, int service_time, const ArrivalOptions& arrivals) :
+   num_barbers_(num_barbers), num_chairs_(num_chairs), service_ns_((uint64_t) service_time * 1000),
+   now_ns_(0), last_arrival_ns_(0), arrivals_(arrivals), waiting_(num_chairs > 0 ? num_chairs : 1),
+   waiting_head_(0), waiting_count_(0), sleeping_(num_barbers), sleeping_head_(0),
+   sleeping_count_(num_barbers), barbers_(num_barbers)
+{
+   for (int i = 0; i < num_barbers_; i++) {
+      sleeping_[i] = i;
+   }
+   stats_.barbers_.resize(num_barbers_);
+}
+
+/**
+ * Simulates num_customers more arrivals and runs until every admitted
+ * customer has been served.
+ * No other methods are called.
+ * @param num_customers number of customers that arrive
+ * @return none
+ * @custom.preconditions  num_customers >= 0
+ * @custom.postconditions  all customers served or dropped
+ **/
+void ShopSimulator::run(long num_customers)
+{
+   long arrived = 0;
+   uint64_t next_arrival_ns = 0;
+   /** a trace that runs out ends the arrivals early */
+   if (!arrivals_.next(&next_arrival_ns)) {
+      num_customers = 0;
+   }
+
+   while (arrived < num_customers || !completions_.empty()) {
+      /** completions at the same instant as an arrival free the barber first */
+      if (!completions_.empty() &&
+          (arrived == num_customers || completions_.top().time_ns_ <= next_arrival_ns)) {
+         Completion next = completions_.top();
+         completions_.pop();
+         now_ns_ = next.time_ns_;
+         complete(next.barber_id_);
+      } else {
+         now_ns_ = next_arrival_ns;
+         last_arrival_ns_ = now_ns_;
+         arrive();
+         ++arrived;
+         if (arrived < num_customers && !arrivals_.next(&next_arrival_ns)) {
+            num_customers = arrived;
+         }
+      }
+   }
+}
+
+/**
+ * Handles a customer arriving at now_ns_.
+ * Calls startService method.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  customer seated, served or dropped
+ **/
+void ShopSimulator::arrive()
+{
+   ++stats_.arrivals_;
+
+   /** Without chairs only a sleeping barber keeps the customer,
+    *  otherwise a full room turns the customer away */
+   if ((num_chairs_ == 0 && sleeping_count_ == 0) ||
+       (num_chairs_ > 0 && waiting_count_ == num_chairs_)) {
+      ++stats_.drops_;
+      wait_.record(0);
+      return;
+   }
+
+   /** Someone is waiting or nobody is free, so take a chair */
+   if (sleeping_count_ == 0 || waiting_count_ > 0) {
+      waiting_[(waiting_head_ + waiting_count_) % num_chairs_] = now_ns_;
+      ++waiting_count_;
+      return;
+   }
+
+   int barber_id = sleeping_[sleeping_head_];
+   sleeping_head_ = (sleeping_head_ + 1) % num_barbers_;
+   --sleeping_count_;
+   startService(barber_id, now_ns_);
+}
+
+/**
+ * Handles a barber finishing a hair-cut at now_ns_ and calls in the
+ * next waiting customer, or puts the barber to sleep.
+ * Calls startService method.
+ * @param barber_id barber finishing
+ * @return none
+ * @custom.preconditions  barber_id is busy
+ * @custom.postconditions  barber busy with the next customer or asleep
+ **/
+void ShopSimulator::complete(int barber_id)
+{
+   SimBarber& barber = barbers_[barber_id];
+   BarberStats& stats = stats_.barbers_[barber_id];
+   ++stats.served_;
+   ++stats_.served_;
+   stats.busy_ns_ += service_ns_;
+   stats_.service_.record(service_ns_);
+   /** the customer pays the moment the hair-cut ends */
+   stats_.payment_.record(0);
+   total_.record(now_ns_ - barber.customer_arrival_ns_);
+
+   if (waiting_count_ > 0) {
+      uint64_t arrival_ns = waiting_[waiting_head_];
+      waiting_head_ = (waiting_head_ + 1) % num_chairs_;
+      --waiting_count_;
+      /** the barber never sleeps, so the next hair-cut follows at once */
+      barber.asleep_since_ns_ = now_ns_;
+      startService(barber_id, arrival_ns);
+      return;
+   }
+
+   sleeping_[(sleeping_head_ + sleeping_count_) % num_barbers_] = barber_id;
+   ++sleeping_count_;
+   barber.asleep_since_ns_ = now_ns_;
+}
+
+/**
+ * Starts a hair-cut for a customer that arrived at arrival_ns.
+ * No other methods are called.
+ * @param barber_id free barber doing the hair-cut
+ * @param arrival_ns arrival time of the customer
+ * @return none
+ * @custom.preconditions  barber_id is free
+ * @custom.postconditions  completion scheduled
+ **/
+void ShopSimulator::startService(int barber_id, uint64_t arrival_ns)
+{
+   SimBarber& barber = barbers_[barber_id];
+   stats_.barbers_[barber_id].idle_ns_ += now_ns_ - barber.asleep_since_ns_;
+   barber.customer_arrival_ns_ = arrival_ns;
+   stats_.queue_wait_.record(now_ns_ - arrival_ns);
+   wait_.record(now_ns_ - arrival_ns);
+
+   Completion completion;
+   completion.time_ns_ = now_ns_ + service_ns_;
+   completion.barber_id_ = barber_id;
+   completions_.push(completion);
+}
+
+/**
+ * This returns the statistics of the simulated shop, in virtual time.
+ * No other methods are called.
+ * @return statistics in the same form as Shop::get_stats
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+ShopStats ShopSimulator::get_stats() const
+{
+   return stats_;
+}
+
+/**
+ * This returns the wait of every customer until a barber was assigned
+ * or it balked, as the CustomerExecutor records it.
+ * No other methods are called.
+ * @return wait histogram in virtual nanoseconds
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+const Histogram& ShopSimulator::get_wait() const
+{
+   return wait_;
+}
+
+/**
+ * This returns the time from arrival until leaving of every served
+ * customer, as the CustomerExecutor records it.
+ * No other methods are called.
+ * @return end-to-end histogram in virtual nanoseconds
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+const Histogram& ShopSimulator::get_total() const
+{
+   return total_;
+}
+
+/**
+ * This returns the virtual time elapsed since the simulation started.
+ * No other methods are called.
+ * @return virtual nanoseconds until the last event
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+uint64_t ShopSimulator::get_elapsed_ns() const
+{
+   return now_ns_;
+}
+
+/**
+ * This returns the virtual time of the last arrival.
+ * No other methods are called.
+ * @return virtual nanoseconds until the last customer arrived
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+uint64_t ShopSimulator::get_last_arrival_ns() const
+{
+   return last_arrival_ns_;
+}
@@ -0,0 +1,214 @@
+/**
+ * ShopSimulator.h
+ *
+ * This is the ShopSimulator.h file that defines the ShopSimulator class, a
+ * single-threaded discrete-event model of the Shop class running on a
+ * virtual clock. It applies the same rules as the threaded shop: a FIFO
+ * waiting room of num_chairs seats, customers balking when every seat is
+ * taken, customers without chairs balking unless a barber is free, and
+ * barbers sleeping in FIFO order until a customer wakes them.
+ *
+ * Customers arrive as a seeded ArrivalProcess, Poisson unless told
+ * otherwise, and every hair-cut takes exactly service_time, so a run is reproducible and
+ * takes no wall-clock time beyond the event processing itself. The only
+ * pending events are the next arrival and at most one completion per
+ * barber, so each event costs a heap operation over num_barbers entries.
+ *
+ * Results are reported as the same ShopStats the threaded shop produces,
+ * plus the wait and end-to-end histograms the benchmark's executor
+ * records, so the two engines can be cross-checked point by point.
+ **/
+#ifndef SHOP_SIMULATOR_H_
+#define SHOP_SIMULATOR_H_
+#include <stdint.h>
+#include <queue>
+#include <random>
+#include <vector>
+#include "ShopStats.h"
+#include "Histogram.h"
+#include "ArrivalProcess.h"
+using namespace std;
+
+class ShopSimulator
+{
+public:
+
+   /**
+    * Creates a simulated shop with every barber asleep and an empty room.
+    * No other methods are called.
+    * @param num_barbers number of barbers
+    * @param num_chairs maximum number of waiting customers there can be
+    * @param service_time duration of every hair-cut in μ seconds
+    * @param arrival_rate mean number of arrivals per virtual second
+    * @param seed seed of the arrival generator
+    * @return none
+    * @custom.preconditions  num_barbers >= 1, num_chairs >= 0,
+    *                        service_time > 0, arrival_rate > 0
+    * @custom.postconditions  simulator ready to run at virtual time 0
+    **/
+   ShopSimulator(int num_barbers, int num_chairs, int service_time, double arrival_rate, unsigned long seed);
+
+   /**
+    * Creates a simulated shop whose customers arrive as the given
+    * arrival process, so the simulator sees the same arrival times as a
+    * threaded run paced by an ArrivalProcess with the same options.
+    * No other methods are called.
+    * @param num_barbers number of barbers
+    * @param num_chairs maximum number of waiting customers there can be
+    * @param service_time duration of every hair-cut in μ seconds
+    * @param arrivals arrival process of the customers
+    * @return none
+    * @custom.preconditions  num_barbers >= 1, num_chairs >= 0,
+    *                        service_time > 0, arrivals.rate_ > 0
+    * @custom.postconditions  simulator ready to run at virtual time 0
+    **/
+   ShopSimulator(int num_barbers, int num_chairs, int service_time, const ArrivalOptions& arrivals);
+
+   /**
+    * Simulates num_customers more arrivals and runs until every admitted
+    * customer has been served.
+    * No other methods are called.
+    * @param num_customers number of customers that arrive
+    * @return none
+    * @custom.preconditions  num_customers >= 0
+    * @custom.postconditions  all customers served or dropped
+    **/
+   void run(long num_customers);
+
+   /**
+    * This returns the statistics of the simulated shop, in virtual time.
+    * No other methods are called.
+    * @return statistics in the same form as Shop::get_stats
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   ShopStats get_stats() const;
+
+   /**
+    * This returns the wait of every customer until a barber was assigned
+    * or it balked, as the CustomerExecutor records it.
+    * No other methods are called.
+    * @return wait histogram in virtual nanoseconds
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   const Histogram& get_wait() const;
+
+   /**
+    * This returns the time from arrival until leaving of every served
+    * customer, as the CustomerExecutor records it.
+    * No other methods are called.
+    * @return end-to-end histogram in virtual nanoseconds
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   const Histogram& get_total() const;
+
+   /**
+    * This returns the virtual time elapsed since the simulation started.
+    * No other methods are called.
+    * @return virtual nanoseconds until the last event
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   uint64_t get_elapsed_ns() const;
+
+   /**
+    * This returns the virtual time of the last arrival.
+    * No other methods are called.
+    * @return virtual nanoseconds until the last customer arrived
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   uint64_t get_last_arrival_ns() const;
+
+private:
+
+   /** a barber finishing a hair-cut */
+   struct Completion {
+      /** virtual time of the completion */
+      uint64_t time_ns_;
+      /** barber finishing */
+      int barber_id_;
+
+      bool operator>(const Completion& other) const
+      {
+         return time_ns_ > other.time_ns_;
+      }
+   };
+
+   /** state of one simulated barber */
+   struct SimBarber {
+      /** arrival time of the customer in the chair */
+      uint64_t customer_arrival_ns_{0};
+      /** time the barber last fell asleep */
+      uint64_t asleep_since_ns_{0};
+   };
+
+   /** number of barbers */
+   int num_barbers_;
+   /** number of waiting chairs */
+   int num_chairs_;
+   /** duration of every hair-cut */
+   uint64_t service_ns_;
+   /** current virtual time */
+   uint64_t now_ns_;
+   /** virtual time of the last arrival */
+   uint64_t last_arrival_ns_;
+   /** arrival generator */
+   ArrivalProcess arrivals_;
+   /** pending completions, earliest first */
+   priority_queue<Completion, vector<Completion>, greater<Completion> > completions_;
+   /** arrival times of waiting customers, a ring of num_chairs seats */
+   vector<uint64_t> waiting_;
+   /** index of the oldest waiting customer */
+   int waiting_head_;
+   /** number of waiting customers */
+   int waiting_count_;
+   /** ids of sleeping barbers, a ring of num_barbers entries */
+   vector<int> sleeping_;
+   /** index of the barber that fell asleep first */
+   int sleeping_head_;
+   /** number of sleeping barbers */
+   int sleeping_count_;
+   /** per-barber state */
+   vector<SimBarber> barbers_;
+   /** accumulated statistics */
+   ShopStats stats_;
+   /** wait until assigned or balked, every customer */
+   Histogram wait_;
+   /** arrival until served, served customers */
+   Histogram total_;
+
+   /**
+    * Handles a customer arriving at now_ns_.
+    * Calls startService method.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  customer seated, served or dropped
+    **/
+   void arrive();
+
+   /**
+    * Handles a barber finishing a hair-cut at now_ns_ and calls in the
+    * next waiting customer, or puts the barber to sleep.
+    * Calls startService method.
+    * @param barber_id barber finishing
+    * @return none
+    * @custom.preconditions  barber_id is busy
+    * @custom.postconditions  barber busy with the next customer or asleep
+    **/
+   void complete(int barber_id);
+
+   /**
+    * Starts a hair-cut for a customer that arrived at arrival_ns.
+    * No other methods are called.
+    * @param barber_id free barber doing the hair-cut
+    * @param arrival_ns arrival time of the customer
+    * @return none
+    * @custom.preconditions  barber_id is free
+    * @custom.postconditions  completion scheduled
+    **/
+   void startService(int barber_id, uint64_t arrival_ns);
+};
+#endif
@@ -0,0 +1,76 @@
+/**
+ * ShopStats.h
+ *
+ * This is the ShopStats.h file that defines the statistics a Shop reports
+ * through get_stats. Latencies are histograms in nanoseconds: queue wait
+ * is the time from a customer entering visitShop until a barber is
+ * assigned, service is the hair-cut from the barber starting it in
+ * helloCustomer until byeCustomer, and payment is the time the barber
+ * then waits in byeCustomer for the customer to pay.
+ *
+ * Customers that leave without service either balked, turned away on
+ * arrival, or reneged, gave up waiting once their patience ran out. A
+ * shop that dispatches by priority class also reports the queue wait and
+ * reneges of each class.
+ *
+ * Each barber also reports how long it was busy with customers and how
+ * long it slept waiting for one.
+ **/
+#ifndef SHOP_STATS_H_
+#define SHOP_STATS_H_
+#include <stdint.h>
+#include <vector>
+#include "Histogram.h"
+using namespace std;
+
+/** number of priority classes a shop can tell apart, class 0 first */
+#define kMaxPriorityClasses 4
+
+/** time accounting of one barber */
+struct BarberStats {
+   /** number of customers the barber finished */
+   long served_{0};
+   /** time spent from starting a hair-cut until paid and free again */
+   uint64_t busy_ns_{0};
+   /** time spent asleep waiting for a customer */
+   uint64_t idle_ns_{0};
+
+   /**
+    * This returns the fraction of the barber's accounted time spent busy.
+    * No other methods are called.
+    * @return busy / (busy + idle), 0 if nothing was accounted yet
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   double get_utilization() const
+   {
+      uint64_t accounted = busy_ns_ + idle_ns_;
+      return (accounted == 0) ? 0.0 : (double) busy_ns_ / accounted;
+   }
+};
+
+/** statistics of a Shop, merged from every thread when read */
+struct ShopStats {
+   /** number of customers that entered visitShop */
+   long arrivals_{0};
+   /** number of customers that were served and paid */
+   long served_{0};
+   /** number of customers turned away on arrival */
+   long drops_{0};
+   /** number of customers that gave up waiting */
+   long reneges_{0};
+   /** visitShop entry until a barber is assigned, served customers only */
+   Histogram queue_wait_;
+   /** hair-cut start until the barber is done */
+   Histogram service_;
+   /** barber done until the customer has paid */
+   Histogram payment_;
+   /** queue wait of the served customers of each priority class, only 
+    *  recorded by shops that seat waiting customers on tickets */
+   Histogram class_wait_[kMaxPriorityClasses];
+   /** reneges of each priority class */
+   long class_reneges_[kMaxPriorityClasses] = {};
+   /** per-barber time accounting, indexed by barber id */
+   vector<BarberStats> barbers_;
+};
+#endif
@@ -0,0 +1,213 @@
+/**
+ * StatsPage.cpp
+ *
+ * This is the StatsPage.cpp file that implements the methods of the
+ * StatsPublisher class. The page is built in
+ * a file next to the final one and renamed over it, so a reader opening
+ * the path sees either the page of an earlier run, which stops changing,
+ * or a complete new one.
+ **/
+#include "StatsPage.h"
+#include "Clock.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+
+/** format version of the page */
+#define kStatsPageVersion 1
+
+/**
+ * Creates the stats page file and starts the thread publishing the
+ * shop's counters to it.
+ * No other methods are called.
+ * @param shop shop whose counters are published
+ * @param path file of the page, such as /dev/shm/barbers.stats
+ * @param interval_ms time between two readings in milliseconds
+ * @return none
+ * @custom.preconditions  shop outlives the publisher
+ * @custom.postconditions  good() tells whether the page was created
+ **/
+StatsPublisher::StatsPublisher(Shop* shop, const char* path, int interval_ms) :
+   shop_(shop), page_(NULL), interval_ms_((interval_ms < 1) ? 1 : interval_ms), samples_(0),
+   stopping_(false)
+{
+   memset(history_, 0, sizeof(history_));
+   pthread_mutex_init(&mutex_, NULL);
+   /** stop wakes the thread on the clock its deadlines are taken on */
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&cond_stop_, &attr);
+   pthread_condattr_destroy(&attr);
+
+   string building = string(path) + ".tmp";
+   int fd = open(building.c_str(), O_CREAT | O_TRUNC | O_RDWR, 0644);
+   if (fd < 0) {
+      return;
+   }
+   if (ftruncate(fd, sizeof(StatsPage)) != 0) {
+      ::close(fd);
+      unlink(building.c_str());
+      return;
+   }
+   void* map = mmap(NULL, sizeof(StatsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   ::close(fd);
+   if (map == MAP_FAILED) {
+      unlink(building.c_str());
+      return;
+   }
+   page_ = (StatsPage*) map;
+   /** the file is zero filled, only what is not zero is set */
+   memcpy(page_->magic_, "SBST", 4);
+   page_->version_ = kStatsPageVersion;
+   page_->size_ = sizeof(StatsPage);
+   page_->interval_ms_ = interval_ms_;
+   publish();
+   if (rename(building.c_str(), path) != 0) {
+      munmap(page_, sizeof(StatsPage));
+      unlink(building.c_str());
+      page_ = NULL;
+      return;
+   }
+   pthread_create(&thread_, NULL, run, this);
+}
+
+/**
+ * Destructor for StatsPublisher class. Stops the publisher if stop has
+ * not been called yet. The file is left for readers to see the last
+ * reading.
+ * Calls stop method.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  thread joined, page unmapped
+ **/
+StatsPublisher::~StatsPublisher()
+{
+   stop();
+   if (page_ != NULL) {
+      munmap(page_, sizeof(StatsPage));
+   }
+   pthread_cond_destroy(&cond_stop_);
+   pthread_mutex_destroy(&mutex_);
+}
+
+/**
+ * This returns false if the page could not be created.
+ * No other methods are called.
+ * @return true if the shop is being published
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+bool StatsPublisher::good() const
+{
+   return page_ != NULL;
+}
+
+/**
+ * Publishes a last reading and stops the thread.
+ * Calls publish method.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  thread joined
+ **/
+void StatsPublisher::stop()
+{
+   pthread_mutex_lock(&mutex_);
+   if (stopping_ || page_ == NULL) {
+      stopping_ = true;
+      pthread_mutex_unlock(&mutex_);
+      return;
+   }
+   stopping_ = true;
+   pthread_cond_signal(&cond_stop_);
+   pthread_mutex_unlock(&mutex_);
+   pthread_join(thread_, NULL);
+   publish();
+}
+
+/**
+ * Reads the shop's counters and writes them to the page.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  called by one thread at a time
+ * @custom.postconditions  page holds a new reading
+ **/
+void StatsPublisher::publish()
+{
+   StatsSample sample;
+   memset(&sample, 0, sizeof(sample));
+   ShopStats stats = shop_->get_stats();
+   sample.timestamp_ns_ = monotonicNs();
+   sample.samples_ = ++samples_;
+   sample.arrivals_ = stats.arrivals_;
+   sample.balks_ = stats.drops_;
+   sample.reneges_ = stats.reneges_;
+   sample.served_ = stats.served_;
+   sample.waiting_ = shop_->get_waiting();
+   sample.chairs_ = shop_->get_num_chairs();
+   sample.active_barbers_ = shop_->get_active_barbers();
+   sample.sleeping_barbers_ = shop_->get_free_barbers();
+   /** the two counts are read apart, so a barber waking in between may
+    *  be off by one, never below zero */
+   sample.busy_barbers_ = sample.active_barbers_ - sample.sleeping_barbers_;
+   if (sample.busy_barbers_ < 0) {
+      sample.busy_barbers_ = 0;
+   }
+   sample.wait_p50_ns_ = stats.queue_wait_.percentile(50);
+   sample.wait_p99_ns_ = stats.queue_wait_.percentile(99);
+
+   /** rates since the oldest reading still in the window, the very first
+    *  reading has none */
+   StatsSample& oldest = history_[samples_ % kStatsRateWindow];
+   if (samples_ > 1) {
+      const StatsSample& since = (samples_ > kStatsRateWindow) ? oldest : history_[1];
+      double elapsed_s = (sample.timestamp_ns_ - since.timestamp_ns_) / 1e9;
+      if (elapsed_s > 0) {
+         sample.arrival_rate_ = (sample.arrivals_ - since.arrivals_) / elapsed_s;
+         sample.served_rate_ = (sample.served_ - since.served_) / elapsed_s;
+      }
+   }
+   oldest = sample;
+
+   /** odd while the sample is written, readers retry until it is even */
+   uint64_t sequence = page_->sequence_.load(memory_order_relaxed);
+   page_->sequence_.store(sequence + 1, memory_order_relaxed);
+   atomic_thread_fence(memory_order_release);
+   memcpy(&page_->sample_, &sample, sizeof(StatsSample));
+   page_->sequence_.store(sequence + 2, memory_order_release);
+}
+
+/**
+ * Entry point of the publisher thread.
+ * Calls publish method.
+ * @param arg the publisher
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  thread exits once stopping_ is set
+ **/
+void* StatsPublisher::run(void* arg)
+{
+   StatsPublisher* self = (StatsPublisher*) arg;
+   uint64_t deadline_ns = monotonicNs();
+   pthread_mutex_lock(&self->mutex_);
+   while (!self->stopping_) {
+      deadline_ns += (uint64_t) self->interval_ms_ * 1000000ULL;
+      struct timespec deadline;
+      deadline.tv_sec = deadline_ns / 1000000000ULL;
+      deadline.tv_nsec = deadline_ns % 1000000000ULL;
+      while (!self->stopping_ && monotonicNs() < deadline_ns) {
+         pthread_cond_timedwait(&self->cond_stop_, &self->mutex_, &deadline);
+      }
+      if (self->stopping_) {
+         break;
+      }
+      pthread_mutex_unlock(&self->mutex_);
+      self->publish();
+      pthread_mutex_lock(&self->mutex_);
+   }
+   pthread_mutex_unlock(&self->mutex_);
+   return nullptr;
+}
@@ -0,0 +1,205 @@
+/**
+ * StatsPage.h
+ *
+ * This is the StatsPage.h file that defines the stats page, a small
+ * memory-mapped file through which a running Shop shows its live
+ * counters to other processes, and the StatsPublisher class that keeps
+ * it up to date.
+ *
+ * The shop's customers and barbers already count into per-thread and
+ * per-barber counters, and the locked and ticket rooms copy their queue
+ * sizes into relaxed gauges whenever they change them. A publisher
+ * thread reads these, like get_stats does, every interval and writes one
+ * StatsSample into the page under a seqlock: the sequence number is odd
+ * while the sample is being written, so a reader that saw the same even
+ * number before and after copying it has a consistent sample. Readers
+ * never write to the page and take no lock, the writer never waits for
+ * a reader, and a reader that polls the page costs the shop nothing. The
+ * publisher takes no lock of the waiting room either.
+ *
+ * Rates are taken over the last kStatsRateWindow samples, so they follow
+ * the load within a few intervals and smooth out single ones.
+ **/
+#ifndef STATS_PAGE_H_
+#define STATS_PAGE_H_
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include "Shop.h"
+using namespace std;
+
+/** samples the rolling rates are taken over */
+#define kStatsRateWindow 10
+/** tries before a reader gives up on a page being rewritten constantly */
+#define kStatsReadTries 1000
+
+/** one reading of a shop's counters */
+struct StatsSample {
+   /** CLOCK_MONOTONIC time of the reading in nanoseconds */
+   uint64_t timestamp_ns_;
+   /** readings published so far, this one included */
+   uint64_t samples_;
+   /** customers that walked in, 0 unless the shop collects stats */
+   int64_t arrivals_;
+   /** customers turned away for want of a chair or barber */
+   int64_t balks_;
+   /** customers that gave up waiting */
+   int64_t reneges_;
+   /** customers whose hair-cut is done */
+   int64_t served_;
+   /** customers in the waiting room now */
+   int32_t waiting_;
+   /** waiting chairs */
+   int32_t chairs_;
+   /** barbers serving or about to serve a customer */
+   int32_t busy_barbers_;
+   /** barbers asleep waiting for a customer */
+   int32_t sleeping_barbers_;
+   /** barbers working, busy or asleep */
+   int32_t active_barbers_;
+   /** padding, zero */
+   int32_t reserved_;
+   /** arrivals and served customers per second over the rate window */
+   double arrival_rate_;
+   double served_rate_;
+   /** queue wait percentiles since the shop opened, in nanoseconds */
+   uint64_t wait_p50_ns_;
+   uint64_t wait_p99_ns_;
+};
+
+/** layout of the stats page file */
+struct StatsPage {
+   /** "SBST" */
+   char magic_[4];
+   /** format version */
+   uint32_t version_;
+   /** sizeof(StatsPage) */
+   uint32_t size_;
+   /** interval between two readings in milliseconds */
+   uint32_t interval_ms_;
+   /** seqlock sequence, odd while sample_ is being written */
+   atomic<uint64_t> sequence_;
+   /** the latest reading */
+   StatsSample sample_;
+
+   /**
+    * Copies the latest reading out of a page another process writes,
+    * retrying while the writer is in the middle of it.
+    * No other methods are called.
+    * @param page mapped page
+    * @param sample receives the reading
+    * @return false if no consistent reading was seen after many tries
+    * @custom.preconditions  page mapped readable
+    * @custom.postconditions  sample holds a reading written as a whole
+    **/
+   static bool read(const StatsPage* page, StatsSample* sample)
+   {
+      for (int i = 0; i < kStatsReadTries; i++) {
+         uint64_t before = page->sequence_.load(memory_order_acquire);
+         if (before & 1) {
+            sched_yield();
+            continue;
+         }
+         memcpy(sample, &page->sample_, sizeof(StatsSample));
+         /** the copy is done before the sequence is read again */
+         atomic_thread_fence(memory_order_acquire);
+         if (page->sequence_.load(memory_order_relaxed) == before) {
+            return true;
+         }
+      }
+      return false;
+   }
+};
+
+class StatsPublisher
+{
+public:
+
+   /**
+    * Creates the stats page file and starts the thread publishing the
+    * shop's counters to it.
+    * No other methods are called.
+    * @param shop shop whose counters are published
+    * @param path file of the page, such as /dev/shm/barbers.stats
+    * @param interval_ms time between two readings in milliseconds
+    * @return none
+    * @custom.preconditions  shop outlives the publisher
+    * @custom.postconditions  good() tells whether the page was created
+    **/
+   StatsPublisher(Shop* shop, const char* path, int interval_ms);
+
+   /**
+    * Destructor for StatsPublisher class. Stops the publisher if stop
+    * has not been called yet. The file is left for readers to see the
+    * last reading.
+    * Calls stop method.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  thread joined, page unmapped
+    **/
+   ~StatsPublisher();
+
+   /**
+    * This returns false if the page could not be created.
+    * No other methods are called.
+    * @return true if the shop is being published
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   bool good() const;
+
+   /**
+    * Publishes a last reading and stops the thread.
+    * Calls publish method.
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  thread joined
+    **/
+   void stop();
+
+private:
+
+   /** shop published */
+   Shop* shop_;
+   /** mapped page, NULL if not good */
+   StatsPage* page_;
+   /** time between two readings */
+   int interval_ms_;
+   /** earlier readings the rates are taken over, oldest overwritten */
+   StatsSample history_[kStatsRateWindow];
+   /** readings taken */
+   uint64_t samples_;
+   /** true once stop was called */
+   bool stopping_;
+   /** guards stopping_ */
+   pthread_mutex_t mutex_;
+   /** wakes the thread early when stopping */
+   pthread_cond_t cond_stop_;
+   /** publisher thread */
+   pthread_t thread_;
+
+   /**
+    * Reads the shop's counters and writes them to the page.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  called by one thread at a time
+    * @custom.postconditions  page holds a new reading
+    **/
+   void publish();
+
+   /**
+    * Entry point of the publisher thread.
+    * Calls publish method.
+    * @param arg the publisher
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  thread exits once stopping_ is set
+    **/
+   static void* run(void* arg);
+
+   StatsPublisher(const StatsPublisher&) = delete;
+   StatsPublisher& operator=(const StatsPublisher&) = delete;
+};
+#endif
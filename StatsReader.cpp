@@ -0,0 +1,244 @@
+/**
+ * StatsReader.cpp
+ *
+ * This is the StatsReader.cpp file that polls the stats page a running
+ * shop publishes, typically shopBenchmark --stats-page, from another
+ * process. It maps the page read-only and takes no lock of the shop, so
+ * it can be left running against a shop under load.
+ *
+ * Every interval one row is printed: the rolling arrival and served
+ * rates of the page, the balks and reneges per second since the last
+ * row, the customers waiting, the busy and sleeping barbers and the
+ * queue wait percentiles. A page whose last reading is older than a few
+ * of its intervals is flagged stale; if a new run replaced the file the
+ * new page is mapped instead.
+ *
+ * With --prom the latest reading is also written to a file in the
+ * Prometheus text format each interval, for the textfile collector of a
+ * node exporter or any scraper reading files. The file is replaced as a
+ * whole, so a scrape never sees half of it.
+ *
+ * Usage: shopStats page [--interval 1000] [--count 0] [--prom file]
+ **/
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <iostream>
+#include <string>
+#include "StatsPage.h"
+#include "Clock.h"
+using namespace std;
+
+/** intervals of the page without a reading before it is called stale */
+#define kStaleIntervals 3
+
+/** maps a stats page read-only */
+static const StatsPage* mapPage(const char* path, ino_t* inode);
+/** writes a reading in the Prometheus text format */
+static bool writeProm(const char* path, const StatsSample& sample, double age_s);
+
+/**
+ * Parses the command line and prints the page once per interval.
+ * Calls mapPage and writeProm methods.
+ * @return 0 on success, -1 on bad arguments or an unreadable page
+ * @custom.preconditions  none
+ * @custom.postconditions  one row per interval written to stdout
+ **/
+int main(int argc, char *argv[])
+{
+   const char* path = NULL;
+   int interval_ms = 1000;
+   long count = 0;
+   const char* prom_path = NULL;
+
+   for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      if (arg[0] != '-' && path == NULL) {
+         path = argv[i];
+         continue;
+      }
+      if (i + 1 >= argc) {
+         path = NULL;
+         break;
+      }
+      const char* value = argv[++i];
+      if (arg == "--interval") {
+         interval_ms = atoi(value);
+      } else if (arg == "--count") {
+         count = atol(value);
+      } else if (arg == "--prom") {
+         prom_path = value;
+      } else {
+         path = NULL;
+         break;
+      }
+   }
+   if (path == NULL || interval_ms < 1) {
+      cerr << "usage: shopStats page [--interval 1000] [--count 0] [--prom file]" << endl;
+      return -1;
+   }
+
+   ino_t inode;
+   const StatsPage* page = mapPage(path, &inode);
+   if (page == NULL) {
+      cerr << "cannot read stats page " << path << endl;
+      return -1;
+   }
+
+   printf("%-8s %10s %10s %8s %8s %9s %5s %6s %9s %9s\n", "time_s", "arrive/s", "served/s", "balk/s",
+          "renege/s", "waiting", "busy", "asleep", "wait_p50", "wait_p99");
+   StatsSample last;
+   memset(&last, 0, sizeof(last));
+   uint64_t start_ns = monotonicNs();
+   for (long row = 0; count == 0 || row < count; row++) {
+      if (row > 0) {
+         usleep(interval_ms * 1000);
+      }
+      StatsSample sample;
+      if (!StatsPage::read(page, &sample)) {
+         printf("# page %s is rewritten too fast to read\n", path);
+         continue;
+      }
+      uint64_t now_ns = monotonicNs();
+      double age_s = (now_ns > sample.timestamp_ns_) ? (now_ns - sample.timestamp_ns_) / 1e9 : 0.0;
+      bool stale = age_s * 1e3 > kStaleIntervals * page->interval_ms_;
+      if (stale) {
+         /** a new run renames a new page over the path */
+         struct stat info;
+         if (stat(path, &info) == 0 && info.st_ino != inode) {
+            const StatsPage* fresh = mapPage(path, &inode);
+            if (fresh != NULL) {
+               munmap((void*) page, sizeof(StatsPage));
+               page = fresh;
+               memset(&last, 0, sizeof(last));
+               row--;
+               continue;
+            }
+         }
+      }
+
+      /** balks and reneges per second since the last row, the page only
+       *  keeps rates of arrivals and served customers */
+      double balk_rate = 0;
+      double renege_rate = 0;
+      if (last.samples_ > 0 && sample.timestamp_ns_ > last.timestamp_ns_) {
+         double elapsed_s = (sample.timestamp_ns_ - last.timestamp_ns_) / 1e9;
+         balk_rate = (sample.balks_ - last.balks_) / elapsed_s;
+         renege_rate = (sample.reneges_ - last.reneges_) / elapsed_s;
+      }
+      char waiting[24];
+      snprintf(waiting, sizeof(waiting), "%d/%d", sample.waiting_, sample.chairs_);
+      printf("%-8.1f %10.0f %10.0f %8.0f %8.0f %9s %5d %6d %9.1f %9.1f%s\n",
+             (now_ns - start_ns) / 1e9, sample.arrival_rate_, sample.served_rate_, balk_rate,
+             renege_rate, waiting, sample.busy_barbers_, sample.sleeping_barbers_,
+             sample.wait_p50_ns_ / 1e3, sample.wait_p99_ns_ / 1e3, stale ? "  stale" : "");
+      fflush(stdout);
+      if (prom_path != NULL && !writeProm(prom_path, sample, age_s)) {
+         cerr << "cannot write " << prom_path << endl;
+         return -1;
+      }
+      last = sample;
+   }
+   munmap((void*) page, sizeof(StatsPage));
+   return 0;
+}
+
+/**
+ * Maps a stats page read-only and checks it was written by a compatible
+ * publisher.
+ * No other methods are called.
+ * @param path file of the page
+ * @param inode receives the inode of the mapped file
+ * @return the page, NULL if it cannot be read
+ * @custom.preconditions  none
+ * @custom.postconditions  page mapped, to be unmapped by the caller
+ **/
+static const StatsPage* mapPage(const char* path, ino_t* inode)
+{
+   int fd = open(path, O_RDONLY);
+   if (fd < 0) {
+      return NULL;
+   }
+   struct stat info;
+   if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(StatsPage)) {
+      close(fd);
+      return NULL;
+   }
+   void* map = mmap(NULL, sizeof(StatsPage), PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);
+   if (map == MAP_FAILED) {
+      return NULL;
+   }
+   const StatsPage* page = (const StatsPage*) map;
+   if (memcmp(page->magic_, "SBST", 4) != 0 || page->size_ != sizeof(StatsPage)) {
+      munmap(map, sizeof(StatsPage));
+      return NULL;
+   }
+   *inode = info.st_ino;
+   return page;
+}
+
+/**
+ * Writes a reading in the Prometheus text format, to a file next to the
+ * given one that is then renamed over it.
+ * No other methods are called.
+ * @param path file to write
+ * @param sample the reading
+ * @param age_s seconds since the reading was taken
+ * @return false if the file cannot be written
+ * @custom.preconditions  none
+ * @custom.postconditions  path holds the reading
+ **/
+static bool writeProm(const char* path, const StatsSample& sample, double age_s)
+{
+   string building = string(path) + ".tmp";
+   FILE* out = fopen(building.c_str(), "w");
+   if (out == NULL) {
+      return false;
+   }
+   fprintf(out, "# HELP barbershop_arrivals_total Customers that walked into the shop.\n");
+   fprintf(out, "# TYPE barbershop_arrivals_total counter\n");
+   fprintf(out, "barbershop_arrivals_total %lld\n", (long long) sample.arrivals_);
+   fprintf(out, "# HELP barbershop_balks_total Customers turned away for want of a chair or barber.\n");
+   fprintf(out, "# TYPE barbershop_balks_total counter\n");
+   fprintf(out, "barbershop_balks_total %lld\n", (long long) sample.balks_);
+   fprintf(out, "# HELP barbershop_reneges_total Customers that gave up waiting.\n");
+   fprintf(out, "# TYPE barbershop_reneges_total counter\n");
+   fprintf(out, "barbershop_reneges_total %lld\n", (long long) sample.reneges_);
+   fprintf(out, "# HELP barbershop_served_total Customers whose hair-cut is done.\n");
+   fprintf(out, "# TYPE barbershop_served_total counter\n");
+   fprintf(out, "barbershop_served_total %lld\n", (long long) sample.served_);
+   fprintf(out, "# HELP barbershop_waiting Customers in the waiting chairs.\n");
+   fprintf(out, "# TYPE barbershop_waiting gauge\n");
+   fprintf(out, "barbershop_waiting %d\n", sample.waiting_);
+   fprintf(out, "# HELP barbershop_chairs Waiting chairs.\n");
+   fprintf(out, "# TYPE barbershop_chairs gauge\n");
+   fprintf(out, "barbershop_chairs %d\n", sample.chairs_);
+   fprintf(out, "# HELP barbershop_barbers Working barbers by state.\n");
+   fprintf(out, "# TYPE barbershop_barbers gauge\n");
+   fprintf(out, "barbershop_barbers{state=\"busy\"} %d\n", sample.busy_barbers_);
+   fprintf(out, "barbershop_barbers{state=\"sleeping\"} %d\n", sample.sleeping_barbers_);
+   fprintf(out, "# HELP barbershop_arrival_rate Arrivals per second over the last readings.\n");
+   fprintf(out, "# TYPE barbershop_arrival_rate gauge\n");
+   fprintf(out, "barbershop_arrival_rate %.3f\n", sample.arrival_rate_);
+   fprintf(out, "# HELP barbershop_served_rate Served customers per second over the last readings.\n");
+   fprintf(out, "# TYPE barbershop_served_rate gauge\n");
+   fprintf(out, "barbershop_served_rate %.3f\n", sample.served_rate_);
+   fprintf(out, "# HELP barbershop_queue_wait_seconds Queue wait of served customers since the shop opened.\n");
+   fprintf(out, "# TYPE barbershop_queue_wait_seconds gauge\n");
+   fprintf(out, "barbershop_queue_wait_seconds{quantile=\"0.5\"} %.9f\n", sample.wait_p50_ns_ / 1e9);
+   fprintf(out, "barbershop_queue_wait_seconds{quantile=\"0.99\"} %.9f\n", sample.wait_p99_ns_ / 1e9);
+   fprintf(out, "# HELP barbershop_stats_age_seconds Time since the shop last published.\n");
+   fprintf(out, "# TYPE barbershop_stats_age_seconds gauge\n");
+   fprintf(out, "barbershop_stats_age_seconds %.3f\n", age_s);
+   bool written = !ferror(out);
+   if (fclose(out) != 0 || !written) {
+      unlink(building.c_str());
+      return false;
+   }
+   return rename(building.c_str(), path) == 0;
+}
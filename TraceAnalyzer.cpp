@@ -0,0 +1,464 @@
+/**
+ * TraceAnalyzer.cpp
+ *
+ * This is the TraceAnalyzer.cpp file that reads back an event file of the
+ * binary or trace sink, typically recorded with shopBenchmark
+ * --event-trace, and reconstructs what happened in the shop:
+ *
+ * Every customer's timeline from walking in to saying good-bye, balking
+ * or reneging gives the queue wait and the time in the shop of every
+ * served customer. The waiting customers are counted up as they take a
+ * chair and down as they move to a barber or give up, which gives the
+ * queue depth over time, and the time between a barber's start and end
+ * of each hair-cut gives its utilization, next to how often it slept.
+ * A customer logs moving to a barber once it runs again, after the
+ * barber called it in, so the depth can run a customer or two over the
+ * number of chairs.
+ *
+ * With --timeline the events of one customer are printed. With --depth
+ * the queue depth is printed per interval. With --arrivals-out and
+ * --service-out the recorded arrival times and hair-cut durations are
+ * written as traces that shopBenchmark replays with --trace and
+ * --service-dist trace --service-trace, to run the recorded incident
+ * again against any number of barbers and chairs.
+ *
+ * A trace of shopBenchmark holds a run per point and per warm-up, each
+ * started by a kEventRunStarts record, and customer ids start over in
+ * every run. Such a trace is reported one run at a time, picked with
+ * --run. A customer that walks in twice within the reported events means
+ * runs were recorded without markers, which is refused.
+ *
+ * Barbers are told apart by their id alone, so the barbers of the shops
+ * of a Franchise with the same id are counted as one.
+ **/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "EventLog.h"
+#include "EventTrace.h"
+#include "Histogram.h"
+using namespace std;
+
+/** what became of a customer */
+enum VisitOutcome {
+   /** still in the shop when the trace ends */
+   kVisitOpen,
+   /** served and said good-bye */
+   kVisitServed,
+   /** left because there was no chair or barber */
+   kVisitBalked,
+   /** gave up waiting */
+   kVisitReneged
+};
+
+/** one customer's visit, times in nanoseconds, 0 if it did not happen */
+struct CustomerTimeline {
+   uint64_t arrive_ns_{0};
+   uint64_t sit_ns_{0};
+   uint64_t start_ns_{0};
+   uint64_t done_ns_{0};
+   /** barber that served the customer, -1 if none */
+   int barber_{-1};
+   VisitOutcome outcome_{kVisitOpen};
+};
+
+/** one barber's work over the trace */
+struct BarberTimeline {
+   /** time spent on hair-cuts */
+   uint64_t busy_ns_{0};
+   /** start of the hair-cut in progress, 0 if none */
+   uint64_t busy_since_ns_{0};
+   long served_{0};
+   long sleeps_{0};
+   /** hair-cuts started after sleeping */
+   long wakeups_{0};
+   bool asleep_{false};
+};
+
+/** queue depth over one interval of --depth */
+struct DepthInterval {
+   int max_depth_{0};
+   int end_depth_{0};
+   /** true if an event fell into the interval */
+   bool seen_{false};
+   long arrivals_{0};
+   long served_{0};
+};
+
+/** prints the events of one customer */
+static void printTimeline(const EventTrace& trace, size_t first, size_t last, int id);
+/** lists the runs of a trace */
+static void printRuns(const EventTrace& trace, const vector<size_t>& runs);
+
+/**
+ * Maps the trace, replays its events in time order and prints what it
+ * found.
+ * Calls printTimeline and printRuns.
+ * @return 0 on success, -1 on bad arguments, an unreadable trace, a
+ *         trace of several runs without --run or one mixing runs
+ * @custom.preconditions  none
+ * @custom.postconditions  report written to stdout and requested files
+ **/
+int main(int argc, char *argv[])
+{
+   const char* path = NULL;
+   int timeline_id = 0;
+   int run = 0;
+   double depth_us = 0;
+   const char* arrivals_path = NULL;
+   const char* service_path = NULL;
+
+   for (int i = 1; i < argc; i++) {
+      string arg = argv[i];
+      if (arg[0] != '-' && path == NULL) {
+         path = argv[i];
+         continue;
+      }
+      if (i + 1 >= argc) {
+         path = NULL;
+         break;
+      }
+      const char* value = argv[++i];
+      if (arg == "--timeline") {
+         timeline_id = atoi(value);
+      } else if (arg == "--run") {
+         run = atoi(value);
+      } else if (arg == "--depth") {
+         depth_us = atof(value);
+      } else if (arg == "--arrivals-out") {
+         arrivals_path = value;
+      } else if (arg == "--service-out") {
+         service_path = value;
+      } else {
+         path = NULL;
+         break;
+      }
+   }
+   if (path == NULL) {
+      cerr << "usage: shopTrace trace [--run n] [--timeline customer] [--depth interval_us]" << endl;
+      cerr << "       [--arrivals-out file] [--service-out file]" << endl;
+      return -1;
+   }
+
+   EventTrace trace;
+   if (!trace.open(path)) {
+      cerr << "cannot read event trace " << path << endl;
+      return -1;
+   }
+   if (trace.get_size() == 0) {
+      printf("# trace %s holds no events\n", path);
+      return 0;
+   }
+
+   /** 
+    * runs[k] is the first event of run k + 1, events before the first 
+    * marker belong to the first run 
+    */
+   vector<size_t> runs;
+   for (size_t i = 0; i < trace.get_size(); i++) {
+      if (trace.at(i).code_ == kEventRunStarts) {
+         runs.push_back(runs.empty() ? 0 : i);
+      }
+   }
+   if (runs.empty()) {
+      runs.push_back(0);
+   }
+   if (run == 0 && runs.size() > 1) {
+      printRuns(trace, runs);
+      cerr << "the trace holds " << runs.size() << " runs, pick one with --run" << endl;
+      return -1;
+   }
+   if (run < 0 || run > (int) runs.size()) {
+      cerr << "the trace holds " << runs.size() << " runs, there is no run " << run << endl;
+      return -1;
+   }
+   if (run == 0) {
+      run = 1;
+   }
+   size_t first = runs[run - 1];
+   size_t last = ((size_t) run < runs.size()) ? runs[run] : trace.get_size();
+
+   if (timeline_id > 0) {
+      printTimeline(trace, first, last, timeline_id);
+      return 0;
+   }
+
+   FILE* arrivals_out = NULL;
+   FILE* service_out = NULL;
+   if (arrivals_path != NULL && (arrivals_out = fopen(arrivals_path, "w")) == NULL) {
+      cerr << "cannot create " << arrivals_path << endl;
+      return -1;
+   }
+   if (service_path != NULL && (service_out = fopen(service_path, "w")) == NULL) {
+      cerr << "cannot create " << service_path << endl;
+      return -1;
+   }
+
+   uint64_t start_ns = trace.at(first).timestamp_ns_;
+   uint64_t end_ns = trace.at(last - 1).timestamp_ns_;
+   uint64_t depth_ns = (uint64_t) (depth_us * 1000);
+   vector<DepthInterval> intervals;
+   if (depth_ns > 0) {
+      intervals.resize((end_ns - start_ns) / depth_ns + 1);
+   }
+
+   unordered_map<int, CustomerTimeline> customers;
+   vector<BarberTimeline> barbers;
+   uint64_t first_arrival_ns = 0;
+   int depth = 0;
+   int peak_depth = 0;
+   uint64_t peak_depth_ns = start_ns;
+   /** integral of the depth over time, for the mean */
+   double depth_area = 0;
+   uint64_t depth_since_ns = start_ns;
+
+   for (size_t i = first; i < last; i++) {
+      const EventRecord& event = trace.at(i);
+      uint64_t now = event.timestamp_ns_;
+      if (event.code_ == kEventRunStarts) {
+         continue;
+      }
+      DepthInterval* interval = (depth_ns > 0) ? &intervals[(now - start_ns) / depth_ns] : NULL;
+      int old_depth = depth;
+
+      if (event.actor_ > 0) {
+         CustomerTimeline& customer = customers[event.actor_];
+         if (event.code_ == kEventArrives && customer.arrive_ns_ != 0) {
+            cerr << "customer " << event.actor_ << " walks in twice, at "
+                 << (customer.arrive_ns_ - start_ns) / 1e6 << " and " << (now - start_ns) / 1e6
+                 << " ms: the trace mixes runs that are not marked" << endl;
+            return -1;
+         }
+         /** a shop that does not log arrivals still logs the first step */
+         if (customer.arrive_ns_ == 0) {
+            customer.arrive_ns_ = now;
+            if (first_arrival_ns == 0) {
+               first_arrival_ns = now;
+            }
+            if (arrivals_out != NULL) {
+               fprintf(arrivals_out, "%.3f\n", (now - first_arrival_ns) / 1e3);
+            }
+            if (interval != NULL) {
+               interval->arrivals_++;
+            }
+         }
+         switch (event.code_) {
+         case kEventTakesChair:
+            customer.sit_ns_ = now;
+            depth++;
+            break;
+         case kEventMovesToChair:
+            customer.start_ns_ = now;
+            customer.barber_ = event.arg0_;
+            if (customer.sit_ns_ != 0 && depth > 0) {
+               depth--;
+            }
+            break;
+         case kEventBalkNoChairs:
+         case kEventBalkNoBarbers:
+            customer.outcome_ = kVisitBalked;
+            break;
+         case kEventReneges:
+            customer.outcome_ = kVisitReneged;
+            if (customer.sit_ns_ != 0 && depth > 0) {
+               depth--;
+            }
+            break;
+         case kEventSaysGoodbye:
+            customer.done_ns_ = now;
+            customer.outcome_ = kVisitServed;
+            if (interval != NULL) {
+               interval->served_++;
+            }
+            break;
+         default:
+            break;
+         }
+      } else {
+         size_t id = (size_t) -event.actor_;
+         if (id >= barbers.size()) {
+            barbers.resize(id + 1);
+         }
+         BarberTimeline& barber = barbers[id];
+         switch (event.code_) {
+         case kEventBarberSleeps:
+            barber.sleeps_++;
+            barber.asleep_ = true;
+            break;
+         case kEventStartsHaircut:
+            barber.busy_since_ns_ = now;
+            if (barber.asleep_) {
+               barber.wakeups_++;
+               barber.asleep_ = false;
+            }
+            break;
+         case kEventDoneHaircut:
+            if (barber.busy_since_ns_ != 0) {
+               barber.busy_ns_ += now - barber.busy_since_ns_;
+               if (service_out != NULL) {
+                  fprintf(service_out, "%.3f\n", (now - barber.busy_since_ns_) / 1e3);
+               }
+               barber.busy_since_ns_ = 0;
+            }
+            barber.served_++;
+            break;
+         default:
+            break;
+         }
+      }
+
+      if (depth != old_depth) {
+         depth_area += (double) old_depth * (now - depth_since_ns);
+         depth_since_ns = now;
+         if (depth > peak_depth) {
+            peak_depth = depth;
+            peak_depth_ns = now;
+         }
+      }
+      if (interval != NULL) {
+         interval->max_depth_ = max(interval->max_depth_, max(old_depth, depth));
+         interval->end_depth_ = depth;
+         interval->seen_ = true;
+      }
+   }
+   depth_area += (double) depth * (end_ns - depth_since_ns);
+
+   if (arrivals_out != NULL) {
+      fclose(arrivals_out);
+   }
+   if (service_out != NULL) {
+      fclose(service_out);
+   }
+
+   Histogram wait;
+   Histogram sojourn;
+   long outcomes[kVisitReneged + 1] = {0};
+   for (unordered_map<int, CustomerTimeline>::const_iterator it = customers.begin(); it != customers.end(); ++it) {
+      const CustomerTimeline& customer = it->second;
+      outcomes[customer.outcome_]++;
+      if (customer.outcome_ == kVisitServed) {
+         if (customer.start_ns_ != 0) {
+            wait.record(customer.start_ns_ - customer.arrive_ns_);
+         }
+         sojourn.record(customer.done_ns_ - customer.arrive_ns_);
+      }
+   }
+
+   double span_ns = (double) (end_ns - start_ns);
+   if (runs.size() > 1) {
+      printf("# trace %s: run %d of %lu, %lu events over %.3f ms\n", path, run,
+             (unsigned long) runs.size(), (unsigned long) (last - first), span_ns / 1e6);
+   } else {
+      printf("# trace %s: %lu events over %.3f ms\n", path, (unsigned long) (last - first), span_ns / 1e6);
+   }
+   printf("customers: %lu arrived, %ld served, %ld balked, %ld reneged, %ld still in the shop\n",
+          (unsigned long) customers.size(), outcomes[kVisitServed], outcomes[kVisitBalked],
+          outcomes[kVisitReneged], outcomes[kVisitOpen]);
+   if (wait.get_count() > 0) {
+      printf("%-8s %9s %9s %9s %9s %9s\n", "us", "mean", "p50", "p99", "p999", "max");
+      printf("%-8s %9.1f %9.1f %9.1f %9.1f %9.1f\n", "wait", wait.get_mean() / 1e3,
+             wait.percentile(50) / 1e3, wait.percentile(99) / 1e3,
+             wait.percentile(99.9) / 1e3, wait.get_max() / 1e3);
+      printf("%-8s %9.1f %9.1f %9.1f %9.1f %9.1f\n", "sojourn", sojourn.get_mean() / 1e3,
+             sojourn.percentile(50) / 1e3, sojourn.percentile(99) / 1e3,
+             sojourn.percentile(99.9) / 1e3, sojourn.get_max() / 1e3);
+   }
+   printf("queue depth: peak %d at %.3f ms, mean %.2f\n", peak_depth,
+          (peak_depth_ns - start_ns) / 1e6, (span_ns > 0) ? depth_area / span_ns : 0.0);
+
+   printf("%7s %8s %6s %7s %8s\n", "barber", "served", "util%", "sleeps", "wakeups");
+   for (size_t b = 0; b < barbers.size(); b++) {
+      const BarberTimeline& barber = barbers[b];
+      if (barber.served_ == 0 && barber.sleeps_ == 0) {
+         continue;
+      }
+      printf("%7lu %8ld %6.1f %7ld %8ld\n", (unsigned long) b, barber.served_,
+             (span_ns > 0) ? 100.0 * barber.busy_ns_ / span_ns : 0.0, barber.sleeps_, barber.wakeups_);
+   }
+
+   if (depth_ns > 0) {
+      printf("%10s %6s %6s %9s %7s\n", "t_ms", "depth", "max", "arrivals", "served");
+      int last_depth = 0;
+      for (size_t i = 0; i < intervals.size(); i++) {
+         DepthInterval& interval = intervals[i];
+         /** an interval without events keeps the depth it started with */
+         if (interval.max_depth_ < last_depth) {
+            interval.max_depth_ = last_depth;
+         }
+         printf("%10.3f %6d %6d %9ld %7ld\n", (double) (i * depth_ns) / 1e6, last_depth,
+                interval.max_depth_, interval.arrivals_, interval.served_);
+         if (interval.seen_) {
+            last_depth = interval.end_depth_;
+         }
+      }
+   }
+   return 0;
+}
+
+/**
+ * Prints the events of one customer within one run, and the starts and
+ * ends of their hair-cut, with the time since the start of the run.
+ * Calls EventLog::format method.
+ * @param trace the trace
+ * @param first first event of the run
+ * @param last event after the run
+ * @param id id of the customer
+ * @return none
+ * @custom.preconditions  id > 0, first < last <= trace.get_size()
+ * @custom.postconditions  timeline written to stdout
+ **/
+static void printTimeline(const EventTrace& trace, size_t first, size_t last, int id)
+{
+   uint64_t start_ns = trace.at(first).timestamp_ns_;
+   char line[160];
+   long found = 0;
+   for (size_t i = first; i < last; i++) {
+      const EventRecord& event = trace.at(i);
+      bool barber_event = event.actor_ <= 0 && event.arg0_ == id &&
+                          (event.code_ == kEventStartsHaircut || event.code_ == kEventDoneHaircut);
+      if (event.actor_ != id && !barber_event) {
+         continue;
+      }
+      EventLog::format(event, line, sizeof(line));
+      printf("%12.3f ms  %s\n", (event.timestamp_ns_ - start_ns) / 1e6, line);
+      found++;
+   }
+   if (found == 0) {
+      printf("# customer %d does not appear in the run\n", id);
+   }
+}
+
+/**
+ * Lists the runs of a trace with their number of events and length.
+ * Calls EventLog::format method.
+ * @param trace the trace
+ * @param runs first event of every run
+ * @return none
+ * @custom.preconditions  runs not empty
+ * @custom.postconditions  runs written to stdout
+ **/
+static void printRuns(const EventTrace& trace, const vector<size_t>& runs)
+{
+   char line[160];
+   for (size_t k = 0; k < runs.size(); k++) {
+      size_t last = (k + 1 < runs.size()) ? runs[k + 1] : trace.get_size();
+      /** the marker is the first event of every run but the first */
+      size_t marker = runs[k];
+      while (marker < last && trace.at(marker).code_ != kEventRunStarts) {
+         marker++;
+      }
+      if (marker < last) {
+         EventLog::format(trace.at(marker), line, sizeof(line));
+      } else {
+         snprintf(line, sizeof(line), "run %lu", (unsigned long) (k + 1));
+      }
+      printf("# run %3lu: %-22s %9lu events over %.3f ms\n", (unsigned long) (k + 1), line,
+             (unsigned long) (last - runs[k]),
+             (trace.at(last - 1).timestamp_ns_ - trace.at(runs[k]).timestamp_ns_) / 1e6);
+   }
+}
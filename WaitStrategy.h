@@ -0,0 +1,248 @@
+/**
+ * WaitStrategy.h
+ *
+ * This is the WaitStrategy.h file that defines how Shop threads wait for
+ * one another. Every wait in the shop is a predicate over shop state
+ * guarded by a mutex and signaled through a condition variable, or a
+ * futex word holding a value the waiter wants to change. Three policies
+ * implement both kinds of wait:
+ *
+ * BlockingWait parks on the condition variable or futex at once, the
+ * original behaviour and the cheapest when waits are long.
+ *
+ * SpinThenParkWait first polls a futex word for up to SHOP_WAIT_SPINS
+ * rounds and only then parks. A hand-off that completes within the budget
+ * costs no sleep or wake-up. Predicates guarded by the mutex are not
+ * polled: each poll would drop and retake the mutex the thread being
+ * waited for needs, so those waits park at once as in BlockingWait. With
+ * a single CPU online the thread being waited for cannot run while we
+ * poll, so the budget is zero and it behaves like BlockingWait.
+ *
+ * YieldWait never parks and gives the CPU away between polls, for runs
+ * where every thread has a dedicated core.
+ *
+ * The policy is chosen at compile time with SHOP_WAIT_STRATEGY and Shop
+ * uses it through the ShopWait typedef, so the default blocking build
+ * contains no dispatch. Signalers always signal, which costs nothing
+ * when the waiter is still polling.
+ **/
+#ifndef WAIT_STRATEGY_H_
+#define WAIT_STRATEGY_H_
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include "Futex.h"
+using namespace std;
+
+/** wait strategies SHOP_WAIT_STRATEGY can select */
+#define kWaitBlocking 0
+#define kWaitSpinThenPark 1
+#define kWaitYield 2
+
+/** wait strategy compiled into Shop, e.g. -DSHOP_WAIT_STRATEGY=kWaitSpinThenPark */
+#ifndef SHOP_WAIT_STRATEGY
+#define SHOP_WAIT_STRATEGY kWaitBlocking
+#endif
+
+/** polls of SpinThenParkWait before it parks */
+#ifndef SHOP_WAIT_SPINS
+#define SHOP_WAIT_SPINS 1000
+#endif
+
+/**
+ * Tells the CPU the caller is in a polling loop.
+ * No other methods are called.
+ * @return none
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+inline void cpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+   __builtin_ia32_pause();
+#elif defined(__aarch64__)
+   asm volatile("yield");
+#endif
+}
+
+/**
+ * This returns the number of polls SpinThenParkWait makes before parking.
+ * No other methods are called.
+ * @return SHOP_WAIT_SPINS, 0 with a single CPU online
+ * @custom.preconditions  none
+ * @custom.postconditions  none
+ **/
+inline int spinBudget()
+{
+   static const int budget = (sysconf(_SC_NPROCESSORS_ONLN) > 1) ? SHOP_WAIT_SPINS : 0;
+   return budget;
+}
+
+/** parks on the condition variable or futex right away */
+struct BlockingWait {
+
+   /**
+    * Waits until done() holds, parked on cond.
+    * No other methods are called.
+    * @param cond condition variable signaled after done() may have changed
+    * @param mutex mutex guarding the state done() reads
+    * @param done predicate to wait for
+    * @return none
+    * @custom.preconditions  mutex held by the caller
+    * @custom.postconditions  mutex held, done() is true
+    **/
+   template<class Predicate>
+   static void wait(pthread_cond_t* cond, pthread_mutex_t* mutex, Predicate done)
+   {
+      while (!done()) {
+         pthread_cond_wait(cond, mutex);
+      }
+   }
+
+   /**
+    * Waits until word no longer holds value, parked on the futex.
+    * Calls futexWait method.
+    * @param word futex word woken after it changes
+    * @param value value to wait out
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  word != value was observed
+    **/
+   static void waitWhile(atomic<int>* word, int value)
+   {
+      while (word->load(memory_order_acquire) == value) {
+         futexWait(word, value);
+      }
+   }
+
+   /**
+    * This returns the name of the strategy for reports.
+    * No other methods are called.
+    * @return name of the strategy
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static const char* name()
+   {
+      return "blocking";
+   }
+};
+
+/** polls futex words for a while, then parks like BlockingWait */
+struct SpinThenParkWait {
+
+   /**
+    * Waits until done() holds, parked on cond. Polling would take the
+    * mutex away from the thread that makes done() true, so this parks
+    * at once.
+    * Calls BlockingWait::wait method.
+    * @param cond condition variable signaled after done() may have changed
+    * @param mutex mutex guarding the state done() reads
+    * @param done predicate to wait for
+    * @return none
+    * @custom.preconditions  mutex held by the caller
+    * @custom.postconditions  mutex held, done() is true
+    **/
+   template<class Predicate>
+   static void wait(pthread_cond_t* cond, pthread_mutex_t* mutex, Predicate done)
+   {
+      BlockingWait::wait(cond, mutex, done);
+   }
+
+   /**
+    * Waits until word no longer holds value, polling it spinBudget()
+    * times before parking on the futex.
+    * Calls spinBudget and BlockingWait::waitWhile methods.
+    * @param word futex word woken after it changes
+    * @param value value to wait out
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  word != value was observed
+    **/
+   static void waitWhile(atomic<int>* word, int value)
+   {
+      int budget = spinBudget();
+      for (int spins = 0; spins < budget; spins++) {
+         if (word->load(memory_order_acquire) != value) {
+            return;
+         }
+         cpuRelax();
+      }
+      BlockingWait::waitWhile(word, value);
+   }
+
+   /**
+    * This returns the name of the strategy for reports.
+    * No other methods are called.
+    * @return name of the strategy
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static const char* name()
+   {
+      return "spin-then-park";
+   }
+};
+
+/** polls until done, yielding the CPU between polls, and never parks */
+struct YieldWait {
+
+   /**
+    * Waits until done() holds, yielding with the mutex released between
+    * polls.
+    * No other methods are called.
+    * @param cond unused, signalers still signal it
+    * @param mutex mutex guarding the state done() reads
+    * @param done predicate to wait for
+    * @return none
+    * @custom.preconditions  mutex held by the caller
+    * @custom.postconditions  mutex held, done() is true
+    **/
+   template<class Predicate>
+   static void wait(pthread_cond_t* /* cond */, pthread_mutex_t* mutex, Predicate done)
+   {
+      while (!done()) {
+         pthread_mutex_unlock(mutex);
+         sched_yield();
+         pthread_mutex_lock(mutex);
+      }
+   }
+
+   /**
+    * Waits until word no longer holds value, yielding between polls.
+    * No other methods are called.
+    * @param word word to poll
+    * @param value value to wait out
+    * @return none
+    * @custom.preconditions  none
+    * @custom.postconditions  word != value was observed
+    **/
+   static void waitWhile(atomic<int>* word, int value)
+   {
+      while (word->load(memory_order_acquire) == value) {
+         sched_yield();
+      }
+   }
+
+   /**
+    * This returns the name of the strategy for reports.
+    * No other methods are called.
+    * @return name of the strategy
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   static const char* name()
+   {
+      return "yield";
+   }
+};
+
+#if SHOP_WAIT_STRATEGY == kWaitSpinThenPark
+typedef SpinThenParkWait ShopWait;
+#elif SHOP_WAIT_STRATEGY == kWaitYield
+typedef YieldWait ShopWait;
+#else
+typedef BlockingWait ShopWait;
+#endif
+#endif
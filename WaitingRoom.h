@@ -0,0 +1,263 @@
+/**
+ * WaitingRoom.h
+ *
+ * This is the WaitingRoom.h file that defines the lock-free building blocks
+ * of the shop's optional lock-free waiting room. LockFreeRing is a fixed
+ * capacity multi-producer multi-consumer ring buffer in which every cell
+ * carries a sequence number telling producers and consumers whose turn it
+ * is, so a push or a pop is a single compare-and-swap on its position in
+ * the uncontended case. BarberSet is a bitmap of free barbers that
+ * customers and barbers claim and release with atomic bit operations.
+ *
+ * Neither class blocks. Parking threads that find nothing to do is left
+ * to the Shop class.
+ **/
+#ifndef WAITING_ROOM_H_
+#define WAITING_ROOM_H_
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+using namespace std;
+
+#define kCacheLineSize 64
+
+template <typename T>
+class LockFreeRing
+{
+public:
+
+   /**
+    * Creates a ring that holds at least min_capacity values. The capacity
+    * is rounded up to a power of two.
+    * No other methods are called.
+    * @param min_capacity minimum number of values the ring can hold
+    * @return none
+    * @custom.preconditions  min_capacity >= 0
+    * @custom.postconditions  empty ring allocated
+    **/
+   explicit LockFreeRing(int min_capacity) : enqueue_pos_(0), dequeue_pos_(0)
+   {
+      size_t capacity = 2;
+      while (capacity < (size_t) min_capacity) {
+         capacity <<= 1;
+      }
+      mask_ = capacity - 1;
+      cells_ = new Cell[capacity];
+      for (size_t i = 0; i < capacity; i++) {
+         cells_[i].sequence_.store(i, memory_order_relaxed);
+      }
+   }
+
+   /**
+    * Destructor for LockFreeRing class.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  no thread is using the ring
+    * @custom.postconditions  cells released
+    **/
+   ~LockFreeRing()
+   {
+      delete[] cells_;
+   }
+
+   /**
+    * Appends value to the tail of the ring.
+    * No other methods are called.
+    * @param value value to append
+    * @return false if the ring is full or the tail cell is still being read
+    * @custom.preconditions  none
+    * @custom.postconditions  value visible to consumers on success
+    **/
+   bool tryPush(const T& value)
+   {
+      size_t pos = enqueue_pos_.load(memory_order_relaxed);
+      while (true) {
+         Cell& cell = cells_[pos & mask_];
+         size_t seq = cell.sequence_.load(memory_order_acquire);
+         intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+         if (diff == 0) {
+            if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+               cell.value_ = value;
+               cell.sequence_.store(pos + 1, memory_order_release);
+               return true;
+            }
+         } else if (diff < 0) {
+            return false;
+         } else {
+            pos = enqueue_pos_.load(memory_order_relaxed);
+         }
+      }
+   }
+
+   /**
+    * Removes the value at the head of the ring.
+    * No other methods are called.
+    * @param value set to the removed value on success
+    * @return false if the ring is empty or the head cell is still being written
+    * @custom.preconditions  none
+    * @custom.postconditions  oldest value removed on success
+    **/
+   bool tryPop(T& value)
+   {
+      size_t pos = dequeue_pos_.load(memory_order_relaxed);
+      while (true) {
+         Cell& cell = cells_[pos & mask_];
+         size_t seq = cell.sequence_.load(memory_order_acquire);
+         intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+         if (diff == 0) {
+            if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+               value = cell.value_;
+               cell.sequence_.store(pos + mask_ + 1, memory_order_release);
+               return true;
+            }
+         } else if (diff < 0) {
+            return false;
+         } else {
+            pos = dequeue_pos_.load(memory_order_relaxed);
+         }
+      }
+   }
+
+private:
+
+   struct Cell {
+      /** position a producer (== pos) or consumer (== pos + 1) waits for */
+      atomic<size_t> sequence_;
+      /** value stored in the cell */
+      T value_;
+   };
+
+   /** capacity - 1, capacity is a power of two */
+   size_t mask_;
+   /** ring storage */
+   Cell* cells_;
+   /** next position to push, on its own cache line */
+   alignas(kCacheLineSize) atomic<size_t> enqueue_pos_;
+   /** next position to pop, on its own cache line */
+   alignas(kCacheLineSize) atomic<size_t> dequeue_pos_;
+};
+
+class BarberSet
+{
+public:
+
+   /**
+    * Creates a set able to hold barber ids 0 ~ num_barbers - 1. The set
+    * starts out empty.
+    * No other methods are called.
+    * @param num_barbers number of barber ids the set covers
+    * @return none
+    * @custom.preconditions  num_barbers >= 1
+    * @custom.postconditions  empty set allocated
+    **/
+   explicit BarberSet(int num_barbers) : num_words_((num_barbers + 63) / 64)
+   {
+      words_ = new atomic<uint64_t>[num_words_];
+      for (int i = 0; i < num_words_; i++) {
+         words_[i].store(0, memory_order_relaxed);
+      }
+   }
+
+   /**
+    * Destructor for BarberSet class.
+    * No other methods are called.
+    * @return none
+    * @custom.preconditions  no thread is using the set
+    * @custom.postconditions  set released
+    **/
+   ~BarberSet()
+   {
+      delete[] words_;
+   }
+
+   /**
+    * Adds a barber to the set.
+    * No other methods are called.
+    * @param id barber id to add
+    * @return none
+    * @custom.preconditions  id is not in the set
+    * @custom.postconditions  id is in the set
+    **/
+   void release(int id)
+   {
+      words_[id / 64].fetch_or((uint64_t) 1 << (id % 64));
+   }
+
+   /**
+    * Removes the lowest free barber id from the set.
+    * No other methods are called.
+    * @param id set to the claimed barber id on success
+    * @return false if the set was empty
+    * @custom.preconditions  none
+    * @custom.postconditions  claimed id is no longer in the set
+    **/
+   bool tryClaim(int& id)
+   {
+      for (int i = 0; i < num_words_; i++) {
+         uint64_t word = words_[i].load();
+         while (word != 0) {
+            int bit = __builtin_ctzll(word);
+            if (words_[i].compare_exchange_weak(word, word & ~((uint64_t) 1 << bit))) {
+               id = i * 64 + bit;
+               return true;
+            }
+         }
+      }
+      return false;
+   }
+
+   /**
+    * Removes a given barber from the set if it is in it.
+    * No other methods are called.
+    * @param id barber id to remove
+    * @return true if the barber was in the set and this call removed it
+    * @custom.preconditions  none
+    * @custom.postconditions  id is not in the set
+    **/
+   bool tryRemove(int id)
+   {
+      uint64_t bit = (uint64_t) 1 << (id % 64);
+      return (words_[id / 64].fetch_and(~bit) & bit) != 0;
+   }
+
+   /**
+    * This returns the number of barbers in the set.
+    * No other methods are called.
+    * @return number of free barbers, a snapshot while others change the set
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   int count() const
+   {
+      int free = 0;
+      for (int i = 0; i < num_words_; i++) {
+         free += __builtin_popcountll(words_[i].load());
+      }
+      return free;
+   }
+
+   /**
+    * This returns true if no barber is in the set.
+    * No other methods are called.
+    * @return true if the set is empty
+    * @custom.preconditions  none
+    * @custom.postconditions  none
+    **/
+   bool empty() const
+   {
+      for (int i = 0; i < num_words_; i++) {
+         if (words_[i].load() != 0) {
+            return false;
+         }
+      }
+      return true;
+   }
+
+private:
+
+   /** number of 64 bit words in the bitmap */
+   int num_words_;
+   /** bitmap, bit i set when barber i is free */
+   atomic<uint64_t>* words_;
+};
+#endif